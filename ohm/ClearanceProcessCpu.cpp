@@ -0,0 +1,847 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ClearanceProcessCpu.h"
+
+#include "DefaultLayer.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "VoxelBuffer.h"
+#include "VoxelOccupancy.h"
+
+#include "private/ClearanceInfo.h"
+#include "private/DynamicEdt.h"
+#include "private/OccupancyMapDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/glm.hpp>
+
+#include <ohmutil/VectorHash.h>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+const unsigned kDefaultBatchSize = 16u;
+/// Minimum squared axis weighting. Avoids division by zero in the lower envelope for zero axis scaling.
+const float kMinWeightSqr = 1e-6f;
+
+/// Parameters for the distance transform of a single region.
+struct EdtParams
+{
+  /// Region voxel dimensions.
+  glm::ivec3 region_dim{ 0 };
+  /// Number of padding voxels on each side of the region along each axis.
+  glm::ivec3 padding{ 0 };
+  /// Number of regions to visit either side of the target region to fill the padding.
+  glm::ivec3 region_padding{ 0 };
+  /// Working grid dimensions: region dimensions plus padding.
+  glm::ivec3 grid_dim{ 0 };
+  /// Squared axis scaling applied to the distance metric.
+  glm::vec3 weight_sqr{ 1.0f };
+  float resolution = 0;
+  float occupancy_threshold = 0;
+  float search_radius_sqr = 0;
+  int occupancy_layer = -1;
+  int clearance_layer = -1;
+  OccupancyEncoding occupancy_encoding = OccupancyEncoding::kFloat;
+  bool unknown_as_occupied = false;
+  bool report_unscaled = false;
+
+  inline size_t gridIndex(int x, int y, int z) const
+  {
+    return size_t(x) + size_t(grid_dim.x) * (size_t(y) + size_t(grid_dim.y) * size_t(z));
+  }
+
+  inline size_t gridVolume() const { return size_t(grid_dim.x) * size_t(grid_dim.y) * size_t(grid_dim.z); }
+};
+
+/// Working memory for processing a region. One per thread.
+struct EdtWorkspace
+{
+  /// Squared distance to the nearest obstruction in voxel units for each grid cell.
+  std::vector<float> dist;
+  /// Grid index of the nearest obstruction for each grid cell or -1 when none.
+  std::vector<int> site;
+  /// Region clearance results.
+  std::vector<float> clearance;
+  // Scratch buffers for a single line transform.
+  std::vector<float> f;
+  std::vector<int> f_site;
+  std::vector<int> v;
+  std::vector<double> z;
+};
+
+/// A region to process and the stamp to apply to its clearance layer.
+struct RegionWork
+{
+  MapChunk *chunk;
+  uint64_t target_stamp;
+};
+
+
+EdtParams makeParams(const OccupancyMap &map, float search_radius, unsigned query_flags,
+                     const glm::vec3 &axis_scaling)
+{
+  EdtParams params;
+  params.region_dim = glm::ivec3(map.regionVoxelDimensions());
+  params.padding = (search_radius > 0) ? calculateVoxelSearchHalfExtents(map, search_radius) : glm::ivec3(0);
+  params.region_padding = (params.padding + params.region_dim - glm::ivec3(1)) / params.region_dim;
+  params.grid_dim = params.region_dim + 2 * params.padding;
+  params.weight_sqr = glm::max(axis_scaling * axis_scaling, glm::vec3(kMinWeightSqr));
+  params.resolution = float(map.resolution());
+  params.occupancy_threshold = map.occupancyThresholdValue();
+  params.search_radius_sqr = std::max(search_radius, 0.0f) * std::max(search_radius, 0.0f);
+  params.occupancy_layer = map.layout().occupancyLayer();
+  params.clearance_layer = map.layout().clearanceLayer();
+  params.occupancy_encoding = map.occupancyEncoding();
+  params.unknown_as_occupied = (query_flags & kQfUnknownAsOccupied) != 0;
+  params.report_unscaled = (query_flags & kQfReportUnscaledResults) != 0;
+  return params;
+}
+
+
+/// Calculate the stamp the clearance layer of @p region_key must reach to be up to date: the maximum occupancy stamp
+/// of the regions within the padding. Map mutex must be locked.
+uint64_t targetStamp(const ChunkMap &chunks, const RegionKey &region_key, const EdtParams &params)
+{
+  uint64_t target_stamp = 0;
+  for (int z = -params.region_padding.z; z <= params.region_padding.z; ++z)
+  {
+    for (int y = -params.region_padding.y; y <= params.region_padding.y; ++y)
+    {
+      for (int x = -params.region_padding.x; x <= params.region_padding.x; ++x)
+      {
+        const RegionKey neighbour_key(region_key.x + x, region_key.y + y, region_key.z + z);
+        const auto search = chunks.find(neighbour_key);
+        if (search != chunks.end())
+        {
+          target_stamp = std::max(target_stamp, uint64_t(search->second->touched_stamps[params.occupancy_layer]));
+        }
+      }
+    }
+  }
+  return target_stamp;
+}
+
+
+/// Seed the working grid with zero distance at obstructed voxels and infinite distance elsewhere.
+/// @return True if any obstruction is present in the grid.
+bool seedGrid(const OccupancyMap &map, const RegionKey &region_key, const EdtParams &params, EdtWorkspace &work)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  // Absent regions and uninitialised blocks are unobserved.
+  work.dist.assign(params.gridVolume(), params.unknown_as_occupied ? 0.0f : inf);
+  bool have_obstruction = params.unknown_as_occupied;
+
+  for (int rz = -params.region_padding.z; rz <= params.region_padding.z; ++rz)
+  {
+    for (int ry = -params.region_padding.y; ry <= params.region_padding.y; ++ry)
+    {
+      for (int rx = -params.region_padding.x; rx <= params.region_padding.x; ++rx)
+      {
+        const MapChunk *chunk = map.region(RegionKey(region_key.x + rx, region_key.y + ry, region_key.z + rz));
+        if (!chunk || chunk->voxel_blocks[params.occupancy_layer]->isUninitialised())
+        {
+          continue;
+        }
+
+        // Grid coordinates of the region's first voxel and the overlap of the region with the grid.
+        const glm::ivec3 region_origin = glm::ivec3(rx, ry, rz) * params.region_dim + params.padding;
+        const glm::ivec3 begin = glm::max(glm::ivec3(0), -region_origin);
+        const glm::ivec3 end = glm::min(params.region_dim, params.grid_dim - region_origin);
+
+        VoxelBuffer<const VoxelBlock> occupancy_buffer(chunk->voxel_blocks[params.occupancy_layer]);
+        const uint8_t *occupancy_mem = occupancy_buffer.voxelMemory();
+        for (int z = begin.z; z < end.z; ++z)
+        {
+          for (int y = begin.y; y < end.y; ++y)
+          {
+            size_t grid_index = params.gridIndex(region_origin.x + begin.x, region_origin.y + y, region_origin.z + z);
+            unsigned voxel_index = voxelIndex(begin.x, y, z, params.region_dim.x, params.region_dim.y, 0);
+            for (int x = begin.x; x < end.x; ++x, ++grid_index, ++voxel_index)
+            {
+              const float value = readOccupancy(occupancy_mem, voxel_index, params.occupancy_encoding);
+              const bool unobserved = value == unobservedOccupancyValue();
+              const bool obstructed = (!unobserved && value >= params.occupancy_threshold) ||
+                                      (unobserved && params.unknown_as_occupied);
+              work.dist[grid_index] = (obstructed) ? 0.0f : inf;
+              have_obstruction = have_obstruction || obstructed;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return have_obstruction;
+}
+
+
+/// Perform the one dimensional squared distance transform along a grid line using the lower envelope of parabolas.
+///
+/// @param work Working memory. Distances and sites are updated in place.
+/// @param base_index Grid index of the first cell of the line.
+/// @param stride Grid index step between cells of the line.
+/// @param count Number of cells in the line.
+/// @param weight_sqr Squared axis scaling for the line axis.
+/// @param seed_sites True for the first pass: obstructions are their own nearest site.
+/// @param out_begin First cell of the line for which results are required.
+/// @param out_end One past the last cell of the line for which results are required.
+void transformLine(EdtWorkspace &work, size_t base_index, size_t stride, int count, float weight_sqr,
+                   bool seed_sites, int out_begin, int out_end)
+{
+  const float inf = std::numeric_limits<float>::infinity();
+  float *f = work.f.data();
+  int *f_site = work.f_site.data();
+  int *v = work.v.data();
+  double *z = work.z.data();
+
+  for (int q = 0; q < count; ++q)
+  {
+    const size_t grid_index = base_index + q * stride;
+    f[q] = work.dist[grid_index];
+    f_site[q] = (seed_sites) ? ((f[q] < inf) ? int(grid_index) : -1) : work.site[grid_index];
+  }
+
+  // Build the lower envelope from the cells with a finite distance.
+  int k = -1;
+  for (int q = 0; q < count; ++q)
+  {
+    if (f[q] == inf)
+    {
+      continue;
+    }
+
+    double s = 0;
+    while (k >= 0)
+    {
+      const int p = v[k];
+      s = ((double(f[q]) + weight_sqr * double(q) * q) - (double(f[p]) + weight_sqr * double(p) * p)) /
+          (2.0 * weight_sqr * (q - p));
+      if (s > z[k])
+      {
+        break;
+      }
+      --k;
+    }
+
+    ++k;
+    v[k] = q;
+    z[k] = (k > 0) ? s : -std::numeric_limits<double>::infinity();
+    z[k + 1] = std::numeric_limits<double>::infinity();
+  }
+
+  if (k < 0)
+  {
+    // No obstructions along the line.
+    for (int q = out_begin; q < out_end; ++q)
+    {
+      work.dist[base_index + q * stride] = inf;
+      work.site[base_index + q * stride] = -1;
+    }
+    return;
+  }
+
+  int j = 0;
+  for (int q = out_begin; q < out_end; ++q)
+  {
+    while (z[j + 1] < q)
+    {
+      ++j;
+    }
+    const int separation = q - v[j];
+    work.dist[base_index + q * stride] = weight_sqr * float(separation * separation) + f[v[j]];
+    work.site[base_index + q * stride] = f_site[v[j]];
+  }
+}
+
+
+/// Calculate the clearance values for a region into @c work.clearance .
+/// @param seed Optional incremental state seed to populate with the distances and nearest obstruction offsets.
+void calculateClearance(const OccupancyMap &map, const RegionKey &region_key, const EdtParams &params,
+                        EdtWorkspace &work, DynamicEdt::RegionSeed *seed = nullptr)
+{
+  const size_t region_volume = size_t(params.region_dim.x) * params.region_dim.y * params.region_dim.z;
+  work.clearance.resize(region_volume);
+  if (seed)
+  {
+    seed->dist_sqr.resize(region_volume);
+    seed->obstruction.resize(region_volume);
+  }
+
+  if (!seedGrid(map, region_key, params, work))
+  {
+    std::fill(work.clearance.begin(), work.clearance.end(), -1.0f);
+    if (seed)
+    {
+      std::fill(seed->dist_sqr.begin(), seed->dist_sqr.end(), std::numeric_limits<float>::infinity());
+    }
+    return;
+  }
+
+  const int max_dim = std::max(params.grid_dim.x, std::max(params.grid_dim.y, params.grid_dim.z));
+  work.site.resize(params.gridVolume());
+  work.f.resize(max_dim);
+  work.f_site.resize(max_dim);
+  work.v.resize(max_dim);
+  work.z.resize(max_dim + 1);
+
+  const glm::ivec3 &pad = params.padding;
+  const glm::ivec3 &grid = params.grid_dim;
+  const glm::ivec3 roi_end = pad + params.region_dim;
+
+  // X pass over all grid rows. Only the target region columns are needed by later passes.
+  for (int z = 0; z < grid.z; ++z)
+  {
+    for (int y = 0; y < grid.y; ++y)
+    {
+      transformLine(work, params.gridIndex(0, y, z), 1u, grid.x, params.weight_sqr.x, true, pad.x, roi_end.x);
+    }
+  }
+
+  // Y pass over the target region columns.
+  for (int z = 0; z < grid.z; ++z)
+  {
+    for (int x = pad.x; x < roi_end.x; ++x)
+    {
+      transformLine(work, params.gridIndex(x, 0, z), size_t(grid.x), grid.y, params.weight_sqr.y, false, pad.y,
+                    roi_end.y);
+    }
+  }
+
+  // Z pass over the target region only.
+  for (int y = pad.y; y < roi_end.y; ++y)
+  {
+    for (int x = pad.x; x < roi_end.x; ++x)
+    {
+      transformLine(work, params.gridIndex(x, y, 0), size_t(grid.x) * grid.y, grid.z, params.weight_sqr.z, false,
+                    pad.z, roi_end.z);
+    }
+  }
+
+  const float resolution_sqr = params.resolution * params.resolution;
+  unsigned voxel_index = 0;
+  for (int z = pad.z; z < roi_end.z; ++z)
+  {
+    for (int y = pad.y; y < roi_end.y; ++y)
+    {
+      for (int x = pad.x; x < roi_end.x; ++x, ++voxel_index)
+      {
+        const size_t grid_index = params.gridIndex(x, y, z);
+        const float dist_sqr = work.dist[grid_index];
+        const int site = work.site[grid_index];
+        if (seed)
+        {
+          seed->dist_sqr[voxel_index] = (site >= 0) ? dist_sqr : std::numeric_limits<float>::infinity();
+          if (site >= 0)
+          {
+            seed->obstruction[voxel_index] =
+              glm::i16vec3(site % grid.x - x, (site / grid.x) % grid.y - y, site / (grid.x * grid.y) - z);
+          }
+        }
+        float clearance = -1.0f;
+        if (dist_sqr == 0)
+        {
+          clearance = 0.0f;
+        }
+        else if (site >= 0)
+        {
+          float range_sqr = dist_sqr * resolution_sqr;
+          if (params.report_unscaled)
+          {
+            const int site_x = site % grid.x;
+            const int site_y = (site / grid.x) % grid.y;
+            const int site_z = site / (grid.x * grid.y);
+            const glm::vec3 separation(site_x - x, site_y - y, site_z - z);
+            range_sqr = glm::dot(separation, separation) * resolution_sqr;
+          }
+
+          if (range_sqr <= params.search_radius_sqr)
+          {
+            clearance = std::sqrt(range_sqr);
+          }
+        }
+        work.clearance[voxel_index] = clearance;
+      }
+    }
+  }
+}
+
+
+/// Calculate and write the clearance values for @p region .
+void processRegion(const OccupancyMap &map, const RegionWork &region, const EdtParams &params, EdtWorkspace &work)
+{
+  calculateClearance(map, region.chunk->region.coord, params, work);
+  VoxelBuffer<VoxelBlock> clearance_buffer(region.chunk->voxel_blocks[params.clearance_layer]);
+  memcpy(clearance_buffer.voxelMemory(), work.clearance.data(),
+         std::min(clearance_buffer.voxelMemorySize(), work.clearance.size() * sizeof(float)));
+  region.chunk->touched_stamps[params.clearance_layer] = region.target_stamp;
+}
+
+
+/// Calculate the clearance values for @p region into @p seed , writing the clearance values when the region is present.
+void seedRegion(const OccupancyMap &map, const RegionWork &region, const EdtParams &params, EdtWorkspace &work,
+                DynamicEdt::RegionSeed &seed)
+{
+  calculateClearance(map, seed.key, params, work, &seed);
+  if (region.chunk)
+  {
+    VoxelBuffer<VoxelBlock> clearance_buffer(region.chunk->voxel_blocks[params.clearance_layer]);
+    memcpy(clearance_buffer.voxelMemory(), work.clearance.data(),
+           std::min(clearance_buffer.voxelMemorySize(), work.clearance.size() * sizeof(float)));
+    region.chunk->touched_stamps[params.clearance_layer] = region.target_stamp;
+  }
+}
+
+
+/// Process @p regions , in parallel when supported.
+void processRegions(const OccupancyMap &map, const std::vector<RegionWork> &regions, const EdtParams &params)
+{
+#ifdef OHM_THREADS
+  const auto parallel_process = [&map, &regions, &params](const tbb::blocked_range<size_t> &range) {
+    EdtWorkspace work;
+    for (size_t i = range.begin(); i < range.end(); ++i)
+    {
+      processRegion(map, regions[i], params, work);
+    }
+  };
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, regions.size(), 1u), parallel_process);
+#else   // OHM_THREADS
+  EdtWorkspace work;
+  for (const RegionWork &region : regions)
+  {
+    processRegion(map, region, params, work);
+  }
+#endif  // OHM_THREADS
+}
+}  // namespace
+
+
+/// Pimpl data for @c ClearanceProcessCpu .
+struct ClearanceProcessCpuDetail
+{
+  unsigned query_flags = 0;
+  glm::vec3 axis_scaling = glm::vec3(1);
+  float search_radius = 0;
+  unsigned batch_size = kDefaultBatchSize;
+  /// Out of date regions pending update. Resolved to chunks when processed.
+  std::vector<RegionKey> dirty_regions;
+  /// Next item in @c dirty_regions to process.
+  size_t dirty_cursor = 0;
+  /// Incremental distance transform state. Null unless incremental updates are enabled.
+  std::unique_ptr<DynamicEdt> dynamic_edt;
+
+  inline bool haveWork() const { return dirty_cursor < dirty_regions.size(); }
+
+  /// Get the parameters to record with the clearance layer. See @c updateClearanceInfo() .
+  inline ClearanceInfo clearanceInfo() const
+  {
+    ClearanceInfo info;
+    info.search_radius = search_radius;
+    info.axis_scaling = axis_scaling;
+    info.unknown_as_occupied = (query_flags & kQfUnknownAsOccupied) != 0;
+    info.report_unscaled = (query_flags & kQfReportUnscaledResults) != 0;
+    info.valid = true;
+    return info;
+  }
+
+  inline void resetWorking()
+  {
+    dirty_regions.clear();
+    dirty_cursor = 0;
+  }
+
+  /// Collect out of date regions into @c dirty_regions .
+  void getWork(const OccupancyMap &map, const EdtParams &params);
+
+  /// Resolve up to @p max_regions keys into @p work . Regions which have become up to date are skipped unless
+  /// @p force is set.
+  void resolveWork(const OccupancyMap &map, const EdtParams &params, const RegionKey *keys, size_t key_count,
+                   bool force, std::vector<RegionWork> &work) const;
+
+  /// Seed @c dynamic_edt from a batch distance transform of the whole map, writing the clearance layer.
+  void seedIncremental(const OccupancyMap &map, const EdtParams &params, const DynamicEdt::Params &dynamic_params);
+};
+
+
+void ClearanceProcessCpuDetail::getWork(const OccupancyMap &map, const EdtParams &params)
+{
+  resetWorking();
+  const OccupancyMapDetail &map_data = *map.detail();
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  for (const auto &chunk_ref : map_data.chunks)
+  {
+    if (chunk_ref.second->touched_stamps[params.clearance_layer] < targetStamp(map_data.chunks, chunk_ref.first, params))
+    {
+      dirty_regions.emplace_back(chunk_ref.first);
+    }
+  }
+}
+
+
+void ClearanceProcessCpuDetail::resolveWork(const OccupancyMap &map, const EdtParams &params, const RegionKey *keys,
+                                            size_t key_count, bool force, std::vector<RegionWork> &work) const
+{
+  const OccupancyMapDetail &map_data = *map.detail();
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  work.clear();
+  for (size_t i = 0; i < key_count; ++i)
+  {
+    const auto search = map_data.chunks.find(keys[i]);
+    if (search == map_data.chunks.end())
+    {
+      continue;
+    }
+
+    const uint64_t target_stamp = targetStamp(map_data.chunks, keys[i], params);
+    if (force || search->second->touched_stamps[params.clearance_layer] < target_stamp)
+    {
+      work.emplace_back(RegionWork{ search->second, target_stamp });
+    }
+  }
+}
+
+
+void ClearanceProcessCpuDetail::seedIncremental(const OccupancyMap &map, const EdtParams &params,
+                                                const DynamicEdt::Params &dynamic_params)
+{
+  dynamic_edt->beginSeed(map, dynamic_params);
+
+  // Seed the map regions and, unless unknown space is an obstruction, the absent regions within the padding. Waves
+  // cross absent regions, so these hold distances to the map obstructions.
+  std::vector<RegionKey> keys;
+  {
+    const OccupancyMapDetail &map_data = *map.detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    std::unordered_set<RegionKey, Vector3Hash<RegionKey>> absent;
+    for (const auto &chunk_ref : map_data.chunks)
+    {
+      keys.emplace_back(chunk_ref.first);
+      if (params.unknown_as_occupied)
+      {
+        continue;
+      }
+
+      for (int z = -params.region_padding.z; z <= params.region_padding.z; ++z)
+      {
+        for (int y = -params.region_padding.y; y <= params.region_padding.y; ++y)
+        {
+          for (int x = -params.region_padding.x; x <= params.region_padding.x; ++x)
+          {
+            const RegionKey neighbour_key(chunk_ref.first.x + x, chunk_ref.first.y + y, chunk_ref.first.z + z);
+            if (map_data.chunks.find(neighbour_key) == map_data.chunks.end())
+            {
+              absent.insert(neighbour_key);
+            }
+          }
+        }
+      }
+    }
+    keys.insert(keys.end(), absent.begin(), absent.end());
+  }
+
+  std::vector<RegionWork> work;
+  std::vector<DynamicEdt::RegionSeed> seeds;
+  for (size_t batch_start = 0; batch_start < keys.size(); batch_start += batch_size)
+  {
+    const size_t batch_end = std::min(batch_start + batch_size, keys.size());
+    work.clear();
+    seeds.resize(batch_end - batch_start);
+    {
+      const OccupancyMapDetail &map_data = *map.detail();
+      std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+      for (size_t i = batch_start; i < batch_end; ++i)
+      {
+        const auto search = map_data.chunks.find(keys[i]);
+        DynamicEdt::RegionSeed &seed = seeds[i - batch_start];
+        seed.key = keys[i];
+        seed.present = search != map_data.chunks.end();
+        seed.occupancy_stamp = (seed.present) ? uint64_t(search->second->touched_stamps[params.occupancy_layer]) : 0u;
+        work.emplace_back(RegionWork{ (seed.present) ? search->second : nullptr,
+                                      (seed.present) ? targetStamp(map_data.chunks, keys[i], params) : 0u });
+      }
+    }
+
+#ifdef OHM_THREADS
+    const auto parallel_seed = [&](const tbb::blocked_range<size_t> &range) {
+      EdtWorkspace workspace;
+      for (size_t i = range.begin(); i < range.end(); ++i)
+      {
+        seedRegion(map, work[i], params, workspace, seeds[i]);
+      }
+    };
+    tbb::parallel_for(tbb::blocked_range<size_t>(0u, work.size(), 1u), parallel_seed);
+#else   // OHM_THREADS
+    EdtWorkspace workspace;
+    for (size_t i = 0; i < work.size(); ++i)
+    {
+      seedRegion(map, work[i], params, workspace, seeds[i]);
+    }
+#endif  // OHM_THREADS
+
+    for (const DynamicEdt::RegionSeed &seed : seeds)
+    {
+      dynamic_edt->seed(seed);
+    }
+  }
+
+  dynamic_edt->endSeed();
+}
+
+
+ClearanceProcessCpu::ClearanceProcessCpu()
+  : imp_(new ClearanceProcessCpuDetail)
+{}
+
+
+ClearanceProcessCpu::ClearanceProcessCpu(float search_radius, unsigned query_flags)
+  : ClearanceProcessCpu()
+{
+  setSearchRadius(search_radius);
+  setQueryFlags(query_flags);
+}
+
+
+ClearanceProcessCpu::~ClearanceProcessCpu() = default;
+
+
+float ClearanceProcessCpu::searchRadius() const
+{
+  return imp_->search_radius;
+}
+
+
+void ClearanceProcessCpu::setSearchRadius(float range)
+{
+  imp_->search_radius = range;
+}
+
+
+unsigned ClearanceProcessCpu::queryFlags() const
+{
+  return imp_->query_flags;
+}
+
+
+void ClearanceProcessCpu::setQueryFlags(unsigned flags)
+{
+  imp_->query_flags = flags;
+}
+
+
+glm::vec3 ClearanceProcessCpu::axisScaling() const
+{
+  return imp_->axis_scaling;
+}
+
+
+void ClearanceProcessCpu::setAxisScaling(const glm::vec3 &scaling)
+{
+  imp_->axis_scaling = scaling;
+}
+
+
+void ClearanceProcessCpu::setBatchSize(unsigned batch_size)
+{
+  imp_->batch_size = (batch_size > 0) ? batch_size : kDefaultBatchSize;
+}
+
+
+unsigned ClearanceProcessCpu::batchSize() const
+{
+  return imp_->batch_size;
+}
+
+
+void ClearanceProcessCpu::setIncremental(bool incremental)
+{
+  if (incremental && !imp_->dynamic_edt)
+  {
+    imp_->dynamic_edt = std::make_unique<DynamicEdt>();
+  }
+  else if (!incremental)
+  {
+    imp_->dynamic_edt.reset();
+  }
+}
+
+
+bool ClearanceProcessCpu::incremental() const
+{
+  return imp_->dynamic_edt != nullptr;
+}
+
+
+void ClearanceProcessCpu::reset()
+{
+  imp_->resetWorking();
+  if (imp_->dynamic_edt)
+  {
+    imp_->dynamic_edt->reset();
+  }
+}
+
+
+void ClearanceProcessCpu::ensureClearanceLayer(OccupancyMap &map)
+{
+  if (map.layout().clearanceLayer() != -1)
+  {
+    return;
+  }
+
+  // Duplicate the layout, add the layer and update the map, preserving the current map.
+  MapLayout updated_layout(map.layout());
+  addClearance(updated_layout);
+  map.updateLayout(updated_layout, true);
+}
+
+
+int ClearanceProcessCpu::update(OccupancyMap &map, double time_slice)
+{
+  ClearanceProcessCpuDetail &d = *imp_;
+  ensureClearanceLayer(map);
+  updateClearanceInfo(map, d.clearanceInfo());
+
+  if (d.dynamic_edt)
+  {
+    DynamicEdt::Params dynamic_params;
+    dynamic_params.search_radius = d.search_radius;
+    dynamic_params.axis_scaling = d.axis_scaling;
+    dynamic_params.unknown_as_occupied = (d.query_flags & kQfUnknownAsOccupied) != 0;
+    dynamic_params.report_unscaled = (d.query_flags & kQfReportUnscaledResults) != 0;
+    if (!d.dynamic_edt->isSeeded(map, dynamic_params))
+    {
+      // Seeding from the batch transform is much faster than propagating wavefronts from every obstruction.
+      const EdtParams params = makeParams(map, d.search_radius, d.query_flags, d.axis_scaling);
+      if (params.occupancy_layer < 0)
+      {
+        return kMprUpToDate;
+      }
+      d.seedIncremental(map, params, dynamic_params);
+      return kMprProgressing;
+    }
+
+    const DynamicEdt::Stats stats = d.dynamic_edt->update(map, dynamic_params, time_slice);
+    return (stats.processed_voxels != 0 || stats.regions_written != 0 || stats.pending_voxels != 0) ?
+             kMprProgressing :
+             kMprUpToDate;
+  }
+
+  const EdtParams params = makeParams(map, d.search_radius, d.query_flags, d.axis_scaling);
+  if (params.occupancy_layer < 0)
+  {
+    return kMprUpToDate;
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  const auto start_time = Clock::now();
+  double elapsed_sec = 0;
+
+  if (!d.haveWork())
+  {
+    d.getWork(map, params);
+  }
+
+  size_t total_processed = 0;
+  std::vector<RegionWork> work;
+  while (d.haveWork() && (time_slice <= 0 || elapsed_sec < time_slice))
+  {
+    const size_t batch_size = std::min<size_t>(d.batch_size, d.dirty_regions.size() - d.dirty_cursor);
+    d.resolveWork(map, params, d.dirty_regions.data() + d.dirty_cursor, batch_size, false, work);
+    d.dirty_cursor += batch_size;
+    processRegions(map, work, params);
+    total_processed += work.size();
+
+    elapsed_sec = std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start_time).count();
+  }
+
+  return (total_processed != 0 || d.haveWork()) ? kMprProgressing : kMprUpToDate;
+}
+
+
+size_t ClearanceProcessCpu::calculateForExtents(OccupancyMap &map, const glm::dvec3 &min_extents,
+                                                const glm::dvec3 &max_extents, bool force)
+{
+  ClearanceProcessCpuDetail &d = *imp_;
+  ensureClearanceLayer(map);
+  updateClearanceInfo(map, d.clearanceInfo());
+
+  const EdtParams params = makeParams(map, d.search_radius, d.query_flags, d.axis_scaling);
+  if (params.occupancy_layer < 0)
+  {
+    return 0;
+  }
+
+  const RegionKey min_region = map.regionKey(min_extents);
+  const RegionKey max_region = map.regionKey(max_extents);
+  const bool instantiate = (d.query_flags & kQfInstantiateUnknown) != 0;
+
+  std::vector<RegionKey> keys;
+  RegionKey region_key;
+  for (int z = min_region.z; z <= max_region.z; ++z)
+  {
+    region_key.z = RegionCoord(z);
+    for (int y = min_region.y; y <= max_region.y; ++y)
+    {
+      region_key.y = RegionCoord(y);
+      for (int x = min_region.x; x <= max_region.x; ++x)
+      {
+        region_key.x = RegionCoord(x);
+        if (instantiate)
+        {
+          // Create regions before parallel processing.
+          map.region(region_key, true);
+        }
+        keys.emplace_back(region_key);
+      }
+    }
+  }
+
+  std::vector<RegionWork> work;
+  d.resolveWork(map, params, keys.data(), keys.size(), force, work);
+  processRegions(map, work, params);
+  return work.size();
+}
+
+
+bool ClearanceProcessCpu::calculateForRegion(OccupancyMap &map, const RegionKey &region_key, bool force)
+{
+  ClearanceProcessCpuDetail &d = *imp_;
+  ensureClearanceLayer(map);
+  updateClearanceInfo(map, d.clearanceInfo());
+
+  const EdtParams params = makeParams(map, d.search_radius, d.query_flags, d.axis_scaling);
+  if (params.occupancy_layer < 0)
+  {
+    return false;
+  }
+
+  if (d.query_flags & kQfInstantiateUnknown)
+  {
+    map.region(region_key, true);
+  }
+
+  std::vector<RegionWork> work;
+  d.resolveWork(map, params, &region_key, 1u, force, work);
+  processRegions(map, work, params);
+  return !work.empty();
+}
+}  // namespace ohm
@@ -0,0 +1,156 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_CLEARANCEPROCESSCPU_H
+#define OHM_CLEARANCEPROCESSCPU_H
+
+#include "OhmConfig.h"
+
+#include "MappingProcess.h"
+#include "QueryFlag.h"
+#include "RegionKey.h"
+
+#include <glm/fwd.hpp>
+
+#include <memory>
+
+namespace ohm
+{
+struct ClearanceProcessCpuDetail;
+
+/// A CPU implementation of the GPU @c ClearanceProcess which calculates the voxel clearance layer values - the range
+/// to the nearest obstructing voxel - using an exact, separable Euclidean distance transform.
+///
+/// Each region is processed by seeding a working grid covering the region padded by the search radius (in voxels)
+/// with the obstructing voxels from the region and its neighbours. The squared distance transform is then calculated
+/// by the lower envelope of parabolas algorithm (Felzenszwalb and Huttenlocher) in three one dimensional passes, one
+/// per axis. The cost per region is linear in the padded grid size rather than dependent on the number of obstacles
+/// or the search volume per voxel. Passes after the first are restricted to the rows which contribute to the target
+/// region. Regions are processed in parallel when ohm is built with @c OHM_THREADS .
+///
+/// The process follows the @c ClearanceProcess semantics and results are interpreted the same way:
+/// - 0.0 => The voxel in question is itself an obstruction.
+/// - > 0 => There is an obstructed voxel within the @c searchRadius().
+/// - < 0 => There are no obstructions within the @c searchRadius().
+///
+/// This process respects the @c kQfUnknownAsOccupied flag, treating unobserved voxels and voxels in absent regions as
+/// obstructions. The @c axisScaling() distorts the distance metric as described by
+/// @c ClearanceProcess::setAxisScaling() and @c kQfReportUnscaledResults reports the unscaled range to the nearest
+/// scaled obstacle. A @c searchRadius() of zero only identifies obstructed voxels.
+///
+/// Results are exact Euclidean ranges. Unlike the brute force @c calculateNearestNeighbour() search, obstacles are
+/// not limited to an axis aligned search cube, so ranges may differ from that search when using an axis scaling
+/// below 1 on any axis.
+///
+/// Region clearance values are tracked as for @c ClearanceProcess : a region is up to date when its clearance layer
+/// @c MapChunk::touched_stamps value is at least the occupancy layer stamp of all regions within the search radius.
+/// The search parameters are recorded in the @c OccupancyMap::mapInfo() so queries can validate the clearance values
+/// before using them. Calculating with different parameters marks all regions as never calculated.
+///
+/// With @c setIncremental() enabled, @c update() instead maintains the clearance layer incrementally, processing only
+/// the voxels whose obstruction state has changed since the last update. Changed obstructions seed insertion and
+/// removal wavefronts in the style of the dynamic distance transform of Lau et al. which update the affected voxels
+/// out to the search radius. This suits frequent updates where each update changes a small fraction of the map, at
+/// the cost of retaining distance state for each voxel (about 11 bytes per voxel) between updates. The first
+/// incremental update seeds the distance state from a batch transform of the whole map, as for
+/// @c calculateForExtents() , and is not time sliced. Later updates propagate the wavefronts serially, stopping when
+/// the time slice expires and resuming on the next update. The incremental state is dropped on @c reset() or when the
+/// parameters change.
+class ohm_API ClearanceProcessCpu : public MappingProcess
+{
+public:
+  /// Extended query flags for @c ClearanceProcessCpu . Matches @c ClearanceProcess::QueryFlag .
+  enum QueryFlag : unsigned
+  {
+    /// Instantiate regions which are in unknown space when calling @c calculateForExtents() .
+    kQfInstantiateUnknown = (kQfSpecialised << 0u),
+  };
+
+  /// Empty constructor.
+  ClearanceProcessCpu();
+
+  /// Construct a process using the given parameters.
+  /// @param search_radius Defines the search radius around each voxel.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag and @c ClearanceProcessCpu::QueryFlag.
+  ClearanceProcessCpu(float search_radius, unsigned query_flags);
+
+  /// Destructor.
+  ~ClearanceProcessCpu() override;
+
+  /// Get the search radius to which we look for obstructing voxels.
+  /// @return The radius to look for obstacles within.
+  float searchRadius() const;
+  /// Set the search radius to which we look for obstructing voxels.
+  /// @param range The new search radius.
+  void setSearchRadius(float range);
+
+  /// The @c QueryFlag values applied to the process.
+  /// @return The value values.
+  unsigned queryFlags() const;
+  /// Set the @c QueryFlag values for the process.
+  /// @param flags The flag values to set.
+  void setQueryFlags(unsigned flags);
+
+  /// Get the axis weightings applied when determining the nearest obstructing voxel.
+  /// @return Current axis weighting.
+  glm::vec3 axisScaling() const;
+  /// Set the per axis scaling applied when determining the closest obstructing voxel. See
+  /// @c ClearanceProcess::setAxisScaling() .
+  /// @param scaling The new axis scaling to apply.
+  void setAxisScaling(const glm::vec3 &scaling);
+
+  /// Set the maximum number of regions to process in parallel between time slice checks in @c update() .
+  /// @param batch_size The region batch size. Zero restores the default.
+  void setBatchSize(unsigned batch_size);
+  /// Query the region batch size for @c update() .
+  /// @return The region batch size.
+  unsigned batchSize() const;
+
+  /// Enable incremental clearance maintenance in @c update() . Disabling drops the incremental state.
+  /// @param incremental True to enable incremental updates.
+  void setIncremental(bool incremental);
+  /// Query if incremental clearance maintenance is enabled.
+  /// @return True if @c update() is incremental.
+  bool incremental() const;
+
+  /// Drop pending work and any incremental state.
+  void reset() override;
+
+  /// Ensure the mapping clearance layer is present in @p map .
+  /// @param map The map to ensure has a clearance layer.
+  static void ensureClearanceLayer(OccupancyMap &map);
+
+  /// Update the clearance values of out of date regions, or incrementally update changed voxels when
+  /// @c incremental() .
+  /// @param map The map to process.
+  /// @param time_slice The amount of time available for processing (seconds). Stop if exceeded. Zero or less for
+  ///   no limit.
+  /// @return See @c MappingProcessResult.
+  int update(OccupancyMap &map, double time_slice) override;
+
+  /// Calculate clearance values for all regions within the given extents, blocking until complete.
+  ///
+  /// @param map The map to process.
+  /// @param min_extents The minimum extents corner of the region to calculate.
+  /// @param max_extents The maximum extents corner of the region to calculate.
+  /// @param force Force recalculation of the clearance values even if they seem up to date.
+  ///   This is required if any of the clearance calculation parameters change.
+  /// @return The number of regions calculated.
+  size_t calculateForExtents(OccupancyMap &map, const glm::dvec3 &min_extents, const glm::dvec3 &max_extents,
+                             bool force = true);
+
+  /// Calculate clearance values for a single region.
+  /// @param map The map to process.
+  /// @param region_key The key of the region to calculate.
+  /// @param force Force recalculation even if the region seems up to date.
+  /// @return True if the region was calculated. False if it is up to date or does not exist.
+  bool calculateForRegion(OccupancyMap &map, const RegionKey &region_key, bool force = true);
+
+private:
+  std::unique_ptr<ClearanceProcessCpuDetail> imp_;
+};
+}  // namespace ohm
+
+#endif  // OHM_CLEARANCEPROCESSCPU_H
@@ -36,6 +36,16 @@ bool ClearingPattern::hasPatternOwnership() const
   return imp_->has_pattern_ownership;
 }
 
+unsigned ClearingPattern::rayFlags() const
+{
+  return imp_->ray_flags;
+}
+
+void ClearingPattern::setRayFlags(unsigned flags)
+{
+  imp_->ray_flags = flags;
+}
+
 const glm::dvec3 *ClearingPattern::lastRaySet(size_t *element_count) const
 {
   *element_count = imp_->ray_set.size();
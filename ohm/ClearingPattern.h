@@ -26,8 +26,8 @@ class OccupancyMap;
 ///
 /// The class is constructed with a @c RayPattern, optionally taking ownership of the pointer. The @c apply() method
 /// is called to generate transformed rays from the @p RayPattern and integrate them into the map as clearing rays.
-/// This means the rays are applied with the following flags: <tt>kRfEndPointAsFree | kRfStopOnFirstOccupied |
-/// kRfClearOnly</tt>.
+/// This means the rays are applied with the following flags by default: <tt>kRfEndPointAsFree | kRfStopOnFirstOccupied |
+/// kRfClearOnly</tt> - see @c setRayFlags() .
 ///
 /// This has the effect of having rays only degrade the first occupied voxel struck, then halt traversal. Intervening
 /// voxels are left unchanged.
@@ -50,6 +50,16 @@ public:
   /// @return True if this class owns the @p pattern() memory.
   bool hasPatternOwnership() const;
 
+  /// Query the @c RayFlag values used to integrate the clearing rays. Defaults to
+  /// <tt>kRfEndPointAsFree | kRfStopOnFirstOccupied | kRfClearOnly</tt>.
+  /// @return The ray flags.
+  unsigned rayFlags() const;
+
+  /// Set the @c RayFlag values used to integrate the clearing rays. For example, add @c kRfSkipEmptyBlocks to skip
+  /// over blocks of free and unknown voxels when searching for the first occupied voxel.
+  /// @param flags The ray flags to use.
+  void setRayFlags(unsigned flags);
+
   /// Apply the clearing @c pattern() to @p map. This supports both APIs for both @c OccupancyMap and the @p GpuMap
   /// extension.
   ///
@@ -88,7 +98,7 @@ void ClearingPattern::apply(MAP *map, const glm::dvec3 &position, const glm::dqu
   const glm::dvec3 *ray_set = buildRaySet(&ray_element_count, position, rotation);
   const float initial_miss_value = map->missValue();
   map->setMissValue(initial_miss_value * probability_scaling);
-  map->integrateRays(ray_set, unsigned(ray_element_count), kRfEndPointAsFree | kRfStopOnFirstOccupied | kRfClearOnly);
+  map->integrateRays(ray_set, unsigned(ray_element_count), rayFlags());
   map->setMissValue(initial_miss_value);
 }
 
@@ -100,7 +110,7 @@ void ClearingPattern::apply(MAP *map, const glm::dmat4 &pattern_transform, float
   const glm::dvec3 *ray_set = buildRaySet(&ray_element_count, pattern_transform);
   const float initial_miss_value = map->missValue();
   map->setMissValue(initial_miss_value * probability_scaling);
-  map->integrateRays(ray_set, unsigned(ray_element_count), kRfEndPointAsFree | kRfStopOnFirstOccupied | kRfClearOnly);
+  map->integrateRays(ray_set, unsigned(ray_element_count), rayFlags());
   map->setMissValue(initial_miss_value);
 }
 }  // namespace ohm
@@ -7,7 +7,9 @@
 
 #include "MapLayer.h"
 #include "MapLayout.h"
+#include "OccupancyPyramid.h"
 #include "VoxelMean.h"
+#include "VoxelOccupancy.h"
 
 #include <algorithm>
 
@@ -40,6 +42,16 @@ const char *clearanceLayerName()
 {
   return "clearance";
 }
+const char *ternaryLayerName()
+{
+  return "ternary";
+}
+const char *occupancyPyramidLayerName(int level)
+{
+  static const char *names[] = { "occupancy_pyramid1", "occupancy_pyramid2", "occupancy_pyramid3" };
+  static_assert(sizeof(names) / sizeof(names[0]) == OccupancyPyramid::kLevels, "Pyramid layer name count mismatch");
+  return (level >= 1 && level <= OccupancyPyramid::kLevels) ? names[level - 1] : nullptr;
+}
 }  // namespace default_layer
 
 
@@ -119,4 +131,65 @@ MapLayer *addClearance(MapLayout &layout)
 
   return layer;
 }
+
+
+MapLayer *addTernaryOccupancy(MapLayout &layout)
+{
+  if (const MapLayer *layer = layout.layer(default_layer::ternaryLayerName()))
+  {
+    // Already present.
+    return layout.layerPtr(layer->layerIndex());
+  }
+
+  // Subsample by 1 with a 16-bit voxel: each 2x2x2 block of voxels maps to 16 bits, or 2 bits per voxel. The layer
+  // memory is then addressed as a flat array of codes using the full resolution voxel index.
+  MapLayer *layer = layout.addLayer(default_layer::ternaryLayerName(), 1);
+  layer->setFlags(layer->flags() | MapLayer::kPackedVoxels);
+  VoxelLayout voxel = layer->voxelLayout();
+  voxel.addMember("codes", DataType::kUInt16, 0);
+
+  if (layer->voxelByteSize() != sizeof(uint16_t))
+  {
+    throw std::runtime_error("Ternary occupancy layer size mismatch");
+  }
+
+  return layer;
+}
+
+
+MapLayer *addOccupancyPyramid(MapLayout &layout)
+{
+  const float unobserved = unobservedOccupancyValue();
+  size_t max_clear_value = 0;
+  memcpy(&max_clear_value, &unobserved, std::min(sizeof(unobserved), sizeof(max_clear_value)));
+
+  MapLayer *level_one = nullptr;
+  for (int level = 1; level <= OccupancyPyramid::kLevels; ++level)
+  {
+    const char *layer_name = default_layer::occupancyPyramidLayerName(level);
+    MapLayer *layer = nullptr;
+    if (const MapLayer *existing = layout.layer(layer_name))
+    {
+      // Already present.
+      layer = layout.layerPtr(existing->layerIndex());
+    }
+    else
+    {
+      layer = layout.addLayer(layer_name, uint16_t(level));
+      VoxelLayout voxel = layer->voxelLayout();
+      voxel.addMember("max_occupancy", DataType::kFloat, max_clear_value);
+      // Clear to every voxel in the block being unobserved.
+      voxel.addMember("unknown_count", DataType::kUInt32, size_t(1u) << unsigned(3 * level));
+
+      if (layer->voxelByteSize() != sizeof(OccupancyPyramidVoxel))
+      {
+        throw std::runtime_error("OccupancyPyramidVoxel layer size mismatch");
+      }
+    }
+
+    level_one = (level == 1) ? layer : level_one;
+  }
+
+  return level_one;
+}
 }  // namespace ohm
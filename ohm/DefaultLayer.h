@@ -24,6 +24,13 @@ const char *ohm_API covarianceLayerName();
 /// Name of the voxel clearance layer.
 /// @return "clearance"
 const char *ohm_API clearanceLayerName();
+/// Name of the packed ternary occupancy layer - see @c TernaryOccupancy .
+/// @return "ternary"
+const char *ohm_API ternaryLayerName();
+/// Name of an @c OccupancyPyramid layer.
+/// @param level The pyramid level [1, @c OccupancyPyramid::kLevels ].
+/// @return "occupancy_pyramid<level>" or null if @p level is out of range.
+const char *ohm_API occupancyPyramidLayerName(int level);
 }  // namespace default_layer
 
 class MapLayout;
@@ -56,6 +63,25 @@ MapLayer *ohm_API addCovariance(MapLayout &layout);
 /// @param layout The @p MapLayout to modify.
 /// @return The map layer added or the pre-existing layer named according to @c clearanceLayerName() .
 MapLayer *ohm_API addClearance(MapLayout &layout);
+
+/// Add the packed ternary occupancy layer to @p layout - see @c TernaryOccupancy .
+///
+/// The layer stores a two bit @c TernaryCode per voxel. To achieve this, the layer is added with a subsampling of 1
+/// and a 16-bit voxel so the layer memory is treated as a flat array of codes indexed by the linear voxel index. This
+/// requires even region voxel dimensions and the layer cannot be accessed via @c Voxel .
+///
+/// @param layout The @p MapLayout to modify.
+/// @return The map layer added or the pre-existing layer named according to @c ternaryLayerName() .
+MapLayer *ohm_API addTernaryOccupancy(MapLayout &layout);
+
+/// Add the @c OccupancyPyramid layers to @p layout.
+///
+/// This adds a layer for each pyramid level, named by @c occupancyPyramidLayerName() , with subsampling matching the
+/// level and holding @c OccupancyPyramidVoxel data. Layers which are already present are left unchanged.
+///
+/// @param layout The @p MapLayout to modify.
+/// @return The level 1 pyramid layer.
+MapLayer *ohm_API addOccupancyPyramid(MapLayout &layout);
 }  // namespace ohm
 
 #endif  // OHMDEFAULTLAYER_H
@@ -116,16 +116,22 @@ struct DstVoxel
   Voxel<float> occupancy;
   /// Heightmap extension data.
   Voxel<HeightmapVoxel> heightmap;
+  /// Heightmap extension data for the compact layout.
+  Voxel<HeightmapVoxelCompact> heightmap_compact;
   /// Voxel mean (if being used.)
   Voxel<VoxelMean> mean;
 
-  DstVoxel(OccupancyMap &map, int heightmap_layer, bool use_mean)
+  DstVoxel(OccupancyMap &map, int heightmap_layer, bool compact_layout, bool use_mean)
     : occupancy(&map, map.layout().occupancyLayer())
-    , heightmap(&map, heightmap_layer)
+    , heightmap(&map, compact_layout ? -1 : heightmap_layer)
+    , heightmap_compact(&map, compact_layout ? heightmap_layer : -1)
     , mean(&map, use_mean ? map.layout().meanLayer() : -1)
   {}
 
-  inline void setKey(const Key &key) { mean.setKey(heightmap.setKey(occupancy.setKey(key))); }
+  inline void setKey(const Key &key)
+  {
+    mean.setKey(heightmap_compact.setKey(heightmap.setKey(occupancy.setKey(key))));
+  }
 
   /// Get the target (height)map
   inline const OccupancyMap &map() const { return *occupancy.map(); }
@@ -157,6 +163,19 @@ struct DstVoxel
   }
 
   inline glm::dvec3 centre() const { return occupancy.map()->voxelCentreGlobal(occupancy.key()); }
+
+  /// Write the heightmap extension data for the current voxel in whichever layout is in use.
+  inline void writeHeightInfo(const HeightmapVoxel &height_info, HeightmapVoxelType type)
+  {
+    if (heightmap_compact.isValid())
+    {
+      heightmap_compact.write(compactHeightmapVoxel(height_info, type));
+    }
+    else
+    {
+      heightmap.write(height_info);
+    }
+  }
 };
 
 inline float relativeVoxelHeight(double absolute_height, const Key &key, const OccupancyMap &map, const glm::dvec3 &up)
@@ -453,12 +472,14 @@ Heightmap::Heightmap()
 {}
 
 
-Heightmap::Heightmap(double grid_resolution, double min_clearance, UpAxis up_axis, unsigned region_size)
+Heightmap::Heightmap(double grid_resolution, double min_clearance, UpAxis up_axis, unsigned region_size,
+                     bool compact_layout)
   : imp_(new HeightmapDetail)
 {
   region_size = region_size ? region_size : kDefaultRegionSize;
 
   imp_->min_clearance = min_clearance;
+  imp_->compact_layout = compact_layout;
 
   if (up_axis < UpAxis::kNegZ || up_axis > UpAxis::kZ)
   {
@@ -473,7 +494,9 @@ Heightmap::Heightmap(double grid_resolution, double min_clearance, UpAxis up_axi
   // Use an OccupancyMap to store grid cells. Each region is 1 voxel thick.
   glm::u8vec3 region_dim(region_size);
   region_dim[int(imp_->vertical_axis_index)] = 1;
-  imp_->heightmap = std::make_unique<OccupancyMap>(grid_resolution, region_dim);
+  // The heightmap occupancy values are only ever 1, -1, 0 or unobserved, which the 8-bit encoding represents exactly.
+  imp_->heightmap = std::make_unique<OccupancyMap>(
+    grid_resolution, region_dim, compact_layout ? MapFlag::kQuantisedOccupancy8 : MapFlag::kDefault);
 
   // Setup the heightmap voxel layout.
   MapLayout &layout = imp_->heightmap->layout();
@@ -495,12 +518,24 @@ Heightmap::Heightmap(double grid_resolution, double min_clearance, UpAxis up_axi
   layer = layout.addLayer(HeightmapVoxel::kHeightmapLayer, 0);
   imp_->heightmap_layer = static_cast<int>(layer->layerIndex());
   voxels = layer->voxelLayout();
-  voxels.addMember("height", DataType::kFloat, 0);
-  voxels.addMember("clearance", DataType::kFloat, 0);
-  voxels.addMember("normal_x", DataType::kFloat, 0);
-  voxels.addMember("normal_y", DataType::kFloat, 0);
-  voxels.addMember("normal_z", DataType::kFloat, 0);
-  voxels.addMember("reserved", DataType::kFloat, 0);
+  if (compact_layout)
+  {
+    // HeightmapVoxelCompact
+    voxels.addMember("height", DataType::kUInt16, 0);
+    voxels.addMember("clearance", DataType::kUInt16, 0);
+    voxels.addMember("normal", DataType::kUInt16, 0);
+    voxels.addMember("flags", DataType::kUInt16, 0);
+  }
+  else
+  {
+    // HeightmapVoxel
+    voxels.addMember("height", DataType::kFloat, 0);
+    voxels.addMember("clearance", DataType::kFloat, 0);
+    voxels.addMember("normal_x", DataType::kFloat, 0);
+    voxels.addMember("normal_y", DataType::kFloat, 0);
+    voxels.addMember("normal_z", DataType::kFloat, 0);
+    voxels.addMember("reserved", DataType::kFloat, 0);
+  }
 
   updateMapInfo(imp_->heightmap->mapInfo());
 }
@@ -599,6 +634,12 @@ bool Heightmap::useFloodFill() const
 }
 
 
+bool Heightmap::compactLayout() const
+{
+  return imp_->compact_layout;
+}
+
+
 UpAxis Heightmap::upAxis() const
 {
   return UpAxis(imp_->up_axis_id);
@@ -726,7 +767,10 @@ HeightmapVoxelType Heightmap::getHeightmapVoxelInfo(const Key &key, glm::dvec3 *
 
     if (heightmap_occupancy.isValid())
     {
-      Voxel<const HeightmapVoxel> heightmap_voxel(imp_->heightmap.get(), imp_->heightmap_layer, key);
+      Voxel<const HeightmapVoxel> heightmap_voxel(imp_->heightmap.get(),
+                                                  (!imp_->compact_layout) ? imp_->heightmap_layer : -1, key);
+      Voxel<const HeightmapVoxelCompact> heightmap_compact_voxel(
+        imp_->heightmap.get(), (imp_->compact_layout) ? imp_->heightmap_layer : -1, key);
       Voxel<const VoxelMean> mean_voxel(imp_->heightmap.get(), imp_->heightmap->layout().meanLayer(), key);
 
       const glm::dvec3 voxel_centre = imp_->heightmap->voxelCentreGlobal(key);
@@ -736,11 +780,20 @@ HeightmapVoxelType Heightmap::getHeightmapVoxelInfo(const Key &key, glm::dvec3 *
       const bool is_uncertain = occupancy == ohm::unobservedOccupancyValue();
       const float heightmap_voxel_value = (!is_uncertain) ? occupancy : -1.0f;
       // isValid() is somewhat redundant, but it silences a clang-tidy check.
-      if (!is_uncertain && heightmap_voxel.isValid())
+      if (!is_uncertain && (heightmap_voxel.isValid() || heightmap_compact_voxel.isValid()))
       {
         // Get height info.
         HeightmapVoxel heightmap_info;
-        heightmap_voxel.read(&heightmap_info);
+        if (heightmap_compact_voxel.isValid())
+        {
+          HeightmapVoxelCompact compact_info;
+          heightmap_compact_voxel.read(&compact_info);
+          heightmap_info = expandHeightmapVoxel(compact_info);
+        }
+        else
+        {
+          heightmap_voxel.read(&heightmap_info);
+        }
         (*pos)[upAxisIndex()] = voxel_centre[upAxisIndex()] + heightmap_info.height;
         if (voxel_info)
         {
@@ -829,7 +882,7 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
     std::max(1, ohm::pointToRegionCoord(imp_->min_clearance, src_map.resolution()) - 1);
 
   SrcVoxel src_voxel(src_map, use_voxel_mean);
-  DstVoxel hm_voxel(heightmap, imp_->heightmap_layer, use_voxel_mean);
+  DstVoxel hm_voxel(heightmap, imp_->heightmap_layer, imp_->compact_layout, use_voxel_mean);
 
   do
   {
@@ -891,8 +944,11 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
         hm_voxel.setPosition(voxel_pos);
 
         // Write the height and clearance values.
-        HeightmapVoxel height_info;
-        hm_voxel.heightmap.read(&height_info);
+        HeightmapVoxel height_info{};
+        if (hm_voxel.heightmap.isValid())
+        {
+          hm_voxel.heightmap.read(&height_info);
+        }
         height_info.height = relativeVoxelHeight(src_height, hm_key, heightmap, imp_->up);
         height_info.clearance = float(clearance);
         height_info.normal_x = height_info.normal_y = height_info.normal_z = 0;
@@ -909,7 +965,8 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
           height_info.normal_y = float(normal.y);
           height_info.normal_z = float(normal.z);
         }
-        hm_voxel.heightmap.write(height_info);
+        hm_voxel.writeHeightInfo(height_info, (voxel_type == kOccupied) ? HeightmapVoxelType::kSurface :
+                                                                           HeightmapVoxelType::kVirtualSurface);
 
         ++populated_count;
       }
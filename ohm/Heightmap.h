@@ -38,6 +38,10 @@ struct HeightmapVoxel;
 /// - *heightmap* layer (named from @c HeightmapVoxel::kHeightmapLayer )
 ///   - @c HeightmapVoxel
 ///
+/// A compact layout may be selected on construction, trading precision for memory and file size. The compact layout
+/// stores the occupancy layer using @c OccupancyEncoding::kInt8 and the heightmap layer as
+/// @c HeightmapVoxelCompact - 9 bytes per cell rather than 28. Use @c getHeightmapVoxelInfo() to read either layout.
+///
 /// The height specifies the absolute height of the surface, while clearance denotes how much room there is above
 /// the surface voxel before the next obstruction. Note that the height values always increase going up, so the
 /// height value will be inverted when using any @c UpAxis::kNegN @c UpAxis value. Similarly, the clearance is always
@@ -99,7 +103,9 @@ public:
   /// @param min_clearance The minimum clearance value expected above each surface voxel.
   /// @param up_axis Identifies the up axis for the map.
   /// @param region_size Grid size of each region in the heightmap.
-  Heightmap(double grid_resolution, double min_clearance, UpAxis up_axis = UpAxis::kZ, unsigned region_size = 0);
+  /// @param compact_layout Use the compact heightmap layout? See class documentation.
+  Heightmap(double grid_resolution, double min_clearance, UpAxis up_axis = UpAxis::kZ, unsigned region_size = 0,
+            bool compact_layout = false);
 
   /// Destructor.
   ~Heightmap();
@@ -200,6 +206,11 @@ public:
   /// @return True when using flood fill.
   bool useFloodFill() const;
 
+  /// Does the heightmap use the compact layout? When true, the @c heightmapVoxelLayer() contains
+  /// @c HeightmapVoxelCompact rather than @c HeightmapVoxel structures.
+  /// @return True for the compact layout.
+  bool compactLayout() const;
+
   /// The layer number which contains @c HeightmapVoxel structures.
   /// @return The heightmap layer index or -1 on error (not present).
   /// @see @ref voxelmean
@@ -270,6 +281,7 @@ public:
   ///             other than @c HeightmapVoxel::Unknown .
   /// @param[out] voxel_info Clearance and height details of the voxel associated with @p key. Only valid when this
   ///             function returns something other than @c HeightmapVoxel::Unknown .
+  ///             Expanded from @c HeightmapVoxelCompact for a @c compactLayout() heightmap.
   /// @return The type of the voxel in question. May return @c HeightmapVoxel::Unknown if @p key is invalid.
   HeightmapVoxelType getHeightmapVoxelInfo(const Key &key, glm::dvec3 *pos, HeightmapVoxel *voxel_info = nullptr) const;
 
@@ -5,8 +5,192 @@
 // Author: Kazys Stepanas
 #include "HeightmapVoxel.h"
 
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 namespace ohm
 {
 const char *const HeightmapVoxel::kHeightmapLayer = "heightmap";
 const char *const HeightmapVoxel::kHeightmapBuildLayer = "heightmap_build";
+
+namespace
+{
+/// Map a value in the range [-1, 1] to an unsigned byte.
+inline unsigned unitToByte(float value)
+{
+  return unsigned(std::round((std::min(1.0f, std::max(-1.0f, value)) * 0.5f + 0.5f) * 255.0f));
+}
+
+/// Map an unsigned byte to the range [-1, 1].
+inline float byteToUnit(unsigned value)
+{
+  return float(value) / 255.0f * 2.0f - 1.0f;
+}
+
+/// Sign function which treats zero as positive.
+inline float signNotZero(float value)
+{
+  return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+}  // namespace
+
+
+uint16_t floatToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16u) & 0x8000u;
+  const int exponent = int((bits >> 23u) & 0xffu);
+  uint32_t mantissa = bits & 0x7fffffu;
+
+  if (exponent == 0xff)
+  {
+    // Infinity or NaN.
+    return uint16_t(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+  }
+
+  const int half_exponent = exponent - 127 + 15;
+  if (half_exponent >= 0x1f)
+  {
+    // Overflow to infinity.
+    return uint16_t(sign | 0x7c00u);
+  }
+
+  if (half_exponent <= 0)
+  {
+    // Subnormal half or underflow to zero.
+    if (half_exponent < -10)
+    {
+      return uint16_t(sign);
+    }
+    mantissa |= 0x800000u;
+    const unsigned shift = unsigned(14 - half_exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1u);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u)))
+    {
+      ++half_mantissa;
+    }
+    return uint16_t(sign | half_mantissa);
+  }
+
+  uint32_t half = sign | (uint32_t(half_exponent) << 10u) | (mantissa >> 13u);
+  const uint32_t remainder = mantissa & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+  {
+    // Rounding may carry into the exponent, which correctly rounds up to the next power of two or infinity.
+    ++half;
+  }
+  return uint16_t(half);
+}
+
+
+float halfToFloat(uint16_t half)
+{
+  const uint32_t sign = uint32_t(half & 0x8000u) << 16u;
+  const uint32_t exponent = (half >> 10u) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+
+  uint32_t bits;
+  if (exponent == 0)
+  {
+    if (mantissa == 0)
+    {
+      bits = sign;
+    }
+    else
+    {
+      // Subnormal half: normal as a float.
+      const float value = std::ldexp(float(mantissa), -24);
+      return (sign) ? -value : value;
+    }
+  }
+  else if (exponent == 0x1f)
+  {
+    bits = sign | 0x7f800000u | (mantissa << 13u);
+  }
+  else
+  {
+    bits = sign | ((exponent - 15u + 127u) << 23u) | (mantissa << 13u);
+  }
+
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+uint16_t encodeOctahedralNormal(const glm::vec3 &normal)
+{
+  const float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1 <= 0.0f)
+  {
+    return encodeOctahedralNormal(glm::vec3(0, 0, 1));
+  }
+
+  float x = normal.x / l1;
+  float y = normal.y / l1;
+  if (normal.z < 0)
+  {
+    // Fold the lower hemisphere over the diagonals.
+    const float folded_x = (1.0f - std::abs(y)) * signNotZero(x);
+    y = (1.0f - std::abs(x)) * signNotZero(y);
+    x = folded_x;
+  }
+
+  return uint16_t(unitToByte(x) | (unitToByte(y) << 8u));
+}
+
+
+glm::vec3 decodeOctahedralNormal(uint16_t encoded)
+{
+  glm::vec3 normal(byteToUnit(encoded & 0xffu), byteToUnit(encoded >> 8u), 0.0f);
+  normal.z = 1.0f - std::abs(normal.x) - std::abs(normal.y);
+  if (normal.z < 0)
+  {
+    const float unfold = -normal.z;
+    normal.x += (normal.x >= 0) ? -unfold : unfold;
+    normal.y += (normal.y >= 0) ? -unfold : unfold;
+  }
+  return normal / std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+}
+
+
+HeightmapVoxelCompact compactHeightmapVoxel(const HeightmapVoxel &voxel, HeightmapVoxelType type)
+{
+  HeightmapVoxelCompact compact{};
+  compact.height = floatToHalf(voxel.height);
+  compact.clearance = floatToHalf(voxel.clearance);
+  compact.flags = uint16_t(unsigned(type) & HeightmapVoxelCompact::kTypeMask);
+  if (voxel.normal_x != 0 || voxel.normal_y != 0 || voxel.normal_z != 0)
+  {
+    compact.normal = encodeOctahedralNormal(glm::vec3(voxel.normal_x, voxel.normal_y, voxel.normal_z));
+    compact.flags = uint16_t(compact.flags | HeightmapVoxelCompact::kNormalValid);
+  }
+  return compact;
+}
+
+
+HeightmapVoxel expandHeightmapVoxel(const HeightmapVoxelCompact &compact, HeightmapVoxelType *type)
+{
+  HeightmapVoxel voxel{};
+  voxel.height = halfToFloat(compact.height);
+  voxel.clearance = halfToFloat(compact.clearance);
+  if (compact.flags & HeightmapVoxelCompact::kNormalValid)
+  {
+    const glm::vec3 normal = decodeOctahedralNormal(compact.normal);
+    voxel.normal_x = normal.x;
+    voxel.normal_y = normal.y;
+    voxel.normal_z = normal.z;
+  }
+  if (type)
+  {
+    *type = HeightmapVoxelType(compact.flags & HeightmapVoxelCompact::kTypeMask);
+  }
+  return voxel;
+}
 }  // namespace ohm
@@ -8,6 +8,12 @@
 
 #include "OhmConfig.h"
 
+#include "HeightmapVoxelType.h"
+
+#include <glm/fwd.hpp>
+
+#include <cinttypes>
+
 namespace ohm
 {
 /// A voxel within the heightmap.
@@ -35,6 +41,66 @@ struct HeightmapVoxel
   /// Padding to ensure expected alignment.
   float reserved;
 };
+
+/// A compact encoding of @c HeightmapVoxel used by heightmaps created with a compact layout - see
+/// @c Heightmap::compactLayout() . The voxel is stored in 8 bytes rather than 24:
+/// - @c height and @c clearance are IEEE half precision floats. Clearance values beyond the half range become
+///   infinite.
+/// - @c normal is an octahedral encoding of the unit surface normal, 8 bits per axis.
+/// - @c flags holds the @c HeightmapVoxelType in the low 4 bits and @c kNormalValid in bit 4. Remaining bits are
+///   reserved.
+///
+/// Use @c compactHeightmapVoxel() and @c expandHeightmapVoxel() to convert between the encodings. The compact layer
+/// uses the same layer name, @c HeightmapVoxel::kHeightmapLayer , and is distinguished by its voxel size.
+struct HeightmapVoxelCompact
+{
+  /// Mask for the @c HeightmapVoxelType in @c flags .
+  static const uint16_t kTypeMask = 0xfu;
+  /// Flag set when @c normal holds a valid normal. Unset for the zero normal.
+  static const uint16_t kNormalValid = (1u << 4u);
+
+  /// Half precision voxel height, relative to the voxel centre.
+  uint16_t height;
+  /// Half precision clearance.
+  uint16_t clearance;
+  /// Octahedral encoded surface normal.
+  uint16_t normal;
+  /// Voxel type and flag bits.
+  uint16_t flags;
+};
+
+/// Convert a float to an IEEE half precision bit pattern, rounding to nearest. Values beyond the half range convert
+/// to infinity.
+/// @param value The value to convert.
+/// @return The half precision bit pattern.
+uint16_t ohm_API floatToHalf(float value);
+
+/// Convert an IEEE half precision bit pattern to a float.
+/// @param half The half precision bit pattern.
+/// @return The float value.
+float ohm_API halfToFloat(uint16_t half);
+
+/// Encode a unit @p normal into 16 bits using an octahedral mapping, 8 bits per axis.
+/// @param normal The unit normal to encode.
+/// @return The encoded normal.
+uint16_t ohm_API encodeOctahedralNormal(const glm::vec3 &normal);
+
+/// Decode a normal encoded by @c encodeOctahedralNormal() .
+/// @param encoded The encoded normal.
+/// @return The decoded unit normal.
+glm::vec3 ohm_API decodeOctahedralNormal(uint16_t encoded);
+
+/// Convert a @c HeightmapVoxel and its @p type to the compact encoding.
+/// @param voxel The voxel to convert.
+/// @param type The voxel type to fold into the compact voxel.
+/// @return The compact voxel.
+HeightmapVoxelCompact ohm_API compactHeightmapVoxel(const HeightmapVoxel &voxel, HeightmapVoxelType type);
+
+/// Convert a compact voxel back to a @c HeightmapVoxel . The normal is zero unless flagged valid.
+/// @param compact The compact voxel.
+/// @param[out] type Optionally set to the voxel type stored in @p compact .
+/// @return The expanded voxel.
+HeightmapVoxel ohm_API expandHeightmapVoxel(const HeightmapVoxelCompact &compact, HeightmapVoxelType *type = nullptr);
 }  // namespace ohm
 
 #endif  // HEIGHTMAPVOXEL_H
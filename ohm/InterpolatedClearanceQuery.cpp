@@ -0,0 +1,417 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "InterpolatedClearanceQuery.h"
+
+#include "Key.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "QueryFlag.h"
+#include "VoxelBuffer.h"
+
+#include "private/InterpolatedClearanceQueryDetail.h"
+#include "private/OccupancyMapDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/glm.hpp>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <limits>
+#include <mutex>
+#include <utility>
+
+namespace ohm
+{
+namespace
+{
+using SamplePoint = InterpolatedClearanceSample;
+
+/// Query execution parameters.
+struct SampleParams
+{
+  glm::dvec3 origin{ 0 };
+  /// Voxel coordinate limits for representable region keys.
+  glm::dvec3 coord_limit{ 0 };
+  glm::ivec3 region_dim{ 0 };
+  double inv_resolution = 0;
+  float resolution = 0;
+  float default_range = -1;
+  float unknown_range = -1;
+  int clearance_layer = -1;
+};
+
+/// Resolve the interpolation cell for @p point . The cell spans the centres of the voxels either side of the point on
+/// each axis. This is equivalent to @c OccupancyMap::voxelKey() for the point offset by half a voxel, but works in
+/// voxel units from the map origin to avoid the region centre calculations.
+/// @return False if the cell lies beyond the representable region range.
+bool resolveCell(const glm::dvec3 &point, const SampleParams &params, SamplePoint &sample)
+{
+  // Voxel coordinates where regions start at multiples of the region dimensions and voxel centres lie at integer
+  // coordinates.
+  const glm::dvec3 coord =
+    (point - params.origin) * params.inv_resolution + 0.5 * glm::dvec3(params.region_dim) - glm::dvec3(0.5);
+  const glm::dvec3 base = glm::floor(coord);
+  if (glm::any(glm::greaterThan(glm::abs(base), params.coord_limit)))
+  {
+    return false;
+  }
+  const glm::ivec3 voxel(base);
+  const glm::ivec3 region(floorDiv(voxel, params.region_dim));
+  const glm::ivec3 local = voxel - region * params.region_dim;
+  sample.base = Key(RegionCoord(region.x), RegionCoord(region.y), RegionCoord(region.z), uint8_t(local.x),
+                    uint8_t(local.y), uint8_t(local.z));
+  sample.t = glm::vec3(coord - base);
+  return true;
+}
+
+/// Clearance memory for the 2x2x2 block of regions which may be referenced by the interpolation cells of points in a
+/// single region. Clearance blocks are only retained when first referenced.
+class RegionNeighbourhood
+{
+public:
+  RegionNeighbourhood(const OccupancyMap &map, const RegionKey &region_key, const SampleParams &params)
+    : params_(params)
+  {
+    const OccupancyMapDetail &map_data = *map.detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    for (int i = 0; i < 8; ++i)
+    {
+      const RegionKey key(region_key.x + (i & 1), region_key.y + ((i >> 1) & 1), region_key.z + ((i >> 2) & 1));
+      const auto search = map_data.chunks.find(key);
+      chunks_[i] = (search != map_data.chunks.end()) ? search->second : nullptr;
+      clearance_[i] = nullptr;
+    }
+  }
+
+  /// Read the clearance at the voxel @p local in the neighbourhood region @p slot , substituting the default and
+  /// unknown range values.
+  float clearance(int slot, const glm::ivec3 &local)
+  {
+    if (!clearance_[slot])
+    {
+      if (!chunks_[slot] || chunks_[slot]->voxel_blocks[params_.clearance_layer]->isUninitialised())
+      {
+        return params_.unknown_range;
+      }
+      buffers_[slot] = VoxelBuffer<const VoxelBlock>(chunks_[slot]->voxel_blocks[params_.clearance_layer]);
+      clearance_[slot] = reinterpret_cast<const float *>(buffers_[slot].voxelMemory());
+    }
+
+    const float value = clearance_[slot][voxelIndex(unsigned(local.x), unsigned(local.y), unsigned(local.z),
+                                                    unsigned(params_.region_dim.x), unsigned(params_.region_dim.y),
+                                                    unsigned(params_.region_dim.z))];
+    return (value >= 0) ? value : params_.default_range;
+  }
+
+private:
+  const SampleParams &params_;
+  const MapChunk *chunks_[8];
+  VoxelBuffer<const VoxelBlock> buffers_[8];
+  const float *clearance_[8];
+};
+
+/// Interpolate the clearance for @c samples in the range [begin, end), all of which share a base region.
+void sampleRegion(const OccupancyMap &map, const SampleParams &params, const SamplePoint *samples, size_t begin,
+                  size_t end, InterpolatedClearanceQueryDetail &query)
+{
+  RegionNeighbourhood neighbourhood(map, samples[begin].base.regionKey(), params);
+  float corners[8];
+
+  for (size_t i = begin; i < end; ++i)
+  {
+    const SamplePoint &sample = samples[i];
+    const glm::ivec3 base_local(sample.base.localKey());
+
+    // Resolve the cell corners. Corners beyond the region wrap into the next region along that axis.
+    if (glm::all(glm::lessThan(base_local + 1, params.region_dim)))
+    {
+      for (int c = 0; c < 8; ++c)
+      {
+        corners[c] = neighbourhood.clearance(0, base_local + glm::ivec3(c & 1, (c >> 1) & 1, (c >> 2) & 1));
+      }
+    }
+    else
+    {
+      for (int c = 0; c < 8; ++c)
+      {
+        glm::ivec3 local = base_local + glm::ivec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+        int slot = 0;
+        for (int a = 0; a < 3; ++a)
+        {
+          if (local[a] >= params.region_dim[a])
+          {
+            local[a] -= params.region_dim[a];
+            slot |= (1 << a);
+          }
+        }
+        corners[c] = neighbourhood.clearance(slot, local);
+      }
+    }
+
+    // Trilinear interpolation and its analytic derivative. Corner c is at offset (c & 1, (c >> 1) & 1, (c >> 2) & 1).
+    const glm::vec3 &t = sample.t;
+    const glm::vec3 s = glm::vec3(1.0f) - t;
+    const float x00 = s.x * corners[0] + t.x * corners[1];
+    const float x10 = s.x * corners[2] + t.x * corners[3];
+    const float x01 = s.x * corners[4] + t.x * corners[5];
+    const float x11 = s.x * corners[6] + t.x * corners[7];
+    const float xy0 = s.y * x00 + t.y * x10;
+    const float xy1 = s.y * x01 + t.y * x11;
+
+    const float dx = s.y * s.z * (corners[1] - corners[0]) + t.y * s.z * (corners[3] - corners[2]) +
+                     s.y * t.z * (corners[5] - corners[4]) + t.y * t.z * (corners[7] - corners[6]);
+    const float dy = s.z * (x10 - x00) + t.z * (x11 - x01);
+    const float dz = xy1 - xy0;
+
+    query.ranges[sample.index] = s.z * xy0 + t.z * xy1;
+    query.gradient_x[sample.index] = dx / params.resolution;
+    query.gradient_y[sample.index] = dy / params.resolution;
+    query.gradient_z[sample.index] = dz / params.resolution;
+
+    // The point lies in the cell corner voxel nearest the point.
+    Key voxel_key = sample.base;
+    for (int a = 0; a < 3; ++a)
+    {
+      if (t[a] >= 0.5f)
+      {
+        if (base_local[a] + 1 < params.region_dim[a])
+        {
+          voxel_key.setLocalAxis(a, uint8_t(base_local[a] + 1));
+        }
+        else
+        {
+          voxel_key.setLocalAxis(a, 0);
+          voxel_key.setRegionAxis(a, RegionCoord(voxel_key.regionKey()[a] + 1));
+        }
+      }
+    }
+    query.intersected_voxels[sample.index] = voxel_key;
+  }
+}
+}  // namespace
+
+
+InterpolatedClearanceQuery::InterpolatedClearanceQuery(InterpolatedClearanceQueryDetail *detail)
+  : Query(detail)
+{}
+
+
+InterpolatedClearanceQuery::InterpolatedClearanceQuery()
+  : InterpolatedClearanceQuery(new InterpolatedClearanceQueryDetail)
+{}
+
+
+InterpolatedClearanceQuery::InterpolatedClearanceQuery(OccupancyMap &map, unsigned query_flags)
+  : InterpolatedClearanceQuery(new InterpolatedClearanceQueryDetail)
+{
+  setMap(&map);
+  setQueryFlags(query_flags);
+}
+
+
+InterpolatedClearanceQuery::~InterpolatedClearanceQuery()
+{
+  wait();
+  InterpolatedClearanceQueryDetail *d = imp();
+  delete d;
+  // Clear pointer for base class.
+  imp_ = nullptr;
+}
+
+
+void InterpolatedClearanceQuery::setPoints(const glm::dvec3 *points, size_t point_count)
+{
+  InterpolatedClearanceQueryDetail *d = imp();
+  d->points.assign(points, points + point_count);
+}
+
+
+const glm::dvec3 *InterpolatedClearanceQuery::points() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return d->points.data();
+}
+
+
+size_t InterpolatedClearanceQuery::pointCount() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return d->points.size();
+}
+
+
+float InterpolatedClearanceQuery::defaultRangeValue() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return d->default_range;
+}
+
+
+void InterpolatedClearanceQuery::setDefaultRangeValue(float range)
+{
+  InterpolatedClearanceQueryDetail *d = imp();
+  d->default_range = range;
+}
+
+
+const float *InterpolatedClearanceQuery::gradientX() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return (!d->gradient_x.empty()) ? d->gradient_x.data() : nullptr;
+}
+
+
+const float *InterpolatedClearanceQuery::gradientY() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return (!d->gradient_y.empty()) ? d->gradient_y.data() : nullptr;
+}
+
+
+const float *InterpolatedClearanceQuery::gradientZ() const
+{
+  const InterpolatedClearanceQueryDetail *d = imp();
+  return (!d->gradient_z.empty()) ? d->gradient_z.data() : nullptr;
+}
+
+
+bool InterpolatedClearanceQuery::onExecute()
+{
+  InterpolatedClearanceQueryDetail *d = imp();
+
+  if (!d->map || d->map->layout().clearanceLayer() < 0)
+  {
+    return false;
+  }
+
+  const OccupancyMap &map = *d->map;
+  SampleParams params;
+  params.origin = map.origin();
+  params.region_dim = glm::ivec3(map.regionVoxelDimensions());
+  params.coord_limit = glm::min(double(std::numeric_limits<RegionCoord>::max()) * glm::dvec3(params.region_dim),
+                                glm::dvec3(std::numeric_limits<int>::max() / 2));
+  params.inv_resolution = 1.0 / map.resolution();
+  params.resolution = float(map.resolution());
+  params.default_range = d->default_range;
+  params.unknown_range = (d->query_flags & kQfUnknownAsOccupied) ? 0.0f : d->default_range;
+  params.clearance_layer = map.layout().clearanceLayer();
+
+  const size_t point_count = d->points.size();
+  d->intersected_voxels.resize(point_count);
+  d->ranges.resize(point_count);
+  d->gradient_x.resize(point_count);
+  d->gradient_y.resize(point_count);
+  d->gradient_z.resize(point_count);
+
+  // Resolve the interpolation cell for each point.
+  std::vector<SamplePoint> &samples = d->samples;
+  samples.resize(point_count);
+  size_t sample_count = 0;
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    SamplePoint &sample = samples[sample_count];
+    if (resolveCell(d->points[i], params, sample))
+    {
+      sample.index = unsigned(i);
+      ++sample_count;
+    }
+    else
+    {
+      d->intersected_voxels[i] = Key::kNull;
+      d->ranges[i] = params.unknown_range;
+      d->gradient_x[i] = d->gradient_y[i] = d->gradient_z[i] = 0.0f;
+    }
+  }
+  samples.resize(sample_count);
+
+  // Group the samples by region using a counting sort. Batches are ordered by first occurrence. Consecutive points
+  // generally share a region, so we only look up the batch on a region change.
+  std::vector<size_t> &batches = d->batches;
+  batches.clear();
+  d->batch_lookup.clear();
+  d->sample_batch.resize(sample_count);
+  RegionKey last_region(0);
+  unsigned last_batch = ~0u;
+  for (size_t i = 0; i < sample_count; ++i)
+  {
+    const RegionKey &region_key = samples[i].base.regionKey();
+    if (last_batch == ~0u || region_key != last_region)
+    {
+      const auto inserted = d->batch_lookup.insert(std::make_pair(region_key, unsigned(batches.size())));
+      if (inserted.second)
+      {
+        batches.emplace_back(0);
+      }
+      last_region = region_key;
+      last_batch = inserted.first->second;
+    }
+    d->sample_batch[i] = last_batch;
+    ++batches[last_batch];
+  }
+
+  // Convert counts to batch start indices then scatter.
+  size_t offset = 0;
+  for (size_t &batch : batches)
+  {
+    const size_t count = batch;
+    batch = offset;
+    offset += count;
+  }
+  batches.emplace_back(offset);
+
+  d->batch_insert.assign(batches.begin(), batches.end() - 1);
+  std::vector<SamplePoint> &grouped = d->grouped_samples;
+  grouped.resize(sample_count);
+  for (size_t i = 0; i < sample_count; ++i)
+  {
+    grouped[d->batch_insert[d->sample_batch[i]]++] = samples[i];
+  }
+
+  const auto sample_batches = [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b)
+    {
+      sampleRegion(map, params, grouped.data(), batches[b], batches[b + 1], *d);
+    }
+  };
+
+#ifdef OHM_THREADS
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, batches.size() - 1),
+                    [&sample_batches](const tbb::blocked_range<size_t> &range) {  //
+                      sample_batches(range.begin(), range.end());
+                    });
+#else   // OHM_THREADS
+  sample_batches(0u, batches.size() - 1);
+#endif  // OHM_THREADS
+
+  d->number_of_results = point_count;
+  return true;
+}
+
+
+void InterpolatedClearanceQuery::onReset(bool /*hard_reset*/)
+{
+  InterpolatedClearanceQueryDetail *d = imp();
+  d->gradient_x.clear();
+  d->gradient_y.clear();
+  d->gradient_z.clear();
+}
+
+
+InterpolatedClearanceQueryDetail *InterpolatedClearanceQuery::imp()
+{
+  return static_cast<InterpolatedClearanceQueryDetail *>(imp_);
+}
+
+
+const InterpolatedClearanceQueryDetail *InterpolatedClearanceQuery::imp() const
+{
+  return static_cast<const InterpolatedClearanceQueryDetail *>(imp_);
+}
+}  // namespace ohm
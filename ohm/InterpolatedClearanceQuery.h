@@ -0,0 +1,114 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_INTERPOLATEDCLEARANCEQUERY_H
+#define OHM_INTERPOLATEDCLEARANCEQUERY_H
+
+#include "OhmConfig.h"
+
+#include "Query.h"
+#include "QueryFlag.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+struct InterpolatedClearanceQueryDetail;
+
+/// A query which samples the voxel clearance layer at arbitrary points, yielding trilinearly interpolated clearance
+/// values and their spatial gradients.
+///
+/// This query is intended for consumers such as trajectory optimisers which make many clearance lookups and require a
+/// continuous distance field. The clearance layer must be populated beforehand by a @c ClearanceProcess or
+/// @c ClearanceProcessCpu ; this query only reads the existing clearance values.
+///
+/// The query points are set via @c setPoints() . Each point is interpolated from the clearance values at the centres of
+/// the eight voxels surrounding the point. Points are internally grouped by region so that each region's clearance
+/// memory is resolved once per batch, and the batches are processed in parallel when ohm is built with
+/// @c OHM_THREADS . Working memory is retained between executions to suit repeated queries. Results are reported in
+/// the order the points are given, in struct of arrays form:
+/// - @c intersectedVoxels() identifies the voxel containing each point.
+/// - @c ranges() holds the interpolated clearance value for each point.
+/// - @c gradientX() , @c gradientY() and @c gradientZ() hold the gradient of the interpolated clearance for each point
+///   in clearance units per metre.
+///
+/// Raw clearance values are negative where there are no obstructions within the clearance search radius. Such values
+/// are replaced by the @c defaultRangeValue() before interpolation, which should be set to the clearance search radius
+/// for a continuous field. Voxels in regions without valid clearance data are replaced by zero when the
+/// @c kQfUnknownAsOccupied flag is set, or by the @c defaultRangeValue() otherwise.
+///
+/// The gradient is the analytic derivative of the trilinear interpolation. It is discontinuous across voxel centres.
+class ohm_API InterpolatedClearanceQuery : public Query
+{
+public:
+  /// Default flags to execute this query with.
+  static const unsigned kDefaultFlags = kQfNoCache;
+
+protected:
+  /// Constructor used for inherited objects. This supports deriving @p InterpolatedClearanceQueryDetail into
+  /// more specialised forms.
+  /// @param detail pimple style data structure. When null, a @c InterpolatedClearanceQueryDetail is allocated by
+  /// this method.
+  explicit InterpolatedClearanceQuery(InterpolatedClearanceQueryDetail *detail);
+
+public:
+  /// Constructor.
+  InterpolatedClearanceQuery();
+
+  /// Construct a new query using the given parameters.
+  /// @param map The map to perform the query on.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag .
+  explicit InterpolatedClearanceQuery(OccupancyMap &map, unsigned query_flags = kDefaultFlags);
+
+  /// Destructor.
+  ~InterpolatedClearanceQuery() override;
+
+  /// Set the points to sample. The points are copied.
+  /// @param points The array of global coordinates to sample.
+  /// @param point_count Number of elements in @p points .
+  void setPoints(const glm::dvec3 *points, size_t point_count);
+
+  /// Access the points to sample.
+  /// @return The sample points array of @c pointCount() elements.
+  const glm::dvec3 *points() const;
+
+  /// Query the number of points to sample.
+  /// @return The number of sample points.
+  size_t pointCount() const;
+
+  /// Get the range value used for voxels with no obstructions within the clearance search radius.
+  /// @return The range value substituted for unobstructed voxels.
+  /// @see setDefaultRangeValue()
+  float defaultRangeValue() const;
+  /// Set the range value used for voxels with no obstructions within the clearance search radius. This should
+  /// generally be the search radius used to generate the clearance layer. The default is -1, which interpolates the
+  /// raw clearance values.
+  /// @param range The range to substitute for unobstructed voxels.
+  void setDefaultRangeValue(float range);
+
+  /// Get the gradient X components for each point. Valid after execution with @c numberOfResults() elements.
+  /// @return The gradient X component array or null when there are no results.
+  const float *gradientX() const;
+  /// Get the gradient Y components for each point. Valid after execution with @c numberOfResults() elements.
+  /// @return The gradient Y component array or null when there are no results.
+  const float *gradientY() const;
+  /// Get the gradient Z components for each point. Valid after execution with @c numberOfResults() elements.
+  /// @return The gradient Z component array or null when there are no results.
+  const float *gradientZ() const;
+
+protected:
+  bool onExecute() override;
+  void onReset(bool hard_reset) override;
+
+  /// Access internal details.
+  /// @return Internal details.
+  InterpolatedClearanceQueryDetail *imp();
+  /// Access internal details.
+  /// @return Internal details.
+  const InterpolatedClearanceQueryDetail *imp() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_INTERPOLATEDCLEARANCEQUERY_H
@@ -0,0 +1,419 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "KNearestOccupied.h"
+
+#include "Key.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "QueryFlag.h"
+
+#include "private/KNearestOccupiedDetail.h"
+#include "private/OccupancyMapDetail.h"
+#include "private/OccupancyQueryAlg.h"
+
+#include <glm/glm.hpp>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+/// Query execution parameters, shared by all query points.
+struct KNearestParams
+{
+  /// Regions which may be searched, with up to date voxel masks.
+  QueryRegionMap regions;
+  /// Bounds of all map regions. Unless treating unknown space as occupied, the search does not expand away from these
+  /// bounds.
+  glm::ivec3 map_region_min{ 0 };
+  glm::ivec3 map_region_max{ -1 };
+  glm::dvec3 region_spatial_dim{ 0 };
+  glm::ivec3 region_dim{ 0 };
+  double resolution = 0;
+  /// Maximum squared search range.
+  float range_limit_sqr = std::numeric_limits<float>::infinity();
+  unsigned k = 1;
+  bool unknown_as_occupied = false;
+};
+
+/// A candidate voxel result.
+struct Neighbour
+{
+  float range_sqr;
+  Key key;
+
+  inline bool operator<(const Neighbour &other) const { return range_sqr < other.range_sqr; }
+};
+
+/// A region in the best first search queue.
+struct RegionItem
+{
+  double range_sqr;
+  RegionKey key;
+
+  inline bool operator>(const RegionItem &other) const { return range_sqr > other.range_sqr; }
+};
+
+/// Working memory for searching about a single point. One per thread.
+struct KNearestWorkspace
+{
+  /// Max heap of the nearest voxels found so far.
+  std::vector<Neighbour> nearest;
+  std::priority_queue<RegionItem, std::vector<RegionItem>, std::greater<RegionItem>> open;
+  ska::bytell_hash_set<RegionKey, Vector3Hash<RegionKey>> visited;
+};
+
+/// Squared range from @p point to the closest point of the region @p region_key .
+double regionRangeSqr(const OccupancyMap &map, const KNearestParams &params, const RegionKey &region_key,
+                      const glm::dvec3 &point)
+{
+  const glm::dvec3 region_min = map.regionCentreGlobal(region_key) - 0.5 * params.region_spatial_dim;
+  const glm::dvec3 separation = glm::clamp(point, region_min, region_min + params.region_spatial_dim) - point;
+  return glm::dot(separation, separation);
+}
+
+/// Search for the nearest voxels to @p point . Results are written to @p keys and @p ranges in order of range.
+/// @return The number of results.
+unsigned searchPoint(const OccupancyMap &map, const KNearestParams &params, const glm::dvec3 &point,
+                     KNearestWorkspace &work, Key *keys, float *ranges)
+{
+  work.nearest.clear();
+  work.visited.clear();
+  while (!work.open.empty())
+  {
+    work.open.pop();
+  }
+
+  const glm::vec3 query_origin(point - map.origin());
+  // Current squared range bound: the search limit or the k-th nearest range once we have k results.
+  const auto range_bound = [&params, &work]() {
+    return (work.nearest.size() < params.k) ? params.range_limit_sqr :
+                                              std::min(params.range_limit_sqr, work.nearest.front().range_sqr);
+  };
+
+  const auto add_voxel = [&](const RegionKey &region_key, unsigned voxel_index, bool /*unobserved*/) {
+    const Key key(region_key, voxelLocalKey(voxel_index, params.region_dim));
+    const glm::vec3 separation = glm::vec3(map.voxelCentreLocal(key)) - query_origin;
+    const float range_sqr = glm::dot(separation, separation);
+    if (range_sqr > range_bound())
+    {
+      return;
+    }
+    if (work.nearest.size() == params.k)
+    {
+      std::pop_heap(work.nearest.begin(), work.nearest.end());
+      work.nearest.pop_back();
+    }
+    work.nearest.emplace_back(Neighbour{ range_sqr, key });
+    std::push_heap(work.nearest.begin(), work.nearest.end());
+  };
+
+  const RegionKey start_region = map.regionKey(point);
+  work.open.push(RegionItem{ regionRangeSqr(map, params, start_region, point), start_region });
+  work.visited.insert(start_region);
+
+  const glm::ivec3 face_offsets[6] = { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),  glm::ivec3(0, -1, 0),
+                                       glm::ivec3(0, 1, 0),  glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1) };
+  const int coord_min = int(std::numeric_limits<RegionCoord>::lowest()) + 1;
+  const int coord_max = int(std::numeric_limits<RegionCoord>::max());
+
+  while (!work.open.empty())
+  {
+    const RegionItem item = work.open.top();
+    work.open.pop();
+
+    if (item.range_sqr > double(range_bound()))
+    {
+      // All remaining regions are further than the bound.
+      break;
+    }
+
+    const auto search = params.regions.find(item.key);
+    const MapChunk *chunk = (search != params.regions.end()) ? search->second : nullptr;
+    if (chunk || params.unknown_as_occupied)
+    {
+      // Limit the voxels visited to the current range bound where available, padded for floating point error.
+      glm::ivec3 voxel_min(0);
+      glm::ivec3 voxel_max = params.region_dim - 1;
+      const float bound = range_bound();
+      if (bound < std::numeric_limits<float>::infinity())
+      {
+        const glm::dvec3 region_min = map.regionCentreGlobal(item.key) - 0.5 * params.region_spatial_dim;
+        const glm::dvec3 extents(std::sqrt(double(bound)));
+        voxel_min = glm::max(glm::ivec3(glm::floor((point - extents - region_min) / params.resolution)) - 1, voxel_min);
+        voxel_max = glm::min(glm::ivec3(glm::floor((point + extents - region_min) / params.resolution)) + 1, voxel_max);
+      }
+
+      visitObstructedVoxels(chunk, params.region_dim, voxel_min, voxel_max, params.unknown_as_occupied,
+                            [&](unsigned voxel_index, bool unobserved) {  //
+                              add_voxel(item.key, voxel_index, unobserved);
+                            });
+    }
+
+    // Expand to face neighbours. Best first expansion over face neighbours reaches regions in order of range.
+    for (const glm::ivec3 &offset : face_offsets)
+    {
+      const glm::ivec3 coord = glm::ivec3(item.key) + offset;
+      if (glm::any(glm::lessThan(coord, glm::ivec3(coord_min))) ||
+          glm::any(glm::greaterThan(coord, glm::ivec3(coord_max))))
+      {
+        continue;
+      }
+      const int axis = (offset.x) ? 0 : ((offset.y) ? 1 : 2);
+      if (!params.unknown_as_occupied && ((offset[axis] < 0 && coord[axis] < params.map_region_min[axis]) ||
+                                          (offset[axis] > 0 && coord[axis] > params.map_region_max[axis])))
+      {
+        // Nothing to find moving away from the map. Regions outside the map are still expanded towards the map so
+        // query points outside the map reach it.
+        continue;
+      }
+
+      const RegionKey neighbour_key(coord);
+      if (!work.visited.insert(neighbour_key).second)
+      {
+        continue;
+      }
+
+      const double range_sqr = regionRangeSqr(map, params, neighbour_key, point);
+      if (range_sqr <= double(range_bound()))
+      {
+        work.open.push(RegionItem{ range_sqr, neighbour_key });
+      }
+    }
+  }
+
+  std::sort_heap(work.nearest.begin(), work.nearest.end());
+  for (size_t i = 0; i < work.nearest.size(); ++i)
+  {
+    keys[i] = work.nearest[i].key;
+    ranges[i] = std::sqrt(work.nearest[i].range_sqr);
+  }
+  return unsigned(work.nearest.size());
+}
+
+
+/// Collect the regions which may be searched into @p params and bring their voxel masks up to date.
+void prepareRegions(const OccupancyMap &map, const KNearestOccupiedDetail &query, KNearestParams &params)
+{
+  // Limit the regions to those within the search radius of the points.
+  glm::ivec3 search_min(std::numeric_limits<int>::lowest());
+  glm::ivec3 search_max(std::numeric_limits<int>::max());
+  if (query.search_radius > 0)
+  {
+    glm::dvec3 point_min = query.near_points.front();
+    glm::dvec3 point_max = query.near_points.front();
+    for (const glm::dvec3 &point : query.near_points)
+    {
+      point_min = glm::min(point_min, point);
+      point_max = glm::max(point_max, point);
+    }
+    search_min = glm::ivec3(map.regionKey(point_min - glm::dvec3(query.search_radius)));
+    search_max = glm::ivec3(map.regionKey(point_max + glm::dvec3(query.search_radius)));
+  }
+
+  prepareQueryRegions(map, search_min, search_max, params.unknown_as_occupied, params.regions,
+                      &params.map_region_min, &params.map_region_max);
+}
+}  // namespace
+
+
+KNearestOccupied::KNearestOccupied(KNearestOccupiedDetail *detail)
+  : Query(detail)
+{}
+
+
+KNearestOccupied::KNearestOccupied()
+  : KNearestOccupied(new KNearestOccupiedDetail)
+{}
+
+
+KNearestOccupied::KNearestOccupied(OccupancyMap &map, const glm::dvec3 &near_point, unsigned k, unsigned query_flags)
+  : KNearestOccupied(new KNearestOccupiedDetail)
+{
+  setMap(&map);
+  setNearPoint(near_point);
+  setK(k);
+  setQueryFlags(query_flags);
+}
+
+
+KNearestOccupied::~KNearestOccupied()
+{
+  wait();
+  KNearestOccupiedDetail *d = imp();
+  delete d;
+  // Clear pointer for base class.
+  imp_ = nullptr;
+}
+
+
+glm::dvec3 KNearestOccupied::nearPoint() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return (!d->near_points.empty()) ? d->near_points.front() : glm::dvec3(0);
+}
+
+
+void KNearestOccupied::setNearPoint(const glm::dvec3 &point)
+{
+  KNearestOccupiedDetail *d = imp();
+  d->near_points.assign(1, point);
+}
+
+
+void KNearestOccupied::setNearPoints(const glm::dvec3 *points, size_t point_count)
+{
+  KNearestOccupiedDetail *d = imp();
+  d->near_points.assign(points, points + point_count);
+}
+
+
+const glm::dvec3 *KNearestOccupied::nearPoints() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return d->near_points.data();
+}
+
+
+size_t KNearestOccupied::pointCount() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return d->near_points.size();
+}
+
+
+unsigned KNearestOccupied::k() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return d->k;
+}
+
+
+void KNearestOccupied::setK(unsigned k)
+{
+  KNearestOccupiedDetail *d = imp();
+  d->k = k;
+}
+
+
+float KNearestOccupied::searchRadius() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return d->search_radius;
+}
+
+
+void KNearestOccupied::setSearchRadius(float range)
+{
+  KNearestOccupiedDetail *d = imp();
+  d->search_radius = range;
+}
+
+
+const size_t *KNearestOccupied::resultOffsets() const
+{
+  const KNearestOccupiedDetail *d = imp();
+  return (!d->result_offsets.empty()) ? d->result_offsets.data() : nullptr;
+}
+
+
+bool KNearestOccupied::onExecute()
+{
+  KNearestOccupiedDetail *d = imp();
+
+  if (!d->map || d->map->layout().occupancyLayer() < 0)
+  {
+    return false;
+  }
+
+  const OccupancyMap &map = *d->map;
+  const size_t point_count = d->near_points.size();
+  d->result_offsets.assign(point_count + 1, 0u);
+
+  KNearestParams params;
+  params.k = (d->query_flags & kQfNearestResult) ? std::min(d->k, 1u) : d->k;
+  if (params.k == 0 || point_count == 0)
+  {
+    return true;
+  }
+
+  params.region_spatial_dim = map.regionSpatialResolution();
+  params.region_dim = glm::ivec3(map.regionVoxelDimensions());
+  params.resolution = map.resolution();
+  params.unknown_as_occupied = (d->query_flags & kQfUnknownAsOccupied) != 0;
+  if (d->search_radius > 0)
+  {
+    params.range_limit_sqr = d->search_radius * d->search_radius;
+  }
+  prepareRegions(map, *d, params);
+
+  // Search each point into a fixed stride buffer, then compact.
+  std::vector<Key> keys(point_count * params.k);
+  std::vector<float> ranges(point_count * params.k);
+  std::vector<unsigned> counts(point_count);
+  const auto search_points = [&](size_t begin, size_t end) {
+    KNearestWorkspace work;
+    for (size_t i = begin; i < end; ++i)
+    {
+      counts[i] =
+        searchPoint(map, params, d->near_points[i], work, keys.data() + i * params.k, ranges.data() + i * params.k);
+    }
+  };
+
+#ifdef OHM_THREADS
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, point_count),
+                    [&search_points](const tbb::blocked_range<size_t> &range) {  //
+                      search_points(range.begin(), range.end());
+                    });
+#else   // OHM_THREADS
+  search_points(0u, point_count);
+#endif  // OHM_THREADS
+
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    d->result_offsets[i + 1] = d->result_offsets[i] + counts[i];
+    for (unsigned j = 0; j < counts[i]; ++j)
+    {
+      d->intersected_voxels.emplace_back(keys[i * params.k + j]);
+      d->ranges.emplace_back(ranges[i * params.k + j]);
+    }
+  }
+  d->number_of_results = d->intersected_voxels.size();
+
+  return true;
+}
+
+
+void KNearestOccupied::onReset(bool /*hard_reset*/)
+{
+  KNearestOccupiedDetail *d = imp();
+  d->result_offsets.clear();
+}
+
+
+KNearestOccupiedDetail *KNearestOccupied::imp()
+{
+  return static_cast<KNearestOccupiedDetail *>(imp_);
+}
+
+
+const KNearestOccupiedDetail *KNearestOccupied::imp() const
+{
+  return static_cast<const KNearestOccupiedDetail *>(imp_);
+}
+}  // namespace ohm
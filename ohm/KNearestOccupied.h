@@ -0,0 +1,119 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_KNEARESTOCCUPIED_H
+#define OHM_KNEARESTOCCUPIED_H
+
+#include "OhmConfig.h"
+
+#include "Query.h"
+#include "QueryFlag.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+struct KNearestOccupiedDetail;
+
+/// A k nearest obstructed voxels query for an @c OccupancyMap.
+///
+/// This finds up to @c k() obstructed voxels closest to each of a set of query points. Obstructed voxels are occupied
+/// voxels and, with the @c kQfUnknownAsOccupied flag, unobserved voxels including those in absent regions. As with
+/// @c NearestNeighbours , ranges are measured to the voxel centres. An optional @c searchRadius() limits the results
+/// to voxels within that range.
+///
+/// Regions are visited best first in order of their distance from the query point. The search terminates once the
+/// next region is further than the k-th nearest voxel found so far, or beyond the @c searchRadius() , or - without
+/// @c kQfUnknownAsOccupied - outside the extents of the map regions. Candidate voxels are resolved from the per region
+/// @c MapChunk::occupied_mask so only obstructed voxels are considered. Query points are processed in parallel when
+/// ohm is built with @c OHM_THREADS .
+///
+/// Results are reported via @c intersectedVoxels() and @c ranges() , grouped by query point and sorted by range.
+/// The results for query point @c i are in the range <tt>[resultOffsets()[i], resultOffsets()[i + 1])</tt> , which
+/// may contain fewer than @c k() results. Setting @c kQfNearestResult is equivalent to a @c k() of one.
+///
+/// The voxel masks for the regions which may be searched are updated before the parallel search. Without a
+/// @c searchRadius() this covers every region in the map, so the first execution may visit the whole map. Subsequent
+/// executions only rebuild masks for modified regions.
+class ohm_API KNearestOccupied : public Query
+{
+public:
+  /// Default flags to execute this query with.
+  static const unsigned kDefaultFlags = kQfNoCache;
+
+protected:
+  /// Constructor used for inherited objects. This supports deriving @p KNearestOccupiedDetail into
+  /// more specialised forms.
+  /// @param detail pimple style data structure. When null, a @c KNearestOccupiedDetail is allocated by
+  /// this method.
+  explicit KNearestOccupied(KNearestOccupiedDetail *detail);
+
+public:
+  /// Constructor.
+  KNearestOccupied();
+
+  /// Construct a new query using the given parameters.
+  /// @param map The map to perform the query on.
+  /// @param near_point The global coordinate to search around.
+  /// @param k The number of nearest voxels to find.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag .
+  KNearestOccupied(OccupancyMap &map, const glm::dvec3 &near_point, unsigned k,
+                   unsigned query_flags = kDefaultFlags);
+
+  /// Destructor.
+  ~KNearestOccupied() override;
+
+  /// Get the first query point.
+  /// @return The first query point or the origin when there are none.
+  glm::dvec3 nearPoint() const;
+  /// Set a single query point, replacing any existing points.
+  /// @param point The new search coordinate.
+  void setNearPoint(const glm::dvec3 &point);
+
+  /// Set multiple query points, replacing any existing points. The points are copied.
+  /// @param points The array of global coordinates to search around.
+  /// @param point_count Number of elements in @p points .
+  void setNearPoints(const glm::dvec3 *points, size_t point_count);
+
+  /// Access the query points.
+  /// @return The query points array of @c pointCount() elements.
+  const glm::dvec3 *nearPoints() const;
+
+  /// Query the number of query points.
+  /// @return The number of query points.
+  size_t pointCount() const;
+
+  /// Get the number of nearest voxels to find for each point.
+  /// @return The maximum number of results per point.
+  unsigned k() const;
+  /// Set the number of nearest voxels to find for each point.
+  /// @param k The maximum number of results per point.
+  void setK(unsigned k);
+
+  /// Get the maximum search radius. Zero for no limit.
+  /// @return The search radius.
+  float searchRadius() const;
+  /// Set the maximum search radius. Only voxels within this range are reported. Zero for no limit.
+  /// @param range The new search radius.
+  void setSearchRadius(float range);
+
+  /// Get the result offsets for each query point. Valid after execution with @c pointCount() + 1 elements.
+  /// @return The result offsets array or null when not executed.
+  const size_t *resultOffsets() const;
+
+protected:
+  bool onExecute() override;
+  void onReset(bool hard_reset) override;
+
+  /// Access internal details.
+  /// @return Internal details.
+  KNearestOccupiedDetail *imp();
+  /// Access internal details.
+  /// @return Internal details.
+  const KNearestOccupiedDetail *imp() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_KNEARESTOCCUPIED_H
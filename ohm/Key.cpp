@@ -10,19 +10,25 @@
 
 namespace ohm
 {
-const int16_t Key::kInvalidValue = INVALID_VALUE;
+const RegionCoord Key::kInvalidValue = INVALID_VALUE;
 const Key Key::kNull(glm::ivec3(INVALID_VALUE), 0, 0, 0);  // NOLINT
 
 size_t Key::Hash::operator()(const Key &key) const
 {
   const unsigned one_byte_shift = 8u;
   const unsigned two_byte_shift = 16u;
-  glm::u32vec3 hash;
-  hash.x = key.region_key_.x | key.region_key_.z << two_byte_shift;  // NOLINT(hicpp-signed-bitwise)
-  hash.y = key.region_key_.y;
-  hash.z =
+  const uint32_t local =
     key.local_[0] | key.local_[1] << one_byte_shift | key.local_[2] << two_byte_shift;  // NOLINT(hicpp-signed-bitwise)
+#ifdef OHM_REGION_COORD_32
+  // Full 32-bit region coordinates. Hash all four words.
+  return vhash::hashBits(uint32_t(key.region_key_.x), uint32_t(key.region_key_.y), uint32_t(key.region_key_.z), local);
+#else   // OHM_REGION_COORD_32
+  glm::u32vec3 hash;
+  hash.x = uint16_t(key.region_key_.x) | uint32_t(uint16_t(key.region_key_.z)) << two_byte_shift;
+  hash.y = uint16_t(key.region_key_.y);
+  hash.z = local;
   return vhash::hashBits(hash.x, hash.y, hash.z);
+#endif  // OHM_REGION_COORD_32
 }
 
 unsigned Key::regionHash() const
@@ -7,6 +7,8 @@
 
 #include "OhmConfig.h"
 
+#include "RegionKey.h"
+
 #include <glm/glm.hpp>
 
 #include <cinttypes>
@@ -25,7 +27,7 @@ class ohm_API Key
 {
 public:
   /// Initialiser value for @c kNull.
-  static const int16_t kInvalidValue;
+  static const RegionCoord kInvalidValue;
   /// A static instance of a null key (equivalent to @c Key(nullptr) ).
   static const Key kNull;
 
@@ -59,19 +61,19 @@ public:
   /// @param x The x coordinate for the local key. Must be in range for the region.
   /// @param y The y coordinate for the local key. Must be in range for the region.
   /// @param z The z coordinate for the local key. Must be in range for the region.
-  Key(int16_t rx, int16_t ry, int16_t rz, uint8_t x, uint8_t y, uint8_t z);
+  Key(RegionCoord rx, RegionCoord ry, RegionCoord rz, uint8_t x, uint8_t y, uint8_t z);
 
   /// Construct a key for a region.
   /// @param region_key Initialises the region key part of the key.
   /// @param x The x coordinate for the local key. Must be in range for the region.
   /// @param y The y coordinate for the local key. Must be in range for the region.
   /// @param z The z coordinate for the local key. Must be in range for the region.
-  Key(const glm::i16vec3 &region_key, uint8_t x, uint8_t y, uint8_t z);
+  Key(const RegionKey &region_key, uint8_t x, uint8_t y, uint8_t z);
 
   /// Construct a key for a region.
   /// @param region_key Initialises the region key part of the key.
   /// @param local_key Initialises the local key part of the key.
-  Key(const glm::i16vec3 &region_key, const glm::u8vec3 &local_key);
+  Key(const RegionKey &region_key, const glm::u8vec3 &local_key);
 
   ~Key() = default;
 
@@ -88,15 +90,15 @@ public:
   /// Set one of the region key axis values.
   /// @param axis The axis to set with 0, 1, 2 cooresponding to x, y, z.
   /// @param val The value to set for the axis.
-  void setRegionAxis(int axis, int16_t val);
+  void setRegionAxis(int axis, RegionCoord val);
 
   /// Access the region part of this key. See class comments.
   /// @return The region part of the key.
-  inline const glm::i16vec3 &regionKey() const { return region_key_; }
+  inline const RegionKey &regionKey() const { return region_key_; }
 
   /// Set the region part for this key. See class comments.
   /// @param key The new @c regionKey() to set.
-  inline void setRegionKey(const glm::i16vec3 &key) { region_key_ = key; }
+  inline void setRegionKey(const RegionKey &key) { region_key_ = key; }
 
   /// Set one of the local key axis values.
   /// @param axis The axis to set with 0, 1, 2 cooresponding to x, y, z.
@@ -193,7 +195,7 @@ public:
   /// Test whether this is a null key or not. Note, the default constructor creates
   /// invalid keys, not null keys.
   /// @return True if this is a null key.
-  inline bool isNull() const { return region_key_ == glm::i16vec3(kInvalidValue); }
+  inline bool isNull() const { return region_key_ == RegionKey(kInvalidValue); }
 
   /// Assignment operator.
   /// @param other Key to copy.
@@ -214,21 +216,21 @@ public:
   bool operator<(const Key &other) const;
 
 private:
-  glm::i16vec3 region_key_;
+  RegionKey region_key_;
   glm::u8vec3 local_;
 };
 
-inline Key::Key(int16_t rx, int16_t ry, int16_t rz, uint8_t x, uint8_t y, uint8_t z)
-  : Key(glm::i16vec3(rx, ry, rz), glm::u8vec3(x, y, z))
+inline Key::Key(RegionCoord rx, RegionCoord ry, RegionCoord rz, uint8_t x, uint8_t y, uint8_t z)
+  : Key(RegionKey(rx, ry, rz), glm::u8vec3(x, y, z))
 {}
 
 
-inline Key::Key(const glm::i16vec3 &region_key, uint8_t x, uint8_t y, uint8_t z)
+inline Key::Key(const RegionKey &region_key, uint8_t x, uint8_t y, uint8_t z)
   : Key(region_key, glm::u8vec3(x, y, z))
 {}
 
 
-inline Key::Key(const glm::i16vec3 &region_key, const glm::u8vec3 &local_key)
+inline Key::Key(const RegionKey &region_key, const glm::u8vec3 &local_key)
   : region_key_(region_key)
   , local_(local_key)
 {}
@@ -261,7 +263,7 @@ inline void Key::setAxisFrom(int axis, const Key &other)
 }
 
 
-inline void Key::setRegionAxis(int axis, int16_t val)
+inline void Key::setRegionAxis(int axis, RegionCoord val)
 {
   region_key_[axis] = val;
 }
@@ -331,18 +333,22 @@ inline bool Key::operator!=(const Key &other) const
 
 inline bool Key::operator<(const Key &other) const
 {
-  // Linearise the region index.
-  uint64_t region_a = uint64_t(unsigned(region_key_.x) + 0xffffu) |                 // NOLINT(readability-magic-numbers)
-                      (uint64_t(unsigned(region_key_.y) + 0xffffu) << 16u) |        // NOLINT(readability-magic-numbers)
-                      (uint64_t(unsigned(region_key_.z) + 0xffffu) << 32u);         // NOLINT(readability-magic-numbers)
-  uint64_t region_b = uint64_t(unsigned(other.region_key_.x) + 0xffffu) |           // NOLINT(readability-magic-numbers)
-                      (uint64_t(unsigned(other.region_key_.y) + 0xffffu) << 16u) |  // NOLINT(readability-magic-numbers)
-                      (uint64_t(unsigned(other.region_key_.z) + 0xffffu) << 32u);   // NOLINT(readability-magic-numbers)
-  // NOLINTNEXTLINE(readability-magic-numbers)
-  uint32_t local_a = uint32_t(local_.x) | (uint32_t(local_.y) << 8u) | (uint32_t(local_.z) << 16u);
-  // NOLINTNEXTLINE(readability-magic-numbers)
-  uint32_t local_b = uint32_t(other.local_.x) | (uint32_t(other.local_.y) << 8u) | (uint32_t(other.local_.z) << 16u);
-  return region_a < region_b || region_a == region_b && local_a < local_b;
+  // Lexicographic ordering: region Z, Y, X then local Z, Y, X.
+  for (int i = 2; i >= 0; --i)
+  {
+    if (region_key_[i] != other.region_key_[i])
+    {
+      return region_key_[i] < other.region_key_[i];
+    }
+  }
+  for (int i = 2; i >= 0; --i)
+  {
+    if (local_[i] != other.local_[i])
+    {
+      return local_[i] < other.local_[i];
+    }
+  }
+  return false;
 }
 }  // namespace ohm
 
@@ -44,4 +44,20 @@ Key &KeyList::add()
   keys_.emplace_back(Key::kNull);
   return keys_.back();
 }
+
+
+bool KeyList::pack(std::vector<PackedKey> &packed, const PackedKeyCodec &codec) const
+{
+  packed.resize(keys_.size());
+  const size_t packed_count = codec.pack(keys_.data(), keys_.size(), packed.data());
+  packed.resize(packed_count);
+  return packed_count == keys_.size();
+}
+
+
+void KeyList::unpack(const std::vector<PackedKey> &packed, const PackedKeyCodec &codec)
+{
+  keys_.resize(packed.size());
+  codec.unpack(packed.data(), packed.size(), keys_.data());
+}
 }  // namespace ohm
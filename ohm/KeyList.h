@@ -8,6 +8,7 @@
 #include "OhmConfig.h"
 
 #include "Key.h"
+#include "PackedKey.h"
 
 #include <vector>
 
@@ -248,6 +249,21 @@ public:
   /// @param key The key to add.
   inline void add(const Key &key) { return emplace_back(key); }
 
+  /// Pack the keys in this list into @p packed using @p codec . The @p packed array is resized to match this list.
+  ///
+  /// Packed keys are cheaper to hash, compare and sort, so this is the preferred form for de-duplicating or sorting
+  /// large key sets. See @c PackedKey .
+  ///
+  /// @param[out] packed The packed key array.
+  /// @param codec The key packing codec for the map which generated the keys.
+  /// @return True if all keys were packed. On failure, @p packed is truncated at the first unpackable key.
+  bool pack(std::vector<PackedKey> &packed, const PackedKeyCodec &codec) const;
+
+  /// Replace the contents of this list with the unpacked @p packed keys.
+  /// @param packed The packed keys.
+  /// @param codec The key packing codec used to pack @p packed .
+  void unpack(const std::vector<PackedKey> &packed, const PackedKeyCodec &codec);
+
 private:
   std::vector<Key> keys_;
 };
@@ -57,6 +57,7 @@ LineKeysQuery::LineKeysQuery(unsigned query_flags)
 
 LineKeysQuery::~LineKeysQuery()
 {
+  wait();
   auto *d = static_cast<LineKeysQueryDetail *>(imp_);
   delete d;
   imp_ = nullptr;
@@ -124,24 +125,6 @@ bool LineKeysQuery::onExecute()
 }
 
 
-bool LineKeysQuery::onExecuteAsync()
-{
-  auto *d = static_cast<LineKeysQueryDetail *>(imp_);
-
-  if ((d->query_flags & kQfGpuEvaluate))
-  {
-    static bool once = false;
-    if (!once)
-    {
-      once = true;
-      std::cerr << "GPU unavailable for LineKeysQuery. Failing async call.\n" << std::flush;
-    }
-  }
-
-  return false;
-}
-
-
 void LineKeysQuery::onReset(bool /*hard_reset*/)
 {
   auto *d = static_cast<LineKeysQueryDetail *>(imp_);
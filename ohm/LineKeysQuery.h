@@ -21,14 +21,14 @@ struct LineKeysQueryDetail;
 ///
 /// The results are similar to those of @c OccupancyMap::calculateSegmentKeys() (identical when using CPU),
 /// but supports batched and GPU based calculation. The GPU calculation is generally only marginally faster
-/// than CPU, but GPU supports @c executeAsync(), which is not supported for CPU.
+/// than CPU.
 ///
 /// In practice, this query isn't very useful as the GPU performance gains are minimal.
 ///
 /// General usage is:
 /// - Initialise the query object setting the map and the GPU flag if required.
 /// - Call @c setRays() to define the ray start/end point pairs.
-/// - Call @c execute() or @c executeAsync() followed by @c wait() (GPU only).
+/// - Call @c execute() or @c executeAsync() followed by @c wait().
 /// - Process results (see below).
 ///
 /// The @c numberOfResults() will match the number of rays (@c pointCount given to @c setRays()) and for
@@ -97,7 +97,6 @@ public:
 
 protected:
   bool onExecute() override;
-  bool onExecuteAsync() override;
   void onReset(bool hard_reset) override;
 
   /// Access internal details.
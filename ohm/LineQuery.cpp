@@ -6,8 +6,12 @@
 #include "LineQuery.h"
 
 #include "Key.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
 #include "OccupancyMap.h"
 #include "QueryFlag.h"
+#include "VoxelBuffer.h"
+#include "private/ClearanceInfo.h"
 #include "private/LineQueryDetail.h"
 #include "private/OccupancyMapDetail.h"
 #include "private/OccupancyQueryAlg.h"
@@ -24,31 +28,84 @@
 #endif  // OHM_THREADS
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <mutex>
+#include <vector>
 
 namespace ohm
 {
 namespace
 {
+/// Read the ranges for the @c LineQueryDetail::segment_keys from the clearance layer where it is up to date. Ranges
+/// for keys in absent or stale regions are left as NaN.
+void resolveCachedClearance(const OccupancyMap &map, LineQueryDetail &query,
+                            const glm::ivec3 &voxel_search_half_extents, std::vector<CachedClearanceRegion> &regions)
+{
+  const OccupancyMapDetail &map_data = *map.detail();
+  const glm::ivec3 region_dim(map_data.region_voxel_dimensions);
+  const glm::ivec3 region_padding = (voxel_search_half_extents + region_dim - glm::ivec3(1)) / region_dim;
+  // Allow for floating point error in clearance values calculated with the same search radius.
+  const float range_limit = query.search_radius + 1e-3f * float(map_data.resolution);
+
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  // Segment keys are ordered along the line, so consecutive keys generally share a region.
+  const CachedClearanceRegion *region = nullptr;
+  for (size_t i = 0; i < query.segment_keys.size(); ++i)
+  {
+    const Key &key = query.segment_keys[i];
+    if (!region || region->region_key != key.regionKey())
+    {
+      region = nullptr;
+      for (const CachedClearanceRegion &cached : regions)
+      {
+        if (cached.region_key == key.regionKey())
+        {
+          region = &cached;
+          break;
+        }
+      }
+
+      if (!region)
+      {
+        regions.emplace_back(cachedClearanceRegion(map_data, key.regionKey(), region_padding));
+        region = &regions.back();
+      }
+    }
+
+    if (region->clearance)
+    {
+      const glm::ivec3 local(key.localKey());
+      const float clearance = region->clearance[voxelIndex(unsigned(local.x), unsigned(local.y), unsigned(local.z),
+                                                           unsigned(region_dim.x), unsigned(region_dim.y),
+                                                           unsigned(region_dim.z))];
+      query.ranges[i] = (clearance >= 0 && clearance <= range_limit) ? clearance : -1.0f;
+    }
+  }
+}
+
+
 void calculateNearestNeighboursRange(LineQueryDetail &query, size_t start_index, size_t end_index,
                                      const OccupancyMap &map, const glm::ivec3 &voxel_search_half_extents)
 {
-  float range;
-
   for (size_t i = start_index; i < end_index; ++i)
   {
+    // Skip ranges resolved from the clearance layer.
+    if (!std::isnan(query.ranges[i]))
+    {
+      continue;
+    }
+
     const Key &key = query.segment_keys[i];
-    range =
+    query.ranges[i] =
       calculateNearestNeighbour(key, map, voxel_search_half_extents, (query.query_flags & kQfUnknownAsOccupied) != 0,
                                 false, query.search_radius, query.axis_scaling);
     // if (range < 0)
     // {
     //   range = query.default_range;
     // }
-    query.intersected_voxels[i] = key;
-    query.ranges[i] = range;
   }
 }
 
@@ -57,9 +114,27 @@ unsigned occupancyLineQueryCpu(const OccupancyMap &map, LineQueryDetail &query,
   glm::ivec3 voxel_search_half_extents = calculateVoxelSearchHalfExtents(map, query.search_radius);
   map.calculateSegmentKeys(query.segment_keys, query.start_point, query.end_point);
 
-  // Allocate results.
+  // Allocate results. NaN ranges are yet to be calculated.
   query.intersected_voxels.resize(query.segment_keys.size());
-  query.ranges.resize(query.segment_keys.size());
+  for (size_t i = 0; i < query.segment_keys.size(); ++i)
+  {
+    query.intersected_voxels[i] = query.segment_keys[i];
+  }
+  query.ranges.assign(query.segment_keys.size(), std::numeric_limits<float>::quiet_NaN());
+
+  // Use the clearance layer where it is up to date, unless caching is disabled or the clearance layer has been
+  // calculated with incompatible parameters.
+  std::vector<CachedClearanceRegion> clearance_regions;
+  if (!(query.query_flags & kQfNoCache) && map.layout().clearanceLayer() >= 0)
+  {
+    ClearanceInfo clearance_info;
+    clearance_info.fromMapInfo(map.mapInfo());
+    if (clearance_info.supports(query.search_radius, (query.query_flags & kQfUnknownAsOccupied) != 0,
+                                glm::vec3(query.axis_scaling)))
+    {
+      resolveCachedClearance(map, query, voxel_search_half_extents, clearance_regions);
+    }
+  }
 
   // Perform query.
 #ifdef OHM_THREADS
@@ -112,6 +187,7 @@ LineQuery::LineQuery(OccupancyMap &map, const glm::dvec3 &start_point, const glm
 
 LineQuery::~LineQuery()
 {
+  wait();
   LineQueryDetail *d = imp();
   delete d;
   // Clear pointer for base class.
@@ -218,12 +294,6 @@ bool LineQuery::onExecute()
 }
 
 
-bool LineQuery::onExecuteAsync()
-{
-  return false;
-}
-
-
 void LineQuery::onReset(bool /*hard_reset*/)
 {
   // LineQueryDetail *d = imp();
@@ -36,6 +36,15 @@ struct LineQueryDetail;
 /// implementation is closer to worst case O(m) although it incurs additional, initial overhead. The GPU
 /// implementation supports caching to offset this overhead.
 ///
+/// The CPU implementation also reads cached ranges from the map's clearance layer unless @c kQfNoCache is set. The
+/// clearance layer is only used when the parameters recorded with it by @c ClearanceProcessCpu match the query: the
+/// same @c kQfUnknownAsOccupied and axis scaling and a search radius at least as large as the query's. This then
+/// applies per region: a region's clearance is used when its clearance layer @c MapChunk::touched_stamps value is at
+/// least the occupancy stamp of all regions within the search radius. Voxels in stale or absent regions fall back to
+/// the brute force search, as do all voxels when the parameters do not match. Cached ranges beyond the query
+/// @c searchRadius() are reported as unobstructed. Calculating the clearance with a slightly larger radius - e.g., by
+/// half a voxel - avoids losing obstructions at exactly the search radius to floating point error.
+///
 /// Using the GPU implementation, the @c LineQuery invokes the @c VoxelRanges query in order to cache the obstacle
 /// ranges. On a soft @c reset(), the obstacle ranges are only recalculated for regions which have not yet
 /// been calculated. A hard @c reset() should be invoked whenever the map changes to recalculate these ranges.
@@ -54,7 +63,7 @@ class ohm_API LineQuery : public Query
 {
 public:
   /// Default flags to execute this query with.
-  static const unsigned kDefaultFlags = kQfNoCache;
+  static const unsigned kDefaultFlags = 0;
 
 protected:
   /// Constructor used for inherited objects. This supports deriving @p LineQueryDetail into
@@ -149,7 +158,6 @@ public:
 
 protected:
   bool onExecute() override;
-  bool onExecuteAsync() override;
   void onReset(bool hard_reset) override;
 
   /// Access internal details.
@@ -17,8 +17,67 @@
 #include <cassert>
 #include <cstdio>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif  // _MSC_VER
+
 namespace ohm
 {
+namespace
+{
+constexpr unsigned kMaskBits = 64u;
+
+/// Find the index of the lowest set bit in @p bits , which must be non zero.
+inline unsigned lowestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+  unsigned long index;  // NOLINT(google-runtime-int)
+  _BitScanForward64(&index, bits);
+  return unsigned(index);
+#else   // _MSC_VER
+  return unsigned(__builtin_ctzll(bits));
+#endif  // _MSC_VER
+}
+
+/// Find the first set bit in @p mask in the range [@p from_index, @p end_index) or @c ~0u when there is none.
+unsigned nextMaskIndex(const std::vector<uint64_t> &mask, unsigned from_index, unsigned end_index)
+{
+  unsigned word_index = from_index / kMaskBits;
+  const unsigned end_word = std::min<unsigned>(unsigned(mask.size()), (end_index - 1) / kMaskBits + 1);
+  if (from_index >= end_index || word_index >= end_word)
+  {
+    return ~0u;
+  }
+
+  // Mask out bits before from_index in the first word.
+  uint64_t bits = mask[word_index] & (~uint64_t(0u) << (from_index % kMaskBits));
+  while (!bits)
+  {
+    if (++word_index >= end_word)
+    {
+      return ~0u;
+    }
+    bits = mask[word_index];
+  }
+
+  const unsigned index = word_index * kMaskBits + lowestBit(bits);
+  return (index < end_index) ? index : ~0u;
+}
+
+/// Resize @p mask to hold @p voxel_count bits, clearing all bits and accounting for any change in capacity.
+void resetMask(std::vector<uint64_t> &mask, unsigned voxel_count, const OccupancyMapDetail &map)
+{
+  const size_t mask_capacity = mask.capacity();
+  mask.clear();
+  mask.resize((voxel_count + kMaskBits - 1) / kMaskBits, 0u);
+  if (mask.capacity() != mask_capacity)
+  {
+    map.voxel_mask_bytes.fetch_add((mask.capacity() - mask_capacity) * sizeof(*mask.data()),
+                                   std::memory_order_relaxed);
+  }
+}
+}  // namespace
+
 MapChunk::MapChunk(const MapRegion &region, const OccupancyMapDetail &map)
 {
   this->region = region;
@@ -33,6 +92,7 @@ MapChunk::MapChunk(const MapRegion &region, const OccupancyMapDetail &map)
     voxel_blocks[i].reset(new VoxelBlock(&map, layer));
     touched_stamps[i] = 0u;
   }
+  map.chunk_count.fetch_add(1u, std::memory_order_relaxed);
 }
 
 
@@ -50,10 +110,26 @@ MapChunk::MapChunk(MapChunk &&other) noexcept
   , touched_stamps(std::move(other.touched_stamps))
   , voxel_blocks(std::move(other.voxel_blocks))
   , flags(std::exchange(other.flags, 0))
+  , observed_mask(std::move(other.observed_mask))
+  , observed_mask_stamp(std::exchange(other.observed_mask_stamp, ~uint64_t(0u)))
+  , observed_count(std::exchange(other.observed_count, 0))
+  , occupied_mask(std::move(other.occupied_mask))
+  , occupied_mask_stamp(std::exchange(other.occupied_mask_stamp, ~uint64_t(0u)))
+  , occupied_mask_threshold(std::exchange(other.occupied_mask_threshold, 0.0f))
+  , occupied_count(std::exchange(other.occupied_count, 0))
 {}
 
 
-MapChunk::~MapChunk() = default;
+MapChunk::~MapChunk()
+{
+  if (map)
+  {
+    map->chunk_count.fetch_sub(1u, std::memory_order_relaxed);
+    map->voxel_mask_bytes.fetch_sub(
+      (observed_mask.capacity() + occupied_mask.capacity()) * sizeof(*observed_mask.data()),
+      std::memory_order_relaxed);
+  }
+}
 
 
 const MapLayout &MapChunk::layout() const
@@ -62,8 +138,42 @@ const MapLayout &MapChunk::layout() const
 }
 
 
+void MapChunk::recycle(const MapRegion &region)
+{
+  this->region = region;
+  first_valid_index = ~0u;
+  touched_time = 0;
+  dirty_stamp = 0;
+  flags = 0;
+  observed_mask.clear();
+  observed_mask_stamp = ~uint64_t(0u);
+  observed_count = 0;
+  occupied_mask.clear();
+  occupied_mask_stamp = ~uint64_t(0u);
+  occupied_count = 0;
+
+  const MapLayout &layout = this->layout();
+  for (size_t i = 0; i < voxel_blocks.size(); ++i)
+  {
+    touched_stamps[i] = 0u;
+    if (!voxel_blocks[i]->reset())
+    {
+      // Block still in use. Replace it.
+      voxel_blocks[i].reset(new VoxelBlock(map, layout.layer(i)));
+    }
+  }
+}
+
+
+bool MapChunk::isLayerAllocated(int layer_index) const
+{
+  return layer_index >= 0 && size_t(layer_index) < voxel_blocks.size() && voxel_blocks[layer_index] &&
+         !voxel_blocks[layer_index]->isUninitialised();
+}
+
+
 Key MapChunk::keyForIndex(size_t voxel_index, const glm::ivec3 &region_voxel_dimensions,
-                          const glm::i16vec3 &region_coord)
+                          const RegionKey &region_coord)
 {
   Key key;
 
@@ -145,8 +255,15 @@ void MapChunk::updateLayout(const MapLayout *new_layout,
 void MapChunk::searchAndUpdateFirstValid(const glm::ivec3 &region_voxel_dimensions, const glm::u8vec3 &search_from)
 {
   const MapLayout &layout = this->layout();
+  if (voxel_blocks[layout.occupancyLayer()]->isUninitialised())
+  {
+    // All voxels are unobserved.
+    first_valid_index = ~0u;
+    return;
+  }
+
   VoxelBuffer<const VoxelBlock> voxel_buffer(voxel_blocks[layout.occupancyLayer()]);
-  const size_t voxel_stride = layout.layer(layout.occupancyLayer()).voxelByteSize();
+  const OccupancyEncoding encoding = occupancyEncoding(layout.layer(layout.occupancyLayer()));
   const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
 
   unsigned voxel_index;
@@ -159,7 +276,7 @@ void MapChunk::searchAndUpdateFirstValid(const glm::ivec3 &region_voxel_dimensio
       {
         voxel_index =
           unsigned(x) + y * region_voxel_dimensions.x + z * region_voxel_dimensions.y * region_voxel_dimensions.x;
-        memcpy(&occupancy, voxel_mem + voxel_stride * voxel_index, sizeof(occupancy));
+        occupancy = readOccupancy(voxel_mem, voxel_index, encoding);
         if (occupancy != unobservedOccupancyValue())
         {
           first_valid_index = voxel_index;
@@ -184,7 +301,7 @@ bool MapChunk::validateFirstValid() const
 {
   const MapLayout &layout = this->layout();
   VoxelBuffer<const VoxelBlock> voxel_buffer(voxel_blocks[layout.occupancyLayer()].get());
-  const size_t voxel_stride = layout.layer(layout.occupancyLayer()).voxelByteSize();
+  const OccupancyEncoding encoding = occupancyEncoding(layout.layer(layout.occupancyLayer()));
   const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
 
   unsigned voxel_index = 0;
@@ -195,7 +312,7 @@ bool MapChunk::validateFirstValid() const
     {
       for (int x = 0; x < map->region_voxel_dimensions.x; ++x)
       {
-        memcpy(&occupancy, voxel_mem + voxel_stride * voxel_index, sizeof(occupancy));
+        occupancy = readOccupancy(voxel_mem, voxel_index, encoding);
         if (occupancy != unobservedOccupancyValue())
         {
           if (first_valid_index != voxel_index)
@@ -223,6 +340,118 @@ bool MapChunk::validateFirstValid() const
 }
 
 
+unsigned MapChunk::updateObservedMask() const
+{
+  const MapLayout &layout = this->layout();
+  const int occupancy_layer = layout.occupancyLayer();
+  if (occupancy_layer < 0)
+  {
+    observed_mask.clear();
+    observed_count = 0;
+    return 0;
+  }
+
+  const uint64_t occupancy_stamp = touched_stamps[occupancy_layer];
+  if (observed_mask_stamp == occupancy_stamp && !observed_mask.empty())
+  {
+    return observed_count;
+  }
+
+  const glm::ivec3 &dim = map->region_voxel_dimensions;
+  const unsigned voxel_count = unsigned(dim.x * dim.y * dim.z);
+  resetMask(observed_mask, voxel_count, *map);
+  observed_count = 0;
+
+  if (voxel_blocks[occupancy_layer]->isUninitialised())
+  {
+    // Default valued layer: nothing observed.
+    observed_mask_stamp = occupancy_stamp;
+    return 0;
+  }
+
+  VoxelBuffer<const VoxelBlock> voxel_buffer(voxel_blocks[occupancy_layer]);
+  const OccupancyEncoding encoding = occupancyEncoding(layout.layer(occupancy_layer));
+  const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
+
+  float occupancy;
+  for (unsigned voxel_index = 0; voxel_index < voxel_count; ++voxel_index)
+  {
+    occupancy = readOccupancy(voxel_mem, voxel_index, encoding);
+    if (occupancy != unobservedOccupancyValue())
+    {
+      observed_mask[voxel_index / kMaskBits] |= (uint64_t(1u) << (voxel_index % kMaskBits));
+      ++observed_count;
+    }
+  }
+
+  observed_mask_stamp = occupancy_stamp;
+  return observed_count;
+}
+
+
+unsigned MapChunk::nextObservedIndex(unsigned from_index) const
+{
+  return nextMaskIndex(observed_mask, from_index, ~0u);
+}
+
+
+unsigned MapChunk::updateOccupiedMask() const
+{
+  const MapLayout &layout = this->layout();
+  const int occupancy_layer = layout.occupancyLayer();
+  if (occupancy_layer < 0)
+  {
+    occupied_mask.clear();
+    occupied_count = 0;
+    return 0;
+  }
+
+  const uint64_t occupancy_stamp = touched_stamps[occupancy_layer];
+  if (occupied_mask_stamp == occupancy_stamp && occupied_mask_threshold == map->occupancy_threshold_value &&
+      !occupied_mask.empty())
+  {
+    return occupied_count;
+  }
+
+  const glm::ivec3 &dim = map->region_voxel_dimensions;
+  const unsigned voxel_count = unsigned(dim.x * dim.y * dim.z);
+  resetMask(occupied_mask, voxel_count, *map);
+  occupied_count = 0;
+  occupied_mask_threshold = map->occupancy_threshold_value;
+
+  if (voxel_blocks[occupancy_layer]->isUninitialised())
+  {
+    // Default valued layer: nothing occupied.
+    occupied_mask_stamp = occupancy_stamp;
+    return 0;
+  }
+
+  VoxelBuffer<const VoxelBlock> voxel_buffer(voxel_blocks[occupancy_layer]);
+  const OccupancyEncoding encoding = occupancyEncoding(layout.layer(occupancy_layer));
+  const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
+
+  float occupancy;
+  for (unsigned voxel_index = 0; voxel_index < voxel_count; ++voxel_index)
+  {
+    occupancy = readOccupancy(voxel_mem, voxel_index, encoding);
+    if (occupancy != unobservedOccupancyValue() && occupancy >= occupied_mask_threshold)
+    {
+      occupied_mask[voxel_index / kMaskBits] |= (uint64_t(1u) << (voxel_index % kMaskBits));
+      ++occupied_count;
+    }
+  }
+
+  occupied_mask_stamp = occupancy_stamp;
+  return occupied_count;
+}
+
+
+unsigned MapChunk::nextOccupiedIndex(unsigned from_index, unsigned end_index) const
+{
+  return nextMaskIndex(occupied_mask, from_index, end_index);
+}
+
+
 bool MapChunk::overlapsExtents(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext) const
 {
   glm::dvec3 region_min;
@@ -180,6 +180,26 @@ struct MapChunk
   /// Chunk flags set from @c MapChunkFlag.
   unsigned flags = 0;
 
+  /// Bit set marking the observed voxels of the occupancy layer, one bit per voxel in @c voxelIndex() order. Built on
+  /// demand by @c updateObservedMask() and used to skip unobserved voxels during iteration.
+  mutable std::vector<uint64_t> observed_mask;
+  /// The occupancy layer @c touched_stamps value from which @c observed_mask was built. The mask is stale when this
+  /// differs from the current occupancy layer stamp.
+  mutable uint64_t observed_mask_stamp = ~uint64_t(0u);
+  /// Number of bits set in @c observed_mask - the number of observed voxels as of @c observed_mask_stamp .
+  mutable unsigned observed_count = 0;
+
+  /// Bit set marking the occupied voxels of the occupancy layer, one bit per voxel in @c voxelIndex() order. Built on
+  /// demand by @c updateOccupiedMask() and used by spatial queries to visit only occupied voxels.
+  mutable std::vector<uint64_t> occupied_mask;
+  /// The occupancy layer @c touched_stamps value from which @c occupied_mask was built.
+  mutable uint64_t occupied_mask_stamp = ~uint64_t(0u);
+  /// The map occupancy threshold value used to build @c occupied_mask . The mask is also stale when the threshold
+  /// changes.
+  mutable float occupied_mask_threshold = 0;
+  /// Number of bits set in @c occupied_mask .
+  mutable unsigned occupied_count = 0;
+
   /// Create an empty @c MapChunk object.
   MapChunk() = default;
   /// Create a @c MapChunk for the given @p map .
@@ -209,7 +229,7 @@ struct MapChunk
   /// @param region_coord The coordinate of the containing region.
   /// @return An @c Key to reference the requested voxel.
   static Key keyForIndex(size_t voxel_index, const glm::ivec3 &region_voxel_dimensions,
-                         const glm::i16vec3 &region_coord);
+                         const RegionKey &region_coord);
 
   /// @overload
   inline Key keyForIndex(size_t voxel_index, const glm::ivec3 &region_voxel_dimensions) const
@@ -217,6 +237,21 @@ struct MapChunk
     return keyForIndex(voxel_index, region_voxel_dimensions, region.coord);
   }
 
+  /// Prepare a recycled chunk for reuse as @p region . All voxel layers are reset to the uninitialised, default
+  /// valued state and all stamps, flags and @c first_valid_index are cleared. Voxel blocks which are still in use -
+  /// retained or queued for compression - are replaced with new blocks.
+  ///
+  /// For use by the owning map in pooling @c MapChunk objects.
+  ///
+  /// @param region The new region for the chunk.
+  void recycle(const MapRegion &region);
+
+  /// Query if the voxel memory for @p layer_index has been allocated. Layer memory is allocated on first access and
+  /// layers which have not been allocated hold default values - see @c VoxelBlock::isUninitialised() .
+  /// @param layer_index The index of the layer to query.
+  /// @return True if the layer memory has been allocated.
+  bool isLayerAllocated(int layer_index) const;
+
   /// Update the @p layout for the chunk, preserving current layers which have an equivalent in @p new_layout.
   ///
   /// Note: this does not change the @p layout pointer as it is assumed the object at that location is about to be
@@ -272,6 +307,41 @@ struct MapChunk
   /// @return True when the @c first_valid_index value matches what it should be.
   bool validateFirstValid() const;
 
+  /// Ensure the @c observed_mask is up to date with the occupancy layer, rebuilding it when the occupancy layer
+  /// @c touched_stamps value differs from @c observed_mask_stamp .
+  ///
+  /// The mask is only as accurate as the occupancy layer stamp, so direct voxel memory modification must update the
+  /// @c touched_stamps as described above. Not thread safe for concurrent calls on the same chunk.
+  ///
+  /// @return The number of observed voxels in the chunk. Zero when the layout has no occupancy layer.
+  unsigned updateObservedMask() const;
+
+  /// Find the first observed voxel index at or after @p from_index using the @c observed_mask .
+  ///
+  /// @c updateObservedMask() must be called first.
+  ///
+  /// @param from_index The linear voxel index to start searching from.
+  /// @return The next observed voxel index or @c ~0u when there are no more observed voxels.
+  unsigned nextObservedIndex(unsigned from_index) const;
+
+  /// Ensure the @c occupied_mask is up to date with the occupancy layer, rebuilding it when the occupancy layer
+  /// @c touched_stamps value differs from @c occupied_mask_stamp or the map occupancy threshold has changed.
+  ///
+  /// As with @c updateObservedMask() , the mask is only as accurate as the occupancy layer stamp. Not thread safe for
+  /// concurrent calls on the same chunk.
+  ///
+  /// @return The number of occupied voxels in the chunk. Zero when the layout has no occupancy layer.
+  unsigned updateOccupiedMask() const;
+
+  /// Find the first occupied voxel index in the range [@p from_index, @p end_index) using the @c occupied_mask .
+  ///
+  /// @c updateOccupiedMask() must be called first.
+  ///
+  /// @param from_index The linear voxel index to start searching from.
+  /// @param end_index The linear voxel index at which to stop searching.
+  /// @return The next occupied voxel index or @c ~0u when there are no more occupied voxels in range.
+  unsigned nextOccupiedIndex(unsigned from_index, unsigned end_index = ~0u) const;
+
   /// Query if this @c MapChunk overlaps the axis aligned bounding box.
   /// @param min_ext The lower extents of the AABB.
   /// @param max_ext The upper extents of the AABB.
@@ -10,9 +10,12 @@
 
 namespace
 {
-const std::array<const char *, 1> kMapFlagNames =  //
+const std::array<const char *, 4> kMapFlagNames =  //
   {
     "VoxelMean",
+    "Compressed",
+    "QuantisedOccupancy16",
+    "QuantisedOccupancy8",
   };
 }  // namespace
 
@@ -21,6 +21,11 @@ enum class MapFlag : unsigned
   kVoxelMean = (1u << 0u),
   /// Maintain compressed voxels in memory. Compression is performed off thread.
   kCompressed = (1u << 1u),
+  /// Store occupancy log-odds values as 16-bit fixed point integers. See @c OccupancyEncoding .
+  kQuantisedOccupancy16 = (1u << 2u),
+  /// Store occupancy log-odds values as 8-bit fixed point integers. See @c OccupancyEncoding . Takes precedence
+  /// over @c kQuantisedOccupancy16 .
+  kQuantisedOccupancy8 = (1u << 3u),
 
   /// Default map creation flags.
   kDefault = kCompressed
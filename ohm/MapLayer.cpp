@@ -108,14 +108,14 @@ MapLayoutMatch MapLayer::checkEquivalent(const MapLayer &other) const
 
 size_t MapLayer::voxelByteSize() const
 {
-  return voxel_layout_->voxel_byte_size;
+  return (flags_ & kPackedVoxels) ? voxel_layout_->next_offset : voxel_layout_->voxel_byte_size;
 }
 
 
 size_t MapLayer::layerByteSize(const glm::u8vec3 &region_dim) const
 {
   // Apply subsampling
-  return volume(region_dim) * voxel_layout_->voxel_byte_size;
+  return volume(region_dim) * voxelByteSize();
 }
 
 
@@ -134,16 +134,17 @@ void MapLayer::release(const uint8_t *voxels)
 void MapLayer::clear(uint8_t *mem, const glm::u8vec3 &region_dim) const
 {
   // Build a clear pattern.
-  auto *pattern = static_cast<uint8_t *>(alloca(voxel_layout_->voxel_byte_size));
+  const size_t voxel_byte_size = voxelByteSize();
+  auto *pattern = static_cast<uint8_t *>(alloca(voxel_byte_size));
   uint8_t *dst = pattern;
   for (size_t i = 0; i < voxel_layout_->members.size(); ++i)
   {
     // Grab the current member.
     VoxelMember &member = voxel_layout_->members[i];
     // Work out the member size by the difference in offets to the next member or the end of the voxel.
-    size_t member_size = ((i + 1 < voxel_layout_->members.size()) ? voxel_layout_->members[i + 1].offset :
-                                                                    voxel_layout_->voxel_byte_size) -
-                         member.offset;
+    size_t member_size =
+      ((i + 1 < voxel_layout_->members.size()) ? voxel_layout_->members[i + 1].offset : voxel_byte_size) -
+      member.offset;
     // Work out how may bytes to clear. Either the member size or the clear value size.
     const size_t clear_size = std::min(member_size, sizeof(member.clear_value));
     // Clear the bytes.
@@ -158,8 +159,8 @@ void MapLayer::clear(uint8_t *mem, const glm::u8vec3 &region_dim) const
   dst = mem;
   for (size_t i = 0; i < voxel_count; ++i)
   {
-    memcpy(dst, pattern, voxel_layout_->voxel_byte_size);
-    dst += voxel_layout_->voxel_byte_size;
+    memcpy(dst, pattern, voxel_byte_size);
+    dst += voxel_byte_size;
   }
 }
 }  // namespace ohm
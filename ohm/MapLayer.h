@@ -32,7 +32,38 @@ public:
   enum Flag
   {
     /// Layer data is not serialised to disk.
-    kSkipSerialise = (1u << 0u)
+    kSkipSerialise = (1u << 0u),
+    /// Voxels are tightly packed at the @c VoxelLayout member size rather than padded to 4 or 8 byte alignment. Voxel
+    /// data must be accessed via @c memcpy() . Used for small, single member layers such as a quantised occupancy
+    /// layer - see @c OccupancyEncoding .
+    kPackedVoxels = (1u << 1u)
+  };
+
+  /// Voxel compression policy for the layer's @c VoxelBlock data. See @c setCompressionPolicy() .
+  struct CompressionPolicy
+  {
+    /// Compression modes.
+    enum Mode : uint8_t
+    {
+      /// Compress when the map has @c MapFlag::kCompressed set (default).
+      kMapDefault,
+      /// Never compress this layer. Suited to layers on the ingestion hot path.
+      kNever,
+      /// Always compress this layer, even when the map does not have @c MapFlag::kCompressed set.
+      kAlways
+    };
+
+    /// The compression mode.
+    Mode mode = kMapDefault;
+    /// Use the @c level and @c type below? When false, the global @c VoxelBlock::CompressionControls apply.
+    bool override_codec = false;
+    /// Compression level used when @c override_codec is set.
+    VoxelBlock::CompressionLevel level = VoxelBlock::kCompressFast;
+    /// Compression type used when @c override_codec is set.
+    VoxelBlock::CompressionType type = VoxelBlock::kCompressDeflate;
+    /// Minimum delay after the last release before a block may be compressed (milliseconds). Negative to use the
+    /// default delay.
+    int release_delay_ms = -1;
   };
 
   /// Construct a new layer.
@@ -67,6 +98,16 @@ public:
   /// @param flags New flags to set.
   inline void setFlags(unsigned flags) { flags_ = flags; }
 
+  /// Access the layer compression policy.
+  /// @return The compression policy.
+  inline const CompressionPolicy &compressionPolicy() const { return compression_policy_; }
+
+  /// Set the layer compression policy. This overrides the map wide @c MapFlag::kCompressed and the global
+  /// @c VoxelBlock::CompressionControls for this layer. The policy takes effect the next time each block is released,
+  /// so blocks already compressed remain so until next accessed. The policy is not serialised.
+  /// @param policy The new policy.
+  inline void setCompressionPolicy(const CompressionPolicy &policy) { compression_policy_ = policy; }
+
   /// Copy the @c VoxelLayout from @p other.
   /// @param other Layer to copy the voxel structure of.
   void copyVoxelLayout(const MapLayer &other);
@@ -150,6 +191,7 @@ private:
   uint16_t layer_index_ = 0;
   uint16_t subsampling_ = 0;
   unsigned flags_ = 0;
+  CompressionPolicy compression_policy_;
 };
 }  // namespace ohm
 
@@ -297,6 +297,8 @@ MapLayout &MapLayout::operator=(const MapLayout &other)
       for (auto &&layer : other.imp_->layers)
       {
         MapLayer *new_layer = addLayer(layer->name(), layer->subsampling());
+        new_layer->setFlags(layer->flags());
+        new_layer->setCompressionPolicy(layer->compressionPolicy());
         new_layer->copyVoxelLayout(*layer);
       }
     }
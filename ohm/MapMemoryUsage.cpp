@@ -0,0 +1,47 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "MapMemoryUsage.h"
+
+#include <numeric>
+
+namespace ohm
+{
+const char *voxelBlockStateName(VoxelBlockState state)
+{
+  static const std::array<const char *, unsigned(VoxelBlockState::kCount)> names = { "uniform", "uncompressed",
+                                                                                      "queued", "compressed" };
+  return (unsigned(state) < names.size()) ? names[unsigned(state)] : "<invalid>";
+}
+
+
+size_t LayerMemoryUsage::totalBlocks() const
+{
+  return std::accumulate(block_count.begin(), block_count.end(), size_t(0u));
+}
+
+
+size_t LayerMemoryUsage::totalBytes() const
+{
+  return std::accumulate(byte_count.begin(), byte_count.end(), size_t(0u));
+}
+
+
+size_t MapMemoryUsage::voxelBytes() const
+{
+  size_t byte_count = overflow.totalBytes();
+  for (const LayerMemoryUsage &layer : layers)
+  {
+    byte_count += layer.totalBytes();
+  }
+  return byte_count;
+}
+
+
+size_t MapMemoryUsage::totalBytes() const
+{
+  return voxelBytes() + chunk_bytes + index_bytes;
+}
+}  // namespace ohm
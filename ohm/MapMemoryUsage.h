@@ -0,0 +1,99 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_MAPMEMORYUSAGE_H
+#define OHM_MAPMEMORYUSAGE_H
+
+#include "OhmConfig.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace ohm
+{
+/// Memory state of a @c VoxelBlock used in memory accounting.
+enum class VoxelBlockState : unsigned
+{
+  /// No voxel data: all voxels implicitly hold the layer default value. See @c VoxelBlock::isUninitialised() . Bytes
+  /// in this state are buffer capacity retained for reuse.
+  kUniform,
+  /// Uncompressed voxel data.
+  kUncompressed,
+  /// Uncompressed voxel data queued for compression by the background compression thread.
+  kCompressionQueued,
+  /// Compressed voxel data.
+  kCompressed,
+  /// Number of states.
+  kCount
+};
+
+/// Get a display name for @p state .
+/// @param state The block state.
+/// @return The state name.
+const char *ohm_API voxelBlockStateName(VoxelBlockState state);
+
+/// Exact memory usage for the voxel blocks of a single map layer. Byte counts are the allocated voxel buffer sizes.
+struct ohm_API LayerMemoryUsage
+{
+  /// Number of blocks in each @c VoxelBlockState .
+  using StateCounts = std::array<size_t, unsigned(VoxelBlockState::kCount)>;
+
+  /// The layer name.
+  std::string name;
+  /// Number of blocks in each state.
+  StateCounts block_count{};
+  /// Voxel buffer bytes allocated in each state.
+  StateCounts byte_count{};
+
+  /// Query the number of blocks in @p state .
+  /// @param state The state of interest.
+  /// @return The block count.
+  inline size_t blocks(VoxelBlockState state) const { return block_count[unsigned(state)]; }
+  /// Query the allocated bytes for blocks in @p state .
+  /// @param state The state of interest.
+  /// @return The byte count.
+  inline size_t bytes(VoxelBlockState state) const { return byte_count[unsigned(state)]; }
+
+  /// Query the total number of blocks for the layer.
+  /// @return The block count.
+  size_t totalBlocks() const;
+  /// Query the total allocated voxel bytes for the layer.
+  /// @return The byte count.
+  size_t totalBytes() const;
+};
+
+/// Memory usage of an @c OccupancyMap as reported by @c OccupancyMap::memoryUsage() .
+///
+/// The voxel layer figures are maintained incrementally by each @c VoxelBlock as its state changes and are exact for
+/// the voxel buffers. Regions held in the map's recycling pool are included.
+struct ohm_API MapMemoryUsage
+{
+  /// Maximum number of layers reported individually in @c layers .
+  static constexpr unsigned kMaxLayers = 32u;
+
+  /// Per layer voxel memory, indexed by layer index, for up to the first @c kMaxLayers layers.
+  std::vector<LayerMemoryUsage> layers;
+  /// Combined voxel memory for any layers beyond the first @c kMaxLayers . Empty, with no name, unless the layout has
+  /// more than @c kMaxLayers layers.
+  LayerMemoryUsage overflow;
+  /// Number of @c MapChunk objects allocated, including pooled chunks.
+  size_t chunk_count = 0;
+  /// Bytes used by @c MapChunk structures excluding voxel buffers: the chunk, its @c VoxelBlock objects, per layer
+  /// arrays and observed and occupied voxel masks.
+  size_t chunk_bytes = 0;
+  /// Bytes used by the region hash table.
+  size_t index_bytes = 0;
+
+  /// Query the total voxel bytes across all layers, including the @c overflow .
+  /// @return The voxel byte count.
+  size_t voxelBytes() const;
+  /// Query the total bytes accounted for.
+  /// @return The total byte count.
+  size_t totalBytes() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_MAPMEMORYUSAGE_H
@@ -22,7 +22,7 @@ unsigned MapRegion::Hash::calculate(const MapRegion &key)
 }
 
 
-unsigned MapRegion::Hash::calculate(const glm::i16vec3 &region_coord)
+unsigned MapRegion::Hash::calculate(const RegionKey &region_coord)
 {
   const glm::i32vec3 hash_coord(region_coord);
   return vhash::hashBits(hash_coord.x, hash_coord.y, hash_coord.z);
@@ -7,6 +7,8 @@
 
 #include "OhmConfig.h"
 
+#include "RegionKey.h"
+
 #include <glm/glm.hpp>
 
 namespace ohm
@@ -21,7 +23,7 @@ struct ohm_API MapRegion
   /// Centre of the map region local to the map origin.
   glm::dvec3 centre = glm::dvec3(0);
   /// Quantised integer indexing of the region within the map.
-  glm::i16vec3 coord = glm::dvec3(0);
+  RegionKey coord = glm::dvec3(0);
 
   /// Hashing function converting a region key or region coordinates into a 32-bit hash value.
   ///
@@ -39,11 +41,11 @@ struct ohm_API MapRegion
     /// Hash quantised integer indexing coordinates for a region.
     /// @param region_coord The region coordinates to hash.
     /// @return The 32-bit hash for @p key.
-    inline unsigned operator()(const glm::i16vec3 &region_coord) const { return calculate(region_coord); }
+    inline unsigned operator()(const RegionKey &region_coord) const { return calculate(region_coord); }
     /// Hash quantised integer indexing coordinates for a region.
     /// @param region_coord The region coordinates to hash.
     /// @return The 32-bit hash for @p key.
-    static unsigned calculate(const glm::i16vec3 &region_coord);
+    static unsigned calculate(const RegionKey &region_coord);
   };
   friend struct Hash;
 
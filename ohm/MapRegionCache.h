@@ -8,7 +8,7 @@
 
 #include "OhmConfig.h"
 
-#include <glm/fwd.hpp>
+#include "RegionKey.h"
 
 namespace ohm
 {
@@ -35,7 +35,7 @@ public:
 
   /// Remove/flush the region matching @p region_coord from the cache.
   /// @param region_coord The region to flush from the cache.
-  virtual void remove(const glm::i16vec3 &region_coord) = 0;
+  virtual void remove(const RegionKey &region_coord) = 0;
 
 private:
   std::unique_ptr<MapRegionCacheDetail> imp_;
@@ -6,6 +6,7 @@
 
 #include "DefaultLayer.h"
 #include "Heightmap.h"
+#include "HeightmapVoxel.h"
 #include "MapChunk.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
@@ -360,6 +361,7 @@ int saveChunk(OutputStream &stream, const MapChunk &chunk, const OccupancyMapDet
 
   // Save each map layer.
   const MapLayout &layout = chunk.layout();
+  std::vector<uint8_t> default_layer_mem;
   for (size_t i = 0; i < layout.layerCount(); ++i)
   {
     const MapLayer &layer = layout.layer(i);
@@ -374,8 +376,6 @@ int saveChunk(OutputStream &stream, const MapChunk &chunk, const OccupancyMapDet
     ok = write<uint64_t>(stream, layer_touched_stamp) && ok;
 
     // Get the layer memory.
-    VoxelBuffer<const VoxelBlock> voxel_buffer(chunk.voxel_blocks[layer.layerIndex()]);
-    const uint8_t *layer_mem = voxel_buffer.voxelMemory();
     const size_t node_count = layer.volume(detail.region_voxel_dimensions);
     const size_t node_byte_count = layer.voxelByteSize() * node_count;
     if (node_byte_count != unsigned(node_byte_count))
@@ -383,6 +383,21 @@ int saveChunk(OutputStream &stream, const MapChunk &chunk, const OccupancyMapDet
       return kSeValueOverflow;
     }
 
+    VoxelBuffer<const VoxelBlock> voxel_buffer;
+    const uint8_t *layer_mem = nullptr;
+    if (chunk.voxel_blocks[layer.layerIndex()]->isUninitialised())
+    {
+      // Write the default layer content without allocating the block memory.
+      default_layer_mem.resize(node_byte_count);
+      layer.clear(default_layer_mem.data(), detail.region_voxel_dimensions);
+      layer_mem = default_layer_mem.data();
+    }
+    else
+    {
+      voxel_buffer = VoxelBuffer<const VoxelBlock>(chunk.voxel_blocks[layer.layerIndex()]);
+      layer_mem = voxel_buffer.voxelMemory();
+    }
+
     ok = stream.write(layer_mem, unsigned(node_byte_count)) == node_byte_count && ok;
   }
 
@@ -483,6 +498,29 @@ int loadHeader(InputStream &stream, HeaderVersion &version, OccupancyMapDetail &
 }
 
 
+/// Update the @c OccupancyMapDetail::flags which are implied by the map layout: @c MapFlag::kVoxelMean and the
+/// occupancy quantisation flags.
+/// @param detail The map to update.
+void updateLayoutFlags(OccupancyMapDetail &detail)
+{
+  if (detail.layout.meanLayer() >= 0)
+  {
+    detail.flags |= MapFlag::kVoxelMean;
+  }
+  else
+  {
+    detail.flags &= ~MapFlag::kVoxelMean;
+  }
+
+  const MapLayer *occupancy_layer = detail.layout.layerPtr(detail.layout.occupancyLayer());
+  const OccupancyEncoding encoding =
+    (occupancy_layer) ? occupancyEncoding(*occupancy_layer) : OccupancyEncoding::kFloat;
+  detail.flags &= ~(MapFlag::kQuantisedOccupancy16 | MapFlag::kQuantisedOccupancy8);
+  detail.flags |= (encoding == OccupancyEncoding::kInt16) ? MapFlag::kQuantisedOccupancy16 : MapFlag::kNone;
+  detail.flags |= (encoding == OccupancyEncoding::kInt8) ? MapFlag::kQuantisedOccupancy8 : MapFlag::kNone;
+}
+
+
 // Current version of chunk loading.
 int loadChunk(InputStream &stream, MapChunk &chunk, const OccupancyMapDetail &detail)
 {
@@ -661,6 +699,11 @@ int ohm::load(const char *filename, OccupancyMap &map, SerialiseProgress *progre
     }
   }
 
+  if (!err)
+  {
+    updateLayoutFlags(detail);
+  }
+
   return err;
 }
 
@@ -684,6 +727,11 @@ int ohm::load(const char *filename, Heightmap &heightmap, SerialiseProgress *pro
 
   detail.fromMapInfo(info);
 
+  // Resolve the heightmap layer and whether it uses the compact layout from the loaded layout.
+  const MapLayer *heightmap_layer = detail.heightmap->layout().layer(HeightmapVoxel::kHeightmapLayer);
+  detail.heightmap_layer = (heightmap_layer) ? int(heightmap_layer->layerIndex()) : -1;
+  detail.compact_layout = heightmap_layer && heightmap_layer->voxelByteSize() == sizeof(HeightmapVoxelCompact);
+
   return err;
 }
 
@@ -737,18 +785,11 @@ int ohm::loadHeader(const char *filename, OccupancyMap &map, MapVersion *version
     }
   }
 
-  // Correct the voxel mean flags. The flags may not match the reality of the map layout, such as when we load an older
-  // version.
+  // Correct the layout derived flags. The flags may not match the reality of the map layout, such as when we load an
+  // older version.
   if (!err)
   {
-    if (detail.layout.meanLayer() >= 0)
-    {
-      detail.flags |= MapFlag::kVoxelMean;
-    }
-    else
-    {
-      detail.flags &= ~MapFlag::kVoxelMean;
-    }
+    updateLayoutFlags(detail);
   }
 
   return err;
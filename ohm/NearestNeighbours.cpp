@@ -27,63 +27,77 @@
 #include <algorithm>
 #include <functional>
 #include <iostream>
+#include <mutex>
 
 namespace ohm
 {
 namespace
 {
-unsigned regionNearestNeighboursCpu(OccupancyMap &map, NearestNeighboursDetail &query, const glm::i16vec3 &region_key,
+unsigned regionNearestNeighboursCpu(OccupancyMap &map, NearestNeighboursDetail &query, const RegionKey &region_key,
                                     ClosestResult &closest)
 {
-  const float invalid_occupancy_value = unobservedOccupancyValue();
   const OccupancyMapDetail &map_data = *map.detail();
+  const bool unknown_as_occupied = (query.query_flags & ohm::kQfUnknownAsOccupied) != 0;
+  const float search_radius_sqr = query.search_radius * query.search_radius;
+
+  // Reject the region when its closest point lies outside the search sphere.
+  const glm::dvec3 region_min = map.regionCentreGlobal(region_key) - 0.5 * map_data.region_spatial_dimensions;
+  const glm::dvec3 region_max = region_min + map_data.region_spatial_dimensions;
+  const glm::dvec3 region_separation = glm::clamp(query.near_point, region_min, region_max) - query.near_point;
+  if (glm::dot(region_separation, region_separation) > double(search_radius_sqr))
+  {
+    return 0;
+  }
+
+  // Hold the map lock to resolve the chunk and its masks. This serialises mask updates between concurrent queries.
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
   const auto chunk_search = map_data.chunks.find(region_key);
-  glm::vec3 query_origin;
-  glm::vec3 voxel_vector;
-  Key voxel_key(nullptr);
   const MapChunk *chunk = nullptr;
-  const uint8_t *occupancy_mem = nullptr;
-  float range_squared = 0;
-  unsigned added = 0;
-  VoxelBuffer<VoxelBlock> voxel_buffer;
-
-  std::function<bool(float, const OccupancyMapDetail &)> voxel_occupied_func;
-
-  query_origin = glm::vec3(query.near_point - map.origin());
-
   if (chunk_search == map_data.chunks.end())
   {
     // The entire region is unknown space...
-    if ((query.query_flags & ohm::kQfUnknownAsOccupied) == 0)
+    if (!unknown_as_occupied)
     {
       // ... and unknown space is considered free. No results to add.
       return 0;
     }
-
-    // ... and we have to treat unknown space as occupied.
-    chunk = nullptr;
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    occupancy_mem = reinterpret_cast<const uint8_t *>(&invalid_occupancy_value);
-    // Setup voxel occupancy test function to pass all voxels in this region.
-    voxel_occupied_func = [](const float /*voxel*/, const OccupancyMapDetail & /*map_data*/) -> bool { return true; };
+    // ... and we have to treat unknown space as occupied. Leave chunk null to accept all voxels.
   }
   else
   {
     chunk = chunk_search->second;
-    // FIXME: (KS) This is a bit of a mix of legacy direct voxel access and newer VoxelBlock access. Makes things a
-    // bit unclear.
-    voxel_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[chunk->layout().occupancyLayer()]);
-    occupancy_mem = voxel_buffer.voxelMemory();
-    // Setup the voxel test function to check the occupancy threshold and behaviour flags.
-    voxel_occupied_func = [&query](const float voxel, const OccupancyMapDetail &map_data) -> bool {
-      if (voxel == unobservedOccupancyValue())
-      {
-        return query.query_flags & ohm::kQfUnknownAsOccupied;
-      }
-      return (voxel >= map_data.occupancy_threshold_value ||
-              (query.query_flags & ohm::kQfUnknownAsOccupied) && voxel == unobservedOccupancyValue());
-    };
+    if (chunk->layout().occupancyLayer() < 0)
+    {
+      return 0;
+    }
+    // Resolve the occupied (and observed) voxel masks. These are only rebuilt when the region changes.
+    if (chunk->updateOccupiedMask() == 0 && !unknown_as_occupied)
+    {
+      return 0;
+    }
+    if (unknown_as_occupied)
+    {
+      chunk->updateObservedMask();
+    }
   }
+  guard.unlock();
+
+  // Limit the voxel search to the local voxel range overlapping the search bounds, padded by a voxel to allow for
+  // floating point error.
+  const glm::ivec3 dim(map_data.region_voxel_dimensions);
+  const glm::dvec3 search_extents(query.search_radius);
+  const glm::ivec3 voxel_min =
+    glm::max(glm::ivec3(glm::floor((query.near_point - search_extents - region_min) / map_data.resolution)) - 1,
+             glm::ivec3(0));
+  const glm::ivec3 voxel_max =
+    glm::min(glm::ivec3(glm::floor((query.near_point + search_extents - region_min) / map_data.resolution)) + 1,
+             dim - 1);
+
+  const glm::vec3 query_origin = glm::vec3(query.near_point - map.origin());
+  glm::vec3 voxel_vector;
+  Key voxel_key(nullptr);
+  float range_squared = 0;
+  unsigned added = 0;
 
   TES_STMT(std::vector<tes::Vector3d> includedOccupied);
   TES_STMT(std::vector<tes::Vector3d> excludedOccupied);
@@ -92,65 +106,54 @@ unsigned regionNearestNeighboursCpu(OccupancyMap &map, NearestNeighboursDetail &
   // TES_BOX_W(g_tes, TES_COLOUR(LightSeaGreen), 0u,
   //           glm::value_ptr(region_centre), glm::value_ptr(map.regionSpatialResolution()));
 
-  float occupancy;
-  for (int z = 0; z < map_data.region_voxel_dimensions.z; ++z)
-  {
-    for (int y = 0; y < map_data.region_voxel_dimensions.y; ++y)
+  // Visit the candidate voxels.
+  const auto visit_voxel = [&](unsigned voxel_index, bool uncertain) {
+    // Occupied voxel, or invalid voxel to be treated as occupied.
+    // Calculate range to centre.
+    voxel_key = Key(region_key, voxelLocalKey(voxel_index, dim));
+    voxel_vector = map.voxelCentreLocal(voxel_key);
+    voxel_vector -= query_origin;
+    range_squared = glm::dot(voxel_vector, voxel_vector);
+    if (range_squared <= search_radius_sqr)
     {
-      for (int x = 0; x < map_data.region_voxel_dimensions.x; ++x)
+      query.intersected_voxels.push_back(voxel_key);
+      query.ranges.push_back(std::sqrt(range_squared));
+
+      if (range_squared < closest.range)
       {
-        memcpy(&occupancy, occupancy_mem, sizeof(float));
-        if (voxel_occupied_func(occupancy, map_data))
-        {
-          // Occupied voxel, or invalid voxel to be treated as occupied.
-          // Calculate range to centre.
-          voxel_key = Key(region_key, x, y, z);
-          voxel_vector = map.voxelCentreLocal(voxel_key);
-          voxel_vector -= query_origin;
-          range_squared = glm::dot(voxel_vector, voxel_vector);
-          if (range_squared <= query.search_radius * query.search_radius)
-          {
-            query.intersected_voxels.push_back(voxel_key);
-            query.ranges.push_back(std::sqrt(range_squared));
-
-            if (range_squared < closest.range)
-            {
-              closest.index = query.intersected_voxels.size() - 1;
-              closest.range = range_squared;
-            }
-
-            ++added;
+        closest.index = query.intersected_voxels.size() - 1;
+        closest.range = range_squared;
+      }
+
+      ++added;
 #ifdef TES_ENABLE
-            if (occupancy != unobservedOccupancyValue())
-            {
-              includedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-            else
-            {
-              includedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
+      if (!uncertain)
+      {
+        includedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
+      else
+      {
+        includedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
 #endif  // TES_ENABLE
-          }
+    }
 #ifdef TES_ENABLE
-          else
-          {
-            if (occupancy != unobservedOccupancyValue())
-            {
-              excludedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-            else
-            {
-              excludedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-          }
-#endif  // TES_ENABLE
-        }
-
-        // Next voxel. Leave pointer as is (pointing to invalid_occupancy_value) if the chunk is invalid.
-        occupancy_mem += (chunk != nullptr) ? sizeof(occupancy) : 0;
+    else
+    {
+      if (!uncertain)
+      {
+        excludedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
+      else
+      {
+        excludedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
       }
     }
-  }
+#endif  // TES_ENABLE
+    (void)uncertain;  // Only used for debug visualisation.
+  };
+
+  visitObstructedVoxels(chunk, dim, voxel_min, voxel_max, unknown_as_occupied, visit_voxel);
 
 #ifdef TES_ENABLE
   // Visualise points.
@@ -203,6 +206,7 @@ NearestNeighbours::NearestNeighbours(OccupancyMap &map, const glm::dvec3 &near_p
 
 NearestNeighbours::~NearestNeighbours()
 {
+  wait();
   NearestNeighboursDetail *d = imp();
   delete d;
   imp_ = nullptr;
@@ -284,12 +288,6 @@ bool NearestNeighbours::onExecute()
 }
 
 
-bool NearestNeighbours::onExecuteAsync()
-{
-  return false;
-}
-
-
 void NearestNeighbours::onReset(bool /*hard_reset*/)
 {
   // NearestNeighboursDetail *d = imp();
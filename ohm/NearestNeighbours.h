@@ -30,6 +30,12 @@ struct NearestNeighboursDetail;
 /// The query only tests for intersections between the query sphere and the centre of nearby voxels. This means that
 /// specifying a small search radius (~ the voxel resolution) may consistently yield zero results.
 ///
+/// The CPU implementation skips regions which do not intersect the query sphere and only considers the voxels
+/// overlapping the query bounds within each region. Candidate voxels are resolved from the @c MapChunk::occupied_mask
+/// (and @c MapChunk::observed_mask for @c kQfUnknownAsOccupied ), which are built on first use and rebuilt only when
+/// the region occupancy changes. As such, the first query touching a region carries the cost of building its masks.
+/// Mask updates are made under the map lock, so concurrent queries may share a map which is not being modified.
+///
 /// A GPU implementation is supported for this query, however it is inferior to the CPU implementation in two ways:
 /// - The CPU implementation is usually faster.
 /// - The GPU implementation is too memory intensive and may result in a crash/SEGFAULT.
@@ -68,7 +74,6 @@ public:
 
 protected:
   bool onExecute() override;
-  bool onExecuteAsync() override;
   void onReset(bool hard_reset) override;
 
   /// Access internal details.
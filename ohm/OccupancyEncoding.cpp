@@ -0,0 +1,54 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OccupancyEncoding.h"
+
+#include "MapLayer.h"
+#include "VoxelLayout.h"
+
+namespace ohm
+{
+bool occupancyEncoding(const MapLayer &layer, OccupancyEncoding *encoding)
+{
+  const VoxelLayoutConst voxel_layout = layer.voxelLayout();
+  if (voxel_layout.memberCount() != 1)
+  {
+    return false;
+  }
+
+  OccupancyEncoding resolved_encoding;
+  switch (voxel_layout.memberType(0))
+  {
+  case DataType::kFloat:
+    resolved_encoding = OccupancyEncoding::kFloat;
+    break;
+  case DataType::kInt16:
+    resolved_encoding = OccupancyEncoding::kInt16;
+    break;
+  case DataType::kInt8:
+    resolved_encoding = OccupancyEncoding::kInt8;
+    break;
+  default:
+    return false;
+  }
+
+  if (layer.voxelByteSize() != occupancyEncodingSize(resolved_encoding))
+  {
+    // Padded voxels are not supported.
+    return false;
+  }
+
+  *encoding = resolved_encoding;
+  return true;
+}
+
+
+OccupancyEncoding occupancyEncoding(const MapLayer &layer)
+{
+  OccupancyEncoding encoding = OccupancyEncoding::kFloat;
+  occupancyEncoding(layer, &encoding);
+  return encoding;
+}
+}  // namespace ohm
@@ -0,0 +1,199 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_OCCUPANCYENCODING_H
+#define OHM_OCCUPANCYENCODING_H
+
+#include "OhmConfig.h"
+
+#include "DataType.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace ohm
+{
+class MapLayer;
+
+/// Identifies how log-odds occupancy values are stored in the occupancy layer.
+///
+/// The default encoding stores a 32-bit float per voxel. The quantised encodings store the log-odds value as a fixed
+/// point integer, trading precision and range for a 2x or 4x reduction in occupancy layer memory. The lowest integer
+/// value is reserved as the unobserved sentinel, so the quantised range is symmetric about zero.
+///
+/// Encoding | Storage  | Resolution | Range
+/// -------- | -------- | ---------- | ---------------
+/// Float    | float    | n/a        | n/a
+/// Int16    | int16_t  | 1/1024     | +/- ~32
+/// Int8     | int8_t   | 1/16       | +/- ~7.9
+///
+/// The ranges comfortably cover the default @c OccupancyMap::minVoxelValue() and @c OccupancyMap::maxVoxelValue() ,
+/// but voxels will clamp to the encoding range if the map value limits are disabled or set beyond that range.
+///
+/// The encoding is determined by the @c DataType of the occupancy layer member - @c DataType::kFloat ,
+/// @c DataType::kInt16 or @c DataType::kInt8 - so it is carried through serialisation by the @c MapLayout . Use
+/// @c MapFlag::kQuantisedOccupancy16 or @c MapFlag::kQuantisedOccupancy8 to create a map with a quantised
+/// occupancy layer.
+///
+/// Code accessing the occupancy layer via @c Voxel<float> or @c Voxel<const float> handles the encoding
+/// transparently. Code accessing occupancy voxel memory directly should use @c readOccupancy() and
+/// @c writeOccupancy() .
+enum class OccupancyEncoding : uint8_t
+{
+  kFloat = 0,  ///< 32-bit float log-odds values.
+  kInt16,      ///< 16-bit fixed point log-odds values.
+  kInt8        ///< 8-bit fixed point log-odds values.
+};
+
+/// Fixed point scale for @c OccupancyEncoding::kInt16 : the log-odds value of one integer step.
+constexpr float kOccupancyQuantisationScale16 = 1.0f / 1024.0f;
+/// Fixed point scale for @c OccupancyEncoding::kInt8 : the log-odds value of one integer step.
+constexpr float kOccupancyQuantisationScale8 = 1.0f / 16.0f;
+
+/// Query the occupancy voxel byte size for @p encoding .
+/// @param encoding The encoding of interest.
+/// @return The number of bytes stored per voxel.
+inline size_t occupancyEncodingSize(OccupancyEncoding encoding)
+{
+  switch (encoding)
+  {
+  case OccupancyEncoding::kInt16:
+    return sizeof(int16_t);
+  case OccupancyEncoding::kInt8:
+    return sizeof(int8_t);
+  default:
+    break;
+  }
+  return sizeof(float);
+}
+
+/// Query the occupancy layer @c DataType for @p encoding .
+/// @param encoding The encoding of interest.
+/// @return The layer member data type.
+inline DataType::Type occupancyEncodingDataType(OccupancyEncoding encoding)
+{
+  switch (encoding)
+  {
+  case OccupancyEncoding::kInt16:
+    return DataType::kInt16;
+  case OccupancyEncoding::kInt8:
+    return DataType::kInt8;
+  default:
+    break;
+  }
+  return DataType::kFloat;
+}
+
+/// Resolve the @c OccupancyEncoding for an occupancy @p layer .
+/// @param layer The occupancy layer to check.
+/// @param[out] encoding Set to the encoding used by @p layer on success.
+/// @return True if @p layer is a single member layer with a supported occupancy encoding.
+bool ohm_API occupancyEncoding(const MapLayer &layer, OccupancyEncoding *encoding);
+
+/// @overload
+/// @param layer The occupancy layer to check.
+/// @return The encoding used by @p layer , or @c OccupancyEncoding::kFloat if @p layer is not a supported occupancy
+///   layer.
+OccupancyEncoding ohm_API occupancyEncoding(const MapLayer &layer);
+
+/// Quantise a log-odds occupancy @p value to the fixed point integer type @c Q .
+///
+/// Infinite values - @c unobservedOccupancyValue() - map to the sentinel @c std::numeric_limits<Q>::lowest() . Other
+/// values are rounded to the nearest step and clamped to the range `[lowest() + 1, max()]`.
+/// @param value The log-odds value to quantise.
+/// @param scale The log-odds value of one integer step.
+/// @return The quantised value.
+/// @tparam Q The integer storage type; @c int16_t or @c int8_t
+template <typename Q>
+inline Q quantiseOccupancy(float value, float scale)
+{
+  if (value == std::numeric_limits<float>::infinity())
+  {
+    return std::numeric_limits<Q>::lowest();
+  }
+  const float steps = std::round(value / scale);
+  const float min_steps = float(std::numeric_limits<Q>::lowest() + 1);
+  const float max_steps = float(std::numeric_limits<Q>::max());
+  return Q(steps < min_steps ? min_steps : (steps > max_steps ? max_steps : steps));
+}
+
+/// Convert a quantised occupancy @p value back to a log-odds float. The sentinel value converts to
+/// @c unobservedOccupancyValue() .
+/// @param value The quantised value.
+/// @param scale The log-odds value of one integer step.
+/// @return The log-odds value.
+/// @tparam Q The integer storage type; @c int16_t or @c int8_t
+template <typename Q>
+inline float dequantiseOccupancy(Q value, float scale)
+{
+  return (value != std::numeric_limits<Q>::lowest()) ? float(value) * scale : std::numeric_limits<float>::infinity();
+}
+
+/// Read the log-odds occupancy value at @p voxel_index from occupancy layer memory stored with @p encoding .
+/// @param voxel_memory The occupancy layer voxel memory for a region.
+/// @param voxel_index The linear voxel index in the region.
+/// @param encoding The occupancy layer encoding.
+/// @return The log-odds occupancy value. Unobserved voxels yield @c unobservedOccupancyValue() .
+inline float readOccupancy(const uint8_t *voxel_memory, unsigned voxel_index, OccupancyEncoding encoding)
+{
+  switch (encoding)
+  {
+  case OccupancyEncoding::kInt16:
+  {
+    int16_t value;
+    memcpy(&value, voxel_memory + sizeof(value) * voxel_index, sizeof(value));
+    return dequantiseOccupancy(value, kOccupancyQuantisationScale16);
+  }
+  case OccupancyEncoding::kInt8:
+    return dequantiseOccupancy(int8_t(voxel_memory[voxel_index]), kOccupancyQuantisationScale8);
+  default:
+    break;
+  }
+  float value;
+  memcpy(&value, voxel_memory + sizeof(value) * voxel_index, sizeof(value));
+  return value;
+}
+
+/// Write the log-odds occupancy @p value at @p voxel_index to occupancy layer memory stored with @p encoding .
+/// @param voxel_memory The occupancy layer voxel memory for a region.
+/// @param voxel_index The linear voxel index in the region.
+/// @param value The log-odds value to write. May be @c unobservedOccupancyValue() .
+/// @param encoding The occupancy layer encoding.
+inline void writeOccupancy(uint8_t *voxel_memory, unsigned voxel_index, float value, OccupancyEncoding encoding)
+{
+  switch (encoding)
+  {
+  case OccupancyEncoding::kInt16:
+  {
+    const int16_t quantised = quantiseOccupancy<int16_t>(value, kOccupancyQuantisationScale16);
+    memcpy(voxel_memory + sizeof(quantised) * voxel_index, &quantised, sizeof(quantised));
+    return;
+  }
+  case OccupancyEncoding::kInt8:
+    voxel_memory[voxel_index] = uint8_t(quantiseOccupancy<int8_t>(value, kOccupancyQuantisationScale8));
+    return;
+  default:
+    break;
+  }
+  memcpy(voxel_memory + sizeof(value) * voxel_index, &value, sizeof(value));
+}
+
+/// Query the raw clear value for an occupancy layer member with @p encoding . This is the bit pattern of the
+/// unobserved value in the encoded type.
+/// @param encoding The occupancy layer encoding.
+/// @return The clear value to use with @c VoxelLayout::addMember() .
+inline uint64_t occupancyEncodingClearValue(OccupancyEncoding encoding)
+{
+  uint64_t clear_value = 0;
+  uint8_t clear_bytes[sizeof(float)] = {};
+  writeOccupancy(clear_bytes, 0, std::numeric_limits<float>::infinity(), encoding);
+  memcpy(&clear_value, clear_bytes, occupancyEncodingSize(encoding));
+  return clear_value;
+}
+}  // namespace ohm
+
+#endif  // OHM_OCCUPANCYENCODING_H
@@ -11,6 +11,7 @@
 #include "MapChunk.h"
 #include "MapCoord.h"
 #include "MapLayer.h"
+#include "MapMemoryUsage.h"
 #include "MapProbability.h"
 #include "MapRegionCache.h"
 #include "OccupancyType.h"
@@ -33,6 +34,7 @@
 #include <cstring>
 #include <functional>
 #include <limits>
+#include <unordered_set>
 #include <utility>
 
 namespace ohm
@@ -97,6 +99,90 @@ void releaseChunkIter(uint8_t *mem)
   using Iterator = ChunkMap::iterator;
   chunkIter(mem).~Iterator();
 }
+
+/// Check if @p chunk has any observed voxels in the @p occupancy_layer . Uses the @c MapChunk::observed_mask when it
+/// is current, otherwise scans the layer for the first observed voxel.
+bool hasObservedVoxels(const MapChunk &chunk, int occupancy_layer)
+{
+  if (chunk.observed_mask_stamp == chunk.touched_stamps[occupancy_layer] && !chunk.observed_mask.empty())
+  {
+    return chunk.observed_count > 0;
+  }
+
+  if (chunk.voxel_blocks[occupancy_layer]->isUninitialised())
+  {
+    return false;
+  }
+
+  const glm::ivec3 &dim = chunk.map->region_voxel_dimensions;
+  const unsigned voxel_count = unsigned(dim.x * dim.y * dim.z);
+  const OccupancyEncoding encoding = occupancyEncoding(chunk.layout().layer(occupancy_layer));
+  VoxelBuffer<const VoxelBlock> voxel_buffer(chunk.voxel_blocks[occupancy_layer]);
+  const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
+  for (unsigned voxel_index = 0; voxel_index < voxel_count; ++voxel_index)
+  {
+    if (readOccupancy(voxel_mem, voxel_index, encoding) != unobservedOccupancyValue())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Check if all voxels in @p layer of @p chunk hold the layer clear values. Uninitialised blocks are clear.
+bool isLayerClear(const MapChunk &chunk, const MapLayer &layer)
+{
+  const VoxelBlock::Ptr &block = chunk.voxel_blocks[layer.layerIndex()];
+  if (block->isUninitialised())
+  {
+    return true;
+  }
+
+  const VoxelLayoutConst voxel_layout = layer.voxelLayout();
+  const size_t voxel_byte_size = voxel_layout.voxelByteSize();
+  const size_t member_count = voxel_layout.memberCount();
+  const size_t voxel_count = layer.volume(glm::u8vec3(chunk.map->region_voxel_dimensions));
+  VoxelBuffer<const VoxelBlock> voxel_buffer(block);
+  const uint8_t *voxel_mem = voxel_buffer.voxelMemory();
+  for (size_t voxel_index = 0; voxel_index < voxel_count; ++voxel_index)
+  {
+    const uint8_t *voxel = voxel_mem + voxel_index * voxel_byte_size;
+    for (size_t member_index = 0; member_index < member_count; ++member_index)
+    {
+      // Compare as MapLayer::clear() writes the clear value.
+      const uint64_t clear_value = voxel_layout.memberClearValue(member_index);
+      const size_t compare_size = std::min(voxel_layout.memberSize(member_index), sizeof(clear_value));
+      if (memcmp(voxel + voxel_layout.memberOffset(member_index), &clear_value, compare_size) != 0)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// Check if @p chunk holds no data: nothing observed in the occupancy layer and all other layers clear.
+bool isChunkEmpty(const MapChunk &chunk, const MapLayout &layout)
+{
+  const int occupancy_layer = layout.occupancyLayer();
+  // Check occupancy first: it is the layer most likely to hold data and may be resolved from the observed mask.
+  if (occupancy_layer >= 0 && hasObservedVoxels(chunk, occupancy_layer))
+  {
+    return false;
+  }
+
+  for (unsigned i = 0; i < layout.layerCount(); ++i)
+  {
+    if (int(i) != occupancy_layer && !isLayerClear(chunk, layout.layer(i)))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
 }  // namespace
 
 OccupancyMap::base_iterator::base_iterator()  // NOLINT
@@ -107,21 +193,37 @@ OccupancyMap::base_iterator::base_iterator()  // NOLINT
   initChunkIter(chunk_mem_.data());
 }
 
-OccupancyMap::base_iterator::base_iterator(OccupancyMap *map, const Key &key)  // NOLINT
+OccupancyMap::base_iterator::base_iterator(OccupancyMap *map, const Key &key, bool observed_only)  // NOLINT
   : map_(map)
   , key_(key)
+  , observed_only_(observed_only)
 {
   ChunkMap::iterator &chunk_iter = initChunkIter(chunk_mem_.data());
   if (!key.isNull())
   {
-    std::unique_lock<decltype(map->detail()->mutex)> guard(map->detail()->mutex);
-    chunk_iter = map->detail()->chunks.find(key.regionKey());
+    {
+      std::unique_lock<decltype(map->detail()->mutex)> guard(map->detail()->mutex);
+      chunk_iter = map->detail()->chunks.find(key.regionKey());
+    }
+
+    if (observed_only_)
+    {
+      if (chunk_iter != map->detail()->chunks.end())
+      {
+        walkObserved(voxelIndex(key_, map->detail()->region_voxel_dimensions));
+      }
+      else
+      {
+        key_ = Key::kNull;
+      }
+    }
   }
 }
 
 OccupancyMap::base_iterator::base_iterator(const base_iterator &other)  // NOLINT
   : map_(other.map_)
   , key_(other.key_)
+  , observed_only_(other.observed_only_)
 {
   static_assert(sizeof(ChunkMap::iterator) <= sizeof(OccupancyMap::base_iterator::chunk_mem_),  //
                 "Insufficient space for chunk iterator.");
@@ -140,6 +242,7 @@ OccupancyMap::base_iterator &OccupancyMap::base_iterator::operator=(const base_i
   {
     map_ = other.map_;
     key_ = other.key_;
+    observed_only_ = other.observed_only_;
     chunkIter(chunk_mem_.data()) = chunkIter(other.chunk_mem_.data());
   }
   return *this;
@@ -166,6 +269,12 @@ void OccupancyMap::base_iterator::walkNext()
 {
   if (!key_.isNull())
   {
+    if (observed_only_)
+    {
+      walkObserved(voxelIndex(key_, map_->detail()->region_voxel_dimensions) + 1);
+      return;
+    }
+
     if (!nextLocalKey(key_, map_->detail()->region_voxel_dimensions))
     {
       // Need to move to the next chunk.
@@ -181,6 +290,34 @@ void OccupancyMap::base_iterator::walkNext()
   }
 }
 
+void OccupancyMap::base_iterator::walkObserved(unsigned from_index)
+{
+  OccupancyMapDetail &map = *map_->detail();
+  ChunkMap::iterator &chunk_iter = chunkIter(chunk_mem_.data());
+  while (chunk_iter != map.chunks.end())
+  {
+    const MapChunk *chunk = chunk_iter->second;
+    if (chunk->updateObservedMask())
+    {
+      const unsigned next_index = chunk->nextObservedIndex(from_index);
+      if (next_index != ~0u)
+      {
+        key_ = chunk->keyForIndex(next_index, map.region_voxel_dimensions);
+        return;
+      }
+    }
+
+    // No more observed voxels in this chunk. Try the next.
+    ++chunk_iter;
+    from_index = 0;
+  }
+
+  // Invalidate.
+  key_ = Key::kNull;
+  releaseChunkIter(chunk_mem_.data());
+  initChunkIter(chunk_mem_.data());
+}
+
 const MapChunk *OccupancyMap::base_iterator::chunk() const
 {
   return chunkIter(chunk_mem_.data())->second;
@@ -264,6 +401,18 @@ OccupancyMap::const_iterator OccupancyMap::begin() const
   return const_iterator(const_cast<OccupancyMap *>(this), firstIterationKey());
 }
 
+OccupancyMap::iterator OccupancyMap::beginObserved()
+{
+  // Start at the first voxel of the first chunk. The observed mask is authoritative so we do not rely on
+  // first_valid_index.
+  Key key = firstIterationKey();
+  if (!key.isNull())
+  {
+    key.setLocalKey(glm::u8vec3(0));
+  }
+  return iterator(this, key, true);
+}
+
 OccupancyMap::iterator OccupancyMap::end()
 {
   return iterator(this, Key::kNull);
@@ -313,6 +462,115 @@ size_t OccupancyMap::calculateApproximateMemory() const
   return byte_count;
 }
 
+void OccupancyMap::memoryUsage(MapMemoryUsage *usage) const
+{
+  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  const MapLayout &layout = imp_->layout;
+
+  const auto read_counters = [](const LayerMemoryCounters &counters, LayerMemoryUsage &layer_usage) {
+    for (unsigned s = 0; s < unsigned(VoxelBlockState::kCount); ++s)
+    {
+      layer_usage.block_count[s] = counters.block_count[s].load(std::memory_order_relaxed);
+      layer_usage.byte_count[s] = counters.byte_count[s].load(std::memory_order_relaxed);
+    }
+  };
+
+  usage->layers.clear();
+  usage->layers.resize(std::min<size_t>(layout.layerCount(), OccupancyMapDetail::kMaxAccountedLayers));
+  for (unsigned i = 0; i < usage->layers.size(); ++i)
+  {
+    usage->layers[i].name = layout.layer(i).name();
+    read_counters(imp_->layer_memory[i], usage->layers[i]);
+  }
+
+  usage->overflow = LayerMemoryUsage();
+  if (layout.layerCount() > OccupancyMapDetail::kMaxAccountedLayers)
+  {
+    usage->overflow.name = "overflow";
+    read_counters(imp_->layerMemoryCounters(OccupancyMapDetail::kMaxAccountedLayers), usage->overflow);
+  }
+
+  usage->chunk_count = imp_->chunk_count.load(std::memory_order_relaxed);
+  const size_t per_layer_bytes = sizeof(VoxelBlock) + sizeof(VoxelBlock::Ptr) + sizeof(std::atomic_uint64_t);
+  usage->chunk_bytes = usage->chunk_count * (sizeof(MapChunk) + layout.layerCount() * per_layer_bytes) +
+                       imp_->voxel_mask_bytes.load(std::memory_order_relaxed);
+  // The bytell hash map stores a metadata byte per slot alongside the key/value pair.
+  usage->index_bytes = imp_->chunks.bucket_count() * (sizeof(ChunkMap::value_type) + 1u);
+}
+
+size_t OccupancyMap::compact()
+{
+  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  size_t reclaimed = 0;
+
+  const auto chunk_memory = [](const MapChunk &chunk) {
+    size_t byte_count = sizeof(MapChunk);
+    for (const VoxelBlock::Ptr &block : chunk.voxel_blocks)
+    {
+      byte_count += (block) ? sizeof(VoxelBlock) + block->allocatedByteSize() : 0u;
+    }
+    return byte_count;
+  };
+
+  // Note the recently released blocks before the region scan below releases blocks again. These are left to the
+  // compression thread.
+  const VoxelBlock::Clock::time_point now = VoxelBlock::Clock::now();
+  std::unordered_set<const VoxelBlock *> recent_blocks;
+  for (auto &chunk_ref : imp_->chunks)
+  {
+    for (const VoxelBlock::Ptr &block : chunk_ref.second->voxel_blocks)
+    {
+      if (!block->isUninitialised() && block->releaseAfter() > now)
+      {
+        recent_blocks.insert(block.get());
+      }
+    }
+  }
+
+  // Remove regions holding no data. Removed chunks may be pooled, so note which pooled chunks predate this call.
+  const size_t initial_pool_size = imp_->chunk_pool.size();
+  std::vector<MapChunk *> empty_chunks;
+  for (auto &chunk_ref : imp_->chunks)
+  {
+    if (isChunkEmpty(*chunk_ref.second, imp_->layout))
+    {
+      empty_chunks.emplace_back(chunk_ref.second);
+    }
+  }
+
+  for (MapChunk *chunk : empty_chunks)
+  {
+    reclaimed += chunk_memory(*chunk);
+    removeRegion(chunk);
+  }
+
+  // Release the chunk pool.
+  for (size_t i = 0; i < initial_pool_size; ++i)
+  {
+    reclaimed += chunk_memory(*imp_->chunk_pool[i]);
+  }
+  imp_->clearChunkPool();
+
+  // Compress blocks past their release delay and shrink the remaining voxel blocks.
+  for (auto &chunk_ref : imp_->chunks)
+  {
+    for (VoxelBlock::Ptr &block : chunk_ref.second->voxel_blocks)
+    {
+      reclaimed += block->compact(recent_blocks.find(block.get()) == recent_blocks.end());
+    }
+  }
+
+  // Repack the region hash table.
+  const size_t bucket_count = imp_->chunks.bucket_count();
+  imp_->chunks.rehash(0);
+  if (imp_->chunks.bucket_count() < bucket_count)
+  {
+    reclaimed += (bucket_count - imp_->chunks.bucket_count()) * (sizeof(ChunkMap::value_type) + 1u);
+  }
+
+  return reclaimed;
+}
+
 double OccupancyMap::resolution() const
 {
   return imp_->resolution;
@@ -346,19 +604,19 @@ size_t OccupancyMap::regionVoxelVolume() const
   return v;
 }
 
-glm::dvec3 OccupancyMap::regionSpatialMin(const glm::i16vec3 &region_key) const
+glm::dvec3 OccupancyMap::regionSpatialMin(const RegionKey &region_key) const
 {
   const glm::dvec3 spatial_min = regionSpatialCentre(region_key) - 0.5 * imp_->region_spatial_dimensions;
   return spatial_min;
 }
 
-glm::dvec3 OccupancyMap::regionSpatialMax(const glm::i16vec3 &region_key) const
+glm::dvec3 OccupancyMap::regionSpatialMax(const RegionKey &region_key) const
 {
   const glm::dvec3 spatial_max = regionSpatialCentre(region_key) + 0.5 * imp_->region_spatial_dimensions;
   return spatial_max;
 }
 
-glm::dvec3 OccupancyMap::regionSpatialCentre(const glm::i16vec3 &region_key) const
+glm::dvec3 OccupancyMap::regionSpatialCentre(const RegionKey &region_key) const
 {
   const glm::dvec3 centre(regionCentreCoord(region_key.x, imp_->region_spatial_dimensions.x),
                           regionCentreCoord(region_key.y, imp_->region_spatial_dimensions.y),
@@ -378,8 +636,6 @@ const glm::dvec3 &OccupancyMap::origin() const
 
 bool OccupancyMap::calculateExtents(glm::dvec3 *min_ext, glm::dvec3 *max_ext, Key *min_key, Key *max_key) const
 {
-  glm::dvec3 region_min;
-  glm::dvec3 region_max;
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   // Empty map if there are no chunks or the voxel dimensions are zero (latter just shouldn't happen).
   if (imp_->chunks.empty() || glm::any(glm::equal(imp_->region_voxel_dimensions, glm::u8vec3(0))))
@@ -405,37 +661,20 @@ bool OccupancyMap::calculateExtents(glm::dvec3 *min_ext, glm::dvec3 *max_ext, Ke
     return false;
   }
 
-  glm::dvec3 min_spatial(std::numeric_limits<double>::max());
-  glm::dvec3 max_spatial(-std::numeric_limits<double>::max());
   // We only need to track the min/max region keys. The min local voxel coordinate within a region is always (0, 0, 0),
   // while the maximum is always the region voxel dimensions - 1
-  glm::i16vec3 min_region_key(std::numeric_limits<int16_t>::max());
-  glm::i16vec3 max_region_key(std::numeric_limits<int16_t>::min());
-  bool have_extents = false;
+  RegionKey min_region_key;
+  RegionKey max_region_key;
+  const bool have_extents = imp_->region_index.extents(&min_region_key, &max_region_key);
 
-  for (auto &&chunk : imp_->chunks)
+  // Region centres are a direct function of the region key, so the spatial extents follow from the key extents.
+  const glm::dvec3 region_half_ext = 0.5 * imp_->region_spatial_dimensions;
+  glm::dvec3 min_spatial;
+  glm::dvec3 max_spatial;
+  for (int i = 0; i < 3; ++i)
   {
-    const MapRegion region = chunk.second->region;
-    region_min = region_max = region.centre;
-    region_min -= 0.5 * regionSpatialResolution();
-    region_max += 0.5 * regionSpatialResolution();
-
-    min_spatial.x = std::min(min_spatial.x, region_min.x);
-    min_spatial.y = std::min(min_spatial.y, region_min.y);
-    min_spatial.z = std::min(min_spatial.z, region_min.z);
-
-    max_spatial.x = std::max(max_spatial.x, region_max.x);
-    max_spatial.y = std::max(max_spatial.y, region_max.y);
-    max_spatial.z = std::max(max_spatial.z, region_max.z);
-
-    min_region_key.x = std::min(region.coord.x, min_region_key.x);
-    min_region_key.y = std::min(region.coord.y, min_region_key.y);
-    min_region_key.z = std::min(region.coord.z, min_region_key.z);
-    max_region_key.x = std::max(region.coord.x, max_region_key.x);
-    max_region_key.y = std::max(region.coord.y, max_region_key.y);
-    max_region_key.z = std::max(region.coord.z, max_region_key.z);
-
-    have_extents = true;
+    min_spatial[i] = regionCentreCoord(min_region_key[i], imp_->region_spatial_dimensions[i]) - region_half_ext[i];
+    max_spatial[i] = regionCentreCoord(max_region_key[i], imp_->region_spatial_dimensions[i]) + region_half_ext[i];
   }
 
   // Finalise the min/max voxel keys.
@@ -511,6 +750,13 @@ bool OccupancyMap::voxelMeanEnabled() const
 }
 
 
+OccupancyEncoding OccupancyMap::occupancyEncoding() const
+{
+  const MapLayer *layer = imp_->layout.layerPtr(imp_->layout.occupancyLayer());
+  return (layer) ? ohm::occupancyEncoding(*layer) : OccupancyEncoding::kFloat;
+}
+
+
 void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map)
 {
   // First check if there is a difference between the @c MapLayout and the actual layout.
@@ -572,6 +818,11 @@ void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map)
   }
 
   imp_->layout = new_layout;
+  // Pooled chunks are allocated for the old layout.
+  {
+    std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+    imp_->clearChunkPool();
+  }
 
   // Now reallocate any GPU cache which relies on the occupancy layer.
   if (imp_->gpu_cache)
@@ -589,14 +840,68 @@ size_t OccupancyMap::regionCount() const
 
 unsigned OccupancyMap::expireRegions(double timestamp)
 {
-  const auto should_remove_chunk = [timestamp](const MapChunk &chunk) { return chunk.touched_time < timestamp; };
+  unsigned removed_count = 0;
+  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  RegionIndex::TimeHeap &time_heap = imp_->region_index.timeHeap();
+  // Pop heap entries before the timestamp. Entries may be stale: the region may have been removed or touched again
+  // since the entry was pushed. The actual region touched_time is the arbiter.
+  while (!time_heap.empty() && time_heap.top().time < timestamp)
+  {
+    const RegionIndex::TimeEntry entry = time_heap.top();
+    time_heap.pop();
+
+    const auto chunk_iter = imp_->chunks.find(entry.region_key);
+    if (chunk_iter == imp_->chunks.end())
+    {
+      // Region already removed.
+      continue;
+    }
+
+    MapChunk *chunk = chunk_iter->second;
+    if (chunk->touched_time < timestamp)
+    {
+      removeRegion(chunk);
+      ++removed_count;
+    }
+    else if (chunk->touched_time != entry.time)
+    {
+      // Stale entry for a live region. Make sure the region's current time is in the heap.
+      time_heap.push(RegionIndex::TimeEntry{ chunk->touched_time, chunk->region.coord });
+    }
+  }
 
-  return cullRegions(should_remove_chunk);
+  imp_->region_index.compactTimeHeap();
+  return removed_count;
 }
 
 unsigned OccupancyMap::removeDistanceRegions(const glm::dvec3 &relative_to, float distance)
 {
   const float dist_sqr = distance * distance;
+  // Block classification is made conservative by this margin to ensure only the per region test is used for regions
+  // near the threshold.
+  const double margin = 1e-6 * glm::length(imp_->region_spatial_dimensions);
+  const auto classify_cell = [relative_to, distance, margin](const glm::dvec3 &centre_min,
+                                                            const glm::dvec3 &centre_max) {
+    // Nearest and furthest points of the region centre bounds.
+    glm::dvec3 nearest;
+    glm::dvec3 furthest;
+    for (int i = 0; i < 3; ++i)
+    {
+      nearest[i] = std::max(centre_min[i], std::min(relative_to[i], centre_max[i]));
+      furthest[i] = (relative_to[i] < 0.5 * (centre_min[i] + centre_max[i])) ? centre_max[i] : centre_min[i];
+    }
+    const double nearest_dist = glm::length(nearest - relative_to);
+    const double furthest_dist = glm::length(furthest - relative_to);
+    if (furthest_dist + margin < distance)
+    {
+      return CellCull::kKeep;
+    }
+    if (nearest_dist - margin > distance)
+    {
+      return CellCull::kRemove;
+    }
+    return CellCull::kTest;
+  };
   const auto should_remove_chunk = [relative_to, dist_sqr](const MapChunk &chunk) {
     glm::dvec3 separation;
     separation = chunk.region.centre - relative_to;
@@ -604,36 +909,54 @@ unsigned OccupancyMap::removeDistanceRegions(const glm::dvec3 &relative_to, floa
     return region_distance_sqr >= dist_sqr;
   };
 
-  return cullRegions(should_remove_chunk);
+  return cullRegionCells(classify_cell, should_remove_chunk);
 }
 
 unsigned OccupancyMap::cullRegionsOutside(const glm::dvec3 &min_extents, const glm::dvec3 &max_extents)
 {
   const glm::dvec3 region_extents = imp_->region_spatial_dimensions;
   const Aabb cull_box(min_extents, max_extents);
+  const double margin = 1e-6 * glm::length(region_extents);
+  const auto classify_cell = [cull_box, region_extents, margin](const glm::dvec3 &centre_min,
+                                                                const glm::dvec3 &centre_max) {
+    const Aabb cell_box(centre_min - 0.5 * region_extents, centre_max + 0.5 * region_extents);
+    if (!cull_box.overlaps(cell_box, margin))
+    {
+      return CellCull::kRemove;
+    }
+    // Every region overlaps the cull box when every region centre lies within the cull box.
+    if (glm::all(glm::greaterThan(centre_min, cull_box.minExtents() + glm::dvec3(margin))) &&
+        glm::all(glm::lessThan(centre_max, cull_box.maxExtents() - glm::dvec3(margin))))
+    {
+      return CellCull::kKeep;
+    }
+    return CellCull::kTest;
+  };
   const auto should_remove_chunk = [cull_box, region_extents](const MapChunk &chunk) {
     return !cull_box.overlaps(
       Aabb(chunk.region.centre - 0.5 * region_extents, chunk.region.centre + 0.5 * region_extents));
   };
 
-  return cullRegions(should_remove_chunk);
+  return cullRegionCells(classify_cell, should_remove_chunk);
 }
 
-void OccupancyMap::touchRegionTimestampByKey(const glm::i16vec3 &region_key, double timestamp, bool allow_create)
+void OccupancyMap::touchRegionTimestampByKey(const RegionKey &region_key, double timestamp, bool allow_create)
 {
   MapChunk *chunk = region(region_key, allow_create);
   if (chunk)
   {
+    std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
     chunk->touched_time = timestamp;
+    imp_->region_index.touch(chunk);
   }
 }
 
-glm::dvec3 OccupancyMap::regionCentreGlobal(const glm::i16vec3 &region_key) const
+glm::dvec3 OccupancyMap::regionCentreGlobal(const RegionKey &region_key) const
 {
   return imp_->origin + regionCentreLocal(region_key);
 }
 
-glm::dvec3 OccupancyMap::regionCentreLocal(const glm::i16vec3 &region_key) const
+glm::dvec3 OccupancyMap::regionCentreLocal(const RegionKey &region_key) const
 {
   glm::dvec3 centre;
   centre.x = region_key.x * imp_->region_spatial_dimensions.x;
@@ -642,7 +965,7 @@ glm::dvec3 OccupancyMap::regionCentreLocal(const glm::i16vec3 &region_key) const
   return centre;
 }
 
-glm::i16vec3 OccupancyMap::regionKey(const glm::dvec3 &point) const
+RegionKey OccupancyMap::regionKey(const glm::dvec3 &point) const
 {
   MapRegion region(point, imp_->origin, imp_->region_spatial_dimensions);
   return region.coord;
@@ -702,7 +1025,21 @@ float OccupancyMap::occupancyThresholdProbability() const
 
 void OccupancyMap::setOccupancyThresholdProbability(float probability)
 {
-  imp_->occupancy_threshold_value = probabilityToValue(probability);
+  const float threshold_value = probabilityToValue(probability);
+  if (threshold_value != imp_->occupancy_threshold_value)
+  {
+    // The ternary occupancy layer classifies voxels by threshold. Mark it as stale in all regions.
+    const int ternary_layer = imp_->layout.layerIndex(default_layer::ternaryLayerName());
+    if (ternary_layer >= 0)
+    {
+      std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+      for (auto &&chunk_ref : imp_->chunks)
+      {
+        chunk_ref.second->touched_stamps[ternary_layer] = 0u;
+      }
+    }
+  }
+  imp_->occupancy_threshold_value = threshold_value;
 }
 
 float OccupancyMap::minVoxelValue() const
@@ -854,7 +1191,7 @@ void OccupancyMap::stepKey(Key &key, int axis, int dir) const
   }
 
   key.setLocalAxis(axis, uint8_t(local_key));
-  key.setRegionAxis(axis, uint16_t(region_key));
+  key.setRegionAxis(axis, RegionCoord(region_key));
 }
 
 void OccupancyMap::moveKey(Key &key, int x, int y, int z) const
@@ -962,13 +1299,15 @@ OccupancyMap *OccupancyMap::clone(const glm::dvec3 &min_ext, const glm::dvec3 &m
       MapChunk *dst_chunk = new_map->region(src_chunk->region.coord, true);
       dst_chunk->first_valid_index = src_chunk->first_valid_index;
       dst_chunk->touched_time = src_chunk->touched_time;
+      new_map->detail()->region_index.touch(dst_chunk);
       dst_chunk->dirty_stamp = src_chunk->dirty_stamp;
       dst_chunk->flags = src_chunk->flags;
 
       for (unsigned i = 0; i < imp_->layout.layerCount(); ++i)
       {
         dst_chunk->touched_stamps[i] = static_cast<uint64_t>(src_chunk->touched_stamps[i]);
-        if (src_chunk->voxel_blocks[i])
+        // Uninitialised source blocks hold default values. Leave the destination uninitialised too.
+        if (src_chunk->voxel_blocks[i] && !src_chunk->voxel_blocks[i]->isUninitialised())
         {
           VoxelBuffer<const VoxelBlock> src_buffer(src_chunk->voxel_blocks[i]);
           VoxelBuffer<VoxelBlock> dst_buffer(dst_chunk->voxel_blocks[i]);
@@ -990,7 +1329,7 @@ void OccupancyMap::enumerateRegions(std::vector<const MapChunk *> &chunks) const
   }
 }
 
-MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key, bool allow_create)
+MapChunk *OccupancyMap::region(const RegionKey &region_key, bool allow_create)
 {
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   const auto region_search = imp_->chunks.find(region_key);
@@ -1007,7 +1346,7 @@ MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key, bool allow_create
   {
     // No such chunk. Create one.
     MapChunk *chunk = newChunk(Key(region_key, 0, 0, 0));
-    imp_->chunks.insert(std::make_pair(chunk->region.coord, chunk));
+    imp_->insertChunk(chunk);
     // No need to touch the map here. We haven't changed the semantics of the map.
     // That happens when the value of a voxel in the region changes.
     return chunk;
@@ -1016,7 +1355,7 @@ MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key, bool allow_create
   return nullptr;
 }
 
-const MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key) const
+const MapChunk *OccupancyMap::region(const RegionKey &region_key) const
 {
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   const auto region_search = imp_->chunks.find(region_key);
@@ -1030,7 +1369,7 @@ const MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key) const
 }
 
 unsigned OccupancyMap::collectDirtyRegions(uint64_t from_stamp,
-                                           std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const
+                                           std::vector<std::pair<uint64_t, RegionKey>> &regions) const
 {
   // Brute for for now.
   unsigned added_count = 0;
@@ -1068,10 +1407,10 @@ unsigned OccupancyMap::collectDirtyRegions(uint64_t from_stamp,
   return added_count;
 }
 
-uint64_t OccupancyMap::calculateDirtyExtents(uint64_t from_stamp, glm::i16vec3 *min_ext, glm::i16vec3 *max_ext) const
+uint64_t OccupancyMap::calculateDirtyExtents(uint64_t from_stamp, RegionKey *min_ext, RegionKey *max_ext) const
 {
-  *min_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::max());
-  *max_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::min());
+  *min_ext = RegionKey(std::numeric_limits<decltype(min_ext->x)>::max());
+  *max_ext = RegionKey(std::numeric_limits<decltype(min_ext->x)>::min());
 
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   const uint64_t at_stamp = imp_->stamp;
@@ -1092,17 +1431,17 @@ uint64_t OccupancyMap::calculateDirtyExtents(uint64_t from_stamp, glm::i16vec3 *
 
   if (min_ext->x > max_ext->x)
   {
-    *min_ext = glm::i16vec3(1);
-    *max_ext = glm::i16vec3(0);
+    *min_ext = RegionKey(1);
+    *max_ext = RegionKey(0);
   }
   return at_stamp;
 }
 
-void OccupancyMap::calculateDirtyClearanceExtents(glm::i16vec3 *min_ext, glm::i16vec3 *max_ext,
+void OccupancyMap::calculateDirtyClearanceExtents(RegionKey *min_ext, RegionKey *max_ext,
                                                   unsigned region_padding) const
 {
-  *min_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::max());
-  *max_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::min());
+  *min_ext = RegionKey(std::numeric_limits<decltype(min_ext->x)>::max());
+  *max_ext = RegionKey(std::numeric_limits<decltype(min_ext->x)>::min());
 
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   const int occupancy_layer = imp_->layout.occupancyLayer();
@@ -1128,8 +1467,8 @@ void OccupancyMap::calculateDirtyClearanceExtents(glm::i16vec3 *min_ext, glm::i1
 
   if (min_ext->x > max_ext->x)
   {
-    *min_ext = glm::i16vec3(1);
-    *max_ext = glm::i16vec3(0);
+    *min_ext = RegionKey(1);
+    *max_ext = RegionKey(0);
   }
 }
 
@@ -1148,7 +1487,7 @@ void OccupancyMap::clear()
     releaseChunk(chunk_ref.second);
   }
 
-  imp_->chunks.clear();
+  imp_->clearChunks();
   imp_->loaded_region_count = 0;
 }
 
@@ -1167,46 +1506,87 @@ Key OccupancyMap::firstIterationKey() const
 
 MapChunk *OccupancyMap::newChunk(const Key &for_key)
 {
-  auto *chunk =
-    new MapChunk(MapRegion(voxelCentreGlobal(for_key), imp_->origin, imp_->region_spatial_dimensions), *imp_);
+  const MapRegion region(voxelCentreGlobal(for_key), imp_->origin, imp_->region_spatial_dimensions);
+  if (!imp_->chunk_pool.empty())
+  {
+    // Reuse a pooled chunk. These have already been recycled.
+    MapChunk *chunk = imp_->chunk_pool.back();
+    imp_->chunk_pool.pop_back();
+    chunk->region = region;
+    return chunk;
+  }
+
+  auto *chunk = new MapChunk(region, *imp_);
   return chunk;
 }
 
-void OccupancyMap::releaseChunk(const MapChunk *chunk)
+void OccupancyMap::releaseChunk(MapChunk *chunk)
 {
+  if (imp_->chunk_pool.size() < imp_->chunk_pool_limit)
+  {
+    chunk->recycle(MapRegion());
+    imp_->chunk_pool.emplace_back(chunk);
+    return;
+  }
   delete chunk;
 }
 
-unsigned OccupancyMap::cullRegions(const RegionCullFunc &cull_func)
+unsigned OccupancyMap::cullRegionCells(const CellCullFunc &cell_func, const RegionCullFunc &cull_func)
 {
-  unsigned removed_count = 0;
   std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
-  auto region_iter = imp_->chunks.begin();
-  const MapChunk *chunk = nullptr;
-  while (region_iter != imp_->chunks.end())
+  std::vector<MapChunk *> culled;
+  glm::ivec3 min_region;
+  glm::ivec3 max_region;
+  glm::dvec3 centre_min;
+  glm::dvec3 centre_max;
+  for (const auto &cell_ref : imp_->region_index.cells())
   {
-    chunk = region_iter->second;
+    RegionIndex::cellRegionRange(cell_ref.first, &min_region, &max_region);
+    for (int i = 0; i < 3; ++i)
+    {
+      centre_min[i] = regionCentreCoord(min_region[i], imp_->region_spatial_dimensions[i]);
+      centre_max[i] = regionCentreCoord(max_region[i], imp_->region_spatial_dimensions[i]);
+    }
 
-    if (cull_func(*chunk))
+    switch (cell_func(centre_min, centre_max))
     {
-      // Remove from the GPU cache.
-      if (imp_->gpu_cache)
+    case CellCull::kKeep:
+      break;
+    case CellCull::kRemove:
+      culled.insert(culled.end(), cell_ref.second.begin(), cell_ref.second.end());
+      break;
+    case CellCull::kTest:
+    default:
+      for (MapChunk *chunk : cell_ref.second)
       {
-        imp_->gpu_cache->remove(chunk->region.coord);
+        if (cull_func(*chunk))
+        {
+          culled.emplace_back(chunk);
+        }
       }
-
-      // Culled region. Remove from the map.
-      region_iter = imp_->chunks.erase(region_iter);
-      releaseChunk(chunk);
-      ++removed_count;
-    }
-    else
-    {
-      // Next.
-      ++region_iter;
+      break;
     }
   }
 
-  return removed_count;
+  // Remove after the cell traversal as removal modifies the cells.
+  for (MapChunk *chunk : culled)
+  {
+    removeRegion(chunk);
+  }
+
+  return unsigned(culled.size());
+}
+
+void OccupancyMap::removeRegion(MapChunk *chunk)
+{
+  // Remove from the GPU cache.
+  if (imp_->gpu_cache)
+  {
+    imp_->gpu_cache->remove(chunk->region.coord);
+  }
+
+  // Remove from the map.
+  imp_->eraseChunk(chunk);
+  releaseChunk(chunk);
 }
 }  // namespace ohm
@@ -11,6 +11,7 @@
 #include "Key.h"
 #include "MapFlag.h"
 #include "MapProbability.h"
+#include "OccupancyEncoding.h"
 #include "RayFilter.h"
 #include "RayFlag.h"
 
@@ -31,6 +32,7 @@ class KeyList;
 struct MapChunk;
 class MapInfo;
 class MapLayout;
+struct MapMemoryUsage;
 struct OccupancyMapDetail;
 class RayFilter;
 
@@ -90,8 +92,8 @@ class RayFilter;
 /// There are two forms of addressing for the @c OccupancyMap - region and local - encapsulated by the @c Key class.
 /// The region key is a coarse indexer which identifies a @c MapRegion and its accociated memory in @c MapChunk .
 /// The local key is a fine indexer which resolves to a specific voxel within a @c MapRegion . Region indexing is
-/// limited by the size of an @c int16_t supporting a spatial range of
-/// ~`2^15 * regionVoxelDimensions() * resolution()` while the local key is limited by @c regionVoxelDimensions() .
+/// limited by the @c RegionCoord type, supporting a spatial range of ~`2^15 * regionVoxelDimensions() * resolution()`
+/// by default (see @c RegionKey ), while the local key is limited by @c regionVoxelDimensions() .
 ///
 /// @par Compression
 /// The dense memory architecture used by this class creates an inherent memory overhead. Regions are readily
@@ -111,9 +113,14 @@ public:
     /// Invalid constructor.
     base_iterator();
     /// Base iterator into @p map starting at @p key. Map must remain unchanged during iteration.
+    ///
+    /// When @p observed_only is set, the iterator skips unobserved voxels using the @c MapChunk::observed_mask ,
+    /// advancing from @p key to the first observed voxel at or after @p key .
+    ///
     /// @param map The map to iterate in.
     /// @param key The key to start iterating at.
-    base_iterator(OccupancyMap *map, const Key &key);
+    /// @param observed_only True to skip unobserved voxels.
+    base_iterator(OccupancyMap *map, const Key &key, bool observed_only = false);
     /// Copy constructor.
     /// @param other Object to shallow copy.
     base_iterator(const base_iterator &other);
@@ -150,6 +157,10 @@ public:
     /// @return True if the iterator may be safely dereferenced.
     bool isValid() const;
 
+    /// Is this iterator skipping unobserved voxels?
+    /// @return True if only observed voxels are visited.
+    inline bool observedOnly() const { return observed_only_; }
+
     /// Dereference the iterator as a key.
     /// @return The current voxel key.
     inline const Key &operator*() const { return key_; }
@@ -162,9 +173,14 @@ public:
     /// Move to the next voxel. Iterator becomes invalid if already referencing the last voxel.
     /// Iterator is unchanged if already invalid.
     void walkNext();
+    /// Move to the first observed voxel at or after the linear voxel index @p from_index in the current chunk, moving
+    /// on to subsequent chunks as required. Iterator becomes invalid if there are no more observed voxels.
+    /// @param from_index The linear voxel index in the current chunk to start searching from.
+    void walkObserved(unsigned from_index);
 
     OccupancyMap *map_ = nullptr;  ///< The referenced map.
     Key key_;            ///< The current voxel key.
+    bool observed_only_ = false;  ///< Skip unobserved voxels?
     /// Memory used to track an iterator into a hidden container type.
     /// We use an anonymous, fixed size memory chunk and placement new to prevent exposing STL
     /// types as part of the ABI.
@@ -180,8 +196,9 @@ public:
     /// Iterator into @p map starting at @p key . Map must remain unchanged during iteration.
     /// @param map The map to iterate in.
     /// @param key The key to start iterating at.
-    inline iterator(OccupancyMap *map, const Key &key)
-      : base_iterator(map, key)
+    /// @param observed_only True to skip unobserved voxels.
+    inline iterator(OccupancyMap *map, const Key &key, bool observed_only = false)
+      : base_iterator(map, key, observed_only)
     {}
     /// Copy constructor.
     /// @param other Object to shallow copy.
@@ -227,8 +244,9 @@ public:
     /// Iterator into @p map starting at @p key. Map must remain unchanged during iteration.
     /// @param map The map to iterate in.
     /// @param key The key to start iterating at.
-    inline const_iterator(OccupancyMap *map, const Key &key)
-      : base_iterator(map, key)
+    /// @param observed_only True to skip unobserved voxels.
+    inline const_iterator(OccupancyMap *map, const Key &key, bool observed_only = false)
+      : base_iterator(map, key, observed_only)
     {}
     /// Copy constructor.
     /// @param other Object to shallow copy.
@@ -300,6 +318,15 @@ public:
   /// @return An @c const_iterator to the first voxel in the map, or an invalid iterator when empty.
   const_iterator begin() const;
 
+  /// Create an iterator to the first observed voxel in the map. The iterator skips unobserved voxels, using the
+  /// @c MapChunk::observed_mask to step directly between observed voxels and to skip regions with no observed voxels.
+  /// Compare against @c end() as for @c begin() .
+  ///
+  /// The map should not have voxels added or removed during iteration, nor should regions be iterated concurrently
+  /// by multiple observed iterators as the observed masks are lazily updated.
+  /// @return An @c iterator to the first observed voxel in the map, or an invalid iterator when none are observed.
+  iterator beginObserved();
+
   /// Create an iterator representing the end of iteration. See standard iteration patterns.
   /// @return An invalid iterator for this map.
   iterator end();
@@ -311,6 +338,32 @@ public:
   /// @return The approximate memory usage (bytes).
   size_t calculateApproximateMemory() const;
 
+  /// Report the memory usage of the map, with voxel memory broken down by layer and @c VoxelBlockState .
+  ///
+  /// Unlike @c calculateApproximateMemory() , the voxel figures are exact allocation sizes maintained incrementally
+  /// as voxel blocks change state, so this call is cheap and does not touch voxel memory. Layers beyond the first
+  /// @c MapMemoryUsage::kMaxLayers are reported combined in @c MapMemoryUsage::overflow .
+  ///
+  /// @param[out] usage Populated with the memory usage.
+  void memoryUsage(MapMemoryUsage *usage) const;
+
+  /// Compact the map memory, returning memory accumulated by long running maps.
+  ///
+  /// - Regions holding no data are removed: regions with no observed voxels in the occupancy layer and all other
+  ///   layers uninitialised or holding only their clear values. These are typically regions created by ray traversal
+  ///   which end up holding nothing observed.
+  /// - Unreferenced, uncompressed @c VoxelBlock data past the layer @c MapLayer::CompressionPolicy::release_delay_ms
+  ///   are compressed immediately (when compression is enabled), rather than waiting on the background compression
+  ///   thread. Recently released blocks are left to the compression thread, as they are likely to be accessed again.
+  ///   Voxel buffer capacity in excess of the data size is freed. See @c VoxelBlock::compact() .
+  /// - Pooled @c MapChunk objects are released and the region hash table is rehashed to suit the remaining regions.
+  ///
+  /// Region removal is subject to the same restrictions as @c removeDistanceRegions() : no other thread may be
+  /// accessing the removed regions.
+  ///
+  /// @return The number of bytes reclaimed.
+  size_t compact();
+
   /// Get the voxel resolution of the occupancy map. Voxels are cubes.
   /// @return The leaf voxel resolution.
   double resolution() const;
@@ -342,21 +395,21 @@ public:
   /// The region need not be present in the map for this calculation.
   /// @param region_key The region of interest.
   /// @return The minimum spatial extent coordinate for the region.
-  glm::dvec3 regionSpatialMin(const glm::i16vec3 &region_key) const;
+  glm::dvec3 regionSpatialMin(const RegionKey &region_key) const;
 
   /// Calculate the maximum spatial coordinate for the region identified by @p region_key.
   ///
   /// The region need not be present in the map for this calculation.
   /// @param region_key The region of interest.
   /// @return The maximum spatial extent coordinate for the region.
-  glm::dvec3 regionSpatialMax(const glm::i16vec3 &region_key) const;
+  glm::dvec3 regionSpatialMax(const RegionKey &region_key) const;
 
   /// Calculate the spatial centre for the region identified by @p region_key.
   ///
   /// The region need not be present in the map for this calculation.
   /// @param region_key The region of interest.
   /// @return The coordiates of the spatial centre of the region.
-  glm::dvec3 regionSpatialCentre(const glm::i16vec3 &region_key) const;
+  glm::dvec3 regionSpatialCentre(const RegionKey &region_key) const;
 
   /// Sets the map origin. All point references are converted to be relative to this origin.
   /// Changing the origin will effectively shift all existing voxels.
@@ -418,6 +471,12 @@ public:
   /// @return True if the @c VoxelMean layer is enabled.
   bool voxelMeanEnabled() const;
 
+  /// Query how occupancy values are stored in the occupancy layer. This is @c OccupancyEncoding::kFloat unless the
+  /// map was created with @c MapFlag::kQuantisedOccupancy16 or @c MapFlag::kQuantisedOccupancy8 , or loaded from
+  /// such a map.
+  /// @return The occupancy layer encoding. @c OccupancyEncoding::kFloat if there is no valid occupancy layer.
+  OccupancyEncoding occupancyEncoding() const;
+
   /// Update the memory layout to match that in this map's @c MapLayout. Must be called after updating
   /// the @p layout() after construction.
   ///
@@ -445,6 +504,9 @@ public:
   /// with a @c touched_time before @p timestamp. The region touch time is updated via
   /// @c Voxel::touch(), @c touchRegionTimestamp() or @c touchRegionTimestampByKey().
   ///
+  /// Regions are visited in @c touched_time order, so the cost is proportional to the number of expired regions
+  /// rather than the number of regions in the map. This relies on the touch time being set via the functions above.
+  ///
   /// @param timestamp The reference time.
   /// @return The number of removed regions.
   unsigned expireRegions(double timestamp);
@@ -493,7 +555,7 @@ public:
   /// @param region_key The key for the region.
   /// @param timestamp The timestamp to update the region touch time to.
   /// @param allow_create Create the region (all uncertain) if it doesn't exist?
-  void touchRegionTimestampByKey(const glm::i16vec3 &region_key, double timestamp, bool allow_create = false);
+  void touchRegionTimestampByKey(const RegionKey &region_key, double timestamp, bool allow_create = false);
 
   /// Returns the centre of the region identified by @p regionKey.
   ///
@@ -501,7 +563,7 @@ public:
   ///
   /// @param region_key The region of interest.
   /// @return The centre of the region @p regionKey in global coordinates.
-  glm::dvec3 regionCentreGlobal(const glm::i16vec3 &region_key) const;
+  glm::dvec3 regionCentreGlobal(const RegionKey &region_key) const;
 
   /// Returns the centre of the region identified by @p regionKey in map local coordinates.
   ///
@@ -509,12 +571,12 @@ public:
   ///
   /// @param region_key The region of interest.
   /// @return The centre of the region @p regionKey in map local coordinates.
-  glm::dvec3 regionCentreLocal(const glm::i16vec3 &region_key) const;
+  glm::dvec3 regionCentreLocal(const RegionKey &region_key) const;
 
   /// Calculates the region key for the key containing @p point (global coordinates).
   /// @param point The global coordinate point of interest.
   /// @return The key of the region containing @p point.
-  glm::i16vec3 regionKey(const glm::dvec3 &point) const;
+  RegionKey regionKey(const glm::dvec3 &point) const;
 
   //-------------------------------------------------------
   // Probabilistic map functions.
@@ -592,6 +654,8 @@ public:
   /// Setting a value less than 0.5 is not recommended as this can include "miss" results integrated
   /// into the map.
   ///
+  /// Changing the threshold marks any @c TernaryOccupancy layer as stale in all regions.
+  ///
   /// @param probability The new occupancy threshold [0, 1].
   void setOccupancyThresholdProbability(float probability);
 
@@ -812,10 +876,10 @@ public:
   /// @param region_key The key of the region to fetch.
   /// @param allow_create Create the region if it doesn't exist?
   /// @return A pointer to the requested region. Null if it doesn't exist and @p allowCreate is @c false.
-  MapChunk *region(const glm::i16vec3 &region_key, bool allow_create = false);
+  MapChunk *region(const RegionKey &region_key, bool allow_create = false);
 
   /// @overload
-  const MapChunk *region(const glm::i16vec3 &region_key) const;
+  const MapChunk *region(const RegionKey &region_key) const;
 
   /// Populate @c regions with a list of regions who's touch stamp is greater than the given value.
   ///
@@ -823,20 +887,20 @@ public:
   ///
   /// @param from_stamp The map stamp value from which to fetch regions.
   /// @param regions The list to add to.
-  unsigned collectDirtyRegions(uint64_t from_stamp, std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const;
+  unsigned collectDirtyRegions(uint64_t from_stamp, std::vector<std::pair<uint64_t, RegionKey>> &regions) const;
 
   /// Experimental: calculate the extents of regions which have been changed since @c from_stamp .
   /// @param from_stamp The base stamp used to determine dirty regions.
   /// @param min_ext The region key which identifies the minimum extents of the dirty regions.
   /// @param max_ext The region key which identifies the maximum extents of the dirty regions.
   /// @return The most up to date stamp value for the dirty regions.
-  uint64_t calculateDirtyExtents(uint64_t from_stamp, glm::i16vec3 *min_ext, glm::i16vec3 *max_ext) const;
+  uint64_t calculateDirtyExtents(uint64_t from_stamp, RegionKey *min_ext, RegionKey *max_ext) const;
 
   /// Experimental: calculate the dirty region extents for the clearance layer.
   /// @param min_ext The region key which identifies the minimum extents of the dirty regions.
   /// @param max_ext The region key which identifies the maximum extents of the dirty regions.
   /// @param region_padding Number of regions to pad the returned extents.
-  void calculateDirtyClearanceExtents(glm::i16vec3 *min_ext, glm::i16vec3 *max_ext, unsigned region_padding = 0) const;
+  void calculateDirtyClearanceExtents(RegionKey *min_ext, RegionKey *max_ext, unsigned region_padding = 0) const;
 
   /// Clear the map content and release map memory.
   void clear();
@@ -844,15 +908,33 @@ public:
 private:
   Key firstIterationKey() const;
   MapChunk *newChunk(const Key &for_key);
-  static void releaseChunk(const MapChunk *chunk);
+  void releaseChunk(MapChunk *chunk);
 
-  /// Culling function for @c cullRegions().
+  /// Region culling function for @c cullRegionCells(). Returns true to remove the region.
   using RegionCullFunc = std::function<bool(const MapChunk &)>;
 
-  /// Remove regions/chunks for which @c cull_func returns true.
-  /// @param cull_func The culling criteria.
+  /// Culling classification for a spatial block of regions in @c cullRegionCells().
+  enum class CellCull : int
+  {
+    kKeep,    ///< Keep all regions in the block.
+    kRemove,  ///< Remove all regions in the block.
+    kTest     ///< Test each region in the block.
+  };
+
+  /// Block culling function for @c cullRegionCells(). Classifies a block of regions given the bounds of the region
+  /// centres in the block.
+  using CellCullFunc = std::function<CellCull(const glm::dvec3 &centre_min, const glm::dvec3 &centre_max)>;
+
+  /// Remove regions/chunks using the spatial region index. Blocks of regions are first classified by @p cell_func ,
+  /// with @p cull_func only invoked for regions in blocks classified as @c CellCull::kTest .
+  /// @param cell_func The block culling criteria.
+  /// @param cull_func The region culling criteria.
   /// @return The number of regions removed.
-  unsigned cullRegions(const RegionCullFunc &cull_func);
+  unsigned cullRegionCells(const CellCullFunc &cell_func, const RegionCullFunc &cull_func);
+
+  /// Remove @p chunk from the map, releasing it. The map mutex must be locked.
+  /// @param chunk The chunk to remove.
+  void removeRegion(MapChunk *chunk);
 
   OccupancyMapDetail *imp_;
 };
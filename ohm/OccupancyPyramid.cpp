@@ -0,0 +1,371 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OccupancyPyramid.h"
+
+#include "DefaultLayer.h"
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "VoxelBuffer.h"
+#include "VoxelOccupancy.h"
+
+#include "private/OccupancyMapDetail.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace ohm
+{
+constexpr int OccupancyPyramid::kLevels;
+
+namespace
+{
+/// Reset @p voxels to the unobserved state for blocks of @p child_count voxels.
+void clearPyramidLevel(std::vector<OccupancyPyramidVoxel> &voxels, uint32_t child_count)
+{
+  for (auto &voxel : voxels)
+  {
+    voxel.max_occupancy = unobservedOccupancyValue();
+    voxel.unknown_count = child_count;
+  }
+}
+
+/// Accumulate a child voxel summary into @p parent .
+void accumulate(OccupancyPyramidVoxel &parent, float max_occupancy, uint32_t unknown_count)
+{
+  if (max_occupancy != unobservedOccupancyValue())
+  {
+    parent.max_occupancy = (parent.max_occupancy != unobservedOccupancyValue()) ?
+                             std::max(parent.max_occupancy, max_occupancy) :
+                             max_occupancy;
+  }
+  parent.unknown_count += unknown_count;
+}
+
+/// Calculate the linear index of the parent voxel for the child voxel at @p coord in a level of dimensions
+/// @p parent_dim .
+inline unsigned parentIndex(const glm::ivec3 &coord, const glm::ivec3 &parent_dim)
+{
+  return voxelIndex(unsigned(coord.x >> 1), unsigned(coord.y >> 1), unsigned(coord.z >> 1), parent_dim.x,
+                    parent_dim.y, parent_dim.z);
+}
+}  // namespace
+
+
+OccupancyPyramid::OccupancyPyramid(OccupancyMap *map)
+  : map_(map)
+{
+  const glm::u8vec3 region_dim = map_->regionVoxelDimensions();
+  const unsigned block_mask = (1u << unsigned(kLevels)) - 1u;
+  if ((region_dim.x & block_mask) || (region_dim.y & block_mask) || (region_dim.z & block_mask))
+  {
+    // Region dimensions must divide evenly into the coarsest level.
+    return;
+  }
+
+  occupancy_layer_ = map_->layout().occupancyLayer();
+  if (occupancy_layer_ < 0)
+  {
+    return;
+  }
+
+  if (map_->layout().layerIndex(default_layer::occupancyPyramidLayerName(1)) < 0)
+  {
+    MapLayout new_layout = map_->layout();
+    addOccupancyPyramid(new_layout);
+    map_->updateLayout(new_layout);
+    occupancy_layer_ = map_->layout().occupancyLayer();
+  }
+
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    layers_[level - 1] = map_->layout().layerIndex(default_layer::occupancyPyramidLayerName(level));
+    if (layers_[level - 1] < 0)
+    {
+      layers_[0] = -1;
+      return;
+    }
+  }
+}
+
+
+size_t OccupancyPyramid::update()
+{
+  if (!isValid())
+  {
+    return 0;
+  }
+
+  std::vector<MapChunk *> chunks;
+  {
+    OccupancyMapDetail &map_data = *map_->detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    chunks.reserve(map_data.chunks.size());
+    for (auto &chunk_ref : map_data.chunks)
+    {
+      chunks.emplace_back(chunk_ref.second);
+    }
+  }
+
+  size_t updated = 0;
+  for (MapChunk *chunk : chunks)
+  {
+    updated += update(chunk) ? 1u : 0u;
+  }
+  return updated;
+}
+
+
+bool OccupancyPyramid::update(MapChunk *chunk)
+{
+  if (!isValid() || !chunk)
+  {
+    return false;
+  }
+
+  const uint64_t occupancy_stamp = chunk->touched_stamps[occupancy_layer_];
+  if (chunk->touched_stamps[layers_[0]] >= occupancy_stamp)
+  {
+    return false;
+  }
+
+  const MapLayout &layout = map_->layout();
+  const glm::u8vec3 region_dim = map_->regionVoxelDimensions();
+  std::vector<OccupancyPyramidVoxel> levels[kLevels];
+  glm::ivec3 level_dims[kLevels];
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    const MapLayer &layer = layout.layer(layers_[level - 1]);
+    level_dims[level - 1] = glm::ivec3(layer.dimensions(region_dim));
+    levels[level - 1].resize(layer.volume(region_dim));
+  }
+
+  const VoxelBlock *occupancy_block = chunk->voxel_blocks[occupancy_layer_].get();
+  if (occupancy_block->isUninitialised())
+  {
+    bool pyramid_uninitialised = true;
+    for (int level = 1; level <= kLevels; ++level)
+    {
+      pyramid_uninitialised = pyramid_uninitialised && chunk->voxel_blocks[layers_[level - 1]]->isUninitialised();
+    }
+
+    if (pyramid_uninitialised)
+    {
+      // The default layer values already represent unobserved blocks.
+      for (int level = 1; level <= kLevels; ++level)
+      {
+        chunk->touched_stamps[layers_[level - 1]] = occupancy_stamp;
+      }
+      return true;
+    }
+
+    for (int level = 1; level <= kLevels; ++level)
+    {
+      clearPyramidLevel(levels[level - 1], 1u << unsigned(3 * level));
+    }
+  }
+  else
+  {
+    // Build level 1 from the occupancy layer.
+    const OccupancyEncoding encoding = occupancyEncoding(layout.layer(occupancy_layer_));
+    VoxelBuffer<const VoxelBlock> occupancy_buffer(chunk->voxel_blocks[occupancy_layer_]);
+    const uint8_t *occupancy_mem = occupancy_buffer.voxelMemory();
+    clearPyramidLevel(levels[0], 0u);
+    unsigned voxel_index = 0;
+    glm::ivec3 coord;
+    for (coord.z = 0; coord.z < region_dim.z; ++coord.z)
+    {
+      for (coord.y = 0; coord.y < region_dim.y; ++coord.y)
+      {
+        for (coord.x = 0; coord.x < region_dim.x; ++coord.x, ++voxel_index)
+        {
+          const float value = readOccupancy(occupancy_mem, voxel_index, encoding);
+          const bool unobserved = value == unobservedOccupancyValue();
+          accumulate(levels[0][parentIndex(coord, level_dims[0])], value, unobserved ? 1u : 0u);
+        }
+      }
+    }
+
+    // Build each subsequent level from the previous.
+    for (int level = 2; level <= kLevels; ++level)
+    {
+      const std::vector<OccupancyPyramidVoxel> &children = levels[level - 2];
+      const glm::ivec3 &child_dim = level_dims[level - 2];
+      clearPyramidLevel(levels[level - 1], 0u);
+      unsigned child_index = 0;
+      for (coord.z = 0; coord.z < child_dim.z; ++coord.z)
+      {
+        for (coord.y = 0; coord.y < child_dim.y; ++coord.y)
+        {
+          for (coord.x = 0; coord.x < child_dim.x; ++coord.x, ++child_index)
+          {
+            const OccupancyPyramidVoxel &child = children[child_index];
+            accumulate(levels[level - 1][parentIndex(coord, level_dims[level - 1])], child.max_occupancy,
+                       child.unknown_count);
+          }
+        }
+      }
+    }
+  }
+
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    const int layer_index = layers_[level - 1];
+    VoxelBuffer<VoxelBlock> pyramid_buffer(chunk->voxel_blocks[layer_index]);
+    memcpy(pyramid_buffer.voxelMemory(), levels[level - 1].data(),
+           std::min(pyramid_buffer.voxelMemorySize(), levels[level - 1].size() * sizeof(OccupancyPyramidVoxel)));
+    chunk->touched_stamps[layer_index] = occupancy_stamp;
+  }
+
+  return true;
+}
+
+
+bool OccupancyPyramid::isCurrent(const MapChunk *chunk) const
+{
+  return isValid() && chunk->touched_stamps[layers_[0]] >= chunk->touched_stamps[occupancy_layer_];
+}
+
+
+unsigned OccupancyPyramid::blockIndex(const Key &key) const
+{
+  const glm::ivec3 level_dim = glm::ivec3(map_->regionVoxelDimensions()) / 2;
+  const glm::ivec3 coarse = coarseLocalKey(key, 1);
+  return voxelIndex(unsigned(coarse.x), unsigned(coarse.y), unsigned(coarse.z), level_dim.x, level_dim.y,
+                    level_dim.z);
+}
+
+
+void OccupancyPyramid::updateBlocks(MapChunk *chunk, std::vector<unsigned> &block_indices)
+{
+  if (!isValid() || !chunk)
+  {
+    return;
+  }
+
+  const MapLayout &layout = map_->layout();
+  const glm::ivec3 region_dim(map_->regionVoxelDimensions());
+  const OccupancyEncoding encoding = occupancyEncoding(layout.layer(occupancy_layer_));
+  VoxelBuffer<const VoxelBlock> occupancy_buffer(chunk->voxel_blocks[occupancy_layer_]);
+  const uint8_t *occupancy_mem = occupancy_buffer.voxelMemory();
+
+  VoxelBuffer<VoxelBlock> level_buffers[kLevels];
+  glm::ivec3 level_dims[kLevels];
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    level_buffers[level - 1] = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[layers_[level - 1]]);
+    level_dims[level - 1] = glm::ivec3(layout.layer(layers_[level - 1]).dimensions(map_->regionVoxelDimensions()));
+  }
+
+  std::vector<unsigned> &indices = block_indices;
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    const glm::ivec3 &level_dim = level_dims[level - 1];
+    const glm::ivec3 &child_dim = (level > 1) ? level_dims[level - 2] : region_dim;
+    uint8_t *level_mem = level_buffers[level - 1].voxelMemory();
+    const uint8_t *child_mem = (level > 1) ? level_buffers[level - 2].voxelMemory() : nullptr;
+
+    for (unsigned &index : indices)
+    {
+      const glm::ivec3 coord(int(index) % level_dim.x, (int(index) / level_dim.x) % level_dim.y,
+                             int(index) / (level_dim.x * level_dim.y));
+      OccupancyPyramidVoxel summary{ unobservedOccupancyValue(), 0u };
+      for (int z = 0; z < 2; ++z)
+      {
+        for (int y = 0; y < 2; ++y)
+        {
+          for (int x = 0; x < 2; ++x)
+          {
+            const glm::ivec3 child = coord * 2 + glm::ivec3(x, y, z);
+            const unsigned child_index = voxelIndex(unsigned(child.x), unsigned(child.y), unsigned(child.z),
+                                                    child_dim.x, child_dim.y, child_dim.z);
+            if (child_mem)
+            {
+              OccupancyPyramidVoxel child_voxel;
+              memcpy(&child_voxel, child_mem + sizeof(OccupancyPyramidVoxel) * child_index, sizeof(child_voxel));
+              accumulate(summary, child_voxel.max_occupancy, child_voxel.unknown_count);
+            }
+            else
+            {
+              const float value = readOccupancy(occupancy_mem, child_index, encoding);
+              accumulate(summary, value, (value == unobservedOccupancyValue()) ? 1u : 0u);
+            }
+          }
+        }
+      }
+      memcpy(level_mem + sizeof(OccupancyPyramidVoxel) * index, &summary, sizeof(summary));
+
+      // Convert to the parent index for the next level.
+      if (level < kLevels)
+      {
+        index = parentIndex(coord, level_dims[level]);
+      }
+    }
+  }
+
+  for (int level = 1; level <= kLevels; ++level)
+  {
+    chunk->touched_stamps[layers_[level - 1]] = chunk->touched_stamps[occupancy_layer_].load();
+  }
+}
+
+
+bool OccupancyPyramid::voxel(const Key &key, int level, OccupancyPyramidVoxel *voxel)
+{
+  voxel->max_occupancy = unobservedOccupancyValue();
+  voxel->unknown_count = 1u << unsigned(3 * level);
+
+  if (!isValid() || key.isNull() || level < 1 || level > kLevels)
+  {
+    return false;
+  }
+
+  MapChunk *chunk = map_->region(key.regionKey(), false);
+  if (!chunk)
+  {
+    return false;
+  }
+
+  update(chunk);
+  const int layer_index = layers_[level - 1];
+  if (chunk->voxel_blocks[layer_index]->isUninitialised())
+  {
+    // Default layer values are unobserved.
+    return true;
+  }
+
+  const MapLayer &layer = map_->layout().layer(layer_index);
+  const glm::ivec3 level_dim(layer.dimensions(map_->regionVoxelDimensions()));
+  const glm::ivec3 coarse = coarseLocalKey(key, level);
+  VoxelBuffer<const VoxelBlock> pyramid_buffer(chunk->voxel_blocks[layer_index]);
+  memcpy(voxel,
+         pyramid_buffer.voxelMemory() + sizeof(OccupancyPyramidVoxel) * voxelIndex(coarse.x, coarse.y, coarse.z,
+                                                                                   level_dim.x, level_dim.y,
+                                                                                   level_dim.z),
+         sizeof(OccupancyPyramidVoxel));
+  return true;
+}
+
+
+OccupancyType OccupancyPyramid::occupancyType(const Key &key, int level)
+{
+  OccupancyPyramidVoxel pyramid_voxel{};
+  voxel(key, level, &pyramid_voxel);
+  const float threshold = map_->occupancyThresholdValue();
+  if (isOccupied(pyramid_voxel, threshold))
+  {
+    return kOccupied;
+  }
+  return isFree(pyramid_voxel, threshold) ? kFree : kUnobserved;
+}
+}  // namespace ohm
@@ -0,0 +1,160 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_OCCUPANCYPYRAMID_H
+#define OHM_OCCUPANCYPYRAMID_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+#include "OccupancyType.h"
+
+#include <glm/vec3.hpp>
+
+#include <cinttypes>
+#include <limits>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+struct MapChunk;
+
+/// Voxel data for each level of the @c OccupancyPyramid , summarising a block of full resolution voxels.
+struct OccupancyPyramidVoxel
+{
+  /// Maximum log-odds occupancy value of the observed voxels in the block. This is @c unobservedOccupancyValue() when
+  /// no voxel in the block has been observed.
+  float max_occupancy;
+  /// Number of unobserved voxels in the block.
+  uint32_t unknown_count;
+};
+
+/// Query if the block summarised by @p voxel contains an occupied voxel.
+/// @param voxel The pyramid voxel.
+/// @param threshold The occupancy threshold value - see @c OccupancyMap::occupancyThresholdValue() .
+/// @return True if any voxel in the block is occupied.
+inline bool isOccupied(const OccupancyPyramidVoxel &voxel, float threshold)
+{
+  return voxel.max_occupancy != std::numeric_limits<float>::infinity() && voxel.max_occupancy >= threshold;
+}
+
+/// Query if the block summarised by @p voxel is entirely free, containing neither occupied nor unobserved voxels.
+/// @param voxel The pyramid voxel.
+/// @param threshold The occupancy threshold value - see @c OccupancyMap::occupancyThresholdValue() .
+/// @return True if all voxels in the block are observed and free.
+inline bool isFree(const OccupancyPyramidVoxel &voxel, float threshold)
+{
+  return voxel.unknown_count == 0 && voxel.max_occupancy < threshold;
+}
+
+/// Derives a multi-resolution occupancy pyramid from the occupancy layer of an @c OccupancyMap .
+///
+/// The pyramid consists of @c kLevels derived layers, named by @c default_layer::occupancyPyramidLayerName() , with
+/// subsampling of 1, 2 and 3: that is, voxels at 1/2, 1/4 and 1/8 of the region resolution. Each
+/// @c OccupancyPyramidVoxel summarises the maximum occupancy and the number of unobserved voxels in its block, so
+/// coarse collision checks and long range queries may test one coarse voxel before descending to full resolution.
+///
+/// The pyramid layers are rebuilt per region from the occupancy layer when stale. A region is stale when the
+/// @c MapChunk::touched_stamps value for the level 1 layer is less than that of the occupancy layer. Since the
+/// pyramid stores raw occupancy values, it is unaffected by changes to the occupancy threshold.
+///
+/// The pyramid is kept up to date incrementally by @c RayMapperOccupancy and @c RayMapperNdt , which rebuild only
+/// the blocks containing the voxels they modify using @c updateBlocks() . Other occupancy updates - such as writes via
+/// @c Voxel or GPU ray integration - mark the region occupancy layer as touched and the pyramid for such regions is
+/// rebuilt lazily by the accessors here, while @c update() brings the entire map up to date. Code reading the pyramid
+/// layers directly, such as @c rayCastFirstOccupied() , must skip stale regions - see @c isCurrent() .
+///
+/// Region voxel dimensions must be multiples of 8 to support the pyramid.
+///
+/// Accessors here are not thread safe with respect to concurrent map updates.
+class ohm_API OccupancyPyramid
+{
+public:
+  /// Number of levels in the pyramid, excluding the full resolution occupancy layer.
+  static constexpr int kLevels = 3;
+
+  /// Create a pyramid for @p map , adding the pyramid layers to @p map if required.
+  /// @param map The target map. Must outlive this object.
+  explicit OccupancyPyramid(OccupancyMap *map);
+
+  /// Query if the map supports the pyramid.
+  /// @return True if the map has occupancy and pyramid layers.
+  inline bool isValid() const { return layers_[0] >= 0 && occupancy_layer_ >= 0; }
+
+  /// Access the target map.
+  /// @return The map.
+  inline OccupancyMap *map() const { return map_; }
+
+  /// Query the layer index for a pyramid @p level .
+  /// @param level The pyramid level [1, @c kLevels ].
+  /// @return The layer index or -1 if not @c isValid() .
+  inline int layerIndex(int level) const { return layers_[level - 1]; }
+
+  /// Rebuild the pyramid for all stale regions.
+  /// @return The number of regions rebuilt.
+  size_t update();
+
+  /// Rebuild the pyramid for @p chunk if stale.
+  /// @param chunk The region to update.
+  /// @return True if the region was stale and has been rebuilt.
+  bool update(MapChunk *chunk);
+
+  /// Query if the pyramid for @p chunk is up to date with its occupancy layer.
+  /// @param chunk The region to check.
+  /// @return True if the region pyramid is current.
+  bool isCurrent(const MapChunk *chunk) const;
+
+  /// Resolve the index of the level 1 block containing the full resolution voxel @p key within its region. For use
+  /// with @c updateBlocks() .
+  /// @param key The full resolution voxel key.
+  /// @return The level 1 voxel index.
+  unsigned blockIndex(const Key &key) const;
+
+  /// Rebuild the pyramid for the given level 1 blocks of @p chunk and their parent blocks, then mark the region
+  /// pyramid as current. This is intended for occupancy writers which maintain the pyramid incrementally: the region
+  /// pyramid must have been current before the occupancy of the voxels in @p block_indices was modified and no other
+  /// voxels may have been modified since.
+  /// @param chunk The region to update.
+  /// @param block_indices Level 1 block indices from @c blockIndex() . May contain duplicates. Modified on return.
+  void updateBlocks(MapChunk *chunk, std::vector<unsigned> &block_indices);
+
+  /// Resolve the coarse voxel coordinate within a region at @p level for the full resolution voxel @p key .
+  /// @param key The full resolution voxel key.
+  /// @param level The pyramid level [1, @c kLevels ].
+  /// @return The coarse voxel coordinate within the region.
+  static inline glm::ivec3 coarseLocalKey(const Key &key, int level);
+
+  /// Query the pyramid voxel at @p level containing the full resolution voxel @p key . Stale regions are rebuilt.
+  /// @param key The full resolution voxel key.
+  /// @param level The pyramid level [1, @c kLevels ].
+  /// @param[out] voxel Set to the pyramid voxel. Blocks in regions which are not present in the map are entirely
+  ///   unobserved.
+  /// @return True if the region containing @p key is present in the map.
+  bool voxel(const Key &key, int level, OccupancyPyramidVoxel *voxel);
+
+  /// Classify the block at @p level containing the full resolution voxel @p key .
+  ///
+  /// The block is @c kOccupied if any voxel is occupied, @c kFree if all voxels are free and @c kUnobserved
+  /// otherwise. Note that a block of mixed free and unobserved voxels is @c kUnobserved .
+  /// @param key The full resolution voxel key.
+  /// @param level The pyramid level [1, @c kLevels ].
+  /// @return The block classification.
+  OccupancyType occupancyType(const Key &key, int level);
+
+private:
+  OccupancyMap *map_ = nullptr;
+  int occupancy_layer_ = -1;
+  int layers_[kLevels] = { -1, -1, -1 };
+};
+
+
+inline glm::ivec3 OccupancyPyramid::coarseLocalKey(const Key &key, int level)
+{
+  return glm::ivec3(key.localKey()) / (1 << level);
+}
+}  // namespace ohm
+
+#endif  // OHM_OCCUPANCYPYRAMID_H
@@ -35,6 +35,7 @@
 #cmakedefine OHM_PROFILE
 #cmakedefine OHM_EMBED_GPU_CODE
 #cmakedefine OHM_WITH_EIGEN
+#cmakedefine OHM_REGION_COORD_32
 
 #ifdef OHM_PROFILE
 #define PROFILING 1
@@ -0,0 +1,204 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "PackedKey.h"
+
+#include "OccupancyMap.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace ohm
+{
+const PackedKey PackedKey::kNull(~0ull);
+
+namespace
+{
+/// Calculate the number of bits required to represent values in the range <tt>[0, dim)</tt>. At least one bit is
+/// used.
+int bitsFor(unsigned dim)
+{
+  int bits = 1;
+  while ((1u << unsigned(bits)) < dim)
+  {
+    ++bits;
+  }
+  return bits;
+}
+}  // namespace
+
+
+PackedKeyCodec::PackedKeyCodec(const glm::u8vec3 &region_voxel_dimensions)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    local_bits_[i] = bitsFor(region_voxel_dimensions[i]);
+    const int region_bits = int(kAxisBits) - local_bits_[i];
+    region_min_[i] = -(1 << (region_bits - 1));
+    region_max_[i] = (1 << (region_bits - 1)) - 1;
+  }
+}
+
+
+PackedKeyCodec::PackedKeyCodec(const OccupancyMap &map)
+  : PackedKeyCodec(map.regionVoxelDimensions())
+{}
+
+
+bool PackedKeyCodec::isLossless() const
+{
+  const glm::ivec3 coord_min(std::numeric_limits<RegionCoord>::lowest());
+  const glm::ivec3 coord_max(std::numeric_limits<RegionCoord>::max());
+  // Key::kInvalidValue is the lowest value and is reserved for null keys, so needs no packed representation.
+  return glm::all(glm::lessThanEqual(region_min_, coord_min + 1)) &&
+         glm::all(glm::greaterThanEqual(region_max_, coord_max));
+}
+
+
+bool PackedKeyCodec::canPack(const Key &key) const
+{
+  if (key.isNull())
+  {
+    return true;
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    const int region = key.regionKey()[i];
+    if (region < region_min_[i] || region > region_max_[i] || key.localKey()[i] >= (1 << local_bits_[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+PackedKey PackedKeyCodec::pack(const Key &key) const
+{
+  if (key.isNull())
+  {
+    return PackedKey::kNull;
+  }
+
+  uint64_t value = 0;
+  for (int i = 2; i >= 0; --i)
+  {
+    const auto region = uint64_t(int(key.regionKey()[i]) - region_min_[i]);
+    const uint64_t field = (region << unsigned(local_bits_[i])) | uint64_t(key.localKey()[i]);
+    value = (value << kAxisBits) | field;
+  }
+  return PackedKey(value);
+}
+
+
+Key PackedKeyCodec::unpack(const PackedKey &key) const
+{
+  if (key.isNull())
+  {
+    return Key::kNull;
+  }
+
+  const uint64_t axis_mask = (1ull << kAxisBits) - 1u;
+  RegionKey region_key;
+  glm::u8vec3 local_key;
+  uint64_t value = key.value();
+  for (int i = 0; i < 3; ++i)
+  {
+    const uint64_t field = value & axis_mask;
+    local_key[i] = uint8_t(field & ((1u << unsigned(local_bits_[i])) - 1u));
+    region_key[i] = RegionCoord(int(field >> unsigned(local_bits_[i])) + region_min_[i]);
+    value >>= kAxisBits;
+  }
+  return Key(region_key, local_key);
+}
+
+
+size_t PackedKeyCodec::pack(const Key *keys, size_t count, PackedKey *packed) const
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (!canPack(keys[i]))
+    {
+      return i;
+    }
+    packed[i] = pack(keys[i]);
+  }
+  return count;
+}
+
+
+void PackedKeyCodec::unpack(const PackedKey *packed, size_t count, Key *keys) const
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    keys[i] = unpack(packed[i]);
+  }
+}
+
+
+void sortPackedKeys(PackedKey *keys, size_t count)
+{
+  const unsigned digit_bits = 8u;
+  const unsigned digit_count = 64u / digit_bits;
+  const size_t bucket_count = 1u << digit_bits;
+  const uint64_t digit_mask = bucket_count - 1u;
+
+  if (count < 2)
+  {
+    return;
+  }
+
+  // Build all digit histograms in one pass.
+  std::vector<std::array<size_t, bucket_count>> histograms(digit_count);
+  for (auto &histogram : histograms)
+  {
+    histogram.fill(0u);
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint64_t value = keys[i].value();
+    for (unsigned d = 0; d < digit_count; ++d)
+    {
+      ++histograms[d][(value >> (d * digit_bits)) & digit_mask];
+    }
+  }
+
+  std::vector<PackedKey> scratch(count);
+  PackedKey *src = keys;
+  PackedKey *dst = scratch.data();
+  for (unsigned d = 0; d < digit_count; ++d)
+  {
+    auto &histogram = histograms[d];
+    const uint64_t first_digit = (src[0].value() >> (d * digit_bits)) & digit_mask;
+    if (histogram[first_digit] == count)
+    {
+      // All keys share this digit. Skip the pass.
+      continue;
+    }
+
+    // Convert to exclusive prefix sums.
+    size_t offset = 0;
+    for (size_t &bucket : histogram)
+    {
+      const size_t bucket_size = bucket;
+      bucket = offset;
+      offset += bucket_size;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const uint64_t digit = (src[i].value() >> (d * digit_bits)) & digit_mask;
+      dst[histogram[digit]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+
+  if (src != keys)
+  {
+    std::copy(src, src + count, keys);
+  }
+}
+}  // namespace ohm
@@ -0,0 +1,175 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_PACKEDKEY_H
+#define OHM_PACKEDKEY_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+
+#include <glm/glm.hpp>
+
+#include <cinttypes>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// A compact, 64-bit representation of a @c Key .
+///
+/// A @c PackedKey holds each axis of a @c Key as a single 21-bit field, with the region coordinate in the high bits
+/// and the local coordinate in the low bits of the field. The fields are arranged with Z in the most significant bits
+/// and X in the least significant. The number of bits allocated to the local coordinate depends on the map region
+/// voxel dimensions, so packing and unpacking is performed by a @c PackedKeyCodec created for the map.
+///
+/// This layout yields the following properties:
+/// - Equality and hashing are single 64-bit operations. The @c Hash uses a single multiply.
+/// - Unsigned integer ordering of @c value() matches the ordering of global voxel coordinates by Z, then Y then X.
+///   This makes packed keys suitable for radix sorting - see @c sortPackedKeys() .
+///
+/// The most significant bit is unused except in @c kNull .
+///
+/// Packed keys are intended for transient, high volume key sets such as @c KeyList contents, line query results and
+/// voxel sets used to de-duplicate keys. Keys from different maps, or with different region dimensions, are not
+/// comparable.
+class ohm_API PackedKey
+{
+public:
+  /// A static instance of a null key. Maps to @c Key::kNull .
+  static const PackedKey kNull;
+
+  /// Hashing structure for the key. To use with hash based containers.
+  struct Hash
+  {
+    /// Calculate the hash for @p key using a single multiply (Fibonacci hashing) and folding the high bits down.
+    /// @param key The key to hash.
+    /// @return The hash value.
+    inline size_t operator()(const PackedKey &key) const
+    {
+      const uint64_t hash = key.value_ * 0x9E3779B97F4A7C15ull;  // NOLINT(readability-magic-numbers)
+      return size_t(hash ^ (hash >> 32u));                       // NOLINT(readability-magic-numbers)
+    }
+  };
+
+  /// Construct a garbage key. Does not initialise member variables for performance reasons.
+  inline PackedKey() = default;  // NOLINT(cppcoreguidelines-pro-type-member-init)
+
+  /// Construct from a raw packed value.
+  /// @param value The packed value.
+  inline explicit PackedKey(uint64_t value)
+    : value_(value)
+  {}
+
+  /// Access the raw packed value.
+  /// @return The packed value.
+  inline uint64_t value() const { return value_; }
+
+  /// Test whether this is a null key.
+  /// @return True if this is a null key.
+  inline bool isNull() const { return value_ == kNull.value_; }
+
+  /// Key equality test.
+  /// @param other The key to compare against.
+  /// @return True when the packed values match.
+  inline bool operator==(const PackedKey &other) const { return value_ == other.value_; }
+
+  /// Key inequality test.
+  /// @param other The key to compare against.
+  /// @return True when the packed values differ.
+  inline bool operator!=(const PackedKey &other) const { return value_ != other.value_; }
+
+  /// Less than operator used for sorting. Orders by global voxel coordinate Z, Y, X.
+  /// @param other The key to compare against.
+  /// @return True if this key sorts before @p other .
+  inline bool operator<(const PackedKey &other) const { return value_ < other.value_; }
+
+private:
+  uint64_t value_;
+};
+
+
+/// Converts between @c Key and @c PackedKey for a particular region voxel dimensions.
+///
+/// Each axis is packed into 21 bits. The local coordinate uses the minimum number of bits required to represent the
+/// region voxel dimensions for that axis, with the remaining bits holding a biased region coordinate. For regions of
+/// up to 32 voxels per axis, the full 16-bit region coordinate range is packed. Larger regions reduce the packable
+/// region coordinate range - see @c canPack() and @c isLossless() .
+class ohm_API PackedKeyCodec
+{
+public:
+  /// Number of bits used to pack each axis.
+  static constexpr unsigned kAxisBits = 21u;
+
+  /// Create a codec for the given region voxel dimensions.
+  /// @param region_voxel_dimensions The number of voxels along each axis of a region.
+  explicit PackedKeyCodec(const glm::u8vec3 &region_voxel_dimensions);
+
+  /// Create a codec for the region voxel dimensions of @p map .
+  /// @param map The map of interest.
+  explicit PackedKeyCodec(const OccupancyMap &map);
+
+  /// Query the number of bits used to pack the local coordinate for each axis.
+  /// @return The local bits per axis.
+  inline const glm::ivec3 &localBits() const { return local_bits_; }
+
+  /// Query whether every valid @c Key for the region dimensions can be packed. This is true when each axis has at
+  /// least as many region bits as the @c RegionCoord type.
+  /// @return True if all keys are packable.
+  bool isLossless() const;
+
+  /// Check whether @p key can be packed. Null keys can always be packed.
+  /// @param key The key to check.
+  /// @return True if @p key is in the packable range.
+  bool canPack(const Key &key) const;
+
+  /// Pack @p key . The key must satisfy @c canPack() .
+  /// @param key The key to pack.
+  /// @return The packed key, or @c PackedKey::kNull for a null key.
+  PackedKey pack(const Key &key) const;
+
+  /// Unpack @p key .
+  /// @param key The key to unpack. Must have been packed by a codec with the same region dimensions.
+  /// @return The unpacked key, or @c Key::kNull for a null key.
+  Key unpack(const PackedKey &key) const;
+
+  /// Pack an array of keys.
+  /// @param keys The keys to pack.
+  /// @param count The number of elements in @p keys .
+  /// @param[out] packed The packed output array. Must have space for @p count elements.
+  /// @return The number of keys packed. Less than @p count if an unpackable key is encountered, in which case packing
+  ///   stops at the unpackable key.
+  size_t pack(const Key *keys, size_t count, PackedKey *packed) const;
+
+  /// Unpack an array of keys.
+  /// @param packed The keys to unpack.
+  /// @param count The number of elements in @p packed .
+  /// @param[out] keys The unpacked output array. Must have space for @p count elements.
+  void unpack(const PackedKey *packed, size_t count, Key *keys) const;
+
+private:
+  glm::ivec3 local_bits_;
+  glm::ivec3 region_min_;
+  glm::ivec3 region_max_;
+};
+
+
+/// Sort an array of @c PackedKey values in increasing order using an LSD radix sort.
+///
+/// Passes for digits which are constant across all keys are skipped, so key sets with a small spatial extent sort in
+/// fewer passes.
+/// @param keys The keys to sort.
+/// @param count The number of elements in @p keys .
+void ohm_API sortPackedKeys(PackedKey *keys, size_t count);
+
+/// @overload
+inline void sortPackedKeys(std::vector<PackedKey> &keys)
+{
+  sortPackedKeys(keys.data(), keys.size());
+}
+}  // namespace ohm
+
+#endif  // OHM_PACKEDKEY_H
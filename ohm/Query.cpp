@@ -6,9 +6,12 @@
 #include "Query.h"
 
 #include "private/QueryDetail.h"
+#include "private/QueryThreadPool.h"
 
 #include "QueryFlag.h"
 
+#include <chrono>
+
 namespace ohm
 {
 Query::Query(QueryDetail *detail)
@@ -100,8 +103,57 @@ bool Query::wait(unsigned timeout_ms)
 }
 
 
-bool Query::onWaitAsync(unsigned /*timeout_ms*/)
+bool Query::asyncResult() const
+{
+  if (imp_->async_exception)
+  {
+    std::rethrow_exception(imp_->async_exception);
+  }
+  return imp_->async_success;
+}
+
+
+bool Query::onExecuteAsync()
 {
-  return false;
+  if (!wait(0))
+  {
+    // Already running.
+    return false;
+  }
+
+  reset(false);
+  imp_->async_success = true;
+  imp_->async_exception = nullptr;
+  imp_->async_result = QueryThreadPool::instance().enqueue([this]() { return onExecute(); });
+  return true;
+}
+
+
+bool Query::onWaitAsync(unsigned timeout_ms)
+{
+  if (!imp_->async_result.valid())
+  {
+    return true;
+  }
+
+  if (timeout_ms != ~0u)
+  {
+    if (imp_->async_result.wait_for(std::chrono::milliseconds(timeout_ms)) != std::future_status::ready)
+    {
+      return false;
+    }
+  }
+
+  // Release the result. Exceptions are stored rather than propagated as wait() is called from destructors.
+  try
+  {
+    imp_->async_success = imp_->async_result.get();
+  }
+  catch (...)
+  {
+    imp_->async_success = false;
+    imp_->async_exception = std::current_exception();
+  }
+  return true;
 }
 }  // namespace ohm
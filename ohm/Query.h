@@ -19,6 +19,9 @@ struct QueryDetail;
 /// Base class for a query operation on an @p OccupancyMap.
 ///
 /// Typical usage is to setup the derived query, then call @c exec() or @c execAsync() and @c wait().
+/// Asynchronous execution is supported by all queries: unless a query provides its own (e.g., GPU) implementation,
+/// @c executeAsync() runs the synchronous query on a shared CPU thread pool. Results must not be accessed and the
+/// query must not be modified until @c wait() returns true.
 /// Results may be available via methods such as @c numberOfResults() and @p intersectedVoxels(). Query behaviour may
 /// be modified by setting various @c QueryFlag values in @c setQueryFlags(), although not all flags are honoured by
 /// all query implementations.
@@ -120,6 +123,14 @@ public:
   ///   one running to begin with.
   bool wait(unsigned timeout_ms = ~0u);
 
+  /// Get the result of the last asynchronous execution, once @c wait() returns true.
+  ///
+  /// Only valid for the default @c onExecuteAsync() implementation. Exceptions thrown by the execution are held
+  /// rather than propagated from @c wait() and are rethrown here.
+  ///
+  /// @return The @c onExecute() result of the last asynchronous execution. True if there has been none.
+  bool asyncResult() const;
+
 protected:
   /// Virtual call for when a map is set.
   /// This is only called from @p setMap(), not from the constructor.
@@ -135,17 +146,23 @@ protected:
 
   /// Virtual function called to execute the query asynchronously from @c executeAsync().
   ///
-  /// Derived classes must implement an asynchronous query in this function returning only on failure or once
+  /// Derived classes may implement an asynchronous query in this function returning only on failure or once
   /// the query has started. The call must fail when there is already an asynchronous query running from this
   /// instance.
   ///
+  /// The default implementation runs @c onExecute() on a shared CPU thread pool. Derived classes relying on this
+  /// must call @c wait() in their destructor, before releasing any state @c onExecute() may access.
+  ///
   /// @return True on successfully starting an asynchronous query.
-  virtual bool onExecuteAsync() = 0;
+  virtual bool onExecuteAsync();
 
   /// Wait for an asynchronous query to complete.
-  /// @param timeout_ms Maximum time to wait (milliseconds) - zero to wait indefinitely.
-  /// @return True if the query completed before the timeout.
-  /// @todo (KS): make pure virtual
+  ///
+  /// The default implementation waits for a query started by the default @c onExecuteAsync() .
+  ///
+  /// @param timeout_ms Maximum time to wait (milliseconds) - @c ~0u to wait indefinitely.
+  /// @return True if no query is running on return; i.e., the query completed before the timeout or there was no
+  ///   query running.
   virtual bool onWaitAsync(unsigned timeout_ms);
 
   /// Called from @c reset(bool hardReset) to complete or terminate any
@@ -0,0 +1,428 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "QueryBatch.h"
+
+#include "Key.h"
+#include "KeyHash.h"
+#include "KeyList.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "QueryFlag.h"
+
+#include "private/OccupancyMapDetail.h"
+#include "private/OccupancyQueryAlg.h"
+#include "private/QueryBatchDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/glm.hpp>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+/// Parameters shared by all queries in a batch execution.
+struct BatchParams
+{
+  /// Regions covering all queries with up to date voxel masks.
+  QueryRegionMap regions;
+  glm::dvec3 region_spatial_dim{ 0 };
+  glm::ivec3 region_dim{ 0 };
+  /// Voxel search half extents for line voxel obstacle ranges.
+  int voxel_search_extents = 0;
+  float search_radius = 0;
+  float resolution = 0;
+  bool unknown_as_occupied = false;
+};
+
+using NeighbourResults = std::vector<std::pair<Key, float>>;
+
+/// Run @p func over the index range [0, @p count), in parallel where available.
+template <typename Func>
+void parallelFor(size_t count, const Func &func)
+{
+#ifdef OHM_THREADS
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, count), [&func](const tbb::blocked_range<size_t> &range) {
+    for (size_t i = range.begin(); i != range.end(); ++i)
+    {
+      func(i);
+    }
+  });
+#else   // OHM_THREADS
+  for (size_t i = 0; i < count; ++i)
+  {
+    func(i);
+  }
+#endif  // OHM_THREADS
+}
+
+/// Calculate the range from @p key to the nearest obstructed voxel within the search cube. Matches the results of
+/// @c calculateNearestNeighbour() without axis scaling.
+/// @return The range to the nearest obstruction or -1 when there is none.
+float nearestObstacleRange(const BatchParams &params, const Key &key)
+{
+  const glm::ivec3 centre(key.localKey());
+  const glm::ivec3 cube_min = centre - params.voxel_search_extents;
+  const glm::ivec3 cube_max = centre + params.voxel_search_extents;
+  // Region offsets from the key region overlapped by the search cube.
+  const glm::ivec3 region_min(floorDiv(cube_min, params.region_dim));
+  const glm::ivec3 region_max(floorDiv(cube_max, params.region_dim));
+  const float search_radius_sqr = params.search_radius * params.search_radius;
+  float closest_range_sqr = std::numeric_limits<float>::infinity();
+
+  glm::ivec3 offset;
+  for (offset.z = region_min.z; offset.z <= region_max.z; ++offset.z)
+  {
+    for (offset.y = region_min.y; offset.y <= region_max.y; ++offset.y)
+    {
+      for (offset.x = region_min.x; offset.x <= region_max.x; ++offset.x)
+      {
+        const RegionKey region_key(glm::ivec3(key.regionKey()) + offset);
+        const auto search = params.regions.find(region_key);
+        const MapChunk *chunk = (search != params.regions.end()) ? search->second : nullptr;
+        if (!chunk && !params.unknown_as_occupied)
+        {
+          continue;
+        }
+
+        // Search cube bounds local to this region.
+        const glm::ivec3 region_origin = offset * params.region_dim;
+        const glm::ivec3 voxel_min = glm::max(cube_min - region_origin, glm::ivec3(0));
+        const glm::ivec3 voxel_max = glm::min(cube_max - region_origin, params.region_dim - 1);
+        visitObstructedVoxels(chunk, params.region_dim, voxel_min, voxel_max, params.unknown_as_occupied,
+                              [&](unsigned voxel_index, bool /*unobserved*/) {
+                                const glm::ivec3 separation_voxels =
+                                  region_origin + glm::ivec3(voxelLocalKey(voxel_index, params.region_dim)) - centre;
+                                const glm::vec3 separation = glm::vec3(separation_voxels) * params.resolution;
+                                const float range_sqr = glm::dot(separation, separation);
+                                if (params.search_radius == 0 || range_sqr <= search_radius_sqr)
+                                {
+                                  closest_range_sqr = std::min(range_sqr, closest_range_sqr);
+                                }
+                              });
+      }
+    }
+  }
+
+  return (closest_range_sqr < std::numeric_limits<float>::infinity()) ? std::sqrt(closest_range_sqr) : -1.0f;
+}
+
+/// Find the obstructed voxels within the search radius of @p near_point . Matches @c NearestNeighbours .
+void nearestNeighbours(const OccupancyMap &map, const BatchParams &params, const glm::dvec3 &near_point,
+                       NeighbourResults &results)
+{
+  const float search_radius_sqr = params.search_radius * params.search_radius;
+  const glm::dvec3 search_extents(params.search_radius);
+  const glm::ivec3 region_min(map.regionKey(near_point - search_extents));
+  const glm::ivec3 region_max(map.regionKey(near_point + search_extents));
+  const glm::vec3 query_origin = glm::vec3(near_point - map.origin());
+
+  glm::ivec3 coord;
+  for (coord.z = region_min.z; coord.z <= region_max.z; ++coord.z)
+  {
+    for (coord.y = region_min.y; coord.y <= region_max.y; ++coord.y)
+    {
+      for (coord.x = region_min.x; coord.x <= region_max.x; ++coord.x)
+      {
+        const RegionKey region_key(coord);
+        const auto search = params.regions.find(region_key);
+        const MapChunk *chunk = (search != params.regions.end()) ? search->second : nullptr;
+        if (!chunk && !params.unknown_as_occupied)
+        {
+          continue;
+        }
+
+        // Reject the region when its closest point lies outside the search sphere.
+        const glm::dvec3 region_lower = map.regionCentreGlobal(region_key) - 0.5 * params.region_spatial_dim;
+        const glm::dvec3 region_separation =
+          glm::clamp(near_point, region_lower, region_lower + params.region_spatial_dim) - near_point;
+        if (glm::dot(region_separation, region_separation) > double(search_radius_sqr))
+        {
+          continue;
+        }
+
+        const glm::ivec3 voxel_min = glm::max(
+          glm::ivec3(glm::floor((near_point - search_extents - region_lower) / double(params.resolution))) - 1,
+          glm::ivec3(0));
+        const glm::ivec3 voxel_max = glm::min(
+          glm::ivec3(glm::floor((near_point + search_extents - region_lower) / double(params.resolution))) + 1,
+          params.region_dim - 1);
+
+        visitObstructedVoxels(chunk, params.region_dim, voxel_min, voxel_max, params.unknown_as_occupied,
+                              [&](unsigned voxel_index, bool /*unobserved*/) {
+                                const Key key(region_key, voxelLocalKey(voxel_index, params.region_dim));
+                                const glm::vec3 separation = glm::vec3(map.voxelCentreLocal(key)) - query_origin;
+                                const float range_sqr = glm::dot(separation, separation);
+                                if (range_sqr <= search_radius_sqr)
+                                {
+                                  results.emplace_back(key, std::sqrt(range_sqr));
+                                }
+                              });
+      }
+    }
+  }
+}
+}  // namespace
+
+
+QueryBatch::QueryBatch(QueryBatchDetail *detail)
+  : Query(detail)
+{}
+
+
+QueryBatch::QueryBatch()
+  : QueryBatch(new QueryBatchDetail)
+{}
+
+
+QueryBatch::QueryBatch(OccupancyMap &map, float search_radius, unsigned query_flags)
+  : QueryBatch(new QueryBatchDetail)
+{
+  setMap(&map);
+  setSearchRadius(search_radius);
+  setQueryFlags(query_flags);
+}
+
+
+QueryBatch::~QueryBatch()
+{
+  wait();
+  QueryBatchDetail *d = imp();
+  delete d;
+  // Clear pointer for base class.
+  imp_ = nullptr;
+}
+
+
+size_t QueryBatch::addLineQuery(const glm::dvec3 &start_point, const glm::dvec3 &end_point)
+{
+  QueryBatchDetail *d = imp();
+  d->queries.emplace_back(QueryBatchDetail::Item{ start_point, end_point, QueryType::kLine });
+  return d->queries.size() - 1;
+}
+
+
+size_t QueryBatch::addNearestNeighboursQuery(const glm::dvec3 &near_point)
+{
+  QueryBatchDetail *d = imp();
+  d->queries.emplace_back(QueryBatchDetail::Item{ near_point, near_point, QueryType::kNearestNeighbours });
+  return d->queries.size() - 1;
+}
+
+
+void QueryBatch::clearQueries()
+{
+  reset(false);
+  QueryBatchDetail *d = imp();
+  d->queries.clear();
+}
+
+
+size_t QueryBatch::queryCount() const
+{
+  const QueryBatchDetail *d = imp();
+  return d->queries.size();
+}
+
+
+QueryBatch::QueryType QueryBatch::queryType(size_t index) const
+{
+  const QueryBatchDetail *d = imp();
+  return d->queries[index].type;
+}
+
+
+float QueryBatch::searchRadius() const
+{
+  const QueryBatchDetail *d = imp();
+  return d->search_radius;
+}
+
+
+void QueryBatch::setSearchRadius(float radius)
+{
+  QueryBatchDetail *d = imp();
+  d->search_radius = radius;
+}
+
+
+const size_t *QueryBatch::resultOffsets() const
+{
+  const QueryBatchDetail *d = imp();
+  return (!d->result_offsets.empty()) ? d->result_offsets.data() : nullptr;
+}
+
+
+bool QueryBatch::onExecute()
+{
+  QueryBatchDetail *d = imp();
+
+  if (!d->map || d->map->layout().occupancyLayer() < 0)
+  {
+    return false;
+  }
+
+  const OccupancyMap &map = *d->map;
+  const size_t query_count = d->queries.size();
+  d->result_offsets.assign(query_count + 1, 0u);
+  if (query_count == 0)
+  {
+    return true;
+  }
+
+  BatchParams params;
+  params.region_spatial_dim = map.regionSpatialResolution();
+  params.region_dim = glm::ivec3(map.regionVoxelDimensions());
+  params.search_radius = d->search_radius;
+  params.resolution = float(map.resolution());
+  params.voxel_search_extents = int(std::ceil(d->search_radius / map.resolution()));
+  params.unknown_as_occupied = (d->query_flags & kQfUnknownAsOccupied) != 0;
+  const bool nearest_only = (d->query_flags & kQfNearestResult) != 0;
+
+  // Resolve the regions covering all queries, padded by a voxel beyond the search radius to cover the line voxel
+  // search cubes.
+  glm::dvec3 query_min = d->queries.front().start_point;
+  glm::dvec3 query_max = query_min;
+  for (const QueryBatchDetail::Item &item : d->queries)
+  {
+    query_min = glm::min(query_min, glm::min(item.start_point, item.end_point));
+    query_max = glm::max(query_max, glm::max(item.start_point, item.end_point));
+  }
+  const glm::dvec3 padding(double(d->search_radius) + map.resolution());
+  prepareQueryRegions(map, glm::ivec3(map.regionKey(query_min - padding)),
+                      glm::ivec3(map.regionKey(query_max + padding)), params.unknown_as_occupied, params.regions);
+
+  // Resolve the line voxels and nearest neighbours per query.
+  std::vector<KeyList> line_keys(query_count);
+  std::vector<NeighbourResults> neighbours(query_count);
+  parallelFor(query_count, [&](size_t i) {
+    const QueryBatchDetail::Item &item = d->queries[i];
+    if (item.type == QueryType::kLine)
+    {
+      map.calculateSegmentKeys(line_keys[i], item.start_point, item.end_point);
+    }
+    else
+    {
+      nearestNeighbours(map, params, item.start_point, neighbours[i]);
+    }
+  });
+
+  // Gather the unique line voxels so shared voxels are only evaluated once.
+  ska::bytell_hash_map<Key, unsigned, KeyHash> unique_lookup;
+  std::vector<Key> unique_keys;
+  std::vector<std::vector<unsigned>> line_indices(query_count);
+  for (size_t i = 0; i < query_count; ++i)
+  {
+    line_indices[i].reserve(line_keys[i].size());
+    for (const Key &key : line_keys[i])
+    {
+      const auto inserted = unique_lookup.insert(std::make_pair(key, unsigned(unique_keys.size())));
+      if (inserted.second)
+      {
+        unique_keys.emplace_back(key);
+      }
+      line_indices[i].emplace_back(inserted.first->second);
+    }
+  }
+
+  std::vector<float> unique_ranges(unique_keys.size());
+  parallelFor(unique_keys.size(), [&](size_t i) {  //
+    unique_ranges[i] = nearestObstacleRange(params, unique_keys[i]);
+  });
+
+  // Write the flat results.
+  for (size_t i = 0; i < query_count; ++i)
+  {
+    if (d->queries[i].type == QueryType::kLine)
+    {
+      const std::vector<unsigned> &indices = line_indices[i];
+      if (nearest_only)
+      {
+        // Report the nearest obstructed voxel, if any.
+        unsigned nearest = ~0u;
+        for (unsigned j = 0; j < unsigned(indices.size()); ++j)
+        {
+          const float range = unique_ranges[indices[j]];
+          if (range >= 0 && (nearest == ~0u || range < unique_ranges[indices[nearest]]))
+          {
+            nearest = j;
+          }
+        }
+        if (nearest != ~0u)
+        {
+          d->intersected_voxels.emplace_back(unique_keys[indices[nearest]]);
+          d->ranges.emplace_back(unique_ranges[indices[nearest]]);
+        }
+      }
+      else
+      {
+        for (unsigned index : indices)
+        {
+          d->intersected_voxels.emplace_back(unique_keys[index]);
+          d->ranges.emplace_back(unique_ranges[index]);
+        }
+      }
+    }
+    else
+    {
+      const NeighbourResults &results = neighbours[i];
+      if (nearest_only)
+      {
+        if (!results.empty())
+        {
+          const auto nearest = std::min_element(
+            results.begin(), results.end(),
+            [](const std::pair<Key, float> &a, const std::pair<Key, float> &b) { return a.second < b.second; });
+          d->intersected_voxels.emplace_back(nearest->first);
+          d->ranges.emplace_back(nearest->second);
+        }
+      }
+      else
+      {
+        for (const auto &result : results)
+        {
+          d->intersected_voxels.emplace_back(result.first);
+          d->ranges.emplace_back(result.second);
+        }
+      }
+    }
+    d->result_offsets[i + 1] = d->intersected_voxels.size();
+  }
+
+  d->number_of_results = d->intersected_voxels.size();
+  return true;
+}
+
+
+void QueryBatch::onReset(bool /*hard_reset*/)
+{
+  QueryBatchDetail *d = imp();
+  d->result_offsets.clear();
+}
+
+
+QueryBatchDetail *QueryBatch::imp()
+{
+  return static_cast<QueryBatchDetail *>(imp_);
+}
+
+
+const QueryBatchDetail *QueryBatch::imp() const
+{
+  return static_cast<const QueryBatchDetail *>(imp_);
+}
+}  // namespace ohm
@@ -0,0 +1,121 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_QUERYBATCH_H
+#define OHM_QUERYBATCH_H
+
+#include "OhmConfig.h"
+
+#include "Query.h"
+#include "QueryFlag.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+struct QueryBatchDetail;
+
+/// Executes a batch of line and nearest neighbour queries together on the CPU.
+///
+/// Each line query is equivalent to a @c LineQuery and each nearest neighbours query is equivalent to a
+/// @c NearestNeighbours query, all sharing the batch @c searchRadius() and @c queryFlags() . The batch amortises the
+/// per query costs of issuing many small queries:
+/// - The voxel masks of the regions covering all queries are resolved once, under a single map lock, and shared by
+///   all queries. Obstructed voxels are then resolved from the masks rather than by per voxel lookups.
+/// - Line voxels shared by multiple line queries have their nearest obstacle range calculated once.
+/// - Queries are processed in parallel when ohm is built with @c OHM_THREADS .
+///
+/// Results are written to the flat @c intersectedVoxels() and @c ranges() arrays. The results for the query at index
+/// @c i - as returned when adding the query - are in the range <tt>[resultOffsets()[i], resultOffsets()[i + 1])</tt>
+/// with the same semantics as the equivalent individual query. That is, line query results list the voxels along the
+/// line in order with the range to the nearest obstruction, or -1 when there is none within the @c searchRadius() ,
+/// while nearest neighbours results list the obstructed voxels within the @c searchRadius() in no particular order.
+/// Setting @c kQfNearestResult limits each query to its nearest result. The @c numberOfResults() is the total result
+/// count over all queries.
+///
+/// Queries persist across executions until @c clearQueries() is called. @c LineQuery::axisScaling() is not supported.
+class ohm_API QueryBatch : public Query
+{
+public:
+  /// Default flags to execute this query with.
+  static const unsigned kDefaultFlags = kQfNoCache;
+
+  /// Identifies the type of a query in the batch.
+  enum class QueryType : unsigned
+  {
+    /// A @c LineQuery equivalent.
+    kLine,
+    /// A @c NearestNeighbours equivalent.
+    kNearestNeighbours
+  };
+
+protected:
+  /// Constructor used for inherited objects. This supports deriving @p QueryBatchDetail into
+  /// more specialised forms.
+  /// @param detail pimple style data structure. When null, a @c QueryBatchDetail is allocated by
+  /// this method.
+  explicit QueryBatch(QueryBatchDetail *detail);
+
+public:
+  /// Constructor.
+  QueryBatch();
+
+  /// Construct a new query batch using the given parameters.
+  /// @param map The map to perform the queries on.
+  /// @param search_radius The search radius shared by all queries.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag .
+  QueryBatch(OccupancyMap &map, float search_radius, unsigned query_flags = kDefaultFlags);
+
+  /// Destructor.
+  ~QueryBatch() override;
+
+  /// Add a line segment query from @p start_point to @p end_point .
+  /// @param start_point The global coordinate of the line start.
+  /// @param end_point The global coordinate of the line end.
+  /// @return The index of the query in the batch.
+  size_t addLineQuery(const glm::dvec3 &start_point, const glm::dvec3 &end_point);
+
+  /// Add a nearest neighbours query around @p near_point .
+  /// @param near_point The global coordinate to search around.
+  /// @return The index of the query in the batch.
+  size_t addNearestNeighboursQuery(const glm::dvec3 &near_point);
+
+  /// Remove all queries from the batch and clear the results.
+  void clearQueries();
+
+  /// Query the number of queries in the batch.
+  /// @return The number of queries.
+  size_t queryCount() const;
+
+  /// Query the type of the query at @p index .
+  /// @param index The query index. Must be less than @c queryCount() .
+  /// @return The query type.
+  QueryType queryType(size_t index) const;
+
+  /// Get the search radius shared by all queries.
+  /// @return The search radius.
+  float searchRadius() const;
+  /// Set the search radius shared by all queries.
+  /// @param radius The new search radius.
+  void setSearchRadius(float radius);
+
+  /// Get the result offsets for each query. Valid after execution with @c queryCount() + 1 elements.
+  /// @return The result offsets array or null when not executed.
+  const size_t *resultOffsets() const;
+
+protected:
+  bool onExecute() override;
+  void onReset(bool hard_reset) override;
+
+  /// Access internal details.
+  /// @return Internal details.
+  QueryBatchDetail *imp();
+  /// Access internal details.
+  /// @return Internal details.
+  const QueryBatchDetail *imp() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_QUERYBATCH_H
@@ -0,0 +1,240 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RayCast.h"
+
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "OccupancyPyramid.h"
+#include "VoxelBuffer.h"
+#include "VoxelOccupancy.h"
+
+#include "private/RayCastDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace ohm
+{
+namespace
+{
+/// Traverse the cells of size @p cell_size intersected by the ray <tt>origin + t * dir</tt> for @p t in the range
+/// <tt>[t_begin, t_end]</tt>. The ray is expressed in global voxel units. The @p visit function is called with the
+/// cell coordinate and the entry and exit times and returns false to stop the traversal.
+/// @return False if the traversal was stopped by @p visit .
+template <typename Visit>
+bool walkCells(const glm::dvec3 &origin, const glm::dvec3 &dir, double t_begin, double t_end, int cell_size,
+               const Visit &visit)
+{
+  const glm::dvec3 entry = origin + dir * t_begin;
+  glm::ivec3 cell(glm::floor(entry / double(cell_size)));
+  glm::ivec3 step(0);
+  glm::dvec3 t_max(std::numeric_limits<double>::max());
+  glm::dvec3 t_delta(std::numeric_limits<double>::max());
+
+  for (int i = 0; i < 3; ++i)
+  {
+    if (dir[i] > 0)
+    {
+      step[i] = 1;
+      t_max[i] = (double(cell[i] + 1) * cell_size - origin[i]) / dir[i];
+      t_delta[i] = cell_size / dir[i];
+    }
+    else if (dir[i] < 0)
+    {
+      step[i] = -1;
+      t_max[i] = (double(cell[i]) * cell_size - origin[i]) / dir[i];
+      t_delta[i] = -cell_size / dir[i];
+    }
+  }
+
+  double t = t_begin;
+  for (;;)
+  {
+    const int axis = (t_max[0] < t_max[1]) ? ((t_max[0] < t_max[2]) ? 0 : 2) : ((t_max[1] < t_max[2]) ? 1 : 2);
+    const double t_exit = std::min(t_max[axis], t_end);
+    if (!visit(cell, t, t_exit))
+    {
+      return false;
+    }
+    if (t_max[axis] >= t_end)
+    {
+      return true;
+    }
+    t = t_max[axis];
+    cell[axis] += step[axis];
+    t_max[axis] += t_delta[axis];
+  }
+}
+
+}  // namespace
+
+
+RayCastContext::RayCastContext(const OccupancyMap &map, const OccupancyPyramid *pyramid, bool unknown_as_occupied,
+                               const QueryRegionMap *regions)
+  : map(map)
+  , pyramid(pyramid)
+  , regions(regions)
+  , region_dim(map.regionVoxelDimensions())
+  , encoding(map.occupancyEncoding())
+  , occupancy_layer(map.layout().occupancyLayer())
+  , threshold(map.occupancyThresholdValue())
+  , unknown_as_occupied(unknown_as_occupied)
+{
+  if (pyramid && pyramid->isValid() && pyramid->map() == &map)
+  {
+    pyramid_layer = pyramid->layerIndex(OccupancyPyramid::kLevels);
+    pyramid_dim = glm::ivec3(map.layout().layer(pyramid_layer).dimensions(map.regionVoxelDimensions()));
+  }
+}
+
+
+glm::ivec3 RayCastContext::selectRegion(const glm::ivec3 &voxel)
+{
+  const RegionKey region_key(floorDiv(voxel, region_dim));
+  if (!chunk_resolved || region_key != chunk_key)
+  {
+    chunk_key = region_key;
+    chunk_resolved = true;
+    occupancy_buffer.release();
+    pyramid_buffer.release();
+    if (regions)
+    {
+      const auto search = regions->find(region_key);
+      chunk = (search != regions->end()) ? search->second : nullptr;
+    }
+    else
+    {
+      chunk = map.region(region_key);
+    }
+    if (chunk && !chunk->voxel_blocks[occupancy_layer]->isUninitialised())
+    {
+      occupancy_buffer = VoxelBuffer<const VoxelBlock>(chunk->voxel_blocks[occupancy_layer]);
+      // Only use the pyramid where it is up to date.
+      if (pyramid_layer >= 0 && chunk->touched_stamps[pyramid_layer] >= chunk->touched_stamps[occupancy_layer] &&
+          !chunk->voxel_blocks[pyramid_layer]->isUninitialised())
+      {
+        pyramid_buffer = VoxelBuffer<const VoxelBlock>(chunk->voxel_blocks[pyramid_layer]);
+      }
+    }
+  }
+  return voxel - glm::ivec3(region_key) * region_dim;
+}
+
+
+bool RayCastContext::canSkipBlock(const glm::ivec3 &block)
+{
+  const glm::ivec3 local = selectRegion(block * 8);
+  if (!occupancy_buffer.isValid())
+  {
+    // Entirely unknown.
+    return !unknown_as_occupied;
+  }
+
+  if (!pyramid_buffer.isValid())
+  {
+    return false;
+  }
+
+  const glm::ivec3 coarse = local / 8;
+  OccupancyPyramidVoxel summary;
+  memcpy(&summary,
+         pyramid_buffer.voxelMemory() + sizeof(OccupancyPyramidVoxel) * voxelIndex(coarse.x, coarse.y, coarse.z,
+                                                                                   pyramid_dim.x, pyramid_dim.y,
+                                                                                   pyramid_dim.z),
+         sizeof(summary));
+  return !isOccupied(summary, threshold) && (!unknown_as_occupied || summary.unknown_count == 0);
+}
+
+
+bool RayCastContext::isHit(const glm::ivec3 &voxel, Key *key, float *occupancy)
+{
+  const glm::ivec3 local = selectRegion(voxel);
+  *key = Key(chunk_key, glm::u8vec3(local));
+  *occupancy = (occupancy_buffer.isValid()) ?
+                 readOccupancy(occupancy_buffer.voxelMemory(),
+                               voxelIndex(local.x, local.y, local.z, region_dim.x, region_dim.y, region_dim.z),
+                               encoding) :
+                 unobservedOccupancyValue();
+  if (*occupancy == unobservedOccupancyValue())
+  {
+    return unknown_as_occupied;
+  }
+  return isOccupied(*occupancy, threshold);
+}
+
+
+bool rayCastFirstOccupied(const OccupancyMap &map, const glm::dvec3 &start, const glm::dvec3 &end,
+                          RayCastResult *result, bool unknown_as_occupied, const OccupancyPyramid *pyramid)
+{
+  *result = RayCastResult();
+  if (map.layout().occupancyLayer() < 0)
+  {
+    return false;
+  }
+
+  RayCastContext context(map, pyramid, unknown_as_occupied);
+  return rayCastFirstOccupied(context, start, end, result);
+}
+
+
+bool rayCastFirstOccupied(RayCastContext &context, const glm::dvec3 &start, const glm::dvec3 &end,
+                          RayCastResult *result)
+{
+  *result = RayCastResult();
+  const OccupancyMap &map = context.map;
+
+  // Express the ray in global voxel units, where the global voxel index is region * region_dim + local.
+  const double resolution = map.resolution();
+  const glm::dvec3 half_region(glm::dvec3(context.region_dim) * 0.5);
+  const glm::dvec3 origin = (start - map.origin()) / resolution + half_region;
+  const glm::dvec3 dir = (end - start) / resolution;
+  const double length = glm::length(end - start);
+
+  const bool can_skip = (context.region_dim.x % 8) == 0 && (context.region_dim.y % 8) == 0 &&
+                        (context.region_dim.z % 8) == 0;
+
+  bool hit = false;
+  const auto visit_voxel = [&](const glm::ivec3 &voxel, double t_enter, double /*t_exit*/) {
+    ++result->voxels_tested;
+    if (context.isHit(voxel, &result->key, &result->occupancy))
+    {
+      result->range = t_enter * length;
+      hit = true;
+      return false;
+    }
+    return true;
+  };
+
+  if (!can_skip)
+  {
+    walkCells(origin, dir, 0.0, 1.0, 1, visit_voxel);
+  }
+  else
+  {
+    walkCells(origin, dir, 0.0, 1.0, 8, [&](const glm::ivec3 &block, double t_enter, double t_exit) {
+      if (context.canSkipBlock(block))
+      {
+        return true;
+      }
+      return walkCells(origin, dir, t_enter, t_exit, 1, visit_voxel);
+    });
+  }
+
+  if (!hit)
+  {
+    result->key = Key::kNull;
+    result->occupancy = 0;
+  }
+  return hit;
+}
+}  // namespace ohm
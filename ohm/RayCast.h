@@ -0,0 +1,58 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_RAYCAST_H
+#define OHM_RAYCAST_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+class OccupancyMap;
+class OccupancyPyramid;
+
+/// Results from @c rayCastFirstOccupied() .
+struct RayCastResult
+{
+  /// Key of the first occupied voxel. Null if there was no hit.
+  Key key = Key::kNull;
+  /// Distance along the ray to where it enters the hit voxel. Zero when the ray starts in the hit voxel.
+  double range = 0;
+  /// Occupancy value of the hit voxel. This is @c unobservedOccupancyValue() for an unknown voxel treated as occupied.
+  float occupancy = 0;
+  /// Number of full resolution voxels tested to find the result. This excludes voxels skipped in empty blocks.
+  size_t voxels_tested = 0;
+};
+
+/// Cast a ray from @p start to @p end and find the first occupied voxel, including the voxel containing @p end .
+///
+/// The ray is first traversed across blocks of 8x8x8 voxels, aligned to the regions. Blocks are skipped in one step
+/// when they cannot contain a hit, and only the remaining blocks are traversed voxel by voxel. The following
+/// summaries are used to skip blocks:
+/// - Regions which are not present in the map or which have no occupancy data are entirely unknown.
+/// - When an @c OccupancyPyramid is given, the coarsest pyramid level summarises each block. Pyramid data are only
+///   used for regions where the pyramid is up to date - see @c OccupancyPyramid::update() - other regions are walked
+///   voxel by voxel.
+///
+/// The region voxel dimensions must be multiples of 8 for block skipping. Otherwise the ray is traversed voxel by
+/// voxel.
+///
+/// @param map The map to cast against.
+/// @param start The ray start point, global coordinates.
+/// @param end The ray end point, global coordinates.
+/// @param[out] result Populated with the results. The key is null when there is no hit.
+/// @param unknown_as_occupied Treat unobserved voxels as hits? Only free blocks are skipped in this case.
+/// @param pyramid Optional pyramid for @p map used to skip blocks within regions.
+/// @return True if an occupied voxel has been found.
+bool ohm_API rayCastFirstOccupied(const OccupancyMap &map, const glm::dvec3 &start, const glm::dvec3 &end,
+                                  RayCastResult *result, bool unknown_as_occupied = false,
+                                  const OccupancyPyramid *pyramid = nullptr);
+}  // namespace ohm
+
+#endif  // OHM_RAYCAST_H
@@ -0,0 +1,180 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RayCastQuery.h"
+
+#include "Key.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "QueryFlag.h"
+#include "RayCast.h"
+
+#include "private/OccupancyMapDetail.h"
+#include "private/OccupancyQueryAlg.h"
+#include "private/RayCastDetail.h"
+#include "private/RayCastQueryDetail.h"
+
+#include <glm/glm.hpp>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <cstring>
+
+namespace ohm
+{
+RayCastQuery::RayCastQuery(RayCastQueryDetail *detail)
+  : Query(detail)
+{}
+
+
+RayCastQuery::RayCastQuery()
+  : RayCastQuery(new RayCastQueryDetail)
+{}
+
+
+RayCastQuery::RayCastQuery(OccupancyMap &map, unsigned query_flags)
+  : RayCastQuery(new RayCastQueryDetail)
+{
+  setMap(&map);
+  setQueryFlags(query_flags);
+}
+
+
+RayCastQuery::~RayCastQuery()
+{
+  wait();
+  RayCastQueryDetail *d = imp();
+  delete d;
+  // Clear pointer for base class.
+  imp_ = nullptr;
+}
+
+
+void RayCastQuery::setRays(const glm::dvec3 *rays, size_t point_count)
+{
+  RayCastQueryDetail *d = imp();
+  d->rays.resize(point_count);
+  if (point_count)
+  {
+    memcpy(d->rays.data(), rays, sizeof(*rays) * point_count);
+  }
+}
+
+
+const glm::dvec3 *RayCastQuery::rays() const
+{
+  const RayCastQueryDetail *d = imp();
+  return d->rays.data();
+}
+
+
+size_t RayCastQuery::rayPointCount() const
+{
+  const RayCastQueryDetail *d = imp();
+  return d->rays.size();
+}
+
+
+void RayCastQuery::setPyramid(const OccupancyPyramid *pyramid)
+{
+  RayCastQueryDetail *d = imp();
+  d->pyramid = pyramid;
+}
+
+
+const OccupancyPyramid *RayCastQuery::pyramid() const
+{
+  const RayCastQueryDetail *d = imp();
+  return d->pyramid;
+}
+
+
+const float *RayCastQuery::occupancy() const
+{
+  const RayCastQueryDetail *d = imp();
+  return d->occupancy.data();
+}
+
+
+bool RayCastQuery::onExecute()
+{
+  RayCastQueryDetail *d = imp();
+
+  if (!d->map || d->map->layout().occupancyLayer() < 0)
+  {
+    return false;
+  }
+
+  const OccupancyMap &map = *d->map;
+  const size_t ray_count = d->rays.size() / 2;
+  d->intersected_voxels.resize(ray_count);
+  d->ranges.resize(ray_count);
+  d->occupancy.resize(ray_count);
+  if (ray_count == 0)
+  {
+    return true;
+  }
+
+  // Resolve the regions covering all rays once so the rays can be cast without locking the map.
+  glm::dvec3 ray_min = d->rays.front();
+  glm::dvec3 ray_max = ray_min;
+  for (const glm::dvec3 &point : d->rays)
+  {
+    ray_min = glm::min(ray_min, point);
+    ray_max = glm::max(ray_max, point);
+  }
+  const bool unknown_as_occupied = (d->query_flags & kQfUnknownAsOccupied) != 0;
+  // Ray casting reads voxel values directly, so the voxel masks are not required.
+  QueryRegionMap regions;
+  prepareQueryRegions(map, glm::ivec3(map.regionKey(ray_min)), glm::ivec3(map.regionKey(ray_max)),
+                      unknown_as_occupied, regions, nullptr, nullptr, false);
+
+  // Cast the rays in [begin, end) with a context per call so region lookups are cached between rays.
+  const auto cast_rays = [&](size_t begin, size_t end) {
+    RayCastContext context(map, d->pyramid, unknown_as_occupied, &regions);
+    RayCastResult result;
+    for (size_t i = begin; i < end; ++i)
+    {
+      const bool hit = rayCastFirstOccupied(context, d->rays[i * 2], d->rays[i * 2 + 1], &result);
+      d->intersected_voxels[i] = result.key;
+      d->ranges[i] = (hit) ? float(result.range) : -1.0f;
+      d->occupancy[i] = result.occupancy;
+    }
+  };
+
+#ifdef OHM_THREADS
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, ray_count),
+                    [&cast_rays](const tbb::blocked_range<size_t> &range) { cast_rays(range.begin(), range.end()); });
+#else   // OHM_THREADS
+  cast_rays(0, ray_count);
+#endif  // OHM_THREADS
+
+  d->number_of_results = ray_count;
+  return true;
+}
+
+
+void RayCastQuery::onReset(bool /*hard_reset*/)
+{
+  RayCastQueryDetail *d = imp();
+  d->occupancy.clear();
+}
+
+
+RayCastQueryDetail *RayCastQuery::imp()
+{
+  return static_cast<RayCastQueryDetail *>(imp_);
+}
+
+
+const RayCastQueryDetail *RayCastQuery::imp() const
+{
+  return static_cast<const RayCastQueryDetail *>(imp_);
+}
+}  // namespace ohm
@@ -0,0 +1,105 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_RAYCASTQUERY_H
+#define OHM_RAYCASTQUERY_H
+
+#include "OhmConfig.h"
+
+#include "Query.h"
+#include "QueryFlag.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+class OccupancyPyramid;
+struct RayCastQueryDetail;
+
+/// Casts a set of rays against the map, finding the first occupied voxel along each ray.
+///
+/// Each ray is equivalent to a call to @c rayCastFirstOccupied() , including the voxel containing the ray end point.
+/// The query is intended for casting large numbers of rays, such as for sensor simulation:
+/// - The map regions covering all rays are resolved once, under a single map lock, and shared by all rays.
+/// - Rays are cast in parallel when ohm is built with @c OHM_THREADS .
+/// - An optional @c OccupancyPyramid is used to skip empty blocks. See @c rayCastFirstOccupied() .
+///
+/// Usage:
+/// - Call @c setRays() to define the ray start/end point pairs.
+/// - Optionally set @c kQfUnknownAsOccupied to treat unobserved voxels as hits.
+/// - Execute the query.
+///
+/// The @c numberOfResults() matches the number of rays with one result per ray, in the order the rays are given to
+/// @c setRays() . For the ray at index @c i :
+/// - @c intersectedVoxels()[i] is the key of the first hit voxel or a null key when there is no hit.
+/// - @c ranges()[i] is the distance along the ray to where it enters the hit voxel or -1 when there is no hit.
+/// - @c occupancy()[i] is the occupancy value of the hit voxel, or zero when there is no hit.
+///   This is @c unobservedOccupancyValue() for an unknown voxel treated as occupied.
+///
+/// The map must not be modified during execution.
+class ohm_API RayCastQuery : public Query
+{
+public:
+  /// Default flags to execute this query with.
+  static const unsigned kDefaultFlags = kQfNoCache;
+
+protected:
+  /// Constructor used for inherited objects. This supports deriving @p RayCastQueryDetail into
+  /// more specialised forms.
+  /// @param detail pimple style data structure. When null, a @c RayCastQueryDetail is allocated by
+  /// this method.
+  explicit RayCastQuery(RayCastQueryDetail *detail);
+
+public:
+  /// Constructor.
+  RayCastQuery();
+
+  /// Construct a new query using the given parameters.
+  /// @param map The map to perform the query on.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag .
+  explicit RayCastQuery(OccupancyMap &map, unsigned query_flags = kDefaultFlags);
+
+  /// Destructor.
+  ~RayCastQuery() override;
+
+  /// Set the ray point pairs to cast. The @p rays array is copied.
+  /// @param rays Array of ray start/end point pairs.
+  /// @param point_count Number of elements in @p rays . Must be even.
+  void setRays(const glm::dvec3 *rays, size_t point_count);
+
+  /// Get the array of ray points set in the last call to @c setRays() .
+  /// @return The ray point pairs. The number of elements is @c rayPointCount() .
+  const glm::dvec3 *rays() const;
+
+  /// Return the number of point elements in @c rays() . The number of rays is half this.
+  /// @return The number of elements in @c rays() .
+  size_t rayPointCount() const;
+
+  /// Set the pyramid used to skip empty blocks. The pyramid must be for the query map and must outlive the query.
+  /// @param pyramid The pyramid to use or null to walk all voxels.
+  void setPyramid(const OccupancyPyramid *pyramid);
+
+  /// Get the pyramid used to skip empty blocks.
+  /// @return The pyramid or null when none is set.
+  const OccupancyPyramid *pyramid() const;
+
+  /// Get the occupancy values of the hit voxels. Valid after execution with @c numberOfResults() elements.
+  /// @return The occupancy value results array.
+  const float *occupancy() const;
+
+protected:
+  bool onExecute() override;
+  void onReset(bool hard_reset) override;
+
+  /// Access internal details.
+  /// @return Internal details.
+  RayCastQueryDetail *imp();
+  /// Access internal details.
+  /// @return Internal details.
+  const RayCastQueryDetail *imp() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_RAYCASTQUERY_H
@@ -34,6 +34,10 @@ enum RayFlag
   /// Exclude the ray part, integrating only the sample. This flag is only recommended in debugging or validation.
   /// @c RayMapperBase code is not optimised for this flag.
   kRfExcludeRay = (1u << 4u),
+  /// Used with <tt>kRfStopOnFirstOccupied | kRfClearOnly</tt> to locate the first occupied voxel using
+  /// @c rayCastFirstOccupied() , skipping whole blocks of free and unknown voxels. Only supported by
+  /// @c RayMapperOccupancy and ignored otherwise.
+  kRfSkipEmptyBlocks = (1u << 5u),
 };
 #if !GPUTIL_DEVICE
 }  // namespace ohm
@@ -12,17 +12,23 @@
 #include "CovarianceVoxel.h"
 
 #include "CalculateSegmentKeys.h"
+#include "DefaultLayer.h"
 #include "KeyList.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
 #include "NdtMap.h"
 #include "OccupancyMap.h"
+#include "OccupancyPyramid.h"
 #include "RayFilter.h"
+#include "TernaryOccupancy.h"
 #include "VoxelBuffer.h"
 #include "VoxelData.h"
 
 #include <ohmutil/LineWalk.h>
 
+#include <unordered_map>
+#include <vector>
+
 namespace ohm
 {
 RayMapperNdt::RayMapperNdt(NdtMap *map)
@@ -30,6 +36,7 @@ RayMapperNdt::RayMapperNdt(NdtMap *map)
   , occupancy_layer_(map_->map().layout().occupancyLayer())
   , mean_layer_(map_->map().layout().meanLayer())
   , covariance_layer_(map_->map().layout().covarianceLayer())
+  , ternary_layer_(map_->map().layout().layerIndex(default_layer::ternaryLayerName()))
 {
   OccupancyMap *map_ptr = &map_->map();
 
@@ -38,10 +45,16 @@ RayMapperNdt::RayMapperNdt(NdtMap *map)
   Voxel<const CovarianceVoxel> cov(map_ptr, covariance_layer_);
 
   occupancy_dim_ = (occupancy.isLayerValid()) ? occupancy.layerDim() : occupancy_dim_;
+  occupancy_encoding_ = occupancy.encoding();
 
   // Validate we have occupancy, mean and covariance layers and their dimensions match.
   valid_ = occupancy.isLayerValid() && mean.isLayerValid() && cov.isLayerValid() &&
            occupancy.layerDim() == mean.layerDim() && occupancy.layerDim() == cov.layerDim();
+
+  if (map_ptr->layout().layerIndex(default_layer::occupancyPyramidLayerName(1)) >= 0)
+  {
+    pyramid_ = std::make_unique<OccupancyPyramid>(map_ptr);
+  }
 }
 
 
@@ -55,6 +68,8 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
   VoxelBuffer<VoxelBlock> occupancy_buffer;
   VoxelBuffer<VoxelBlock> mean_buffer;
   VoxelBuffer<VoxelBlock> cov_buffer;
+  VoxelBuffer<VoxelBlock> ternary_buffer;
+  bool ternary_current = false;
   bool stop_adjustments = false;
 
   OccupancyMap &occupancy_map = map_->map();
@@ -62,6 +77,7 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
   const bool use_filter = bool(ray_filter);
   const auto occupancy_layer = occupancy_layer_;
   const auto occupancy_dim = occupancy_dim_;
+  const auto occupancy_encoding = occupancy_encoding_;
   const auto occupancy_threshold_value = occupancy_map.occupancyThresholdValue();
   const auto map_origin = occupancy_map.origin();
   const auto miss_value = occupancy_map.missValue();
@@ -78,10 +94,56 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
   // Mean and covariance layers must exists.
   const auto mean_layer = mean_layer_;
   const auto covariance_layer = covariance_layer_;
+  const auto ternary_layer = ternary_layer_;
 
   // Touch the map to flag changes.
   const auto touch_stamp = occupancy_map.touch();
 
+  // Maintain the ternary layer (if present) for regions where it is up to date. Stale regions are left for
+  // TernaryOccupancy to rebuild.
+  const auto select_ternary = [&](MapChunk *chunk) {
+    if (ternary_layer >= 0)
+    {
+      ternary_current = chunk->touched_stamps[ternary_layer] >= chunk->touched_stamps[occupancy_layer];
+      ternary_buffer = ternary_current ? VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[ternary_layer]) :
+                                         VoxelBuffer<VoxelBlock>();
+    }
+  };
+  const auto update_ternary = [&](MapChunk *chunk, unsigned voxel_index, float occupancy_value) {
+    if (ternary_current)
+    {
+      writeTernary(ternary_buffer.voxelMemory(), voxel_index, ternaryCode(occupancy_value, occupancy_threshold_value));
+      chunk->touched_stamps[ternary_layer].store(touch_stamp, std::memory_order_relaxed);
+    }
+  };
+
+  // Maintain the pyramid (if present) for regions where it is up to date when first modified. The modified blocks are
+  // rebuilt once all rays have been integrated, so the regions are stale in the meantime. Stale regions are left for
+  // OccupancyPyramid to rebuild.
+  std::unordered_map<MapChunk *, std::vector<unsigned>> pyramid_blocks;
+  std::vector<unsigned> *chunk_pyramid_blocks = nullptr;
+  const auto select_pyramid_blocks = [&](MapChunk *chunk) {
+    if (pyramid_)
+    {
+      auto blocks = pyramid_blocks.find(chunk);
+      if (blocks == pyramid_blocks.end() && pyramid_->isCurrent(chunk))
+      {
+        blocks = pyramid_blocks.emplace(chunk, std::vector<unsigned>()).first;
+      }
+      chunk_pyramid_blocks = (blocks != pyramid_blocks.end()) ? &blocks->second : nullptr;
+    }
+  };
+  const auto add_pyramid_block = [&](const Key &key) {
+    if (chunk_pyramid_blocks)
+    {
+      const unsigned block_index = pyramid_->blockIndex(key);
+      if (chunk_pyramid_blocks->empty() || chunk_pyramid_blocks->back() != block_index)
+      {
+        chunk_pyramid_blocks->emplace_back(block_index);
+      }
+    }
+  };
+
   glm::dvec3 start;
   glm::dvec3 sample;
 
@@ -113,13 +175,15 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
       occupancy_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[occupancy_layer]);
       mean_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[mean_layer]);
       cov_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[covariance_layer_]);
+      select_ternary(chunk);
+      select_pyramid_blocks(chunk);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
     float occupancy_value;
     CovarianceVoxel cov;
     VoxelMean voxel_mean;
-    occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+    occupancy_value = readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_encoding);
     cov_buffer.readVoxel(voxel_index, &cov);
     mean_buffer.readVoxel(voxel_index, &voxel_mean);
     const glm::dvec3 mean =
@@ -127,12 +191,12 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
     const float initial_value = occupancy_value;
     float adjusted_value = initial_value;
 
-    const bool is_occupied = (initial_value != unobservedOccupancyValue() && initial_value > occupancy_threshold_value);
+    const bool is_occupied = isOccupied(initial_value, occupancy_threshold_value);
     calculateMissNdt(&cov, &adjusted_value, start, sample, mean, voxel_mean.count, unobservedOccupancyValue(),
                      miss_value, ndt_adaptation_rate, sensor_noise, ndt_sample_threshold);
     occupancyAdjustDown(&occupancy_value, initial_value, adjusted_value, unobservedOccupancyValue(), voxel_min,
                         saturation_min, saturation_max, stop_adjustments);
-    occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+    writeOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_value, occupancy_encoding);
     // Lint(KS): The analyser takes some branches which are not possible in practice.
     // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
     chunk->updateFirstValid(voxel_index);
@@ -142,6 +206,8 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
     // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
     // not so much the sequencing. We really don't want to synchronise here.
     chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
+    update_ternary(chunk, voxel_index, occupancy_value);
+    add_pyramid_block(key);
   };
 
   unsigned filter_flags;
@@ -186,6 +252,8 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
         occupancy_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[occupancy_layer]);
         mean_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[mean_layer]);
         cov_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[covariance_layer_]);
+        select_ternary(chunk);
+        select_pyramid_blocks(chunk);
       }
       last_chunk = chunk;
       const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
@@ -193,7 +261,7 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
       float occupancy_value;
       CovarianceVoxel cov;
       VoxelMean voxel_mean;
-      occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+      occupancy_value = readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_encoding);
       cov_buffer.readVoxel(voxel_index, &cov);
       mean_buffer.readVoxel(voxel_index, &voxel_mean);
       const glm::dvec3 mean = subVoxelToLocalCoord<glm::dvec3>(voxel_mean.coord, resolution) + voxel_centre;
@@ -210,7 +278,7 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
       voxel_mean.coord = subVoxelUpdate(voxel_mean.coord, voxel_mean.count, sample - voxel_centre, resolution);
       ++voxel_mean.count;
 
-      occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+      writeOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_value, occupancy_encoding);
       cov_buffer.writeVoxel(voxel_index, cov);
       mean_buffer.writeVoxel(voxel_index, voxel_mean);
 
@@ -224,9 +292,16 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
       chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
       chunk->touched_stamps[mean_layer].store(touch_stamp, std::memory_order_relaxed);
       chunk->touched_stamps[covariance_layer].store(touch_stamp, std::memory_order_relaxed);
+      update_ternary(chunk, voxel_index, occupancy_value);
+      add_pyramid_block(key);
     }
   }
 
+  for (auto &blocks : pyramid_blocks)
+  {
+    pyramid_->updateBlocks(blocks.first, blocks.second);
+  }
+
   return element_count / 2;
 }
 }  // namespace ohm
@@ -7,14 +7,18 @@
 
 #include "OhmConfig.h"
 
+#include "OccupancyEncoding.h"
 #include "RayFlag.h"
 #include "RayMapper.h"
 
 #include <glm/vec3.hpp>
 
+#include <memory>
+
 namespace ohm
 {
 class NdtMap;
+class OccupancyPyramid;
 
 /// A @c RayMapper implementation built around updating a map in CPU. This mapper supports occupancy population
 /// using a normal distributions transform methodology. The given map must support the following layers:
@@ -24,7 +28,8 @@ class NdtMap;
 /// The @c integrateRays() implementation performs a single threaded walk of the voxels to update and touches
 /// those voxels one at a time, updating their occupancy value. Occupancy values are updated using
 /// @c calculateMissNdt() for voxels the rays pass through and @c calculateHitWithCovariance() for the sample/end
-/// voxels. Sample voxels also have their @c CovarianceVoxel and @c VoxelMean layers updated.
+/// voxels. Sample voxels also have their @c CovarianceVoxel and @c VoxelMean layers updated. The @c TernaryOccupancy
+/// layer and @c OccupancyPyramid are also maintained if present.
 ///
 /// For reference see:
 /// 3D Normal Distributions Transform Occupancy Maps: An Efficient Representation for Mapping in Dynamic Environments
@@ -64,9 +69,13 @@ protected:
   int occupancy_layer_ = -1;   ///< Cached occupancy layer index.
   int mean_layer_ = -1;        ///< Cached voxel mean layer index.
   int covariance_layer_ = -1;  ///< Cached covariance layer index.
+  int ternary_layer_ = -1;     ///< Cached ternary occupancy layer index, if present.
   /// Cached occupancy layer voxel dimensions. Voxel mean and covariance layers must exactly match.
   glm::u8vec3 occupancy_dim_{ 0, 0, 0 };
+  OccupancyEncoding occupancy_encoding_ = OccupancyEncoding::kFloat;  ///< Cached occupancy layer encoding.
   bool valid_ = false;  ///< Has layer validation passed?
+  /// Pyramid maintained when the map has the pyramid layers.
+  std::unique_ptr<OccupancyPyramid> pyramid_;
 };
 
 }  // namespace ohm
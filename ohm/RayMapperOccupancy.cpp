@@ -4,22 +4,52 @@
 //
 #include "RayMapperOccupancy.h"
 
+#include "DefaultLayer.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
 #include "OccupancyMap.h"
+#include "OccupancyPyramid.h"
+#include "RayCast.h"
+#include "TernaryOccupancy.h"
 #include "Voxel.h"
 #include "VoxelBuffer.h"
 #include "VoxelMean.h"
 #include "VoxelOccupancy.h"
 
 #include <ohmutil/LineWalk.h>
+#include <ohmutil/VectorHash.h>
+
+#include <unordered_set>
 
 namespace ohm
 {
+namespace
+{
+/// Adaptor for @c walkSegmentKeys() walking the regions intersected by a line segment in the global map frame.
+struct WalkRegionAdaptor
+{
+  const OccupancyMap &map;
+  glm::dvec3 region_spatial_dim;
+
+  inline explicit WalkRegionAdaptor(const OccupancyMap &map)
+    : map(map)
+    , region_spatial_dim(map.regionSpatialResolution())
+  {}
+
+  inline RegionKey voxelKey(const glm::dvec3 &pt) const { return map.regionKey(pt); }
+  static inline bool isNull(const RegionKey & /*key*/) { return false; }
+  inline glm::dvec3 voxelCentre(const RegionKey &key) const { return map.regionCentreGlobal(key); }
+  static inline void stepKey(RegionKey &key, int axis, int dir) { key[axis] += dir; }
+  inline double voxelResolution(int axis) const { return region_spatial_dim[axis]; }
+};
+}  // namespace
+
+
 RayMapperOccupancy::RayMapperOccupancy(OccupancyMap *map)
   : map_(map)
   , occupancy_layer_(map_->layout().occupancyLayer())
   , mean_layer_(map_->layout().meanLayer())
+  , ternary_layer_(map_->layout().layerIndex(default_layer::ternaryLayerName()))
 {
   // Use Voxel to validate the layers.
   // In processing we use VoxelBuffer instead of Voxel objects. While Voxel mapes for a neader API, using VoxelBuffer
@@ -28,10 +58,16 @@ RayMapperOccupancy::RayMapperOccupancy(OccupancyMap *map)
   Voxel<const VoxelMean> mean(map_, mean_layer_);
 
   occupancy_dim_ = occupancy.isLayerValid() ? occupancy.layerDim() : occupancy_dim_;
+  occupancy_encoding_ = occupancy.encoding();
 
   // Validate we only have an occupancy layer or we also have a mean layer and the layer dimesions match.
   valid_ = occupancy.isLayerValid() && !mean.isLayerValid() ||
            occupancy.isLayerValid() && mean.isLayerValid() && occupancy.layerDim() == mean.layerDim();
+
+  if (map_->layout().layerIndex(default_layer::occupancyPyramidLayerName(1)) >= 0)
+  {
+    pyramid_ = std::make_unique<OccupancyPyramid>(map_);
+  }
 }
 
 
@@ -45,13 +81,17 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
   MapChunk *last_mean_chunk = nullptr;
   VoxelBuffer<VoxelBlock> occupancy_buffer;
   VoxelBuffer<VoxelBlock> mean_buffer;
+  VoxelBuffer<VoxelBlock> ternary_buffer;
+  bool ternary_current = false;
   bool stop_adjustments = false;
 
   const RayFilterFunction ray_filter = map_->rayFilter();
   const bool use_filter = bool(ray_filter);
   const auto occupancy_layer = occupancy_layer_;
   const auto mean_layer = mean_layer_;
+  const auto ternary_layer = ternary_layer_;
   const auto occupancy_dim = occupancy_dim_;
+  const auto occupancy_encoding = occupancy_encoding_;
   const auto occupancy_threshold_value = map_->occupancyThresholdValue();
   const auto map_origin = map_->origin();
   const auto miss_value = map_->missValue();
@@ -64,6 +104,51 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
   // Touch the map to flag changes.
   const auto touch_stamp = map_->touch();
 
+  // Maintain the ternary layer (if present) for regions where it is up to date. Stale regions are left for
+  // TernaryOccupancy to rebuild.
+  const auto select_ternary = [&](MapChunk *chunk) {
+    if (ternary_layer >= 0)
+    {
+      ternary_current = chunk->touched_stamps[ternary_layer] >= chunk->touched_stamps[occupancy_layer];
+      ternary_buffer = ternary_current ? VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[ternary_layer]) :
+                                         VoxelBuffer<VoxelBlock>();
+    }
+  };
+  const auto update_ternary = [&](MapChunk *chunk, unsigned voxel_index, float occupancy_value) {
+    if (ternary_current)
+    {
+      writeTernary(ternary_buffer.voxelMemory(), voxel_index, ternaryCode(occupancy_value, occupancy_threshold_value));
+      chunk->touched_stamps[ternary_layer].store(touch_stamp, std::memory_order_relaxed);
+    }
+  };
+
+  // Maintain the pyramid (if present) for regions where it is up to date when first modified. The modified blocks are
+  // rebuilt once all rays have been integrated, so the regions are stale in the meantime. Stale regions are left for
+  // OccupancyPyramid to rebuild.
+  std::unordered_map<MapChunk *, std::vector<unsigned>> pyramid_blocks;
+  std::vector<unsigned> *chunk_pyramid_blocks = nullptr;
+  const auto select_pyramid_blocks = [&](MapChunk *chunk) {
+    if (pyramid_)
+    {
+      auto blocks = pyramid_blocks.find(chunk);
+      if (blocks == pyramid_blocks.end() && pyramid_->isCurrent(chunk))
+      {
+        blocks = pyramid_blocks.emplace(chunk, std::vector<unsigned>()).first;
+      }
+      chunk_pyramid_blocks = (blocks != pyramid_blocks.end()) ? &blocks->second : nullptr;
+    }
+  };
+  const auto add_pyramid_block = [&](const Key &key) {
+    if (chunk_pyramid_blocks)
+    {
+      const unsigned block_index = pyramid_->blockIndex(key);
+      if (chunk_pyramid_blocks->empty() || chunk_pyramid_blocks->back() != block_index)
+      {
+        chunk_pyramid_blocks->emplace_back(block_index);
+      }
+    }
+  };
+
   const auto visit_func = [&](const Key &key)  //
   {                                            //
     // The update logic here is a little unclear as it tries to avoid outright branches.
@@ -88,16 +173,18 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
     if (chunk != last_chunk)
     {
       occupancy_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[occupancy_layer]);
+      select_ternary(chunk);
+      select_pyramid_blocks(chunk);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
-    float occupancy_value;
-    occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+    float occupancy_value = readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_encoding);
     const float initial_value = occupancy_value;
-    const bool is_occupied = (initial_value != unobservedOccupancyValue() && initial_value > occupancy_threshold_value);
+    const bool is_occupied = isOccupied(initial_value, occupancy_threshold_value);
     occupancyAdjustMiss(&occupancy_value, initial_value, miss_value, unobservedOccupancyValue(), voxel_min,
-                        saturation_min, saturation_max, stop_adjustments);
-    occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+                        saturation_min, saturation_max,
+                        stop_adjustments || ((ray_update_flags & kRfClearOnly) && !is_occupied));
+    writeOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_value, occupancy_encoding);
     // Lint(KS): The analyser takes some branches which are not possible in practice.
     // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
     chunk->updateFirstValid(voxel_index);
@@ -107,11 +194,27 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
     // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
     // not so much the sequencing. We really don't want to synchronise here.
     chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
+    update_ternary(chunk, voxel_index, occupancy_value);
+    add_pyramid_block(key);
+  };
+
+  const bool skip_empty_blocks = (ray_update_flags & kRfSkipEmptyBlocks) &&
+                                 (ray_update_flags & kRfStopOnFirstOccupied) && (ray_update_flags & kRfClearOnly);
+  // Regions along the rays are brought up to date in the pyramid once per call as the rays reach them. Regions we
+  // modify below become stale and are walked voxel by voxel for the remainder of this call.
+  std::unordered_set<RegionKey, Vector3Hash<RegionKey>> pyramid_regions;
+  const WalkRegionAdaptor region_walk(*map_);
+  const auto update_pyramid = [&](const RegionKey &region_key) {
+    if (pyramid_regions.insert(region_key).second)
+    {
+      pyramid_->update(map_->region(region_key));
+    }
   };
 
   glm::dvec3 start;
   glm::dvec3 end;
   unsigned filter_flags;
+  RayCastResult hit;
   for (size_t i = 0; i < element_count; i += 2)
   {
     filter_flags = 0;
@@ -127,6 +230,25 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
       }
     }
 
+    if (skip_empty_blocks)
+    {
+      // Only the first occupied voxel is affected. Find it directly.
+      if (ray_update_flags & kRfExcludeRay)
+      {
+        continue;
+      }
+      if (pyramid_)
+      {
+        walkSegmentKeys<RegionKey>(update_pyramid, start, end, true, region_walk);
+      }
+      if (rayCastFirstOccupied(*map_, start, end, &hit, false, pyramid_.get()))
+      {
+        stop_adjustments = false;
+        visit_func(hit.key);
+      }
+      continue;
+    }
+
     const bool include_sample_in_ray =
       (filter_flags & kRffClippedEnd) || (ray_update_flags & kRfEndPointAsFree) || (ray_update_flags & kRfClearOnly);
 
@@ -152,12 +274,13 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
       if (chunk != last_chunk)
       {
         occupancy_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[occupancy_layer]);
+        select_ternary(chunk);
+        select_pyramid_blocks(chunk);
       }
       last_chunk = chunk;
       const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
 
-      float occupancy_value;
-      occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+      float occupancy_value = readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_encoding);
       const float initial_value = occupancy_value;
       occupancyAdjustHit(&occupancy_value, initial_value, hit_value, unobservedOccupancyValue(), voxel_max,
                          saturation_min, saturation_max, stop_adjustments);
@@ -180,7 +303,7 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
         // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
         chunk->touched_stamps[mean_layer].store(touch_stamp, std::memory_order_relaxed);
       }
-      occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+      writeOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_value, occupancy_encoding);
       // Lint(KS): The analyser takes some branches which are not possible in practice.
       // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
       chunk->updateFirstValid(voxel_index);
@@ -189,9 +312,16 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
       // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
       // not so much the sequencing. We really don't want to synchronise here.
       chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
+      update_ternary(chunk, voxel_index, occupancy_value);
+      add_pyramid_block(key);
     }
   }
 
+  for (auto &blocks : pyramid_blocks)
+  {
+    pyramid_->updateBlocks(blocks.first, blocks.second);
+  }
+
   return element_count / 2;
 }
 }  // namespace ohm
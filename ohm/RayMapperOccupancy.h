@@ -9,6 +9,7 @@
 
 #include "CalculateSegmentKeys.h"
 #include "KeyList.h"
+#include "OccupancyEncoding.h"
 #include "RayFilter.h"
 #include "RayFlag.h"
 #include "RayMapper.h"
@@ -16,11 +17,21 @@
 
 #include <glm/vec3.hpp>
 
+#include <memory>
+
 namespace ohm
 {
+class OccupancyPyramid;
+
 /// A @c RayMapper implementation built around updating a map in CPU. This mapper supports basic occupancy population
 /// and @c VoxelMean update (if enabled by the map) - @c MayLayout::occupancyLayer() and @c MapLayout::meanLayer()
-/// respectively.
+/// respectively. The @c TernaryOccupancy layer and @c OccupancyPyramid are also maintained if present.
+///
+/// Rays integrated with <tt>kRfStopOnFirstOccupied | kRfClearOnly | kRfSkipEmptyBlocks</tt> use
+/// @c rayCastFirstOccupied() to find and adjust only the first occupied voxel, skipping blocks of free and unknown
+/// voxels. This uses the @c OccupancyPyramid when the map has the pyramid layers, rebuilding stale pyramid regions
+/// only as the rays reach them. Regions modified by the current @c integrateRays() call remain stale until the call
+/// completes.
 ///
 /// The @c integrateRays() implementation performs a single threaded walk of the voxels to update and touches
 /// those voxels one at a time, updating their occupancy value. The given @c OccupancyMap must have an occupancy
@@ -62,7 +73,11 @@ protected:
   OccupancyMap *map_ = nullptr;           ///< Target map.
   int occupancy_layer_ = -1;              ///< Cached occupancy layer index.
   int mean_layer_ = -1;                   ///< Cached voxel mean layer index.
+  int ternary_layer_ = -1;                ///< Cached ternary occupancy layer index, if present.
   glm::u8vec3 occupancy_dim_{ 0, 0, 0 };  ///< Cached occupancy layer voxel dimensions. Voxel mean must exactly match.
+  OccupancyEncoding occupancy_encoding_ = OccupancyEncoding::kFloat;  ///< Cached occupancy layer encoding.
+  /// Pyramid maintained and used with @c kRfSkipEmptyBlocks when the map has the pyramid layers.
+  std::unique_ptr<OccupancyPyramid> pyramid_;
   bool valid_ = false;                    ///< Has layer validation passed?
 };
 
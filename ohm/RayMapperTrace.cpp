@@ -15,6 +15,8 @@
 
 #include "private/OccupancyMapDetail.h"
 
+#include <iostream>
+
 #ifdef TES_ENABLE
 #include <3esmeshmessages.h>
 #include <3esservermacros.h>
@@ -26,8 +28,8 @@
 
 namespace ohm
 {
-using KeyToIndexMap = std::unordered_map<Key, uint32_t, Key::Hash>;
-using KeySet = std::unordered_set<Key, Key::Hash>;
+using KeyToIndexMap = std::unordered_map<PackedKey, uint32_t, PackedKey::Hash>;
+using KeySet = std::unordered_set<PackedKey, PackedKey::Hash>;
 
 enum TraceCategory
 {
@@ -41,6 +43,8 @@ struct OccupancyMeshDetail
 {
   OccupancyMap *map;
   uint32_t id;
+  /// Packs voxel keys for the @c map .
+  PackedKeyCodec key_codec{ glm::u8vec3(1) };
 
   std::vector<tes::Vector3d> vertices;
   // Define the render extents for the voxels.
@@ -50,6 +54,8 @@ struct OccupancyMeshDetail
   std::vector<uint32_t> unused_vertex_list;
   /// Maps voxel keys to their vertex indices.
   KeyToIndexMap voxel_index_map;
+  /// Number of occupied voxels omitted from the mesh because their keys cannot be packed.
+  size_t skipped_key_count = 0;
 };
 
 /// Defines and maintains a 3rd Eye Scene mesh resource based on an octomap.
@@ -85,6 +91,10 @@ public:
   /// @param touched_occupied Keys of voxels which have changed occupied probability.
   void update(const KeySet &newly_occupied, const KeySet &newly_free, const KeySet &touched_occupied);
 
+  /// Query the number of occupied voxels omitted when building the mesh because their keys cannot be packed.
+  /// @return The number of skipped voxels.
+  inline size_t skippedKeyCount() const { return imp_->skipped_key_count; }
+
 private:
   std::unique_ptr<OccupancyMeshDetail> imp_;
 };
@@ -111,6 +121,7 @@ OccupancyMesh::OccupancyMesh(OccupancyMap *map)
 {
   imp_->map = map;
   imp_->id = tes::Id(this).id();
+  imp_->key_codec = PackedKeyCodec(*map);
 }
 
 OccupancyMesh::~OccupancyMesh() = default;
@@ -192,6 +203,7 @@ int OccupancyMesh::transfer(tes::PacketWriter &packet, unsigned byte_limit, tes:
   {
     imp_->vertices.clear();
     imp_->colours.clear();
+    imp_->skipped_key_count = 0;
     Voxel<const float> occupancy_voxel(imp_->map, imp_->map->layout().occupancyLayer());
     const OccupancyMap &map = *imp_->map;
     for (auto iter = map.begin(); iter != map.end(); ++iter)
@@ -199,8 +211,14 @@ int OccupancyMesh::transfer(tes::PacketWriter &packet, unsigned byte_limit, tes:
       occupancy_voxel.setKey(iter);
       if (isOccupied(occupancy_voxel))
       {
+        if (!imp_->key_codec.canPack(*iter))
+        {
+          ++imp_->skipped_key_count;
+          continue;
+        }
+
         // Add voxel.
-        imp_->voxel_index_map.insert(std::make_pair(*iter, uint32_t(imp_->vertices.size())));
+        imp_->voxel_index_map.insert(std::make_pair(imp_->key_codec.pack(*iter), uint32_t(imp_->vertices.size())));
         imp_->vertices.emplace_back(glm::value_ptr(map.voxelCentreGlobal(*iter)));
         // Normals represent voxel half extents.
         imp_->normals.emplace_back(0.5 * map.resolution());
@@ -256,7 +274,8 @@ void OccupancyMesh::update(const KeySet &newly_occupied, const KeySet &newly_fre
   while (!imp_->unused_vertex_list.empty() && occupied_iter != newly_occupied.end())
   {
     const uint32_t vertex_index = imp_->unused_vertex_list.back();
-    const Key key = *occupied_iter;
+    const PackedKey packed_key = *occupied_iter;
+    const Key key = imp_->key_codec.unpack(packed_key);
     const bool mark_as_modified = imp_->unused_vertex_list.size() <= initial_unused_vertex_count;
     imp_->unused_vertex_list.pop_back();
     ++occupied_iter;
@@ -264,7 +283,7 @@ void OccupancyMesh::update(const KeySet &newly_occupied, const KeySet &newly_fre
     occupancy_voxel.setKey(key);
     imp_->vertices[vertex_index] = tes::Vector3d(glm::value_ptr(imp_->map->voxelCentreGlobal(key)));
     imp_->colours[vertex_index] = voxelColour(occupancy_voxel);
-    imp_->voxel_index_map.insert(std::make_pair(key, vertex_index));
+    imp_->voxel_index_map.insert(std::make_pair(packed_key, vertex_index));
     // Only mark as modified if this vertex wasn't just invalidate by removal.
     // It will already be on the list otherwise.
     if (mark_as_modified)
@@ -332,8 +351,9 @@ void OccupancyMesh::update(const KeySet &newly_occupied, const KeySet &newly_fre
   for (; occupied_iter != newly_occupied.end(); ++occupied_iter, ++processed_occupied_count)
   {
     const auto vertex_index = uint32_t(imp_->vertices.size());
-    const Key key = *occupied_iter;
-    imp_->voxel_index_map.insert(std::make_pair(key, vertex_index));
+    const PackedKey packed_key = *occupied_iter;
+    const Key key = imp_->key_codec.unpack(packed_key);
+    imp_->voxel_index_map.insert(std::make_pair(packed_key, vertex_index));
     imp_->vertices.emplace_back(glm::value_ptr(imp_->map->voxelCentreGlobal(key)));
     // Normals represent voxel half extents.
     imp_->normals.emplace_back(0.5 * imp_->map->resolution());
@@ -419,7 +439,7 @@ void drawNdt(const glm::i16vec4 &sector_key, const OccupancyMap &map)
   std::vector<tes::Sphere> ellipsoids;
   std::vector<tes::Shape *> ellipsoid_ptrs;
 
-  const glm::i16vec3 region_key(sector_key);
+  const RegionKey region_key(sector_key);
   const MapChunk *chunk = map.region(region_key);
 
   if (chunk)
@@ -498,6 +518,7 @@ class OccupancyMesh
 {
 public:
   OccupancyMesh(OccupancyMap *) {}
+  inline size_t skippedKeyCount() const { return 0; }
 };
 }  // namespace ohm
 #endif  // TES_ENABLE
@@ -507,6 +528,7 @@ namespace ohm
 RayMapperTrace::RayMapperTrace(OccupancyMap *map, RayMapper *true_mapper)
   : map_(map)
   , true_mapper_(true_mapper)
+  , key_codec_(*map)
   , imp_(std::make_unique<OccupancyMesh>(map))
 {
 #ifdef TES_ENABLE
@@ -558,7 +580,7 @@ size_t RayMapperTrace::integrateRays(const glm::dvec3 *rays, size_t element_coun
 
   if (g_tes && element_count)
   {
-    cacheState(rays, element_count, &initial_state, &sector_set);
+    noteSkippedKeys(cacheState(rays, element_count, &initial_state, &sector_set));
   }
 #endif  // TES_ENABLE
 
@@ -642,6 +664,22 @@ size_t RayMapperTrace::integrateRays(const glm::dvec3 *rays, size_t element_coun
 }
 
 
+size_t RayMapperTrace::skippedKeyCount() const
+{
+  return skipped_key_count_ + imp_->skippedKeyCount();
+}
+
+
+void RayMapperTrace::noteSkippedKeys(size_t count)
+{
+  if (count && skipped_key_count_ == 0)
+  {
+    std::cerr << "RayMapperTrace: voxel keys beyond the packed key range are not traced" << std::endl;
+  }
+  skipped_key_count_ += count;
+}
+
+
 glm::i16vec4 RayMapperTrace::sectorKey(const Key &key) const
 {
   // We divide the MapChunk into 8 sectors, like a voxel. We need to convert the local key into a sector index
@@ -658,9 +696,10 @@ glm::i16vec4 RayMapperTrace::sectorKey(const Key &key) const
 }
 
 
-void RayMapperTrace::cacheState(const glm::dvec3 *rays, size_t element_count, VoxelMap *voxels, SectorSet *sectors)
+size_t RayMapperTrace::cacheState(const glm::dvec3 *rays, size_t element_count, VoxelMap *voxels, SectorSet *sectors)
 {
   KeyList keys;
+  size_t skipped_count = 0;
 
   // Setup voxel references
   Voxel<const float> occupancy_voxel(map_, map_->layout().occupancyLayer());
@@ -680,7 +719,15 @@ void RayMapperTrace::cacheState(const glm::dvec3 *rays, size_t element_count, Vo
         sectors->insert(sectorKey(key));
       }
 
-      if (voxels->find(key) == voxels->end())
+      if (!key_codec_.canPack(key))
+      {
+        // Beyond the packed key range. Not traced.
+        ++skipped_count;
+        continue;
+      }
+
+      const PackedKey packed_key = key_codec_.pack(key);
+      if (voxels->find(packed_key) == voxels->end())
       {
         // not already in the set.
         setVoxelKey(key, occupancy_voxel, mean_voxel, covariance_voxel);
@@ -697,9 +744,11 @@ void RayMapperTrace::cacheState(const glm::dvec3 *rays, size_t element_count, Vo
           covarianceUnitSphereTransformation(&cov, &voxel_info.ellipse_rotation, &voxel_info.ellipse_scale);
         }
 
-        voxels->insert(std::make_pair(key, voxel_info));
+        voxels->insert(std::make_pair(packed_key, voxel_info));
       }
     }
   }
+
+  return skipped_count;
 }
 }  // namespace ohm
@@ -10,6 +10,7 @@
 
 #include "Key.h"
 #include "OccupancyType.h"
+#include "PackedKey.h"
 #include "RayMapper.h"
 
 #include <ohmutil/VectorHash.h>
@@ -34,6 +35,11 @@ class OccupancyMesh;
 ///
 /// The visualisation shows rays being integrated, occupied voxels and NDT ellipsoids if present.
 ///
+/// Voxel state is tracked using @c PackedKey values. Voxels beyond the @c PackedKeyCodec range of the map - possible
+/// with regions with more than 32 voxels along an axis or 32-bit region coordinates (see
+/// @c PackedKeyCodec::isLossless() ) - cannot be traced. These are counted in @c skippedKeyCount() and a warning is
+/// logged the first time ray keys are skipped.
+///
 /// See https://github.com/csiro-robotics/3rdEyeScene
 class ohm_API RayMapperTrace : public RayMapper
 {
@@ -60,8 +66,8 @@ public:
     }
   };
 
-  /// Set for tracking voxel state.
-  using VoxelMap = std::unordered_map<Key, VoxelState, Key::Hash>;
+  /// Set for tracking voxel state. Keyed by @c PackedKey to reduce the memory and hashing overhead of large ray sets.
+  using VoxelMap = std::unordered_map<PackedKey, VoxelState, PackedKey::Hash>;
   /// Tracks touched voxels for NDT sending. We use the region key for XYZ and a W component [0, 7] which identifies
   /// a sector in the region. Each of the first 3 bits selects the lower or upper half of the region with bits
   /// (0, 1, 2) mapping to the (x, y, z) axes.
@@ -105,16 +111,28 @@ public:
   /// @param ray_update_flags @c RayFlag bitset used to modify the behaviour of this function.
   size_t integrateRays(const glm::dvec3 *rays, size_t element_count, unsigned ray_update_flags) override;
 
+  /// Query the number of voxel keys which have not been traced because they are beyond the packed key range of the
+  /// map. Always zero when the map keys are losslessly packable - see @c PackedKeyCodec::isLossless() .
+  /// @return The number of voxel keys skipped by the trace.
+  size_t skippedKeyCount() const;
+
 private:
   /// Work out the sector key associated with @p key . See @c SectorSet .
   /// @param key The voxel key to translate.
   glm::i16vec4 sectorKey(const Key &key) const;
 
   /// Cache the initial state of voxels affected by the given @p ray set.
-  void cacheState(const glm::dvec3 *rays, size_t element_count, VoxelMap *voxels, SectorSet *sectors = nullptr);
+  /// @return The number of voxel keys skipped because they cannot be packed.
+  size_t cacheState(const glm::dvec3 *rays, size_t element_count, VoxelMap *voxels, SectorSet *sectors = nullptr);
+
+  /// Add @p count to the @c skippedKeyCount() , logging a warning on the first skipped key.
+  /// @param count The number of keys skipped.
+  void noteSkippedKeys(size_t count);
 
   OccupancyMap *map_;
   RayMapper *true_mapper_;
+  PackedKeyCodec key_codec_;
+  size_t skipped_key_count_ = 0;
   std::unique_ptr<OccupancyMesh> imp_;
 };
 }  // namespace ohm
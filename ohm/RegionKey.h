@@ -0,0 +1,40 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONKEY_H
+#define OHM_REGIONKEY_H
+
+#include "OhmConfig.h"
+
+#include <glm/glm.hpp>
+
+#include <cinttypes>
+
+namespace ohm
+{
+#ifdef OHM_REGION_COORD_32
+/// Scalar type used for region key coordinates. See @c RegionKey .
+using RegionCoord = int32_t;
+/// Type used to address a region in an @c OccupancyMap . This is the region part of a @c Key and is the key type for
+/// region lookup.
+///
+/// Region coordinates are 16-bit by default, limiting the spatial range of a map to
+/// ~`2^15 * regionVoxelDimensions() * resolution()` along each axis. Building with the CMake option
+/// @c OHM_REGION_COORD_32 widens the coordinates to 32-bit for very large maps at the cost of a larger @c Key .
+using RegionKey = glm::i32vec3;
+#else   // OHM_REGION_COORD_32
+/// Scalar type used for region key coordinates. See @c RegionKey .
+using RegionCoord = int16_t;
+/// Type used to address a region in an @c OccupancyMap . This is the region part of a @c Key and is the key type for
+/// region lookup.
+///
+/// Region coordinates are 16-bit by default, limiting the spatial range of a map to
+/// ~`2^15 * regionVoxelDimensions() * resolution()` along each axis. Building with the CMake option
+/// @c OHM_REGION_COORD_32 widens the coordinates to 32-bit for very large maps at the cost of a larger @c Key .
+using RegionKey = glm::i16vec3;
+#endif  // OHM_REGION_COORD_32
+}  // namespace ohm
+
+#endif  // OHM_REGIONKEY_H
@@ -0,0 +1,492 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RegionPrefetcher.h"
+
+#include "MapChunk.h"
+#include "MapRegion.h"
+#include "OccupancyMap.h"
+#include "VoxelBlock.h"
+
+#include "private/OccupancyMapDetail.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ohm
+{
+/// Pimpl data for @c RegionPrefetcher .
+struct RegionPrefetcherDetail
+{
+  using Clock = std::chrono::steady_clock;
+
+  /// A region held by the prefetcher.
+  struct Hold
+  {
+    /// Retained blocks for the region.
+    std::vector<VoxelBlock *> blocks;
+    /// Last time the region was part of the predicted set.
+    Clock::time_point last_wanted;
+    /// Has the region been observed by @c RegionPrefetcher::observeRays() while held?
+    bool observed = false;
+  };
+
+  const OccupancyMap *map = nullptr;
+  /// Guards all members below.
+  mutable std::mutex mutex;
+  /// Wakes the background thread.
+  std::condition_variable work_cv;
+  /// Signalled when the background thread becomes idle.
+  std::condition_variable idle_cv;
+  /// Regions pending prefetch, in priority order.
+  std::deque<RegionKey> queue;
+  /// Regions currently held.
+  std::unordered_map<RegionKey, Hold, MapRegion::Hash> held;
+  std::thread thread;
+  /// Incremented by @c releaseAll() so the background thread can discard an in flight prefetch.
+  unsigned release_generation = 0;
+  bool quit = false;
+  /// True while the background thread is retaining a region outside the lock.
+  bool busy = false;
+
+  double lookahead = RegionPrefetcher::kDefaultLookahead;
+  double sensor_range = RegionPrefetcher::kDefaultSensorRange;
+  double hold_time = RegionPrefetcher::kDefaultHoldTime;
+  size_t capacity = RegionPrefetcher::kDefaultCapacity;
+
+  glm::dvec3 last_position{ 0.0 };
+  double last_timestamp = 0;
+  bool have_last = false;
+
+  RegionPrefetcher::Stats stats;
+
+  /// Release the blocks of @p hold , counting waste. Must be called with the @c mutex locked.
+  void release(Hold &hold)
+  {
+    for (VoxelBlock *block : hold.blocks)
+    {
+      block->release();
+    }
+    hold.blocks.clear();
+    if (!hold.observed)
+    {
+      ++stats.waste;
+    }
+  }
+
+  /// Release held regions which have not been predicted within the hold time. Must be called with the @c mutex
+  /// locked.
+  void expire()
+  {
+    const auto now = Clock::now();
+    const auto hold_duration = std::chrono::duration<double>(hold_time);
+    for (auto iter = held.begin(); iter != held.end();)
+    {
+      if (now - iter->second.last_wanted > hold_duration)
+      {
+        release(iter->second);
+        iter = held.erase(iter);
+      }
+      else
+      {
+        ++iter;
+      }
+    }
+  }
+
+  void run();
+};
+
+
+namespace
+{
+/// Reference the initialised voxel blocks of the region at @p region_key under the map lock. The references keep the
+/// blocks valid should the region be removed from the map before they are released.
+void referenceRegion(const OccupancyMap &map, const RegionKey &region_key, std::vector<VoxelBlock *> &blocks)
+{
+  const OccupancyMapDetail &map_data = *map.detail();
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  const auto search = map_data.chunks.find(region_key);
+  if (search == map_data.chunks.end())
+  {
+    return;
+  }
+
+  for (const VoxelBlock::Ptr &block : search->second->voxel_blocks)
+  {
+    // Do not force allocation of uninitialised blocks.
+    if (block && !block->isUninitialised())
+    {
+      block->addReference();
+      blocks.emplace_back(block.get());
+    }
+  }
+}
+
+
+/// Retain the referenced @p blocks , decompressing as required, in place of the references.
+void retainBlocks(const std::vector<VoxelBlock *> &blocks)
+{
+  for (VoxelBlock *block : blocks)
+  {
+    block->retain();
+    block->release();
+  }
+}
+
+
+/// Check if the region at @p region_key has compressed voxel memory.
+bool isRegionCompressed(const OccupancyMap &map, const RegionKey &region_key)
+{
+  const OccupancyMapDetail &map_data = *map.detail();
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  const auto search = map_data.chunks.find(region_key);
+  if (search != map_data.chunks.end())
+  {
+    for (const VoxelBlock::Ptr &block : search->second->voxel_blocks)
+    {
+      if (block && block->isCompressed())
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+}  // namespace
+
+
+void RegionPrefetcherDetail::run()
+{
+  const auto idle_interval = std::chrono::milliseconds(100);
+  std::unique_lock<std::mutex> guard(mutex);
+  while (!quit)
+  {
+    expire();
+
+    if (queue.empty())
+    {
+      idle_cv.notify_all();
+      work_cv.wait_for(guard, idle_interval);
+      continue;
+    }
+
+    const RegionKey region_key = queue.front();
+    queue.pop_front();
+
+    if (held.find(region_key) != held.end() || held.size() >= capacity)
+    {
+      continue;
+    }
+
+    // Retain outside the lock; decompression is the expensive part. The blocks are referenced under the map lock
+    // first so they remain valid should the region be removed meanwhile.
+    const unsigned generation = release_generation;
+    std::vector<VoxelBlock *> blocks;
+    busy = true;
+    guard.unlock();
+    referenceRegion(*map, region_key, blocks);
+    retainBlocks(blocks);
+    guard.lock();
+    busy = false;
+
+    if (blocks.empty())
+    {
+      continue;
+    }
+
+    Hold hold;
+    hold.blocks = std::move(blocks);
+    if (generation != release_generation || quit)
+    {
+      // Cancelled by releaseAll().
+      hold.observed = true;
+      release(hold);
+      continue;
+    }
+
+    hold.last_wanted = Clock::now();
+    held.emplace(region_key, std::move(hold));
+    ++stats.prefetched;
+  }
+
+  idle_cv.notify_all();
+}
+
+
+RegionPrefetcher::RegionPrefetcher(const OccupancyMap &map)
+  : imp_(new RegionPrefetcherDetail)
+{
+  imp_->map = &map;
+  imp_->thread = std::thread([this]() { imp_->run(); });
+}
+
+
+RegionPrefetcher::~RegionPrefetcher()
+{
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    imp_->quit = true;
+  }
+  imp_->work_cv.notify_all();
+  imp_->thread.join();
+  releaseAll();
+}
+
+
+void RegionPrefetcher::setLookahead(double seconds)
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->lookahead = std::max(seconds, 0.0);
+}
+
+
+double RegionPrefetcher::lookahead() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->lookahead;
+}
+
+
+void RegionPrefetcher::setSensorRange(double range)
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->sensor_range = std::max(range, 0.0);
+}
+
+
+double RegionPrefetcher::sensorRange() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->sensor_range;
+}
+
+
+void RegionPrefetcher::setHoldTime(double seconds)
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->hold_time = std::max(seconds, 0.0);
+}
+
+
+double RegionPrefetcher::holdTime() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->hold_time;
+}
+
+
+void RegionPrefetcher::setCapacity(size_t max_regions)
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->capacity = max_regions;
+}
+
+
+size_t RegionPrefetcher::capacity() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->capacity;
+}
+
+
+void RegionPrefetcher::update(const glm::dvec3 &position, const glm::dvec3 &velocity, double timestamp)
+{
+  double lookahead = 0;
+  double sensor_range = 0;
+  size_t capacity = 0;
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    lookahead = imp_->lookahead;
+    sensor_range = imp_->sensor_range;
+    capacity = imp_->capacity;
+  }
+
+  // Sample the extrapolated path at half region intervals, nearest first, collecting the regions within sensor range
+  // of each sample.
+  const OccupancyMap &map = *imp_->map;
+  const glm::dvec3 region_extents = map.regionSpatialResolution();
+  const double region_radius = 0.5 * glm::length(region_extents);
+  const double step_length = 0.5 * std::min(region_extents.x, std::min(region_extents.y, region_extents.z));
+  const double path_length = glm::length(velocity) * lookahead;
+  const unsigned kMaxSteps = 256u;
+  const unsigned steps = std::min(unsigned(std::ceil(path_length / step_length)), kMaxSteps);
+
+  std::vector<RegionKey> predicted;
+  std::unordered_set<RegionKey, MapRegion::Hash> visited;
+  for (unsigned s = 0; s <= steps && predicted.size() < capacity; ++s)
+  {
+    const glm::dvec3 sample = (steps) ? position + velocity * (lookahead * double(s) / double(steps)) : position;
+    const glm::ivec3 min_key(map.regionKey(sample - glm::dvec3(sensor_range)));
+    const glm::ivec3 max_key(map.regionKey(sample + glm::dvec3(sensor_range)));
+    for (int z = min_key.z; z <= max_key.z && predicted.size() < capacity; ++z)
+    {
+      for (int y = min_key.y; y <= max_key.y && predicted.size() < capacity; ++y)
+      {
+        for (int x = min_key.x; x <= max_key.x && predicted.size() < capacity; ++x)
+        {
+          const RegionKey region_key(x, y, z);
+          if (visited.insert(region_key).second &&
+              glm::length(map.regionCentreGlobal(region_key) - sample) <= sensor_range + region_radius)
+          {
+            predicted.emplace_back(region_key);
+          }
+        }
+      }
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    imp_->last_position = position;
+    imp_->last_timestamp = timestamp;
+    imp_->have_last = true;
+
+    const auto now = RegionPrefetcherDetail::Clock::now();
+    imp_->queue.clear();
+    for (const RegionKey &region_key : predicted)
+    {
+      auto held = imp_->held.find(region_key);
+      if (held != imp_->held.end())
+      {
+        held->second.last_wanted = now;
+      }
+      else
+      {
+        imp_->queue.emplace_back(region_key);
+      }
+    }
+  }
+  imp_->work_cv.notify_one();
+}
+
+
+void RegionPrefetcher::update(const glm::dvec3 &position, double timestamp)
+{
+  glm::dvec3 velocity(0.0);
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    if (imp_->have_last && timestamp > imp_->last_timestamp)
+    {
+      velocity = (position - imp_->last_position) / (timestamp - imp_->last_timestamp);
+    }
+  }
+  update(position, velocity, timestamp);
+}
+
+
+void RegionPrefetcher::observeRays(const glm::dvec3 *rays, size_t element_count, double timestamp)
+{
+  if (element_count < 2)
+  {
+    return;
+  }
+
+  const OccupancyMap &map = *imp_->map;
+  glm::dvec3 origin_sum(0.0);
+  std::unordered_set<RegionKey, MapRegion::Hash> sample_regions;
+  for (size_t i = 0; i + 1 < element_count; i += 2)
+  {
+    origin_sum += rays[i];
+    sample_regions.insert(map.regionKey(rays[i + 1]));
+  }
+
+  // Classify held regions under lock, then check the remaining regions for compressed data outside the lock.
+  std::vector<RegionKey> unheld;
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    const auto now = RegionPrefetcherDetail::Clock::now();
+    for (const RegionKey &region_key : sample_regions)
+    {
+      auto held = imp_->held.find(region_key);
+      if (held != imp_->held.end())
+      {
+        held->second.last_wanted = now;
+        if (!held->second.observed)
+        {
+          // Count each prefetched region once, comparable with the prefetched count.
+          held->second.observed = true;
+          ++imp_->stats.hits;
+        }
+      }
+      else
+      {
+        unheld.emplace_back(region_key);
+      }
+    }
+  }
+
+  uint64_t misses = 0;
+  for (const RegionKey &region_key : unheld)
+  {
+    if (isRegionCompressed(map, region_key))
+    {
+      ++misses;
+    }
+  }
+
+  if (misses)
+  {
+    std::unique_lock<std::mutex> guard(imp_->mutex);
+    imp_->stats.misses += misses;
+  }
+
+  update(origin_sum / double(element_count / 2), timestamp);
+}
+
+
+void RegionPrefetcher::wait()
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->work_cv.notify_one();
+  imp_->idle_cv.wait(guard, [this]() { return (imp_->queue.empty() && !imp_->busy) || imp_->quit; });
+}
+
+
+void RegionPrefetcher::releaseAll()
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->queue.clear();
+  ++imp_->release_generation;
+  // Wait for any in flight prefetch so no region remains retained on return.
+  imp_->idle_cv.wait(guard, [this]() { return !imp_->busy; });
+  for (auto &held : imp_->held)
+  {
+    imp_->release(held.second);
+  }
+  imp_->held.clear();
+}
+
+
+size_t RegionPrefetcher::heldRegionCount() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->held.size();
+}
+
+
+RegionPrefetcher::Stats RegionPrefetcher::stats() const
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  return imp_->stats;
+}
+
+
+void RegionPrefetcher::resetStats()
+{
+  std::unique_lock<std::mutex> guard(imp_->mutex);
+  imp_->stats = Stats();
+}
+}  // namespace ohm
@@ -0,0 +1,159 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONPREFETCHER_H
+#define OHM_REGIONPREFETCHER_H
+
+#include "OhmConfig.h"
+
+#include <glm/fwd.hpp>
+
+#include <memory>
+
+namespace ohm
+{
+class OccupancyMap;
+struct RegionPrefetcherDetail;
+
+/// Predicts which map regions a moving sensor is about to observe and decompresses their @c VoxelBlock data on a
+/// background thread ahead of ray integration.
+///
+/// With voxel compression enabled, regions the sensor has moved away from are compressed by the background
+/// compression thread. When the sensor returns, the first @c VoxelBlock::retain() on the ingestion path blocks while
+/// the region is inflated. The prefetcher extrapolates the sensor position along its velocity over the
+/// @c lookahead() period and retains the existing regions within @c sensorRange() of that path on its own thread.
+/// Retained blocks are uncompressed and cannot be recompressed, so ingestion finds them ready. A prefetched region is
+/// held until it has dropped out of the predicted set for @c holdTime() seconds.
+///
+/// The sensor motion is supplied either via @c update() or by passing each ray batch to @c observeRays() before it
+/// is integrated. @c observeRays() estimates the sensor position from the batch origins and the velocity from
+/// successive batches. It also maintains the @c Stats counters by classifying the regions containing the batch
+/// sample points:
+/// - a hit is a prefetched region observed while held. Each prefetched region counts at most one hit.
+/// - a miss is a region which was not held and had compressed voxel memory, so ingestion would block to inflate it.
+/// - waste is a prefetched region released without having been observed.
+///
+/// The prefetcher only retains regions which already exist; it does not create regions nor allocate uninitialised
+/// @c VoxelBlock memory.
+///
+/// The prefetcher holds references to the @c VoxelBlock objects of the held regions. Regions may be removed from the
+/// map, or the map layout changed, while held: removed blocks remain valid until the prefetcher releases them and are
+/// deleted then. Call @c releaseAll() to free such blocks immediately. The prefetcher must be destroyed before the map.
+///
+/// Usage:
+/// @code
+/// ohm::RegionPrefetcher prefetcher(map);
+/// prefetcher.setSensorRange(max_range);
+/// while (mapping)
+/// {
+///   prefetcher.observeRays(rays.data(), rays.size(), timestamp);
+///   mapper.integrateRays(rays.data(), unsigned(rays.size()));
+/// }
+/// @endcode
+class ohm_API RegionPrefetcher
+{
+public:
+  /// Prefetch statistics. Counts are in regions.
+  struct Stats
+  {
+    /// Number of regions prefetched.
+    uint64_t prefetched = 0;
+    /// Number of prefetched regions which were observed while held.
+    uint64_t hits = 0;
+    /// Number of observed regions which were compressed and not held by the prefetcher.
+    uint64_t misses = 0;
+    /// Number of prefetched regions released without being observed.
+    uint64_t waste = 0;
+  };
+
+  /// Default prediction lookahead (seconds).
+  static constexpr double kDefaultLookahead = 1.0;
+  /// Default sensor range (metres).
+  static constexpr double kDefaultSensorRange = 10.0;
+  /// Default hold time (seconds).
+  static constexpr double kDefaultHoldTime = 2.0;
+  /// Default maximum number of held regions.
+  static constexpr size_t kDefaultCapacity = 1024u;
+
+  /// Create a prefetcher for @p map and start the background thread.
+  /// @param map The map to prefetch regions of. Must outlive the prefetcher.
+  explicit RegionPrefetcher(const OccupancyMap &map);
+
+  /// Destructor: stops the background thread and releases all held regions.
+  ~RegionPrefetcher();
+
+  /// Set the time period over which the sensor motion is extrapolated.
+  /// @param seconds The lookahead period.
+  void setLookahead(double seconds);
+  /// Query the motion extrapolation period.
+  /// @return The lookahead period (seconds).
+  double lookahead() const;
+
+  /// Set the sensor range. Regions within this distance of the predicted path are prefetched.
+  /// @param range The sensor range.
+  void setSensorRange(double range);
+  /// Query the sensor range.
+  /// @return The sensor range.
+  double sensorRange() const;
+
+  /// Set the time for which a prefetched region is held once it is no longer predicted.
+  /// @param seconds The hold time.
+  void setHoldTime(double seconds);
+  /// Query the hold time.
+  /// @return The hold time (seconds).
+  double holdTime() const;
+
+  /// Set the maximum number of regions which may be held at any time. Bounds the uncompressed memory pinned by the
+  /// prefetcher.
+  /// @param max_regions The region capacity.
+  void setCapacity(size_t max_regions);
+  /// Query the maximum number of held regions.
+  /// @return The region capacity.
+  size_t capacity() const;
+
+  /// Update the sensor pose and velocity and queue the predicted regions for prefetch. Replaces any outstanding
+  /// prefetch requests.
+  /// @param position The current sensor position.
+  /// @param velocity The current sensor velocity.
+  /// @param timestamp The time of @p position (seconds).
+  void update(const glm::dvec3 &position, const glm::dvec3 &velocity, double timestamp);
+
+  /// @overload
+  /// Estimates the velocity from the previous @c update() position and time.
+  void update(const glm::dvec3 &position, double timestamp);
+
+  /// Observe a ray batch about to be integrated into the map. Updates the hit and miss counters for the regions
+  /// containing the sample points, then calls @c update() with the mean ray origin.
+  ///
+  /// Only the sample point regions are classified; regions traversed by the rays are not.
+  ///
+  /// @param rays Origin/sample point pairs as passed to @c RayMapper::integrateRays() .
+  /// @param element_count The number of points in @p rays . Twice the ray count.
+  /// @param timestamp The time of the ray batch (seconds).
+  void observeRays(const glm::dvec3 *rays, size_t element_count, double timestamp);
+
+  /// Block until all outstanding prefetch requests have been processed.
+  void wait();
+
+  /// Cancel outstanding prefetch requests and release all held regions.
+  void releaseAll();
+
+  /// Query the number of regions currently held.
+  /// @return The held region count.
+  size_t heldRegionCount() const;
+
+  /// Query the prefetch statistics.
+  /// @return The current statistics.
+  Stats stats() const;
+
+  /// Reset the prefetch statistics to zero.
+  void resetStats();
+
+private:
+  std::unique_ptr<RegionPrefetcherDetail> imp_;
+};
+}  // namespace ohm
+
+#endif  // OHM_REGIONPREFETCHER_H
@@ -0,0 +1,89 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RegionVisit.h"
+
+#include "OccupancyMap.h"
+
+#include "private/OccupancyMapDetail.h"
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+/// Take a snapshot of the map regions, sorted by region coordinate for a deterministic visiting order.
+std::vector<const MapChunk *> collectRegions(const OccupancyMapDetail &map)
+{
+  std::vector<const MapChunk *> regions;
+  {
+    std::unique_lock<decltype(map.mutex)> guard(map.mutex);
+    regions.reserve(map.chunks.size());
+    for (const auto &chunk_ref : map.chunks)
+    {
+      regions.emplace_back(chunk_ref.second);
+    }
+  }
+
+  std::sort(regions.begin(), regions.end(), [](const MapChunk *a, const MapChunk *b) {
+    const RegionKey &ra = a->region.coord;
+    const RegionKey &rb = b->region.coord;
+    return ra.z < rb.z || (ra.z == rb.z && (ra.y < rb.y || (ra.y == rb.y && ra.x < rb.x)));
+  });
+
+  return regions;
+}
+}  // namespace
+
+
+size_t visitRegions(const OccupancyMap &map, const RegionVisitFunction &visit, bool parallel)
+{
+  const std::vector<const MapChunk *> regions = collectRegions(*map.detail());
+
+#ifdef OHM_THREADS
+  if (parallel)
+  {
+    const auto parallel_visit = [&regions, &visit](const tbb::blocked_range<size_t> &range) {
+      for (size_t i = range.begin(); i < range.end(); ++i)
+      {
+        visit(*regions[i], i);
+      }
+    };
+    tbb::parallel_for(tbb::blocked_range<size_t>(0u, regions.size()), parallel_visit);
+    return regions.size();
+  }
+#else   // OHM_THREADS
+  (void)parallel;
+#endif  // OHM_THREADS
+
+  for (size_t i = 0; i < regions.size(); ++i)
+  {
+    visit(*regions[i], i);
+  }
+
+  return regions.size();
+}
+
+
+size_t visitObservedVoxels(const OccupancyMap &map, const ObservedVoxelVisitFunction &visit, bool parallel)
+{
+  const glm::ivec3 region_voxel_dimensions = map.detail()->region_voxel_dimensions;
+  return visitRegions(
+    map,
+    [&visit, &region_voxel_dimensions](const MapChunk &chunk, size_t region_index) {
+      visitObserved(chunk, [&](unsigned voxel_index) {
+        visit(chunk, region_index, voxel_index, chunk.keyForIndex(voxel_index, region_voxel_dimensions));
+      });
+    },
+    parallel);
+}
+}  // namespace ohm
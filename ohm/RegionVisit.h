@@ -0,0 +1,96 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONVISIT_H
+#define OHM_REGIONVISIT_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+#include "MapChunk.h"
+
+#include <functional>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// @defgroup regionvisit Region Visitor Functions
+/// These functions support bulk, read only processing of an @c OccupancyMap one region at a time, optionally in
+/// parallel. They are intended for export and analysis code which would otherwise use the @c OccupancyMap::iterator
+/// to touch every voxel in the map.
+///
+/// The visitor functions take a snapshot of the map regions, sorted by region coordinate, then invoke the visit
+/// function for each region. Each region is visited exactly once and by only one thread, so per region data may be
+/// safely written to an array indexed by the given @c region_index . The visit function must otherwise be thread safe
+/// when parallel visiting is requested.
+///
+/// The map must not have regions added or removed during the visit.
+
+/// Function signature used to visit map regions in @c visitRegions() .
+///
+/// The arguments are the @c MapChunk being visited and a zero based index of the region in the visiting order. The
+/// @c region_index is in the range <tt>[0, region_count)</tt> where @c region_count is the value returned from
+/// @c visitRegions() - equivalent to @c OccupancyMap::regionCount() .
+using RegionVisitFunction = std::function<void(const MapChunk &chunk, size_t region_index)>;
+
+/// Function signature used to visit observed voxels in @c visitObservedVoxels() .
+///
+/// The arguments are the containing @c MapChunk , the index of the region in the visiting order (see
+/// @c RegionVisitFunction ), the voxel linear index in the chunk and the voxel @c Key .
+using ObservedVoxelVisitFunction =
+  std::function<void(const MapChunk &chunk, size_t region_index, unsigned voxel_index, const Key &key)>;
+
+/// @ingroup regionvisit
+/// Visit each region in @p map , invoking @p visit for each. Regions are visited in parallel when @p parallel is
+/// @c true and ohm has been built with threading support (@c OHM_THREADS ), otherwise they are visited serially in
+/// region coordinate order.
+///
+/// @param map The map to visit.
+/// @param visit The function to invoke for each region.
+/// @param parallel True to allow parallel visiting.
+/// @return The number of regions visited.
+size_t ohm_API visitRegions(const OccupancyMap &map, const RegionVisitFunction &visit, bool parallel = true);
+
+/// @ingroup regionvisit
+/// Visit each observed voxel in @p map , invoking @p visit for each. This skips unobserved voxels and regions with no
+/// observed voxels using the @c MapChunk::observed_mask . Parallelism is as for @c visitRegions() , with all voxels
+/// in a region visited by the same thread in increasing voxel index order.
+///
+/// @param map The map to visit.
+/// @param visit The function to invoke for each observed voxel.
+/// @param parallel True to allow parallel visiting.
+/// @return The number of regions visited.
+size_t ohm_API visitObservedVoxels(const OccupancyMap &map, const ObservedVoxelVisitFunction &visit,
+                                   bool parallel = true);
+
+/// @ingroup regionvisit
+/// Invoke @p func for each observed voxel in @p chunk , passing the linear voxel index. This updates the
+/// @c MapChunk::observed_mask as required.
+///
+/// This template is intended for use inside a @c RegionVisitFunction and avoids the @c std::function overhead of
+/// @c visitObservedVoxels() .
+///
+/// @param chunk The region to visit.
+/// @param func The function to invoke. Must accept an @c unsigned voxel index argument.
+/// @return The number of observed voxels visited.
+template <typename Func>
+unsigned visitObserved(const MapChunk &chunk, Func &&func)
+{
+  unsigned visited = 0;
+  if (chunk.updateObservedMask())
+  {
+    for (unsigned voxel_index = chunk.nextObservedIndex(0); voxel_index != ~0u;
+         voxel_index = chunk.nextObservedIndex(voxel_index + 1))
+    {
+      func(voxel_index);
+      ++visited;
+    }
+  }
+  return visited;
+}
+}  // namespace ohm
+
+#endif  // OHM_REGIONVISIT_H
@@ -0,0 +1,317 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "SharedMapPublisher.h"
+
+#include "private/SharedMapDetail.h"
+
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "VoxelBuffer.h"
+
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace ohm
+{
+using namespace shared_map;
+
+/// Pimpl data for @c SharedMapPublisher .
+struct SharedMapPublisherDetail
+{
+  SharedSegment segment;
+  /// Publication generation in which each table entry was last seen in the map. Used to detect removed regions.
+  std::vector<uint64_t> seen_generation;
+  uint64_t generation = 0;
+
+  inline SharedMapHeader *header() const { return static_cast<SharedMapHeader *>(segment.memory); }
+};
+
+namespace
+{
+inline size_t alignSize(size_t size, size_t alignment)
+{
+  return (size + alignment - 1u) / alignment * alignment;
+}
+
+/// Resolve the most recent modification stamp for any layer of @p chunk .
+uint64_t chunkStamp(const MapChunk &chunk, unsigned layer_count)
+{
+  uint64_t stamp = chunk.dirty_stamp;
+  for (unsigned i = 0; i < layer_count; ++i)
+  {
+    stamp = std::max<uint64_t>(stamp, chunk.touched_stamps[i].load(std::memory_order_relaxed));
+  }
+  return stamp;
+}
+
+/// Begin a seqlock write to @p entry .
+inline void beginWrite(SharedRegionEntry &entry)
+{
+  entry.sequence.store(entry.sequence.load(std::memory_order_relaxed) + 1u, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+/// End a seqlock write to @p entry .
+inline void endWrite(SharedRegionEntry &entry)
+{
+  entry.sequence.store(entry.sequence.load(std::memory_order_relaxed) + 1u, std::memory_order_release);
+}
+}  // namespace
+
+
+SharedMapPublisher::SharedMapPublisher()
+  : imp_(new SharedMapPublisherDetail)
+{}
+
+
+SharedMapPublisher::~SharedMapPublisher()
+{
+  close();
+}
+
+
+bool SharedMapPublisher::create(const char *name, const OccupancyMap &map, size_t region_capacity)
+{
+  close();
+
+  const MapLayout &layout = map.layout();
+  if (layout.layerCount() > kMaxLayers || region_capacity == 0)
+  {
+    return false;
+  }
+
+  uint32_t capacity = 1u;
+  while (capacity < region_capacity)
+  {
+    capacity <<= 1u;
+  }
+
+  // Resolve the slot layout.
+  const glm::u8vec3 region_dim = map.regionVoxelDimensions();
+  SharedLayerInfo layers[kMaxLayers] = {};
+  size_t slot_size = 0;
+  for (unsigned i = 0; i < layout.layerCount(); ++i)
+  {
+    const MapLayer &layer = layout.layer(i);
+    strncpy(layers[i].name, layer.name(), kLayerNameLength - 1u);
+    layers[i].voxel_byte_size = uint32_t(layer.voxelByteSize());
+    layers[i].subsampling = layer.subsampling();
+    layers[i].byte_size = layer.layerByteSize(region_dim);
+    layers[i].slot_offset = slot_size;
+    slot_size = alignSize(slot_size + layers[i].byte_size, sizeof(uint64_t));
+  }
+
+  const size_t table_offset = alignSize(sizeof(SharedMapHeader), 64u);
+  const size_t data_offset = alignSize(table_offset + capacity * sizeof(SharedRegionEntry), 64u);
+  const size_t segment_size = data_offset + capacity * slot_size;
+
+  if (!createSegment(&imp_->segment, name, segment_size))
+  {
+    return false;
+  }
+
+  auto *header = new (imp_->segment.memory) SharedMapHeader();
+  header->segment_size = segment_size;
+  header->resolution = map.resolution();
+  header->origin[0] = map.origin().x;
+  header->origin[1] = map.origin().y;
+  header->origin[2] = map.origin().z;
+  header->region_dim[0] = region_dim.x;
+  header->region_dim[1] = region_dim.y;
+  header->region_dim[2] = region_dim.z;
+  header->occupancy_layer = layout.occupancyLayer();
+  header->occupancy_encoding =
+    uint8_t((layout.occupancyLayer() >= 0) ? occupancyEncoding(layout.layer(layout.occupancyLayer())) :
+                                              OccupancyEncoding::kFloat);
+  header->layer_count = layout.layerCount();
+  header->region_capacity = capacity;
+  header->slot_size = slot_size;
+  header->table_offset = table_offset;
+  header->data_offset = data_offset;
+  std::copy(layers, layers + kMaxLayers, header->layers);
+
+  SharedRegionEntry *table = regionTable(header);
+  for (uint32_t i = 0; i < capacity; ++i)
+  {
+    new (&table[i]) SharedRegionEntry();
+  }
+
+  imp_->seen_generation.clear();
+  imp_->seen_generation.resize(capacity, 0u);
+  imp_->generation = 0;
+
+  // Validate the header last. Readers check the magic value before anything else.
+  header->version = kVersion;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+
+  return true;
+}
+
+
+void SharedMapPublisher::close()
+{
+  closeSegment(&imp_->segment);
+  imp_->seen_generation.clear();
+}
+
+
+bool SharedMapPublisher::isOpen() const
+{
+  return imp_->segment.memory != nullptr;
+}
+
+
+const char *SharedMapPublisher::name() const
+{
+  return imp_->segment.name.c_str();
+}
+
+
+size_t SharedMapPublisher::regionCapacity() const
+{
+  return (isOpen()) ? imp_->header()->region_capacity : 0u;
+}
+
+
+bool SharedMapPublisher::publish(const OccupancyMap &map, size_t *published_count)
+{
+  if (published_count)
+  {
+    *published_count = 0;
+  }
+
+  if (!isOpen())
+  {
+    return false;
+  }
+
+  SharedMapHeader *header = imp_->header();
+  const MapLayout &layout = map.layout();
+
+  // Validate the layout against the segment.
+  if (layout.layerCount() != header->layer_count)
+  {
+    return false;
+  }
+  for (unsigned i = 0; i < layout.layerCount(); ++i)
+  {
+    if (layout.layer(i).voxelByteSize() != header->layers[i].voxel_byte_size ||
+        layout.layer(i).layerByteSize(map.regionVoxelDimensions()) != header->layers[i].byte_size)
+    {
+      return false;
+    }
+  }
+
+  const float threshold = map.occupancyThresholdValue();
+  uint32_t threshold_bits = 0;
+  memcpy(&threshold_bits, &threshold, sizeof(threshold_bits));
+  header->occupancy_threshold_bits.store(threshold_bits, std::memory_order_relaxed);
+
+  const uint64_t generation = ++imp_->generation;
+  SharedRegionEntry *table = regionTable(header);
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+
+  // Mark the entries of regions still in the map, then remove the others before inserting new regions so the
+  // removed entries may be reused.
+  for (const MapChunk *chunk : chunks)
+  {
+    const int32_t coord[3] = { int32_t(chunk->region.coord.x), int32_t(chunk->region.coord.y),
+                               int32_t(chunk->region.coord.z) };
+    const int64_t found = findRegion(header, coord);
+    if (found >= 0 && table[found].state.load(std::memory_order_relaxed) == kEntryValid)
+    {
+      imp_->seen_generation[size_t(found)] = generation;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->region_capacity; ++i)
+  {
+    SharedRegionEntry &entry = table[i];
+    if (entry.state.load(std::memory_order_relaxed) == kEntryValid && imp_->seen_generation[i] != generation)
+    {
+      beginWrite(entry);
+      entry.state.store(kEntryRemoved, std::memory_order_relaxed);
+      endWrite(entry);
+      header->region_count.fetch_sub(1u, std::memory_order_relaxed);
+    }
+  }
+
+  size_t published = 0;
+  bool table_full = false;
+  for (const MapChunk *chunk : chunks)
+  {
+    const int32_t coord[3] = { int32_t(chunk->region.coord.x), int32_t(chunk->region.coord.y),
+                               int32_t(chunk->region.coord.z) };
+    size_t insert_index = 0;
+    int64_t found = findRegion(header, coord, &insert_index);
+    if (found < 0)
+    {
+      if (insert_index >= header->region_capacity)
+      {
+        table_full = true;
+        continue;
+      }
+      found = int64_t(insert_index);
+    }
+
+    const size_t index = size_t(found);
+    SharedRegionEntry &entry = table[index];
+    imp_->seen_generation[index] = generation;
+
+    const uint32_t state = entry.state.load(std::memory_order_relaxed);
+    const uint64_t stamp = chunkStamp(*chunk, header->layer_count);
+    if (state == kEntryValid && entry.stamp == stamp)
+    {
+      // Unchanged.
+      continue;
+    }
+
+    beginWrite(entry);
+    if (state != kEntryValid)
+    {
+      // New or reused entry. Readers validate the coordinate within the seqlock.
+      entry.coord[0] = coord[0];
+      entry.coord[1] = coord[1];
+      entry.coord[2] = coord[2];
+    }
+
+    uint8_t *slot = regionSlot(header, index);
+    for (unsigned i = 0; i < header->layer_count; ++i)
+    {
+      VoxelBuffer<const VoxelBlock> voxels(chunk->voxel_blocks[i]);
+      memcpy(slot + header->layers[i].slot_offset, voxels.voxelMemory(),
+             std::min<size_t>(header->layers[i].byte_size, voxels.voxelMemorySize()));
+    }
+    entry.stamp = stamp;
+    entry.touched_time = chunk->touched_time;
+
+    if (state != kEntryValid)
+    {
+      header->region_count.fetch_add(1u, std::memory_order_relaxed);
+      // Release ensures the coordinate is visible to readers probing the table.
+      entry.state.store(kEntryValid, std::memory_order_release);
+    }
+    endWrite(entry);
+    ++published;
+  }
+
+  header->publish_stamp.fetch_add(1u, std::memory_order_release);
+  if (published_count)
+  {
+    *published_count = published;
+  }
+  return !table_full;
+}
+}  // namespace ohm
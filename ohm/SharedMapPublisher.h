@@ -0,0 +1,88 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_SHAREDMAPPUBLISHER_H
+#define OHM_SHAREDMAPPUBLISHER_H
+
+#include "OhmConfig.h"
+
+#include <memory>
+
+namespace ohm
+{
+class OccupancyMap;
+struct SharedMapPublisherDetail;
+
+/// Publishes the regions of an @c OccupancyMap into a named shared memory segment for zero copy access by
+/// @c SharedMapView objects in other processes.
+///
+/// The segment holds a region table and a fixed size data slot per region containing the voxel memory for every
+/// layer in the map layout. Publication is incremental: @c publish() only copies regions which have changed since
+/// they were last published, and marks regions which have been removed from the map. Each region is protected by a
+/// seqlock, so readers never block the publisher and always observe a consistent copy of each region. Consistency
+/// is per region: a reader may see some regions from one publication and others from the next.
+///
+/// The segment size is fixed on @c create() by the region capacity. Entries of removed regions are reused for new
+/// regions. Regions beyond the capacity are not published and @c publish() reports failure.
+/// The map layout must not change after @c create() .
+///
+/// Shared memory publication is only supported on POSIX platforms. @c create() fails elsewhere.
+///
+/// Usage:
+/// @code
+/// ohm::SharedMapPublisher publisher;
+/// publisher.create("ohm_map", map, 4096);
+/// while (mapping)
+/// {
+///   // ... integrate rays into map ...
+///   publisher.publish(map);
+/// }
+/// @endcode
+class ohm_API SharedMapPublisher
+{
+public:
+  /// Create an unopened publisher.
+  SharedMapPublisher();
+  /// Destructor: closes and unlinks the segment.
+  ~SharedMapPublisher();
+
+  /// Create the named segment for publishing @p map . Any existing segment of the same name is replaced.
+  /// @param name The segment name.
+  /// @param map The map to publish. Sets the resolution, origin, region dimensions and layout of the segment.
+  /// @param region_capacity The maximum number of regions which may be published. Rounded up to a power of two.
+  /// @return True on success.
+  bool create(const char *name, const OccupancyMap &map, size_t region_capacity);
+
+  /// Close and unlink the segment. Attached readers retain their mapping until they close.
+  void close();
+
+  /// Is the segment open?
+  /// @return True if open.
+  bool isOpen() const;
+
+  /// Query the segment name.
+  /// @return The segment name, including the leading '/'.
+  const char *name() const;
+
+  /// Query the region capacity of the segment.
+  /// @return The number of regions which may be published.
+  size_t regionCapacity() const;
+
+  /// Publish changes in @p map . Only regions modified since they were last published are copied.
+  ///
+  /// Fails when the segment is not open, when the @p map layout does not match the segment or when the map has more
+  /// regions than the segment capacity. In the latter case, the regions which fit are still published.
+  ///
+  /// @param map The map to publish. Must have the same layout as the map given to @c create() .
+  /// @param[out] published_count Set to the number of regions copied into the segment. May be null.
+  /// @return True when all regions in @p map are published.
+  bool publish(const OccupancyMap &map, size_t *published_count = nullptr);
+
+private:
+  std::unique_ptr<SharedMapPublisherDetail> imp_;
+};
+}  // namespace ohm
+
+#endif  // OHM_SHAREDMAPPUBLISHER_H
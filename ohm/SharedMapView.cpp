@@ -0,0 +1,332 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "SharedMapView.h"
+
+#include "private/SharedMapDetail.h"
+
+#include "MapChunk.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "VoxelOccupancy.h"
+
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace ohm
+{
+using namespace shared_map;
+
+/// Pimpl data for @c SharedMapView .
+struct SharedMapViewDetail
+{
+  SharedSegment segment;
+  /// Empty map used for key and coordinate conversions.
+  std::unique_ptr<OccupancyMap> key_map;
+
+  inline const SharedMapHeader *header() const { return static_cast<const SharedMapHeader *>(segment.memory); }
+
+  /// Perform a seqlock protected read of the region @p region_key . The @p read function is invoked with the region
+  /// slot memory and may be invoked multiple times.
+  /// @return True if the region is published and has been read.
+  template <typename Read>
+  bool readConsistent(const RegionKey &region_key, const Read &read, uint64_t *stamp = nullptr) const
+  {
+    const SharedMapHeader *hdr = header();
+    if (!hdr)
+    {
+      return false;
+    }
+
+    const int32_t coord[3] = { int32_t(region_key.x), int32_t(region_key.y), int32_t(region_key.z) };
+    int64_t index = findRegion(hdr, coord);
+    if (index < 0)
+    {
+      return false;
+    }
+
+    // Bound the retries so a publisher which dies mid write cannot block the reader.
+    for (unsigned attempt = 0; attempt < kMaxReadAttempts; ++attempt)
+    {
+      const SharedRegionEntry &entry = regionTable(hdr)[index];
+      const uint32_t sequence = entry.sequence.load(std::memory_order_acquire);
+      if (sequence & 1u)
+      {
+        // Write in progress.
+        std::this_thread::yield();
+        continue;
+      }
+
+      const bool matched = entry.coord[0] == coord[0] && entry.coord[1] == coord[1] && entry.coord[2] == coord[2];
+      const bool valid = matched && entry.state.load(std::memory_order_relaxed) == kEntryValid;
+      const uint64_t entry_stamp = entry.stamp;
+      if (valid)
+      {
+        read(regionSlot(hdr, size_t(index)));
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (entry.sequence.load(std::memory_order_relaxed) == sequence)
+      {
+        if (!matched)
+        {
+          // The entry has been reused for another region. Look up the region again.
+          index = findRegion(hdr, coord);
+          if (index < 0)
+          {
+            return false;
+          }
+          continue;
+        }
+
+        if (valid && stamp)
+        {
+          *stamp = entry_stamp;
+        }
+        return valid;
+      }
+    }
+
+    return false;
+  }
+};
+
+
+SharedMapView::SharedMapView()
+  : imp_(new SharedMapViewDetail)
+{}
+
+
+SharedMapView::~SharedMapView()
+{
+  close();
+}
+
+
+bool SharedMapView::open(const char *name)
+{
+  close();
+  if (!openSegment(&imp_->segment, name))
+  {
+    return false;
+  }
+
+  const SharedMapHeader *header = imp_->header();
+  const bool valid_header = header->magic == kMagic && header->version == kVersion &&
+                            header->segment_size <= imp_->segment.size && header->layer_count <= kMaxLayers;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!valid_header)
+  {
+    close();
+    return false;
+  }
+
+  const glm::u8vec3 region_dim(header->region_dim[0], header->region_dim[1], header->region_dim[2]);
+  imp_->key_map = std::make_unique<OccupancyMap>(header->resolution, region_dim);
+  imp_->key_map->setOrigin(glm::dvec3(header->origin[0], header->origin[1], header->origin[2]));
+  return true;
+}
+
+
+void SharedMapView::close()
+{
+  closeSegment(&imp_->segment);
+  imp_->key_map.reset();
+}
+
+
+bool SharedMapView::isOpen() const
+{
+  return imp_->segment.memory != nullptr;
+}
+
+
+double SharedMapView::resolution() const
+{
+  return (isOpen()) ? imp_->header()->resolution : 0.0;
+}
+
+
+glm::dvec3 SharedMapView::origin() const
+{
+  return (isOpen()) ? imp_->key_map->origin() : glm::dvec3(0.0);
+}
+
+
+glm::u8vec3 SharedMapView::regionVoxelDimensions() const
+{
+  return (isOpen()) ? imp_->key_map->regionVoxelDimensions() : glm::u8vec3(0);
+}
+
+
+float SharedMapView::occupancyThresholdValue() const
+{
+  if (!isOpen())
+  {
+    return 0.0f;
+  }
+
+  const uint32_t bits = imp_->header()->occupancy_threshold_bits.load(std::memory_order_relaxed);
+  float threshold = 0;
+  memcpy(&threshold, &bits, sizeof(threshold));
+  return threshold;
+}
+
+
+unsigned SharedMapView::layerCount() const
+{
+  return (isOpen()) ? imp_->header()->layer_count : 0u;
+}
+
+
+const char *SharedMapView::layerName(int layer_index) const
+{
+  if (layer_index < 0 || unsigned(layer_index) >= layerCount())
+  {
+    return nullptr;
+  }
+  return imp_->header()->layers[layer_index].name;
+}
+
+
+int SharedMapView::layerIndex(const char *name) const
+{
+  for (unsigned i = 0; i < layerCount(); ++i)
+  {
+    if (strncmp(imp_->header()->layers[i].name, name, kLayerNameLength) == 0)
+    {
+      return int(i);
+    }
+  }
+  return -1;
+}
+
+
+int SharedMapView::occupancyLayer() const
+{
+  return (isOpen()) ? imp_->header()->occupancy_layer : -1;
+}
+
+
+size_t SharedMapView::voxelByteSize(int layer_index) const
+{
+  if (layer_index < 0 || unsigned(layer_index) >= layerCount())
+  {
+    return 0;
+  }
+  return imp_->header()->layers[layer_index].voxel_byte_size;
+}
+
+
+size_t SharedMapView::regionByteSize(int layer_index) const
+{
+  if (layer_index < 0 || unsigned(layer_index) >= layerCount())
+  {
+    return 0;
+  }
+  return imp_->header()->layers[layer_index].byte_size;
+}
+
+
+uint64_t SharedMapView::publishStamp() const
+{
+  return (isOpen()) ? imp_->header()->publish_stamp.load(std::memory_order_acquire) : 0u;
+}
+
+
+size_t SharedMapView::regionCount() const
+{
+  return (isOpen()) ? imp_->header()->region_count.load(std::memory_order_relaxed) : 0u;
+}
+
+
+Key SharedMapView::voxelKey(const glm::dvec3 &point) const
+{
+  return (isOpen()) ? imp_->key_map->voxelKey(point) : Key::kNull;
+}
+
+
+glm::dvec3 SharedMapView::voxelCentreGlobal(const Key &key) const
+{
+  return (isOpen()) ? imp_->key_map->voxelCentreGlobal(key) : glm::dvec3(0.0);
+}
+
+
+bool SharedMapView::hasRegion(const RegionKey &region_key, uint64_t *stamp) const
+{
+  return imp_->readConsistent(
+    region_key, [](const uint8_t *) {}, stamp);
+}
+
+
+bool SharedMapView::readVoxel(const Key &key, int layer_index, void *value, size_t value_size) const
+{
+  if (!isOpen() || layer_index < 0 || unsigned(layer_index) >= layerCount() || key.isNull() ||
+      value_size != voxelByteSize(layer_index))
+  {
+    return false;
+  }
+
+  const SharedLayerInfo &layer = imp_->header()->layers[layer_index];
+  const glm::ivec3 region_dim(regionVoxelDimensions());
+  const glm::ivec3 layer_dim = glm::max(region_dim / (1 << layer.subsampling), glm::ivec3(1));
+  const glm::ivec3 local = glm::ivec3(key.localKey()) / (1 << layer.subsampling);
+  const size_t offset = layer.slot_offset + size_t(voxelIndex(unsigned(local.x), unsigned(local.y),
+                                                               unsigned(local.z), unsigned(layer_dim.x),
+                                                               unsigned(layer_dim.y), unsigned(layer_dim.z))) *
+                                              layer.voxel_byte_size;
+
+  return imp_->readConsistent(key.regionKey(),
+                              [&](const uint8_t *slot) { memcpy(value, slot + offset, value_size); });
+}
+
+
+bool SharedMapView::readRegion(const RegionKey &region_key, int layer_index, void *buffer, size_t buffer_size,
+                               uint64_t *stamp) const
+{
+  const size_t byte_size = regionByteSize(layer_index);
+  if (byte_size == 0 || buffer_size < byte_size)
+  {
+    return false;
+  }
+
+  const size_t offset = imp_->header()->layers[layer_index].slot_offset;
+  return imp_->readConsistent(
+    region_key, [&](const uint8_t *slot) { memcpy(buffer, slot + offset, byte_size); }, stamp);
+}
+
+
+float SharedMapView::occupancy(const Key &key) const
+{
+  const int layer_index = occupancyLayer();
+  uint8_t value[sizeof(float)] = {};
+  if (layer_index < 0 || !readVoxel(key, layer_index, value, voxelByteSize(layer_index)))
+  {
+    return unobservedOccupancyValue();
+  }
+  return readOccupancy(value, 0, OccupancyEncoding(imp_->header()->occupancy_encoding));
+}
+
+
+OccupancyType SharedMapView::occupancyType(const Key &key) const
+{
+  const int layer_index = occupancyLayer();
+  uint8_t value[sizeof(float)] = {};
+  if (layer_index < 0 || !readVoxel(key, layer_index, value, voxelByteSize(layer_index)))
+  {
+    return kNull;
+  }
+
+  const float occupancy = readOccupancy(value, 0, OccupancyEncoding(imp_->header()->occupancy_encoding));
+  if (occupancy == unobservedOccupancyValue())
+  {
+    return kUnobserved;
+  }
+  return (occupancy >= occupancyThresholdValue()) ? kOccupied : kFree;
+}
+}  // namespace ohm
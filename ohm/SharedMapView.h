@@ -0,0 +1,163 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_SHAREDMAPVIEW_H
+#define OHM_SHAREDMAPVIEW_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+#include "OccupancyType.h"
+
+#include <glm/fwd.hpp>
+
+#include <memory>
+
+namespace ohm
+{
+struct SharedMapViewDetail;
+
+/// A read only view of an @c OccupancyMap published to shared memory by a @c SharedMapPublisher , typically in
+/// another process.
+///
+/// The view maps the shared segment read only and reads voxels directly from it, so attaching to a large map is
+/// effectively free and does not duplicate the map memory. Voxel and region reads are seqlock protected: a read
+/// retries while the publisher is modifying the containing region, so each read observes a consistent copy of the
+/// region. Separate reads may observe different publications; use @c readRegion() to read a whole region
+/// consistently.
+///
+/// Key and coordinate conversions match those of the published @c OccupancyMap .
+///
+/// Shared memory publication is only supported on POSIX platforms. @c open() fails elsewhere.
+class ohm_API SharedMapView
+{
+public:
+  /// Create an unopened view.
+  SharedMapView();
+  /// Destructor: unmaps the segment.
+  ~SharedMapView();
+
+  /// Attach to the named segment.
+  /// @param name The segment name as given to @c SharedMapPublisher::create() .
+  /// @return True on success.
+  bool open(const char *name);
+
+  /// Detach from the segment.
+  void close();
+
+  /// Is the view attached to a segment?
+  /// @return True if open.
+  bool isOpen() const;
+
+  /// Query the map voxel resolution.
+  /// @return The voxel resolution.
+  double resolution() const;
+
+  /// Query the map origin.
+  /// @return The map origin.
+  glm::dvec3 origin() const;
+
+  /// Query the region voxel dimensions.
+  /// @return The region voxel dimensions.
+  glm::u8vec3 regionVoxelDimensions() const;
+
+  /// Query the occupancy threshold value of the map as of the last publication.
+  /// @return The occupancy threshold (log-odds).
+  float occupancyThresholdValue() const;
+
+  /// Query the number of published layers. These match the @c MapLayout of the published map.
+  /// @return The layer count.
+  unsigned layerCount() const;
+
+  /// Query the name of the layer at @p layer_index .
+  /// @param layer_index The layer index.
+  /// @return The layer name or null if out of range.
+  const char *layerName(int layer_index) const;
+
+  /// Query the index of the layer named @p name .
+  /// @param name The layer name.
+  /// @return The layer index or -1 if not present.
+  int layerIndex(const char *name) const;
+
+  /// Query the occupancy layer index.
+  /// @return The occupancy layer index or -1 if not present.
+  int occupancyLayer() const;
+
+  /// Query the voxel byte size for @p layer_index .
+  /// @param layer_index The layer index.
+  /// @return The voxel size or zero if out of range.
+  size_t voxelByteSize(int layer_index) const;
+
+  /// Query the byte size of a region for @p layer_index . This is the buffer size required by @c readRegion() .
+  /// @param layer_index The layer index.
+  /// @return The region layer size or zero if out of range.
+  size_t regionByteSize(int layer_index) const;
+
+  /// Query the publication stamp. This increments each time the publisher calls @c SharedMapPublisher::publish() ,
+  /// and may be polled to detect changes.
+  /// @return The publication stamp.
+  uint64_t publishStamp() const;
+
+  /// Query the number of regions currently published.
+  /// @return The region count.
+  size_t regionCount() const;
+
+  /// Convert a global coordinate to a voxel key.
+  /// @param point The global coordinate.
+  /// @return The voxel key.
+  Key voxelKey(const glm::dvec3 &point) const;
+
+  /// Convert a voxel key to the global coordinate of the voxel centre.
+  /// @param key The voxel key.
+  /// @return The voxel centre.
+  glm::dvec3 voxelCentreGlobal(const Key &key) const;
+
+  /// Query if @p region_key has been published.
+  /// @param region_key The region of interest.
+  /// @param[out] stamp Optionally set to the map stamp of the published region data.
+  /// @return True if the region is published.
+  bool hasRegion(const RegionKey &region_key, uint64_t *stamp = nullptr) const;
+
+  /// Read a single voxel.
+  /// @param key The voxel key.
+  /// @param layer_index The layer to read from.
+  /// @param[out] value Buffer to read into.
+  /// @param value_size The size of @p value . Must match @c voxelByteSize() .
+  /// @return True if the voxel region is published and the voxel was read.
+  bool readVoxel(const Key &key, int layer_index, void *value, size_t value_size) const;
+
+  /// @overload
+  template <typename T>
+  inline bool readVoxel(const Key &key, int layer_index, T *value) const
+  {
+    return readVoxel(key, layer_index, value, sizeof(T));
+  }
+
+  /// Read the voxel memory of a whole region for one layer.
+  /// @param region_key The region of interest.
+  /// @param layer_index The layer to read from.
+  /// @param[out] buffer Buffer to read into.
+  /// @param buffer_size The size of @p buffer . Must be at least @c regionByteSize() .
+  /// @param[out] stamp Optionally set to the map stamp of the region data read.
+  /// @return True if the region is published and has been read.
+  bool readRegion(const RegionKey &region_key, int layer_index, void *buffer, size_t buffer_size,
+                  uint64_t *stamp = nullptr) const;
+
+  /// Read the log-odds occupancy value of a voxel, decoding any quantised occupancy encoding.
+  /// @param key The voxel key.
+  /// @return The occupancy value, or @c unobservedOccupancyValue() if the voxel region is not published.
+  float occupancy(const Key &key) const;
+
+  /// Classify a voxel using the published occupancy threshold.
+  /// @param key The voxel key.
+  /// @return The occupancy type. @c kNull if the voxel region is not published.
+  OccupancyType occupancyType(const Key &key) const;
+
+private:
+  std::unique_ptr<SharedMapViewDetail> imp_;
+};
+}  // namespace ohm
+
+#endif  // OHM_SHAREDMAPVIEW_H
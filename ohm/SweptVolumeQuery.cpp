@@ -0,0 +1,657 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "SweptVolumeQuery.h"
+
+#include "Key.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "QueryFlag.h"
+
+#include "private/ClearanceInfo.h"
+#include "private/OccupancyMapDetail.h"
+#include "private/OccupancyQueryAlg.h"
+#include "private/SweptVolumeQueryDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+using Shape = SweptVolumeQuery::Shape;
+
+/// Parameters shared by all tests in a sweep.
+struct SweepParams
+{
+  /// Regions covering all tests with up to date voxel masks.
+  QueryRegionMap regions;
+  /// Up to date clearance values by region.
+  ska::bytell_hash_map<RegionKey, const float *, Vector3Hash<RegionKey>> clearance;
+  /// Retains the clearance voxel buffers.
+  std::vector<CachedClearanceRegion> clearance_regions;
+  glm::ivec3 region_dim{ 0 };
+  double resolution = 0;
+  /// Search radius the clearance layer was calculated with.
+  float clearance_radius = 0;
+  bool use_clearance = false;
+  bool unknown_as_occupied = false;
+};
+
+/// A shape pose to test.
+struct Sample
+{
+  glm::dvec3 position;
+  glm::dquat orientation;
+  /// Index of the pose at or before this sample.
+  size_t pose_index;
+  /// Distance travelled along the pose positions to this sample.
+  double distance;
+};
+
+/// A sphere bounding part of the shape, in the shape's local frame.
+struct BoundingSphere
+{
+  glm::dvec3 centre;
+  double radius;
+};
+
+/// Distance from the shape centre to its furthest point.
+double boundingRadius(const SweptVolumeQueryDetail &query)
+{
+  switch (query.shape)
+  {
+  case Shape::kCapsule:
+    return query.half_length + query.radius;
+  case Shape::kBox:
+    return glm::length(query.half_extents);
+  case Shape::kSphere:
+  default:
+    break;
+  }
+  return query.radius;
+}
+
+/// Build spheres which together bound the shape. A capsule is covered by spheres spaced no more than @p spacing
+/// apart along its axis. Other shapes use a single bounding sphere.
+void boundingSpheres(const SweptVolumeQueryDetail &query, double spacing, std::vector<BoundingSphere> &spheres)
+{
+  spheres.clear();
+  if (query.shape == Shape::kCapsule && query.half_length > 0)
+  {
+    const int intervals = std::max(1, int(std::ceil(2.0 * query.half_length / spacing)));
+    const double interval = 2.0 * query.half_length / intervals;
+    for (int i = 0; i <= intervals; ++i)
+    {
+      spheres.emplace_back(
+        BoundingSphere{ glm::dvec3(0, 0, -query.half_length + i * interval), query.radius + 0.5 * interval });
+    }
+    return;
+  }
+  spheres.emplace_back(BoundingSphere{ glm::dvec3(0), boundingRadius(query) });
+}
+
+/// Convert @p point to a global voxel coordinate, where the global voxel index is region * region_dim + local.
+glm::ivec3 globalVoxel(const OccupancyMap &map, const SweepParams &params, const glm::dvec3 &point)
+{
+  const glm::dvec3 half_region(glm::dvec3(params.region_dim) * 0.5);
+  return glm::ivec3(glm::floor((point - map.origin()) / params.resolution + half_region));
+}
+
+/// Split the global voxel coordinate @p voxel into its region key and local coordinate.
+RegionKey splitVoxel(const SweepParams &params, const glm::ivec3 &voxel, glm::ivec3 *local)
+{
+  const RegionKey region_key(floorDiv(voxel, params.region_dim));
+  *local = voxel - glm::ivec3(region_key) * params.region_dim;
+  return region_key;
+}
+
+/// Use the clearance layer to test if the sphere at @p centre with @p radius is free of obstructions.
+/// @return True when the sphere is known to be free. False when it may collide or there is no clearance data.
+bool clearanceFree(const OccupancyMap &map, const SweepParams &params, const glm::dvec3 &centre, double radius)
+{
+  glm::ivec3 local;
+  const RegionKey region_key = splitVoxel(params, globalVoxel(map, params, centre), &local);
+  const auto search = params.clearance.find(region_key);
+  if (search == params.clearance.end())
+  {
+    return false;
+  }
+
+  const float clearance =
+    search->second[voxelIndex(unsigned(local.x), unsigned(local.y), unsigned(local.z), unsigned(params.region_dim.x),
+                              unsigned(params.region_dim.y), unsigned(params.region_dim.z))];
+  // Clearance is measured between voxel centres. Allow for the offset of centre from its voxel centre and the
+  // extents of the obstructing voxel: each up to half a voxel diagonal.
+  const double margin = params.resolution * std::sqrt(3.0);
+  const double free_range = (clearance >= 0) ? double(clearance) : double(params.clearance_radius);
+  return free_range - margin > radius;
+}
+
+/// Test if an oriented box intersects an axis aligned box using the separating axis theorem.
+/// @param centre The oriented box centre.
+/// @param axes The oriented box axes as matrix columns.
+/// @param half_extents The oriented box half extents.
+/// @param box_centre The axis aligned box centre.
+/// @param box_half_extents The axis aligned box half extents.
+bool orientedBoxIntersects(const glm::dvec3 &centre, const glm::dmat3 &axes, const glm::dvec3 &half_extents,
+                           const glm::dvec3 &box_centre, const glm::dvec3 &box_half_extents)
+{
+  const double epsilon = 1e-9;
+  const glm::dvec3 separation = box_centre - centre;
+  // Rotation from the oriented box frame to the world frame in which the other box is aligned.
+  double rotation[3][3];
+  double abs_rotation[3][3];
+  glm::dvec3 t;
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      rotation[i][j] = axes[i][j];
+      abs_rotation[i][j] = std::abs(rotation[i][j]) + epsilon;
+    }
+    t[i] = glm::dot(separation, axes[i]);
+  }
+
+  // Oriented box axes.
+  for (int i = 0; i < 3; ++i)
+  {
+    const double rb = box_half_extents[0] * abs_rotation[i][0] + box_half_extents[1] * abs_rotation[i][1] +
+                      box_half_extents[2] * abs_rotation[i][2];
+    if (std::abs(t[i]) > half_extents[i] + rb)
+    {
+      return false;
+    }
+  }
+
+  // World axes.
+  for (int j = 0; j < 3; ++j)
+  {
+    const double ra = half_extents[0] * abs_rotation[0][j] + half_extents[1] * abs_rotation[1][j] +
+                      half_extents[2] * abs_rotation[2][j];
+    if (std::abs(separation[j]) > ra + box_half_extents[j])
+    {
+      return false;
+    }
+  }
+
+  // Cross products of the axes.
+  for (int i = 0; i < 3; ++i)
+  {
+    const int i1 = (i + 1) % 3;
+    const int i2 = (i + 2) % 3;
+    for (int j = 0; j < 3; ++j)
+    {
+      const int j1 = (j + 1) % 3;
+      const int j2 = (j + 2) % 3;
+      const double ra = half_extents[i1] * abs_rotation[i2][j] + half_extents[i2] * abs_rotation[i1][j];
+      const double rb = box_half_extents[j1] * abs_rotation[i][j2] + box_half_extents[j2] * abs_rotation[i][j1];
+      if (std::abs(t[i2] * rotation[i1][j] - t[i1] * rotation[i2][j]) > ra + rb)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// Squared distance from @p point to the axis aligned box at @p box_centre .
+inline double boxDistanceSqr(const glm::dvec3 &point, const glm::dvec3 &box_centre, const glm::dvec3 &box_half_extents)
+{
+  const glm::dvec3 closest = glm::clamp(point, box_centre - box_half_extents, box_centre + box_half_extents);
+  return glm::dot(point - closest, point - closest);
+}
+
+/// Test if the shape at @p sample intersects the voxel cube at @p voxel_centre .
+bool shapeIntersectsVoxel(const SweptVolumeQueryDetail &query, const Sample &sample, const glm::dmat3 &axes,
+                          const glm::dvec3 &voxel_centre, const glm::dvec3 &voxel_half_extents)
+{
+  switch (query.shape)
+  {
+  case Shape::kCapsule:
+  {
+    // The distance from the capsule axis to the box is convex along the axis. Search for the minimum.
+    const glm::dvec3 axis = axes[2] * query.half_length;
+    double low = -1.0;
+    double high = 1.0;
+    for (int i = 0; i < 40; ++i)
+    {
+      const double a = low + (high - low) / 3.0;
+      const double b = high - (high - low) / 3.0;
+      if (boxDistanceSqr(sample.position + a * axis, voxel_centre, voxel_half_extents) <
+          boxDistanceSqr(sample.position + b * axis, voxel_centre, voxel_half_extents))
+      {
+        high = b;
+      }
+      else
+      {
+        low = a;
+      }
+    }
+    return boxDistanceSqr(sample.position + 0.5 * (low + high) * axis, voxel_centre, voxel_half_extents) <=
+           query.radius * query.radius;
+  }
+  case Shape::kBox:
+    return orientedBoxIntersects(sample.position, axes, query.half_extents, voxel_centre, voxel_half_extents);
+  case Shape::kSphere:
+  default:
+    break;
+  }
+  return boxDistanceSqr(sample.position, voxel_centre, voxel_half_extents) <= query.radius * query.radius;
+}
+
+/// Test the shape at @p sample for a collision.
+/// @param[out] key Set to the obstructing voxel on collision.
+/// @return True on collision.
+bool testSample(const OccupancyMap &map, const SweepParams &params, const SweptVolumeQueryDetail &query,
+                const std::vector<BoundingSphere> &spheres, const Sample &sample, Key *key)
+{
+  const glm::dmat3 axes = glm::mat3_cast(sample.orientation);
+
+  if (params.use_clearance)
+  {
+    bool free = true;
+    for (const BoundingSphere &sphere : spheres)
+    {
+      if (!clearanceFree(map, params, sample.position + axes * sphere.centre, sphere.radius))
+      {
+        free = false;
+        break;
+      }
+    }
+
+    if (free)
+    {
+      return false;
+    }
+  }
+
+  // Test the obstructed voxels overlapping the shape bounds.
+  glm::dvec3 extents(query.radius);
+  if (query.shape == Shape::kCapsule)
+  {
+    extents += glm::abs(axes[2]) * query.half_length;
+  }
+  else if (query.shape == Shape::kBox)
+  {
+    extents = glm::dmat3(glm::abs(axes[0]), glm::abs(axes[1]), glm::abs(axes[2])) * query.half_extents;
+  }
+  const glm::ivec3 voxel_min = globalVoxel(map, params, sample.position - extents);
+  const glm::ivec3 voxel_max = globalVoxel(map, params, sample.position + extents);
+  const glm::dvec3 voxel_half_extents(0.5 * params.resolution);
+
+  const auto mask_bit = [](const std::vector<uint64_t> &mask, unsigned voxel_index) {
+    return (mask[voxel_index / 64u] & (uint64_t(1u) << (voxel_index % 64u))) != 0;
+  };
+
+  RegionKey region_key(0);
+  const MapChunk *chunk = nullptr;
+  bool region_resolved = false;
+  for (int z = voxel_min.z; z <= voxel_max.z; ++z)
+  {
+    for (int y = voxel_min.y; y <= voxel_max.y; ++y)
+    {
+      for (int x = voxel_min.x; x <= voxel_max.x; ++x)
+      {
+        glm::ivec3 local;
+        const RegionKey voxel_region = splitVoxel(params, glm::ivec3(x, y, z), &local);
+        if (!region_resolved || voxel_region != region_key)
+        {
+          region_key = voxel_region;
+          region_resolved = true;
+          const auto search = params.regions.find(region_key);
+          chunk = (search != params.regions.end()) ? search->second : nullptr;
+        }
+
+        bool obstructed = params.unknown_as_occupied;
+        if (chunk)
+        {
+          const unsigned voxel_index =
+            voxelIndex(unsigned(local.x), unsigned(local.y), unsigned(local.z), unsigned(params.region_dim.x),
+                       unsigned(params.region_dim.y), unsigned(params.region_dim.z));
+          obstructed = mask_bit(chunk->occupied_mask, voxel_index) ||
+                       (params.unknown_as_occupied && !mask_bit(chunk->observed_mask, voxel_index));
+        }
+
+        if (obstructed)
+        {
+          const Key voxel_key(region_key, glm::u8vec3(local));
+          if (shapeIntersectsVoxel(query, sample, axes, map.voxelCentreGlobal(voxel_key), voxel_half_extents))
+          {
+            *key = voxel_key;
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+/// Build the shape poses to test along the sweep.
+void buildSamples(const SweptVolumeQueryDetail &query, double step, std::vector<Sample> &samples)
+{
+  samples.clear();
+  const double bounding_radius = boundingRadius(query);
+  double distance = 0;
+  for (size_t i = 0; i + 1 < query.positions.size(); ++i)
+  {
+    const glm::dvec3 &p0 = query.positions[i];
+    const glm::dvec3 &p1 = query.positions[i + 1];
+    const glm::dquat &q0 = query.orientations[i];
+    const glm::dquat &q1 = query.orientations[i + 1];
+    const double length = glm::length(p1 - p0);
+    const double angle = 2.0 * std::acos(std::min(1.0, std::abs(glm::dot(q0, q1))));
+    const int steps = std::max(1, int(std::ceil((length + angle * bounding_radius) / step)));
+    for (int j = 0; j < steps; ++j)
+    {
+      const double t = double(j) / double(steps);
+      samples.emplace_back(Sample{ p0 + t * (p1 - p0), glm::slerp(q0, q1, t), i, distance + t * length });
+    }
+    distance += length;
+  }
+
+  if (!query.positions.empty())
+  {
+    samples.emplace_back(
+      Sample{ query.positions.back(), query.orientations.back(), query.positions.size() - 1, distance });
+  }
+}
+}  // namespace
+
+
+SweptVolumeQuery::SweptVolumeQuery(SweptVolumeQueryDetail *detail)
+  : Query(detail)
+{}
+
+
+SweptVolumeQuery::SweptVolumeQuery()
+  : SweptVolumeQuery(new SweptVolumeQueryDetail)
+{}
+
+
+SweptVolumeQuery::SweptVolumeQuery(OccupancyMap &map, unsigned query_flags)
+  : SweptVolumeQuery(new SweptVolumeQueryDetail)
+{
+  setMap(&map);
+  setQueryFlags(query_flags);
+}
+
+
+SweptVolumeQuery::~SweptVolumeQuery()
+{
+  wait();
+  SweptVolumeQueryDetail *d = imp();
+  delete d;
+  // Clear pointer for base class.
+  imp_ = nullptr;
+}
+
+
+void SweptVolumeQuery::setSphere(double radius)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->shape = Shape::kSphere;
+  d->radius = radius;
+}
+
+
+void SweptVolumeQuery::setCapsule(double radius, double half_length)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->shape = Shape::kCapsule;
+  d->radius = radius;
+  d->half_length = half_length;
+}
+
+
+void SweptVolumeQuery::setBox(const glm::dvec3 &half_extents)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->shape = Shape::kBox;
+  d->half_extents = half_extents;
+}
+
+
+SweptVolumeQuery::Shape SweptVolumeQuery::shape() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->shape;
+}
+
+
+double SweptVolumeQuery::radius() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->radius;
+}
+
+
+double SweptVolumeQuery::halfLength() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->half_length;
+}
+
+
+glm::dvec3 SweptVolumeQuery::halfExtents() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->half_extents;
+}
+
+
+void SweptVolumeQuery::setPoses(const glm::dvec3 *positions, const glm::dquat *orientations, size_t pose_count)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->positions.assign(positions, positions + pose_count);
+  if (orientations)
+  {
+    d->orientations.assign(orientations, orientations + pose_count);
+  }
+  else
+  {
+    d->orientations.assign(pose_count, glm::dquat(1, 0, 0, 0));
+  }
+}
+
+
+const glm::dvec3 *SweptVolumeQuery::positions() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->positions.data();
+}
+
+
+const glm::dquat *SweptVolumeQuery::orientations() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->orientations.data();
+}
+
+
+size_t SweptVolumeQuery::poseCount() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->positions.size();
+}
+
+
+double SweptVolumeQuery::sweepStep() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->sweep_step;
+}
+
+
+void SweptVolumeQuery::setSweepStep(double step)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->sweep_step = step;
+}
+
+
+bool SweptVolumeQuery::collides() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->collision_pose != ~size_t(0u);
+}
+
+
+size_t SweptVolumeQuery::collisionPoseIndex() const
+{
+  const SweptVolumeQueryDetail *d = imp();
+  return d->collision_pose;
+}
+
+
+bool SweptVolumeQuery::onExecute()
+{
+  SweptVolumeQueryDetail *d = imp();
+
+  if (!d->map || d->map->layout().occupancyLayer() < 0)
+  {
+    return false;
+  }
+
+  const OccupancyMap &map = *d->map;
+  d->collision_pose = ~size_t(0u);
+  d->intersected_voxels.clear();
+  d->ranges.clear();
+  d->number_of_results = 0;
+  if (d->positions.empty())
+  {
+    return true;
+  }
+
+  SweepParams params;
+  params.region_dim = glm::ivec3(map.regionVoxelDimensions());
+  params.resolution = map.resolution();
+  params.unknown_as_occupied = (d->query_flags & kQfUnknownAsOccupied) != 0;
+  if (!(d->query_flags & kQfNoCache) && map.layout().clearanceLayer() >= 0)
+  {
+    // Clearance values are only usable when calculated with a matching obstruction definition and unit scaling.
+    ClearanceInfo clearance_info;
+    clearance_info.fromMapInfo(map.mapInfo());
+    params.use_clearance =
+      clearance_info.search_radius > 0 && clearance_info.supports(0.0f, params.unknown_as_occupied);
+    params.clearance_radius = clearance_info.search_radius;
+  }
+
+  // Resolve the regions covering all poses, padded by the shape bounds.
+  glm::dvec3 pose_min = d->positions.front();
+  glm::dvec3 pose_max = pose_min;
+  for (const glm::dvec3 &position : d->positions)
+  {
+    pose_min = glm::min(pose_min, position);
+    pose_max = glm::max(pose_max, position);
+  }
+  const glm::dvec3 padding(boundingRadius(*d) + map.resolution());
+  prepareQueryRegions(map, glm::ivec3(map.regionKey(pose_min - padding)), glm::ivec3(map.regionKey(pose_max + padding)),
+                      params.unknown_as_occupied, params.regions);
+
+  if (params.use_clearance)
+  {
+    const OccupancyMapDetail &map_data = *map.detail();
+    const glm::ivec3 region_padding =
+      (calculateVoxelSearchHalfExtents(map, params.clearance_radius) + params.region_dim - glm::ivec3(1)) /
+      params.region_dim;
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    params.clearance_regions.reserve(params.regions.size());
+    for (const auto &region : params.regions)
+    {
+      CachedClearanceRegion cached = cachedClearanceRegion(map_data, region.first, region_padding);
+      if (cached.clearance)
+      {
+        params.clearance.insert(std::make_pair(region.first, cached.clearance));
+        params.clearance_regions.emplace_back(std::move(cached));
+      }
+    }
+  }
+
+  const double step = (d->sweep_step > 0) ? d->sweep_step : map.resolution();
+  std::vector<Sample> samples;
+  buildSamples(*d, step, samples);
+  std::vector<BoundingSphere> spheres;
+  boundingSpheres(*d, map.resolution(), spheres);
+
+  // Find the first colliding sample. Samples after a known collision are skipped.
+  std::vector<Key> collision_keys(samples.size());
+  size_t first_collision = ~size_t(0u);
+#ifdef OHM_THREADS
+  std::atomic<size_t> first_collision_shared(~size_t(0u));
+  tbb::parallel_for(tbb::blocked_range<size_t>(0u, samples.size()), [&](const tbb::blocked_range<size_t> &range) {
+    for (size_t i = range.begin(); i != range.end() && i < first_collision_shared; ++i)
+    {
+      if (testSample(map, params, *d, spheres, samples[i], &collision_keys[i]))
+      {
+        size_t current = first_collision_shared;
+        while (i < current && !first_collision_shared.compare_exchange_weak(current, i))
+        {
+        }
+        break;
+      }
+    }
+  });
+  first_collision = first_collision_shared;
+#else   // OHM_THREADS
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    if (testSample(map, params, *d, spheres, samples[i], &collision_keys[i]))
+    {
+      first_collision = i;
+      break;
+    }
+  }
+#endif  // OHM_THREADS
+
+  if (first_collision != ~size_t(0u))
+  {
+    d->collision_pose = samples[first_collision].pose_index;
+    d->intersected_voxels.emplace_back(collision_keys[first_collision]);
+    d->ranges.emplace_back(float(samples[first_collision].distance));
+    d->number_of_results = 1;
+  }
+
+  return true;
+}
+
+
+void SweptVolumeQuery::onReset(bool /*hard_reset*/)
+{
+  SweptVolumeQueryDetail *d = imp();
+  d->collision_pose = ~size_t(0u);
+}
+
+
+SweptVolumeQueryDetail *SweptVolumeQuery::imp()
+{
+  return static_cast<SweptVolumeQueryDetail *>(imp_);
+}
+
+
+const SweptVolumeQueryDetail *SweptVolumeQuery::imp() const
+{
+  return static_cast<const SweptVolumeQueryDetail *>(imp_);
+}
+}  // namespace ohm
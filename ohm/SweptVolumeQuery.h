@@ -0,0 +1,157 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_SWEPTVOLUMEQUERY_H
+#define OHM_SWEPTVOLUMEQUERY_H
+
+#include "OhmConfig.h"
+
+#include "Query.h"
+#include "QueryFlag.h"
+
+#include <glm/fwd.hpp>
+
+namespace ohm
+{
+struct SweptVolumeQueryDetail;
+
+/// Checks a shape swept along a sequence of poses for collisions with the map.
+///
+/// The shape is a sphere, a capsule or an oriented box, centred on the pose position and rotated by the pose
+/// orientation. The capsule axis is the local z axis. The shape is tested at each pose and at interpolated poses in
+/// between, such that no point of the shape moves more than the @c sweepStep() between tests. Position is linearly
+/// interpolated and orientation is spherically interpolated.
+///
+/// The shape collides when it intersects the cube of an obstructed voxel. Obstructed voxels are occupied voxels and,
+/// with @c kQfUnknownAsOccupied , unobserved voxels. The query only answers whether the sweep collides, stopping
+/// at the first collision:
+/// - @c collides() reports whether there is a collision.
+/// - @c collisionPoseIndex() is the index of the pose at or before the first collision.
+/// - There is a single result on collision. @c intersectedVoxels() holds the obstructing voxel and @c ranges() holds
+///   the distance travelled along the pose positions to the colliding test.
+///
+/// Tests are resolved as follows:
+/// - The clearance layer is used to prove a test is free of collisions without visiting voxels. This requires
+///   the parameters recorded with the clearance layer by @c ClearanceProcessCpu to match this query: the same
+///   @c kQfUnknownAsOccupied setting, unit axis scaling and a non-zero search radius. The clearance layer is only used
+///   in regions where it is up to date with the occupancy layer and is not used with @c kQfNoCache .
+/// - Otherwise the obstructed voxels overlapping the shape bounds are tested against the shape, using the
+///   @c MapChunk occupancy and observation masks, resolved once under a single map lock.
+/// - Tests are executed in parallel when ohm is built with @c OHM_THREADS .
+///
+/// The map must not be modified during execution.
+class ohm_API SweptVolumeQuery : public Query
+{
+public:
+  /// Default flags to execute this query with.
+  static const unsigned kDefaultFlags = 0;
+
+  /// Supported shapes.
+  enum class Shape : unsigned
+  {
+    /// A sphere of @c radius() .
+    kSphere,
+    /// A capsule of @c radius() with a core line segment of @c halfLength() either side of the centre along the
+    /// local z axis.
+    kCapsule,
+    /// An oriented box with @c halfExtents() .
+    kBox
+  };
+
+protected:
+  /// Constructor used for inherited objects. This supports deriving @p SweptVolumeQueryDetail into
+  /// more specialised forms.
+  /// @param detail pimple style data structure. When null, a @c SweptVolumeQueryDetail is allocated by
+  /// this method.
+  explicit SweptVolumeQuery(SweptVolumeQueryDetail *detail);
+
+public:
+  /// Constructor.
+  SweptVolumeQuery();
+
+  /// Construct a new query using the given parameters.
+  /// @param map The map to perform the query on.
+  /// @param query_flags Flags controlling the query behaviour. See @c QueryFlag .
+  explicit SweptVolumeQuery(OccupancyMap &map, unsigned query_flags = kDefaultFlags);
+
+  /// Destructor.
+  ~SweptVolumeQuery() override;
+
+  /// Set the shape to a sphere.
+  /// @param radius The sphere radius.
+  void setSphere(double radius);
+
+  /// Set the shape to a capsule aligned with the local z axis.
+  /// @param radius The capsule radius.
+  /// @param half_length Half the length of the capsule core line segment, excluding the end caps.
+  void setCapsule(double radius, double half_length);
+
+  /// Set the shape to an oriented box.
+  /// @param half_extents The box half extents along each local axis.
+  void setBox(const glm::dvec3 &half_extents);
+
+  /// Get the shape type.
+  /// @return The shape type.
+  Shape shape() const;
+
+  /// Get the sphere or capsule radius.
+  /// @return The shape radius.
+  double radius() const;
+
+  /// Get the capsule core line segment half length.
+  /// @return The capsule half length.
+  double halfLength() const;
+
+  /// Get the box half extents.
+  /// @return The box half extents.
+  glm::dvec3 halfExtents() const;
+
+  /// Set the poses to sweep the shape along. The arrays are copied.
+  /// @param positions Array of pose positions in global coordinates.
+  /// @param orientations Array of pose orientations. May be null to use the identity orientation for all poses.
+  /// @param pose_count Number of elements in @p positions and @p orientations .
+  void setPoses(const glm::dvec3 *positions, const glm::dquat *orientations, size_t pose_count);
+
+  /// Get the pose positions set in the last call to @c setPoses() .
+  /// @return The pose positions. The number of elements is @c poseCount() .
+  const glm::dvec3 *positions() const;
+
+  /// Get the pose orientations set in the last call to @c setPoses() .
+  /// @return The pose orientations. The number of elements is @c poseCount() .
+  const glm::dquat *orientations() const;
+
+  /// Get the number of poses.
+  /// @return The number of poses.
+  size_t poseCount() const;
+
+  /// Get the maximum distance any point of the shape moves between tests.
+  /// @return The sweep step. Zero to use the map resolution.
+  double sweepStep() const;
+  /// Set the maximum distance any point of the shape moves between tests.
+  /// @param step The sweep step. Zero to use the map resolution.
+  void setSweepStep(double step);
+
+  /// Query whether the last execution found a collision.
+  /// @return True on collision.
+  bool collides() const;
+
+  /// Get the index of the pose at or before the first collision. The collision lies between this pose and the next.
+  /// @return The collision pose index or ~0u when there is no collision.
+  size_t collisionPoseIndex() const;
+
+protected:
+  bool onExecute() override;
+  void onReset(bool hard_reset) override;
+
+  /// Access internal details.
+  /// @return Internal details.
+  SweptVolumeQueryDetail *imp();
+  /// Access internal details.
+  /// @return Internal details.
+  const SweptVolumeQueryDetail *imp() const;
+};
+}  // namespace ohm
+
+#endif  // OHM_SWEPTVOLUMEQUERY_H
@@ -0,0 +1,253 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "TernaryOccupancy.h"
+
+#include "DefaultLayer.h"
+#include "Key.h"
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "OccupancyEncoding.h"
+#include "OccupancyMap.h"
+#include "VoxelBuffer.h"
+
+#include "private/OccupancyMapDetail.h"
+#include "private/VoxelAlgorithms.h"
+
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace ohm
+{
+void TernaryWindow::resize(const glm::ivec3 &dimensions)
+{
+  dimensions_ = glm::max(dimensions, glm::ivec3(0));
+  const size_t voxel_count = size_t(dimensions_.x) * size_t(dimensions_.y) * size_t(dimensions_.z);
+  codes_.clear();
+  codes_.resize((voxel_count + 3u) / 4u, 0u);
+}
+
+
+TernaryOccupancy::TernaryOccupancy(OccupancyMap *map)
+  : map_(map)
+{
+  const glm::u8vec3 region_dim = map_->regionVoxelDimensions();
+  if ((region_dim.x & 1u) || (region_dim.y & 1u) || (region_dim.z & 1u))
+  {
+    // The packed layer requires even region dimensions.
+    return;
+  }
+
+  occupancy_layer_ = map_->layout().occupancyLayer();
+  if (occupancy_layer_ < 0)
+  {
+    return;
+  }
+
+  layer_index_ = map_->layout().layerIndex(default_layer::ternaryLayerName());
+  if (layer_index_ < 0)
+  {
+    MapLayout new_layout = map_->layout();
+    addTernaryOccupancy(new_layout);
+    map_->updateLayout(new_layout);
+    layer_index_ = map_->layout().layerIndex(default_layer::ternaryLayerName());
+    occupancy_layer_ = map_->layout().occupancyLayer();
+  }
+}
+
+
+size_t TernaryOccupancy::update()
+{
+  if (!isValid())
+  {
+    return 0;
+  }
+
+  // Snapshot the regions under the map lock, then rebuild outside the lock.
+  std::vector<MapChunk *> chunks;
+  {
+    OccupancyMapDetail &map_data = *map_->detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    chunks.reserve(map_data.chunks.size());
+    for (auto &chunk_ref : map_data.chunks)
+    {
+      chunks.push_back(chunk_ref.second);
+    }
+  }
+
+  size_t updated = 0;
+  for (MapChunk *chunk : chunks)
+  {
+    updated += update(chunk) ? 1u : 0u;
+  }
+  return updated;
+}
+
+
+bool TernaryOccupancy::update(MapChunk *chunk)
+{
+  if (!isValid() || !chunk)
+  {
+    return false;
+  }
+
+  const uint64_t occupancy_stamp = chunk->touched_stamps[occupancy_layer_];
+  if (chunk->touched_stamps[layer_index_] >= occupancy_stamp)
+  {
+    return false;
+  }
+
+  VoxelBlock *ternary_block = chunk->voxel_blocks[layer_index_].get();
+  const VoxelBlock *occupancy_block = chunk->voxel_blocks[occupancy_layer_].get();
+  if (occupancy_block->isUninitialised())
+  {
+    // No occupancy data: everything is unknown.
+    if (!ternary_block->isUninitialised())
+    {
+      VoxelBuffer<VoxelBlock> ternary_buffer(ternary_block);
+      memset(ternary_buffer.voxelMemory(), 0, ternary_buffer.voxelMemorySize());
+    }
+  }
+  else
+  {
+    const MapLayer &occupancy_layer = map_->layout().layer(occupancy_layer_);
+    const OccupancyEncoding encoding = occupancyEncoding(occupancy_layer);
+    const float threshold = map_->occupancyThresholdValue();
+    const size_t voxel_count = occupancy_layer.volume(map_->regionVoxelDimensions());
+
+    VoxelBuffer<const VoxelBlock> occupancy_buffer(chunk->voxel_blocks[occupancy_layer_]);
+    VoxelBuffer<VoxelBlock> ternary_buffer(ternary_block);
+    const uint8_t *occupancy_mem = occupancy_buffer.voxelMemory();
+    uint8_t *codes = ternary_buffer.voxelMemory();
+
+    // Assemble whole bytes of four codes at a time.
+    for (size_t i = 0; i < voxel_count; i += 4)
+    {
+      unsigned packed = 0;
+      for (unsigned j = 0; j < 4u; ++j)
+      {
+        const float value = readOccupancy(occupancy_mem, unsigned(i + j), encoding);
+        packed |= unsigned(ternaryCode(value, threshold)) << (j * 2u);
+      }
+      codes[i >> 2u] = uint8_t(packed);
+    }
+  }
+
+  chunk->touched_stamps[layer_index_] = occupancy_stamp;
+  return true;
+}
+
+
+TernaryCode TernaryOccupancy::code(const Key &key)
+{
+  if (!isValid() || key.isNull())
+  {
+    return kTernaryUnknown;
+  }
+
+  MapChunk *chunk = map_->region(key.regionKey(), false);
+  if (!chunk)
+  {
+    return kTernaryUnknown;
+  }
+
+  update(chunk);
+  if (chunk->voxel_blocks[layer_index_]->isUninitialised())
+  {
+    return kTernaryUnknown;
+  }
+
+  VoxelBuffer<const VoxelBlock> ternary_buffer(chunk->voxel_blocks[layer_index_]);
+  return readTernary(ternary_buffer.voxelMemory(), voxelIndex(key, glm::ivec3(map_->regionVoxelDimensions())));
+}
+
+
+TernaryCode TernaryOccupancy::code(const glm::dvec3 &point)
+{
+  return code(map_->voxelKey(point));
+}
+
+
+glm::ivec3 TernaryOccupancy::globalVoxel(const Key &key) const
+{
+  const glm::ivec3 region_dim(map_->regionVoxelDimensions());
+  return glm::ivec3(key.regionKey()) * region_dim + glm::ivec3(key.localKey());
+}
+
+
+void TernaryOccupancy::extract(const Key &min_key, const glm::ivec3 &dimensions, TernaryWindow *window)
+{
+  window->resize(dimensions);
+  window->setOrigin(globalVoxel(min_key));
+
+  if (!isValid() || glm::any(glm::lessThanEqual(window->dimensions(), glm::ivec3(0))))
+  {
+    return;
+  }
+
+  const glm::ivec3 region_dim(map_->regionVoxelDimensions());
+  const glm::ivec3 window_min = window->origin();
+  const glm::ivec3 window_max = window_min + window->dimensions() - 1;
+  const glm::ivec3 region_min(floorDiv(window_min, region_dim));
+  const glm::ivec3 region_max(floorDiv(window_max, region_dim));
+
+  // Unknown is zero, so only regions with data need to be visited.
+  for (int rz = region_min.z; rz <= region_max.z; ++rz)
+  {
+    for (int ry = region_min.y; ry <= region_max.y; ++ry)
+    {
+      for (int rx = region_min.x; rx <= region_max.x; ++rx)
+      {
+        const RegionKey region_key(rx, ry, rz);
+        MapChunk *chunk = map_->region(region_key, false);
+        if (!chunk)
+        {
+          continue;
+        }
+
+        update(chunk);
+        if (chunk->voxel_blocks[layer_index_]->isUninitialised())
+        {
+          continue;
+        }
+
+        VoxelBuffer<const VoxelBlock> ternary_buffer(chunk->voxel_blocks[layer_index_]);
+        const uint8_t *codes = ternary_buffer.voxelMemory();
+
+        // Resolve the overlap between the window and this region in global voxel coordinates.
+        const glm::ivec3 region_origin = glm::ivec3(rx, ry, rz) * region_dim;
+        const glm::ivec3 overlap_min = glm::max(window_min, region_origin);
+        const glm::ivec3 overlap_max = glm::min(window_max, region_origin + region_dim - 1);
+
+        for (int z = overlap_min.z; z <= overlap_max.z; ++z)
+        {
+          for (int y = overlap_min.y; y <= overlap_max.y; ++y)
+          {
+            const glm::ivec3 local(overlap_min.x - region_origin.x, y - region_origin.y, z - region_origin.z);
+            size_t src_index = voxelIndex(local.x, local.y, local.z, region_dim.x, region_dim.y, region_dim.z);
+            size_t dst_index = window->index(glm::ivec3(overlap_min.x, y, z) - window_min);
+            for (int x = overlap_min.x; x <= overlap_max.x; ++x, ++src_index, ++dst_index)
+            {
+              writeTernary(window->data(), dst_index, readTernary(codes, src_index));
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+void TernaryOccupancy::extract(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext, TernaryWindow *window)
+{
+  const Key min_key = map_->voxelKey(min_ext);
+  const Key max_key = map_->voxelKey(max_ext);
+  extract(min_key, globalVoxel(max_key) - globalVoxel(min_key) + 1, window);
+}
+}  // namespace ohm
@@ -0,0 +1,206 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_TERNARYOCCUPANCY_H
+#define OHM_TERNARYOCCUPANCY_H
+
+#include "OhmConfig.h"
+
+#include <glm/fwd.hpp>
+#include <glm/vec3.hpp>
+
+#include <cinttypes>
+#include <limits>
+#include <vector>
+
+namespace ohm
+{
+class Key;
+class OccupancyMap;
+struct MapChunk;
+
+/// Two bit voxel classification codes stored in the ternary occupancy layer - see @c TernaryOccupancy .
+enum TernaryCode : uint8_t
+{
+  kTernaryUnknown = 0,   ///< Unobserved voxel.
+  kTernaryFree = 1,      ///< Observed voxel below the occupancy threshold.
+  kTernaryOccupied = 2,  ///< Observed voxel at or above the occupancy threshold.
+};
+
+/// Classify a log-odds @p occupancy value as a @c TernaryCode . This matches @c occupancyType() .
+/// @param occupancy The log-odds occupancy value.
+/// @param threshold The occupancy threshold value - see @c OccupancyMap::occupancyThresholdValue() .
+/// @return The ternary code for @p occupancy .
+inline TernaryCode ternaryCode(float occupancy, float threshold)
+{
+  if (occupancy == std::numeric_limits<float>::infinity())
+  {
+    return kTernaryUnknown;
+  }
+  return (occupancy >= threshold) ? kTernaryOccupied : kTernaryFree;
+}
+
+/// Read the @c TernaryCode at @p index from an array of packed two bit @p codes .
+/// @param codes The packed code array.
+/// @param index The code index.
+/// @return The code at @p index .
+inline TernaryCode readTernary(const uint8_t *codes, size_t index)
+{
+  return TernaryCode((codes[index >> 2u] >> ((index & 3u) * 2u)) & 3u);
+}
+
+/// Write the @c TernaryCode at @p index into an array of packed two bit @p codes .
+/// @param codes The packed code array.
+/// @param index The code index.
+/// @param code The code to write.
+inline void writeTernary(uint8_t *codes, size_t index, TernaryCode code)
+{
+  const unsigned shift = unsigned(index & 3u) * 2u;
+  codes[index >> 2u] = uint8_t((codes[index >> 2u] & ~(3u << shift)) | (unsigned(code) << shift));
+}
+
+/// A dense, packed window of @c TernaryCode values extracted from a @c TernaryOccupancy layer.
+///
+/// The window covers @c dimensions() voxels starting at @c origin() . Codes are stored at two bits per voxel, indexed
+/// with X varying fastest, then Y, then Z, matching the region voxel ordering.
+class ohm_API TernaryWindow
+{
+public:
+  /// Resize the window to @p dimensions voxels, clearing all codes to @c kTernaryUnknown .
+  /// @param dimensions The number of voxels along each axis.
+  void resize(const glm::ivec3 &dimensions);
+
+  /// The window origin in global voxel coordinates. See @c TernaryOccupancy::globalVoxel() .
+  /// @return The global voxel coordinate of the first window voxel.
+  inline const glm::ivec3 &origin() const { return origin_; }
+  /// Set the @c origin() .
+  /// @param origin The global voxel coordinate of the first window voxel.
+  inline void setOrigin(const glm::ivec3 &origin) { origin_ = origin; }
+
+  /// The number of voxels along each axis.
+  /// @return The window dimensions.
+  inline const glm::ivec3 &dimensions() const { return dimensions_; }
+
+  /// Query the linear code index for the voxel at @p coord relative to the window @c origin() .
+  /// @param coord The voxel coordinate relative to the window @c origin() . Must be within @c dimensions() .
+  /// @return The code index for use with @c readTernary() on @c data() .
+  inline size_t index(const glm::ivec3 &coord) const
+  {
+    return size_t(coord.x) + size_t(dimensions_.x) * (size_t(coord.y) + size_t(dimensions_.y) * size_t(coord.z));
+  }
+
+  /// Read the code for the voxel at @p coord relative to the window @c origin() .
+  /// @param coord The voxel coordinate relative to the window @c origin() . Must be within @c dimensions() .
+  /// @return The voxel code.
+  inline TernaryCode at(const glm::ivec3 &coord) const { return readTernary(codes_.data(), index(coord)); }
+
+  /// Set the code for the voxel at @p coord relative to the window @c origin() .
+  /// @param coord The voxel coordinate relative to the window @c origin() . Must be within @c dimensions() .
+  /// @param code The code to write.
+  inline void set(const glm::ivec3 &coord, TernaryCode code) { writeTernary(codes_.data(), index(coord), code); }
+
+  /// Access the packed code array.
+  /// @return The packed codes.
+  inline const uint8_t *data() const { return codes_.data(); }
+  /// @overload
+  inline uint8_t *data() { return codes_.data(); }
+
+  /// Query the size of the packed code array in bytes.
+  /// @return The byte size of @c data() .
+  inline size_t byteSize() const { return codes_.size(); }
+
+private:
+  std::vector<uint8_t> codes_;
+  glm::ivec3 origin_{ 0 };
+  glm::ivec3 dimensions_{ 0 };
+};
+
+/// A derived map layer which classifies each voxel as free, occupied or unknown using two bits per voxel - a 16x
+/// reduction over a float occupancy layer. This is intended for planners which only need the voxel classification and
+/// benefit from the cache friendly representation.
+///
+/// The layer is added to the map using @c addTernaryOccupancy() , named @c default_layer::ternaryLayerName() . Codes
+/// are stored as a flat array of @c TernaryCode values indexed by the linear voxel index within each region. The layer
+/// does not support @c Voxel access; use @c readTernary() with the layer voxel memory or the accessors here.
+///
+/// The layer is kept up to date incrementally by @c RayMapperOccupancy and @c RayMapperNdt . Other occupancy updates -
+/// such as writes via @c Voxel or GPU ray integration - mark the region occupancy layer as touched and the ternary
+/// codes for such regions are rebuilt lazily on access here. A region is stale when its ternary layer
+/// @c MapChunk::touched_stamps value is less than that of the occupancy layer. Changing the map occupancy threshold
+/// marks all ternary codes as stale.
+///
+/// Accessors here modify the ternary layer of the target map, so a non-const map is required. They are not thread
+/// safe: the map must not be updated concurrently - including by other @c TernaryOccupancy objects - while any
+/// accessor here is in progress.
+class ohm_API TernaryOccupancy
+{
+public:
+  /// Create a ternary occupancy view of @p map , adding the ternary layer to @p map if required.
+  ///
+  /// The @p map region voxel dimensions must all be even to support the packed layer, otherwise the object is not
+  /// @c isValid() .
+  /// @param map The target map. Must outlive this object.
+  explicit TernaryOccupancy(OccupancyMap *map);
+
+  /// Query if the map supports the ternary layer.
+  /// @return True if the map has occupancy and ternary layers.
+  inline bool isValid() const { return layer_index_ >= 0 && occupancy_layer_ >= 0; }
+
+  /// Access the target map.
+  /// @return The map.
+  inline OccupancyMap *map() const { return map_; }
+
+  /// Query the ternary layer index.
+  /// @return The ternary layer index or -1 if not @c isValid() .
+  inline int layerIndex() const { return layer_index_; }
+
+  /// Rebuild the codes for all stale regions.
+  ///
+  /// The map lock is only held while collecting the regions. Regions must not be added, removed or updated during
+  /// the call.
+  /// @return The number of regions rebuilt.
+  size_t update();
+
+  /// Rebuild the codes for @p chunk if stale.
+  /// @param chunk The region to update.
+  /// @return True if the region was stale and has been rebuilt.
+  bool update(MapChunk *chunk);
+
+  /// Query the code for the voxel at @p key . Stale regions are rebuilt.
+  /// @param key The voxel key.
+  /// @return The voxel code. Voxels in regions not present in the map are @c kTernaryUnknown .
+  TernaryCode code(const Key &key);
+  /// @overload
+  TernaryCode code(const glm::dvec3 &point);
+
+  /// Convert @p key into a global voxel coordinate, combining the region and local keys.
+  /// @param key The voxel key.
+  /// @return The global voxel coordinate.
+  glm::ivec3 globalVoxel(const Key &key) const;
+
+  /// Extract a dense window of codes covering @p dimensions voxels starting at @p min_key . Stale regions are
+  /// rebuilt. Voxels in regions not present in the map are @c kTernaryUnknown .
+  ///
+  /// This operates on whole regions, copying runs of codes along the X axis.
+  /// @param min_key The key of the first voxel in the window.
+  /// @param dimensions The number of voxels along each axis to extract.
+  /// @param[out] window The window to populate.
+  void extract(const Key &min_key, const glm::ivec3 &dimensions, TernaryWindow *window);
+
+  /// @overload
+  /// Extract the window of voxels overlapping the box given by @p min_ext and @p max_ext .
+  /// @param min_ext The minimum box extents.
+  /// @param max_ext The maximum box extents.
+  /// @param[out] window The window to populate.
+  void extract(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext, TernaryWindow *window);
+
+private:
+  OccupancyMap *map_ = nullptr;
+  int layer_index_ = -1;
+  int occupancy_layer_ = -1;
+};
+}  // namespace ohm
+
+#endif  // OHM_TERNARYOCCUPANCY_H
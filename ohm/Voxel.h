@@ -13,6 +13,7 @@
 #include "MapChunk.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
+#include "OccupancyEncoding.h"
 #include "OccupancyMap.h"
 #include "VoxelBlock.h"
 
@@ -25,6 +26,89 @@ namespace ohm
 {
 namespace detail
 {
+/// Internal helper to validate a layer for data type @c T and to copy @c T values in and out of voxel memory. The
+/// general case copies @c T directly and requires an exact size match with the layer voxel size.
+template <typename T>
+struct VoxelValue
+{
+  /// Check whether @p layer can be accessed as type @c T .
+  /// @param layer The layer to validate.
+  /// @param is_occupancy_layer True if @p layer is the map occupancy layer.
+  /// @param[out] encoding Set to the @c OccupancyEncoding to use for the layer. Always @c OccupancyEncoding::kFloat
+  ///   here.
+  /// @return True if the layer voxel size matches @c T .
+  static bool validateLayer(const MapLayer &layer, bool is_occupancy_layer, OccupancyEncoding *encoding)
+  {
+    (void)is_occupancy_layer;
+    *encoding = OccupancyEncoding::kFloat;
+    return layer.voxelByteSize() == sizeof(T);
+  }
+
+  /// Read the value for @p voxel_index from @p voxel_memory .
+  /// @param voxel_memory Start of the voxel memory.
+  /// @param voxel_index Index of the voxel within @p voxel_memory - strided by @c T .
+  /// @param[out] value The value read.
+  /// @param encoding Ignored.
+  static void read(const uint8_t *voxel_memory, unsigned voxel_index, T *value, OccupancyEncoding encoding)
+  {
+    (void)encoding;
+    memcpy(value, voxel_memory + sizeof(T) * voxel_index, sizeof(T));
+  }
+
+  /// Write @p value for @p voxel_index to @p voxel_memory .
+  /// @param voxel_memory Start of the voxel memory.
+  /// @param voxel_index Index of the voxel within @p voxel_memory - strided by @c T .
+  /// @param value The value to write.
+  /// @param encoding Ignored.
+  static void write(uint8_t *voxel_memory, unsigned voxel_index, const T &value, OccupancyEncoding encoding)
+  {
+    (void)encoding;
+    memcpy(voxel_memory + sizeof(T) * voxel_index, &value, sizeof(T));
+  }
+};
+
+/// @c VoxelValue specialisation for @c float , which additionally supports a quantised occupancy layer. The
+/// @c OccupancyEncoding is resolved when validating the occupancy layer and values are converted to and from float
+/// log-odds values on access.
+template <>
+struct VoxelValue<float>
+{
+  /// Check whether @p layer can be accessed as a @c float , possibly with a quantised @c OccupancyEncoding .
+  /// @param layer The layer to validate.
+  /// @param is_occupancy_layer True if @p layer is the map occupancy layer. Only the occupancy layer may be quantised.
+  /// @param[out] encoding Set to the @c OccupancyEncoding to use for the layer.
+  /// @return True if the layer can be accessed as a @c float .
+  static bool validateLayer(const MapLayer &layer, bool is_occupancy_layer, OccupancyEncoding *encoding)
+  {
+    if (is_occupancy_layer && occupancyEncoding(layer, encoding))
+    {
+      return true;
+    }
+    *encoding = OccupancyEncoding::kFloat;
+    return layer.voxelByteSize() == sizeof(float);
+  }
+
+  /// Read the value for @p voxel_index from @p voxel_memory , converting from @p encoding .
+  /// @param voxel_memory Start of the voxel memory.
+  /// @param voxel_index Index of the voxel within @p voxel_memory .
+  /// @param[out] value The value read.
+  /// @param encoding The voxel memory encoding.
+  static void read(const uint8_t *voxel_memory, unsigned voxel_index, float *value, OccupancyEncoding encoding)
+  {
+    *value = readOccupancy(voxel_memory, voxel_index, encoding);
+  }
+
+  /// Write @p value for @p voxel_index to @p voxel_memory , converting to @p encoding .
+  /// @param voxel_memory Start of the voxel memory.
+  /// @param voxel_index Index of the voxel within @p voxel_memory .
+  /// @param value The value to write.
+  /// @param encoding The voxel memory encoding.
+  static void write(uint8_t *voxel_memory, unsigned voxel_index, const float &value, OccupancyEncoding encoding)
+  {
+    writeOccupancy(voxel_memory, voxel_index, value, encoding);
+  }
+};
+
 /// Internal helper to manage updating const/mutable chunks with the base as the mutable version.
 template <typename T>
 struct VoxelChunkAccess
@@ -55,12 +139,13 @@ struct VoxelChunkAccess
   /// @param voxel_memory Start of the voxel memory.
   /// @param voxel_index Index of the voxel within @p voxel_memory - strided by @c T .
   /// @param value The value to write.
+  /// @param encoding The voxel memory encoding - see @c VoxelValue .
   /// @param flags_change Flags to set in @p flags .
   /// @param flags Flags to modify by setting @p flags_change .
-  static void writeVoxel(uint8_t *voxel_memory, unsigned voxel_index, const T &value, unsigned flags_change,
-                         uint16_t *flags)
+  static void writeVoxel(uint8_t *voxel_memory, unsigned voxel_index, const T &value, OccupancyEncoding encoding,
+                         unsigned flags_change, uint16_t *flags)
   {
-    memcpy(voxel_memory + sizeof(T) * voxel_index, &value, sizeof(T));
+    VoxelValue<T>::write(voxel_memory, voxel_index, value, encoding);
     *flags |= flags_change;
   }
 };
@@ -95,8 +180,8 @@ struct VoxelChunkAccess<const T>
     (void)layer_index;
   }
 
-  static void writeVoxel(uint8_t voxel_memory, unsigned voxel_index, const T &value, unsigned flags_change,
-                         uint16_t *flags) = delete;
+  static void writeVoxel(uint8_t voxel_memory, unsigned voxel_index, const T &value, OccupancyEncoding encoding,
+                         unsigned flags_change, uint16_t *flags) = delete;
 };
 }  // namespace detail
 
@@ -107,6 +192,8 @@ struct VoxelChunkAccess<const T>
 /// the template type, supporting mutable and const access (see below). The template type is validated against
 /// the data in the proposed layer index by checking the size of @c T against the size of the data stored in the
 /// layer. The layer index is invalidated when the sizes do not match.
+/// The exception is a @c float @c Voxel on a quantised occupancy layer, which converts values on @c read() and
+/// @c write() - see @c OccupancyEncoding .
 ///
 /// A mutable @c Voxel is one where the template type @c T is non-const, while a const @c Voxel has a const template
 /// type @c T . Only a mutable @c Voxel can create new @c MapChunks within the @c OccupancyMap . This occurs
@@ -341,7 +428,7 @@ public:
   /// @param map The map to access and mutate for non-const @c Voxel types.
   /// @param layer_index The @c MapLayer to access for the type @c T .
   /// @param region_key The region coordinate key for the chunk to reference.
-  Voxel(MapTypePtr map, int layer_index, const glm::i16vec3 &region_key);
+  Voxel(MapTypePtr map, int layer_index, const RegionKey &region_key);
 
   /// Create a @c Voxel reference from a @c OccupancyMap::iterator (mutable @c Voxel ) or a
   /// @c OccupancyMap::const_iterator (const @c Voxel ). This is similar to using the
@@ -389,6 +476,11 @@ public:
   /// Query the status @c Error flag values for the voxel.
   /// @return The current error flags.
   inline unsigned errorFlags() const { return error_flags_; }
+  /// Query the @c OccupancyEncoding for the layer data. This is only ever other than @c OccupancyEncoding::kFloat
+  /// for a @c float @c Voxel referencing a quantised occupancy layer, in which case @c read() and @c write() convert
+  /// to and from float log-odds values.
+  /// @return The layer data encoding.
+  inline OccupancyEncoding encoding() const { return encoding_; }
 
   /// Set the voxel @c Key . This may create a @c MapChunk for a mutable @c Voxel .
   /// @param key The key for the voxel to reference. Must be non-null and in range.
@@ -435,7 +527,7 @@ public:
   /// @return The read value - i.e., `*value`.
   inline const DataType &read(DataType *value) const
   {
-    memcpy(value, voxel_memory_ + sizeof(T) * voxelIndex(), sizeof(T));
+    detail::VoxelValue<DataType>::read(voxel_memory_, voxelIndex(), value, encoding_);
     return *value;
   }
 
@@ -448,7 +540,7 @@ public:
   /// @param[in] value Value to write for the current voxel.
   inline void write(const DataType &value)
   {
-    detail::VoxelChunkAccess<T>::writeVoxel(voxel_memory_, voxelIndex(), value,
+    detail::VoxelChunkAccess<T>::writeVoxel(voxel_memory_, voxelIndex(), value, encoding_,
                                             unsigned(Flag::kTouchedChunk) | unsigned(Flag::kTouchedVoxel), &flags_);
   }
 
@@ -542,6 +634,7 @@ private:
   glm::u8vec3 layer_dim_{ 0, 0, 0 };     ///< The voxel dimensions of the layer.
   uint16_t flags_ = 0;                   ///< Current status/book keeping flags
   uint16_t error_flags_ = 0;             ///< Current error flags.
+  OccupancyEncoding encoding_ = OccupancyEncoding::kFloat;  ///< Layer data encoding. See @c VoxelValue .
 };
 
 
@@ -626,6 +719,7 @@ Voxel<T>::Voxel(const Voxel<T> &other)
   , layer_dim_(other.layer_dim_)
   , flags_(other.flags_ & ~unsigned(Flag::kNonPropagatingFlags))
   , error_flags_(other.error_flags_)
+  , encoding_(other.encoding_)
 {
   // Do not set chunk or voxel_memory_ pointers directly. Use the method call to ensure flags are correctly
   // maintained.
@@ -643,6 +737,7 @@ Voxel<T>::Voxel(Voxel<T> &&other) noexcept
   , layer_dim_(std::exchange(other.layer_dim_, glm::u8vec3(0, 0, 0)))
   , flags_(std::exchange(other.flags_, 0u))
   , error_flags_(std::exchange(other.error_flags_, 0u))
+  , encoding_(std::exchange(other.encoding_, OccupancyEncoding::kFloat))
 {}
 
 
@@ -684,7 +779,7 @@ Voxel<T>::Voxel(MapTypePtr map, int layer_index, const Key &key)
 
 
 template <typename T>
-Voxel<T>::Voxel(MapTypePtr map, int layer_index, const glm::i16vec3 &region_key)
+Voxel<T>::Voxel(MapTypePtr map, int layer_index, const RegionKey &region_key)
   : Voxel<T>(map, layer_index, Key(region_key, 0, 0, 0))
 {}
 
@@ -783,6 +878,7 @@ void Voxel<T>::swap(Voxel &other)
   std::swap(layer_dim_, other.layer_dim_);
   std::swap(flags_, other.flags_);
   std::swap(error_flags_, other.error_flags_);
+  std::swap(encoding_, other.encoding_);
 }
 
 
@@ -798,6 +894,7 @@ Voxel<T> &Voxel<T>::operator=(const Voxel<T> &other)
   layer_dim_ = other.layer_dim_;
   flags_ = other.flags_ & ~unsigned(Flag::kNonPropagatingFlags);
   error_flags_ = other.error_flags_;
+  encoding_ = other.encoding_;
   // Do not set chunk or voxel_memory_ pointers directly. Use the method call to ensure flags are correctly
   // maintained.
   voxel_memory_ = nullptr;  // About to be resolved in setChunk()
@@ -830,7 +927,8 @@ void Voxel<T>::validateLayer()
       // Invalid layer.
       error_flags_ |= unsigned(Error::kInvalidLayerIndex);
     }
-    else if (layer->voxelByteSize() != sizeof(T))
+    else if (!detail::VoxelValue<DataType>::validateLayer(*layer, layer_index_ == map_->layout().occupancyLayer(),
+                                                          &encoding_))
     {
       // Incorrect layer size.
       error_flags_ |= unsigned(Error::kVoxelSizeMismatch);
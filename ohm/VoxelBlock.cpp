@@ -28,9 +28,31 @@ const int kZLibMemLevel = 8;
 const int kCompressionStrategy = Z_DEFAULT_STRATEGY;
 
 const int kGZipCompressionFlag = 16;
+/// Window bits flag for @c inflateInit2() to auto detect zlib or gzip headers. Blocks of different layers may use
+/// different compression types.
+const int kAutoDetectHeaderFlag = 32;
 const unsigned kReleaseDelayMs = 500;
 /// When reserving compressed buffer space, device the uncompressed size by this factor.
 const unsigned kBufferReservationQutient = 10;
+
+int zlibCompressionLevel(VoxelBlock::CompressionLevel level)
+{
+  switch (level)
+  {
+  default:
+  case VoxelBlock::kCompressFast:
+    return Z_BEST_SPEED;
+  case VoxelBlock::kCompressBalanced:
+    return Z_DEFAULT_COMPRESSION;
+  case VoxelBlock::kCompressMax:
+    return Z_BEST_COMPRESSION;
+  }
+}
+
+inline const MapLayer::CompressionPolicy &layerCompressionPolicy(const OccupancyMapDetail *map, unsigned layer_index)
+{
+  return map->layout.layer(layer_index).compressionPolicy();
+}
 }  // namespace
 
 
@@ -65,20 +87,7 @@ void VoxelBlock::getCompressionControls(CompressionControls *controls)
 void VoxelBlock::setCompressionControls(const CompressionControls &controls)
 {
   g_minimum_buffer_size = (controls.minimum_buffer_size > 0) ? controls.minimum_buffer_size : g_minimum_buffer_size;
-  switch (controls.compression_level)
-  {
-  default:
-  case kCompressFast:
-    g_zlib_compression_level = Z_BEST_SPEED;
-    break;
-  case kCompressBalanced:
-    g_zlib_compression_level = Z_DEFAULT_COMPRESSION;
-    break;
-  case kCompressMax:
-    g_zlib_compression_level = Z_BEST_COMPRESSION;
-    break;
-  }
-
+  g_zlib_compression_level = zlibCompressionLevel(controls.compression_level);
   g_zlib_gzip_flag = (controls.compression_type == kCompressGZip) ? kGZipCompressionFlag : 0;
 }
 
@@ -88,13 +97,8 @@ VoxelBlock::VoxelBlock(const OccupancyMapDetail *map, const MapLayer &layer)
   , layer_index_(layer.layerIndex())
   , uncompressed_byte_size_(layer.layerByteSize(map->region_voxel_dimensions))
 {
-  initUncompressed(voxel_bytes_, layer);
-  flags_ |= kFUncompressed;
-  if (needsCompression())
-  {
-    std::unique_lock<Mutex> guard(access_guard_);
-    queueCompression(guard);
-  }
+  // Voxel memory is allocated on the first retain().
+  updateAccounting();
 }
 
 
@@ -105,9 +109,10 @@ void VoxelBlock::destroy()
 {
   // Don't use scoped lock as we will delete this which would make releasing the lock invalid.
   access_guard_.lock();
-  if (flags_ & kFCompressionQueued)
+  removeAccounting();
+  if ((flags_ & kFCompressionQueued) || reference_count_ > 0)
   {
-    // Currently queue. Mark for death. The compression queue will destroy it.
+    // Currently queued or referenced. Mark for death. The compression queue or the last release() will destroy it.
     flags_ |= kFMarkedForDeath;
     access_guard_.unlock();
   }
@@ -120,18 +125,68 @@ void VoxelBlock::destroy()
 }
 
 
+bool VoxelBlock::reset()
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  if (reference_count_ > 0 || (flags_ & kFCompressionQueued))
+  {
+    return false;
+  }
+
+  // Clear without releasing capacity so the memory can be reused.
+  voxel_bytes_.clear();
+  flags_ = 0;
+  updateAccounting();
+  return true;
+}
+
+
+bool VoxelBlock::isUninitialised() const
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  return voxel_bytes_.empty();
+}
+
+
+bool VoxelBlock::isCompressed() const
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  return !voxel_bytes_.empty() && !(flags_ & kFUncompressed);
+}
+
+
+size_t VoxelBlock::allocatedByteSize() const
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  return voxel_bytes_.capacity();
+}
+
+
 void VoxelBlock::retain()
 {
   std::unique_lock<Mutex> guard(access_guard_);
   ++reference_count_;
   // Ensure uncompressed data are available.
-  if (!(flags_ & kFUncompressed))
+  if (voxel_bytes_.empty())
+  {
+    // Lazy initialisation. Allocate and clear directly into the voxel buffer.
+    initUncompressed(voxel_bytes_, map_->layout.layer(layer_index_));
+    flags_ |= kFUncompressed;
+  }
+  else if (!(flags_ & kFUncompressed))
   {
     std::vector<uint8_t> working_buffer;
     uncompressUnguarded(working_buffer);
     voxel_bytes_.swap(working_buffer);
     flags_ |= kFUncompressed;
   }
+  updateAccounting();
+}
+
+void VoxelBlock::addReference()
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  ++reference_count_;
 }
 
 void VoxelBlock::release()
@@ -140,7 +195,16 @@ void VoxelBlock::release()
   if (reference_count_ > 0)
   {
     --reference_count_;
-    if (needsCompression())
+    if (flags_ & kFMarkedForDeath)
+    {
+      if (reference_count_ == 0 && !(flags_ & kFCompressionQueued))
+      {
+        // Destroyed while referenced. Delete with the access guard held, as for the compression queue.
+        guard.release();
+        delete this;
+      }
+    }
+    else if (needsCompression())
     {
       queueCompression(guard);
     }
@@ -152,16 +216,47 @@ void VoxelBlock::compressInto(std::vector<uint8_t> &compression_buffer)
   std::unique_lock<Mutex> guard(access_guard_);
 
   // Handle uninitialised buffer. We may not have initialised the buffer yet, but this call requires data to be
-  // compressed such as when used for serialisation to disk.
+  // compressed such as when used for serialisation to disk. We temporarily initialise the buffer, then restore the
+  // uninitialised state so we do not hold the memory.
   if (voxel_bytes_.empty())
   {
     initUncompressed(voxel_bytes_, map_->layout.layer(layer_index_));
     flags_ |= kFUncompressed;
+    compressUnguarded(compression_buffer);
+    std::vector<uint8_t>().swap(voxel_bytes_);
+    flags_ &= ~kFUncompressed;
+    updateAccounting();
+    return;
   }
 
   compressUnguarded(compression_buffer);
 }
 
+size_t VoxelBlock::compact(bool compress)
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  if (reference_count_ > 0)
+  {
+    return 0;
+  }
+
+  const size_t initial_capacity = voxel_bytes_.capacity();
+  if (compress && needsCompression())
+  {
+    // Compress now. Should the block also be on the compression queue, the queue finds it already compressed.
+    std::vector<uint8_t> compression_buffer;
+    if (compressUnguarded(compression_buffer))
+    {
+      voxel_bytes_.swap(compression_buffer);
+      flags_ &= ~kFUncompressed;
+    }
+  }
+  voxel_bytes_.shrink_to_fit();
+  updateAccounting();
+
+  return (initial_capacity > voxel_bytes_.capacity()) ? initial_capacity - voxel_bytes_.capacity() : 0u;
+}
+
 VoxelBlock::Clock::time_point VoxelBlock::releaseAfter() const
 {
   std::unique_lock<Mutex> guard(access_guard_);
@@ -172,21 +267,44 @@ void VoxelBlock::updateLayerIndex(unsigned layer_index)
 {
   std::unique_lock<Mutex> guard(access_guard_);
   layer_index_ = layer_index;
+  updateAccounting();
+}
+
+VoxelBlockState VoxelBlock::state() const
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  return stateUnguarded();
 }
 
 bool VoxelBlock::needsCompression() const
 {
-  return reference_count_ == 0 && (flags_ & kFUncompressed) &&
-         (map_->flags & MapFlag::kCompressed) == MapFlag::kCompressed;
+  if (reference_count_ != 0 || !(flags_ & kFUncompressed))
+  {
+    return false;
+  }
+
+  switch (layerCompressionPolicy(map_, layer_index_).mode)
+  {
+  case MapLayer::CompressionPolicy::kNever:
+    return false;
+  case MapLayer::CompressionPolicy::kAlways:
+    return true;
+  default:
+    break;
+  }
+  return (map_->flags & MapFlag::kCompressed) == MapFlag::kCompressed;
 }
 
 void VoxelBlock::queueCompression(std::unique_lock<Mutex> &guard)
 {
-  release_after_ = Clock::now() + std::chrono::milliseconds(kReleaseDelayMs);
+  const int release_delay_ms = layerCompressionPolicy(map_, layer_index_).release_delay_ms;
+  release_after_ = Clock::now() + std::chrono::milliseconds((release_delay_ms >= 0) ? unsigned(release_delay_ms) :
+                                                                                       kReleaseDelayMs);
   if (!(flags_ & kFCompressionQueued))
   {
     // This flag will be cleared when processed for compression.
     flags_ |= kFCompressionQueued;
+    updateAccounting();
     guard.unlock();
     // Add to compression queue.
     VoxelBlockCompressionQueue::instance().push(this);
@@ -197,11 +315,20 @@ bool VoxelBlock::compressUnguarded(std::vector<uint8_t> &compression_buffer)
 {
   if (flags_ & kFUncompressed)
   {
+    int compression_level = g_zlib_compression_level;
+    int gzip_flag = g_zlib_gzip_flag;
+    const MapLayer::CompressionPolicy &policy = layerCompressionPolicy(map_, layer_index_);
+    if (policy.override_codec)
+    {
+      compression_level = zlibCompressionLevel(policy.level);
+      gzip_flag = (policy.type == kCompressGZip) ? kGZipCompressionFlag : 0;
+    }
+
     int ret = Z_OK;
     z_stream stream;
     memset(&stream, 0u, sizeof(stream));
     // NOLINTNEXTLINE(hicpp-signed-bitwise)
-    deflateInit2(&stream, g_zlib_compression_level, Z_DEFLATED, kWindowBits | g_zlib_gzip_flag, kZLibMemLevel,
+    deflateInit2(&stream, compression_level, Z_DEFLATED, kWindowBits | gzip_flag, kZLibMemLevel,
                  kCompressionStrategy);
 
     stream.next_in = static_cast<Bytef *>(voxel_bytes_.data());
@@ -299,7 +426,7 @@ bool VoxelBlock::uncompressUnguarded(std::vector<uint8_t> &expanded_buffer)
   int ret = Z_OK;
   z_stream stream;
   memset(&stream, 0u, sizeof(stream));
-  inflateInit2(&stream, kWindowBits | g_zlib_gzip_flag);  // NOLINT(hicpp-signed-bitwise)
+  inflateInit2(&stream, kWindowBits | kAutoDetectHeaderFlag);  // NOLINT(hicpp-signed-bitwise)
 
   stream.avail_in = unsigned(voxel_bytes_.size());
   stream.next_in = voxel_bytes_.data();
@@ -374,6 +501,7 @@ bool VoxelBlock::setCompressedBytes(const std::vector<uint8_t> &compressed_voxel
     voxel_bytes_.shrink_to_fit();
     // Clear uncompressed flag.
     flags_ &= ~(kFUncompressed | kFCompressionQueued);
+    updateAccounting();
     if (flags_ & kFMarkedForDeath)
     {
       // fprintf(stderr, "0x%" PRIXPTR ", VoxelBlock::setCompressedBytes()\n", (uintptr_t)this);
@@ -383,4 +511,55 @@ bool VoxelBlock::setCompressedBytes(const std::vector<uint8_t> &compressed_voxel
   }
   return false;
 }
+
+
+VoxelBlockState VoxelBlock::stateUnguarded() const
+{
+  if (voxel_bytes_.empty())
+  {
+    return VoxelBlockState::kUniform;
+  }
+  if (!(flags_ & kFUncompressed))
+  {
+    return VoxelBlockState::kCompressed;
+  }
+  return (flags_ & kFCompressionQueued) ? VoxelBlockState::kCompressionQueued : VoxelBlockState::kUncompressed;
+}
+
+
+void VoxelBlock::updateAccounting()
+{
+  if (flags_ & kFMarkedForDeath)
+  {
+    // No longer part of the map.
+    return;
+  }
+
+  const VoxelBlockState state = stateUnguarded();
+  const size_t byte_count = voxel_bytes_.capacity();
+  if (accounted_layer_ == layer_index_ && accounted_state_ == state && accounted_bytes_ == byte_count)
+  {
+    return;
+  }
+
+  removeAccounting();
+  LayerMemoryCounters &counters = map_->layerMemoryCounters(layer_index_);
+  counters.block_count[unsigned(state)].fetch_add(1u, std::memory_order_relaxed);
+  counters.byte_count[unsigned(state)].fetch_add(byte_count, std::memory_order_relaxed);
+  accounted_layer_ = layer_index_;
+  accounted_state_ = state;
+  accounted_bytes_ = byte_count;
+}
+
+
+void VoxelBlock::removeAccounting()
+{
+  if (accounted_layer_ != ~0u)
+  {
+    LayerMemoryCounters &counters = map_->layerMemoryCounters(accounted_layer_);
+    counters.block_count[unsigned(accounted_state_)].fetch_sub(1u, std::memory_order_relaxed);
+    counters.byte_count[unsigned(accounted_state_)].fetch_sub(accounted_bytes_, std::memory_order_relaxed);
+  }
+  accounted_layer_ = ~0u;
+}
 }  // namespace ohm
@@ -8,6 +8,7 @@
 
 #include "OhmConfig.h"
 
+#include "MapMemoryUsage.h"
 #include "Mutex.h"
 
 #include <glm/fwd.hpp>
@@ -27,11 +28,17 @@ struct OccupancyMapDetail;
 /// A utility class used to track the memory for a dense voxel layer in a @c MapChunk. This class ensures voxel memory
 /// is uncompressed when requested and compressed using the background compression thread when no longer needed.
 ///
+/// Voxel memory is lazily allocated. A new block holds no voxel memory and is considered to be uninitialised - see
+/// @c isUninitialised() - with all voxels implicitly holding the default value for the layer as defined by
+/// @c MapLayer::clear(). Memory is allocated and cleared on the first @c retain() . Bulk readers may check
+/// @c isUninitialised() to treat the whole block as default valued without forcing allocation.
+///
 /// Internally the @c VoxelBlock allocates or decompresses voxel memory for its associated @c MapLayer
 /// (@c layerInfo()) when @c retain() is called. It then maintains a reference count for the number of @c retain()
 /// calls ensuring uncompressed voxel data remain valid until all references are by calling @c release(). The block is
 /// then passed to the background compression thread when the last reference is released. The level of compression
-/// can be globally set using the static @c setCompressionControls() function.
+/// can be globally set using the static @c setCompressionControls() function and overridden per layer by
+/// @c MapLayer::setCompressionPolicy() .
 ///
 /// Typically, @c retain() and @c release() should not be called directly. Instead user code should use the @c Voxel
 /// data access object. This object manages multiple aspects of voxel data access including ensuring @c retain() and
@@ -74,7 +81,8 @@ public:
     kFUncompressed = (1u << 0u),
     /// Block is queued for compression.
     kFCompressionQueued = (1u << 1u),
-    /// Block is to be deleted. Only set when the block should be deleted but is currently on the compression thread.
+    /// Block is to be deleted. Only set when the block should be deleted but is currently on the compression thread or
+    /// referenced.
     kFMarkedForDeath = (1u << 2u)
   };
 
@@ -134,9 +142,10 @@ private:
 public:
   /// Delete and destroy this object; use in place of <tt>delete voxel_block</tt>.
   ///
-  /// This will either immediately delete the @c VoxelBlock or mark it for deletion by the compression thread.
-  /// As such, the object instance should no longer be used after making this call, but it may persist until the
-  /// background thread releases it.
+  /// This will either immediately delete the @c VoxelBlock or mark it for deletion by the compression thread, or by
+  /// the last @c release() call while the block remains referenced. As such, the object instance should no longer be
+  /// used after making this call, except to @c release() outstanding references, but it may persist until the
+  /// background thread or the last reference releases it.
   void destroy();
 
   /// Static overload to destroy the @p block for use with @c std::unique_ptr . Calls through to the instance overload
@@ -144,6 +153,27 @@ public:
   /// @param block The object to destroy.
   inline static void destroy(VoxelBlock *block) { block->destroy(); }
 
+  /// Reset the block to the uninitialised state, discarding the voxel content but retaining the buffer capacity for
+  /// reuse. This fails if the block is currently retained or queued for compression. For internal use in recycling
+  /// @c MapChunk objects.
+  /// @return True if the block has been reset, false if the block is in use.
+  bool reset();
+
+  /// Query if the block voxel memory has yet to be allocated. An uninitialised block has never been retained (or has
+  /// been @c reset() ) and all voxels implicitly have the default layer value.
+  /// @return True if the voxel memory has not been allocated.
+  bool isUninitialised() const;
+
+  /// Query if the block voxel memory is currently held in compressed form. A @c retain() call on a compressed block
+  /// blocks while the voxel memory is decompressed.
+  /// @return True if the voxel memory is allocated and compressed.
+  bool isCompressed() const;
+
+  /// Query the heap memory currently allocated for the voxel bytes. This is the buffer capacity, which may exceed the
+  /// compressed or uncompressed data size.
+  /// @return The allocated voxel buffer size in bytes.
+  size_t allocatedByteSize() const;
+
   /// Size of a single voxel in the map.
   /// @return The size of a voxel in bytes.
   size_t perVoxelByteSize() const;
@@ -155,17 +185,30 @@ public:
   /// Retain the uncompressed voxel memory until a corresponding @c release() call. Not recommended; use
   /// @c voxelBuffer().
   ///
-  /// This call may block while the voxel memory is uncompressed or allocated an initialised.
+  /// This call may block while the voxel memory is uncompressed or allocated and initialised. Memory for an
+  /// uninitialised block is allocated and cleared here.
   void retain();
 
+  /// Add a reference to the block without uncompressing or allocating the voxel memory. The block remains valid
+  /// until a matching @c release() call, even if it is destroyed in the meantime. For internal use by background
+  /// loaders which resolve blocks under the map lock and @c retain() them after releasing the lock.
+  void addReference();
+
   /// Release the uncompressed voxel memory until a corresponding @c release() call. Not recommended; use
   /// @c voxelBuffer().
   void release();
 
+  /// Reduce the memory held by an unreferenced block. Uncompressed voxel memory is compressed immediately rather than
+  /// waiting for the background compression thread (when the map enables compression), and any excess buffer
+  /// capacity is freed. Blocks which are currently retained are left unchanged.
+  /// @param compress False to only free excess capacity, leaving compression to the background thread.
+  /// @return The number of bytes freed.
+  size_t compact(bool compress = true);
+
   /// Compress the voxel data into @p compression_buffer. Writes the current voxel bytes when already compressed.
   ///
-  /// @note This may initialise the buffer if empty, so that this method can be used for serialisation of the map to
-  ///   disk.
+  /// @note An uninitialised block compresses the default voxel content without retaining the allocation, so that this
+  ///   method can be used for serialisation of the map to disk.
   /// @param[in,out] compression_buffer Buffer to write compression data into. Resized to the compressed data size.
   void compressInto(std::vector<uint8_t> &compression_buffer);
 
@@ -181,6 +224,10 @@ public:
   /// @return Voxel bytes.
   const uint8_t *voxelBytes() const;
 
+  /// Query the current memory accounting state of the block.
+  /// @return The block memory state.
+  VoxelBlockState state() const;
+
   /// Internal function for updating the layer index value when remapping layouts. For internal use.
   /// @param layer_index The new layer index.
   void updateLayerIndex(unsigned layer_index);
@@ -216,6 +263,13 @@ private:
   /// @return True on success when there are no retained references.
   bool setCompressedBytes(const std::vector<uint8_t> &compressed_voxels);
 
+  /// Resolve the memory accounting state. Mutex is not locked.
+  VoxelBlockState stateUnguarded() const;
+  /// Update the map memory accounting after a change in the block state or allocation. Mutex is not locked.
+  void updateAccounting();
+  /// Remove the block's contribution from the map memory accounting. Mutex is not locked.
+  void removeAccounting();
+
   /// Voxel data.
   ///
   /// This data can be in one of three states:
@@ -237,6 +291,12 @@ private:
   unsigned layer_index_ = 0;
   /// Byte size of this voxel block when uncompressed.
   size_t uncompressed_byte_size_ = 0;
+  /// Layer index under which the block is currently accounted in the map memory usage. ~0u when not accounted.
+  unsigned accounted_layer_ = ~0u;
+  /// State under which the block is currently accounted.
+  VoxelBlockState accounted_state_ = VoxelBlockState::kUniform;
+  /// Bytes currently accounted for the block.
+  size_t accounted_bytes_ = 0;
 };
 
 inline uint8_t *VoxelBlock::voxelBytes()
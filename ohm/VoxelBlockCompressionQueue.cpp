@@ -126,6 +126,13 @@ void VoxelBlockCompressionQueue::run()
         // Marked for death. Clean it up.
         // Lock access guard to make sure the code that sets the flag has completed
         voxels->access_guard_.lock();
+        if (voxels->reference_count_ > 0)
+        {
+          // Still referenced. The last release() deletes it.
+          voxels->flags_ &= ~VoxelBlock::kFCompressionQueued;
+          voxels->access_guard_.unlock();
+          continue;
+        }
         // fprintf(stderr, "0x%" PRIXPTR ", VoxelBlockCompressionQueue\n", (uintptr_t)voxels);
         delete voxels;
       }
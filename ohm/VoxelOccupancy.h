@@ -153,6 +153,17 @@ inline OccupancyType occupancyType(const Voxel<const float> &voxel)
   return occupancyTypeT(voxel);
 }
 
+/// @ingroup voxeloccupancy
+/// Return @c true if @p value represents an occupied voxel for the given occupancy @p threshold . This is the
+/// occupancy test shared by the ray mappers and ray casting.
+/// @param value The occupancy value to test.
+/// @param threshold The occupancy threshold value - see @c OccupancyMap::occupancyThresholdValue() .
+/// @return True if occupied.
+inline bool isOccupied(float value, float threshold)
+{
+  return value != unobservedOccupancyValue() && value >= threshold;
+}
+
 /// @ingroup voxeloccupancy
 /// Return @c true if @p value represents an occupied voxel within @p map .
 /// @param value The occupancy value to test.
@@ -160,7 +171,7 @@ inline OccupancyType occupancyType(const Voxel<const float> &voxel)
 /// @return True if occupied.
 inline bool isOccupied(float value, const OccupancyMap &map)
 {
-  return value != unobservedOccupancyValue() && value >= map.occupancyThresholdValue();
+  return isOccupied(value, map.occupancyThresholdValue());
 }
 
 template <typename T>
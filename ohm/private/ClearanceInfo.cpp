@@ -0,0 +1,89 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ClearanceInfo.h"
+
+#include "MapChunk.h"
+#include "MapInfo.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+
+#include "OccupancyMapDetail.h"
+
+#include <mutex>
+
+namespace ohm
+{
+void ClearanceInfo::fromMapInfo(const MapInfo &info)
+{
+  valid = bool(info.get("clearance"));
+  if (!valid)
+  {
+    *this = ClearanceInfo();
+    return;
+  }
+  search_radius = float(info.get("clearance-radius"));
+  axis_scaling.x = float(info.get("clearance-axis-scaling-x"));
+  axis_scaling.y = float(info.get("clearance-axis-scaling-y"));
+  axis_scaling.z = float(info.get("clearance-axis-scaling-z"));
+  unknown_as_occupied = bool(info.get("clearance-unknown-as-occupied"));
+  report_unscaled = bool(info.get("clearance-report-unscaled"));
+}
+
+
+void ClearanceInfo::toMapInfo(MapInfo &info) const
+{
+  info.set(MapValue("clearance", true));
+  info.set(MapValue("clearance-radius", search_radius));
+  info.set(MapValue("clearance-axis-scaling-x", axis_scaling.x));
+  info.set(MapValue("clearance-axis-scaling-y", axis_scaling.y));
+  info.set(MapValue("clearance-axis-scaling-z", axis_scaling.z));
+  info.set(MapValue("clearance-unknown-as-occupied", unknown_as_occupied));
+  info.set(MapValue("clearance-report-unscaled", report_unscaled));
+}
+
+
+bool ClearanceInfo::supports(float radius, bool unknown, const glm::vec3 &scaling) const
+{
+  if (!valid || search_radius < radius || unknown_as_occupied != unknown || axis_scaling != scaling)
+  {
+    return false;
+  }
+  // Unscaled reporting only changes the values with non-unit scaling.
+  return !report_unscaled || scaling == glm::vec3(1.0f);
+}
+
+
+bool ClearanceInfo::operator==(const ClearanceInfo &other) const
+{
+  return search_radius == other.search_radius && axis_scaling == other.axis_scaling &&
+         unknown_as_occupied == other.unknown_as_occupied && report_unscaled == other.report_unscaled;
+}
+
+
+void updateClearanceInfo(OccupancyMap &map, const ClearanceInfo &info)
+{
+  ClearanceInfo recorded;
+  recorded.fromMapInfo(map.mapInfo());
+  if (recorded.valid && recorded == info)
+  {
+    return;
+  }
+
+  const int clearance_layer = map.layout().clearanceLayer();
+  if (clearance_layer >= 0)
+  {
+    // Existing values were calculated with different or unknown parameters.
+    const OccupancyMapDetail &map_data = *map.detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    for (auto &chunk_ref : map_data.chunks)
+    {
+      chunk_ref.second->touched_stamps[clearance_layer] = 0u;
+    }
+  }
+
+  info.toMapInfo(map.mapInfo());
+}
+}  // namespace ohm
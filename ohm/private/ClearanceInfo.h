@@ -0,0 +1,68 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_CLEARANCEINFO_H
+#define OHM_CLEARANCEINFO_H
+
+#include "OhmConfig.h"
+
+#include <glm/glm.hpp>
+
+namespace ohm
+{
+class MapInfo;
+class OccupancyMap;
+
+/// The parameters the clearance layer values have been calculated with. This is recorded in the @c MapInfo by the
+/// clearance processes so queries can validate clearance values before using them in place of a brute force search.
+struct ohm_API ClearanceInfo
+{
+  /// Search radius the clearance values were calculated with.
+  float search_radius = 0;
+  /// Axis scaling the clearance values were calculated with.
+  glm::vec3 axis_scaling{ 1.0f };
+  /// Were unobserved voxels treated as obstructions? See @c kQfUnknownAsOccupied .
+  bool unknown_as_occupied = false;
+  /// Were scaled distances reported unscaled? See @c kQfReportUnscaledResults .
+  bool report_unscaled = false;
+  /// False when the map records no clearance parameters.
+  bool valid = false;
+
+  /// Read the clearance parameters from @p info . The result is not @c valid when @p info holds no clearance
+  /// parameters.
+  /// @param info The map info to read.
+  void fromMapInfo(const MapInfo &info);
+
+  /// Write the clearance parameters to @p info .
+  /// @param info The map info to write to.
+  void toMapInfo(MapInfo &info) const;
+
+  /// Check whether clearance values calculated with these parameters can be used in place of a nearest obstruction
+  /// search with the given parameters. This requires the same obstruction and distance definitions and a search radius
+  /// at least as large as @p search_radius .
+  /// @param search_radius The search radius required.
+  /// @param unknown_as_occupied Are unobserved voxels required to be obstructions?
+  /// @param scaling The axis scaling required. Distances must be reported scaled unless this is unit scaling.
+  /// @return True if the clearance values satisfy the given parameters.
+  bool supports(float search_radius, bool unknown_as_occupied, const glm::vec3 &scaling = glm::vec3(1.0f)) const;
+
+  /// Equality comparison, ignoring @c valid .
+  /// @param other The info to compare to.
+  /// @return True if the parameters match.
+  bool operator==(const ClearanceInfo &other) const;
+};
+
+/// Record the clearance parameters @p info in the @p map info. Clearance values calculated with different parameters
+/// are invalidated by resetting the clearance layer @c MapChunk::touched_stamps to zero. This marks them as never
+/// calculated so they are recalculated by the clearance process and ignored by queries until then.
+///
+/// The map mutex must not be locked.
+///
+/// @param map The map to update. Must have a clearance layer.
+/// @param info The clearance parameters to record.
+void ohm_API updateClearanceInfo(OccupancyMap &map, const ClearanceInfo &info);
+}  // namespace ohm
+
+#endif  // OHM_CLEARANCEINFO_H
@@ -8,6 +8,8 @@
 
 #include "OhmConfig.h"
 
+#include "ohm/RayFlag.h"
+
 #include <glm/glm.hpp>
 
 #include <vector>
@@ -20,6 +22,7 @@ struct ClearingPatternDetail
 {
   std::vector<glm::dvec3> ray_set;
   const RayPattern *pattern = nullptr;
+  unsigned ray_flags = kRfEndPointAsFree | kRfStopOnFirstOccupied | kRfClearOnly;
   bool has_pattern_ownership = false;
 };
 }  // namespace ohm
@@ -0,0 +1,611 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "DynamicEdt.h"
+
+#include "ohm/MapChunk.h"
+#include "ohm/MapLayout.h"
+#include "ohm/OccupancyEncoding.h"
+#include "ohm/OccupancyMap.h"
+#include "ohm/VoxelBuffer.h"
+#include "ohm/VoxelOccupancy.h"
+
+#include "OccupancyMapDetail.h"
+#include "VoxelAlgorithms.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace ohm
+{
+namespace
+{
+/// Minimum squared axis weighting. Avoids degenerate distances for zero axis scaling.
+const float kMinWeightSqr = 1e-6f;
+const int kMaxOffset = std::numeric_limits<int16_t>::max();
+/// Obstruction offset marking a voxel with no known obstruction.
+const glm::i16vec3 kNoObstruction(std::numeric_limits<int16_t>::min());
+
+enum StateFlag : uint8_t
+{
+  /// The voxel is currently an obstruction.
+  kFObstructed = (1u << 0u),
+  /// The voxel is queued to propagate a raise wave.
+  kFRaise = (1u << 1u)
+};
+
+/// Offsets to the 26 neighbours of a voxel.
+const std::array<glm::ivec3, 26> &neighbourOffsets()
+{
+  static const std::array<glm::ivec3, 26> offsets = []() {
+    std::array<glm::ivec3, 26> init{};
+    size_t next = 0;
+    for (int z = -1; z <= 1; ++z)
+    {
+      for (int y = -1; y <= 1; ++y)
+      {
+        for (int x = -1; x <= 1; ++x)
+        {
+          if (x || y || z)
+          {
+            init[next++] = glm::ivec3(x, y, z);
+          }
+        }
+      }
+    }
+    return init;
+  }();
+  return offsets;
+}
+
+inline bool operator==(const DynamicEdt::Params &a, const DynamicEdt::Params &b)
+{
+  return a.search_radius == b.search_radius && a.axis_scaling == b.axis_scaling &&
+         a.unknown_as_occupied == b.unknown_as_occupied && a.report_unscaled == b.report_unscaled;
+}
+}  // namespace
+
+
+/// Distance state for the voxels of one region.
+struct DynamicEdt::RegionState
+{
+  /// Scaled, squared distance to the nearest obstruction in voxel units.
+  std::vector<float> dist_sqr;
+  /// Offset to the nearest obstruction or @c kNoObstruction .
+  std::vector<glm::i16vec3> obstruction;
+  /// @c StateFlag values.
+  std::vector<uint8_t> flags;
+  /// Occupancy layer @c MapChunk::touched_stamps value when last checked for changes.
+  uint64_t occupancy_stamp = 0;
+  /// Is the region present in the map as of the last check?
+  bool present = false;
+  /// Have the distances changed since the clearance layer was last written?
+  bool modified = false;
+
+  /// Initialise all voxels as obstructions or all clear.
+  RegionState(size_t volume, bool obstructed)
+    : dist_sqr(volume, (obstructed) ? 0.0f : std::numeric_limits<float>::infinity())
+    , obstruction(volume, (obstructed) ? glm::i16vec3(0) : kNoObstruction)
+    , flags(volume, (obstructed) ? uint8_t(kFObstructed) : uint8_t(0u))
+  {}
+};
+
+
+DynamicEdt::DynamicEdt() = default;
+
+
+DynamicEdt::~DynamicEdt() = default;
+
+
+void DynamicEdt::reset()
+{
+  regions_.clear();
+  open_ = decltype(open_)();
+  stamp_regions_.clear();
+  cached_state_ = nullptr;
+  seeded_ = false;
+}
+
+
+bool DynamicEdt::isSeeded(const OccupancyMap &map, const Params &params) const
+{
+  return seeded_ && params == params_ && region_dim_ == glm::ivec3(map.regionVoxelDimensions());
+}
+
+
+void DynamicEdt::beginSeed(const OccupancyMap &map, const Params &params)
+{
+  reset();
+  setParams(map, params);
+}
+
+
+void DynamicEdt::seed(const RegionSeed &region_seed)
+{
+  const size_t volume = size_t(region_dim_.x) * region_dim_.y * region_dim_.z;
+  std::unique_ptr<RegionState> region(new RegionState(volume, false));
+  bool have_distance = false;
+  for (size_t i = 0; i < volume; ++i)
+  {
+    const float dist_sqr = region_seed.dist_sqr[i];
+    if (dist_sqr == 0)
+    {
+      region->flags[i] = kFObstructed;
+      region->dist_sqr[i] = 0.0f;
+      region->obstruction[i] = glm::i16vec3(0);
+      have_distance = true;
+    }
+    else if (dist_sqr <= max_dist_sqr_)
+    {
+      region->dist_sqr[i] = dist_sqr;
+      region->obstruction[i] = region_seed.obstruction[i];
+      have_distance = true;
+    }
+  }
+
+  region->present = region_seed.present;
+  region->occupancy_stamp = region_seed.occupancy_stamp;
+  if (region->present || have_distance)
+  {
+    regions_[region_seed.key] = std::move(region);
+    cached_state_ = nullptr;
+  }
+}
+
+
+void DynamicEdt::endSeed()
+{
+  seeded_ = true;
+}
+
+
+DynamicEdt::Stats DynamicEdt::update(OccupancyMap &map, const Params &params, double time_slice)
+{
+  Stats stats;
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const int clearance_layer = map.layout().clearanceLayer();
+  if (occupancy_layer < 0 || clearance_layer < 0)
+  {
+    return stats;
+  }
+
+  if (!isSeeded(map, params))
+  {
+    // Build the state by treating every obstruction as a change.
+    reset();
+    setParams(map, params);
+    seeded_ = true;
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  const auto start_time = Clock::now();
+
+  // Only look for further changes once the current wavefronts are complete.
+  if (open_.empty())
+  {
+    // Find regions with changed occupancy and regions which have been removed.
+    struct ChangedRegion
+    {
+      RegionKey key;
+      const MapChunk *chunk;
+      uint64_t occupancy_stamp;
+    };
+    std::vector<ChangedRegion> changed;
+    {
+      const OccupancyMapDetail &map_data = *map.detail();
+      std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+      for (const auto &chunk_ref : map_data.chunks)
+      {
+        const uint64_t occupancy_stamp = chunk_ref.second->touched_stamps[occupancy_layer];
+        const auto search = regions_.find(chunk_ref.first);
+        if (search == regions_.end() || !search->second->present ||
+            search->second->occupancy_stamp != occupancy_stamp)
+        {
+          changed.emplace_back(ChangedRegion{ chunk_ref.first, chunk_ref.second, occupancy_stamp });
+        }
+      }
+
+      for (const auto &region_ref : regions_)
+      {
+        if (region_ref.second->present && map_data.chunks.find(region_ref.first) == map_data.chunks.end())
+        {
+          changed.emplace_back(ChangedRegion{ region_ref.first, nullptr, 0 });
+        }
+      }
+    }
+
+    // Seed wavefronts from voxels with changed obstruction state.
+    const OccupancyEncoding encoding = map.occupancyEncoding();
+    const float occupancy_threshold = map.occupancyThresholdValue();
+    for (const ChangedRegion &changed_region : changed)
+    {
+      RegionState &region = *state(changed_region.key, true);
+      const glm::ivec3 region_origin = glm::ivec3(changed_region.key) * region_dim_;
+      const bool have_voxels =
+        changed_region.chunk && !changed_region.chunk->voxel_blocks[occupancy_layer]->isUninitialised();
+      VoxelBuffer<const VoxelBlock> occupancy_buffer;
+      if (have_voxels)
+      {
+        occupancy_buffer = VoxelBuffer<const VoxelBlock>(changed_region.chunk->voxel_blocks[occupancy_layer]);
+      }
+
+      unsigned voxel_index = 0;
+      glm::ivec3 local;
+      for (local.z = 0; local.z < region_dim_.z; ++local.z)
+      {
+        for (local.y = 0; local.y < region_dim_.y; ++local.y)
+        {
+          for (local.x = 0; local.x < region_dim_.x; ++local.x, ++voxel_index)
+          {
+            // Absent regions and uninitialised blocks are unobserved.
+            bool obstructed = params.unknown_as_occupied;
+            if (have_voxels)
+            {
+              const float value = readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, encoding);
+              const bool unobserved = value == unobservedOccupancyValue();
+              obstructed = (unobserved) ? params.unknown_as_occupied : value >= occupancy_threshold;
+            }
+
+            if (bool(region.flags[voxel_index] & kFObstructed) != obstructed)
+            {
+              setObstruction(region, voxel_index, region_origin + local, obstructed);
+              ++stats.changed_voxels;
+            }
+          }
+        }
+      }
+
+      // New regions need their clearance values written.
+      region.modified = region.modified || (changed_region.chunk && !region.present);
+      region.present = changed_region.chunk != nullptr;
+      region.occupancy_stamp = changed_region.occupancy_stamp;
+      stamp_regions_.emplace_back(changed_region.key);
+    }
+    stats.regions_checked = changed.size();
+  }
+
+  // Propagate the wavefronts, checking the time slice periodically.
+  const size_t time_check_interval = 256u;
+  while (!open_.empty())
+  {
+    if (time_slice > 0 && stats.processed_voxels && stats.processed_voxels % time_check_interval == 0 &&
+        std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start_time).count() >= time_slice)
+    {
+      break;
+    }
+
+    const QueueItem item = open_.top();
+    open_.pop();
+
+    unsigned index = 0;
+    RegionState *region = cellState(item.coord, &index, false);
+    if (!region)
+    {
+      continue;
+    }
+
+    ++stats.processed_voxels;
+    if (region->flags[index] & kFRaise)
+    {
+      raise(item.coord);
+    }
+    else if (item.dist_sqr <= region->dist_sqr[index] && region->obstruction[index] != kNoObstruction &&
+             isObstructed(item.coord + glm::ivec3(region->obstruction[index])))
+    {
+      lower(item.coord, *region, index);
+    }
+  }
+
+  if (!open_.empty())
+  {
+    stats.pending_voxels = open_.size();
+    return stats;
+  }
+
+  // Write clearance values for modified regions.
+  const float resolution = float(map.resolution());
+  const float resolution_sqr = resolution * resolution;
+  const float search_radius_sqr = std::max(params.search_radius, 0.0f) * std::max(params.search_radius, 0.0f);
+  const size_t region_volume = size_t(region_dim_.x) * region_dim_.y * region_dim_.z;
+  std::vector<float> clearance(region_volume);
+  for (auto &region_ref : regions_)
+  {
+    RegionState &region = *region_ref.second;
+    if (!region.modified || !region.present)
+    {
+      continue;
+    }
+
+    MapChunk *chunk = map.region(region_ref.first, false);
+    if (!chunk)
+    {
+      continue;
+    }
+
+    for (size_t i = 0; i < region_volume; ++i)
+    {
+      float range = -1.0f;
+      if (region.flags[i] & kFObstructed)
+      {
+        range = 0.0f;
+      }
+      else if (region.obstruction[i] != kNoObstruction)
+      {
+        float range_sqr = region.dist_sqr[i] * resolution_sqr;
+        if (params.report_unscaled)
+        {
+          const glm::vec3 separation(region.obstruction[i]);
+          range_sqr = glm::dot(separation, separation) * resolution_sqr;
+        }
+
+        if (range_sqr <= search_radius_sqr)
+        {
+          range = std::sqrt(range_sqr);
+        }
+      }
+      clearance[i] = range;
+    }
+
+    VoxelBuffer<VoxelBlock> clearance_buffer(chunk->voxel_blocks[clearance_layer]);
+    memcpy(clearance_buffer.voxelMemory(), clearance.data(),
+           std::min(clearance_buffer.voxelMemorySize(), clearance.size() * sizeof(float)));
+    region.modified = false;
+    stamp_regions_.emplace_back(region_ref.first);
+    ++stats.regions_written;
+  }
+
+  // Update the clearance stamps for the regions affected by changes. The target stamp is taken from the occupancy
+  // stamps the state reflects rather than the map, so regions changed during time sliced propagation remain stale.
+  if (!stamp_regions_.empty())
+  {
+    const glm::ivec3 region_padding =
+      (glm::ivec3(int(std::ceil(radius_voxels_))) + region_dim_ - glm::ivec3(1)) / region_dim_;
+    std::unordered_set<RegionKey, Vector3Hash<RegionKey>> affected;
+    for (const RegionKey &region_key : stamp_regions_)
+    {
+      for (int z = -region_padding.z; z <= region_padding.z; ++z)
+      {
+        for (int y = -region_padding.y; y <= region_padding.y; ++y)
+        {
+          for (int x = -region_padding.x; x <= region_padding.x; ++x)
+          {
+            affected.insert(RegionKey(region_key.x + x, region_key.y + y, region_key.z + z));
+          }
+        }
+      }
+    }
+
+    const OccupancyMapDetail &map_data = *map.detail();
+    std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+    for (const RegionKey &region_key : affected)
+    {
+      const auto region_search = map_data.chunks.find(region_key);
+      if (region_search == map_data.chunks.end())
+      {
+        continue;
+      }
+
+      uint64_t target_stamp = 0;
+      for (int z = -region_padding.z; z <= region_padding.z; ++z)
+      {
+        for (int y = -region_padding.y; y <= region_padding.y; ++y)
+        {
+          for (int x = -region_padding.x; x <= region_padding.x; ++x)
+          {
+            const RegionState *neighbour = state(RegionKey(region_key.x + x, region_key.y + y, region_key.z + z), false);
+            if (neighbour && neighbour->present)
+            {
+              target_stamp = std::max(target_stamp, neighbour->occupancy_stamp);
+            }
+          }
+        }
+      }
+      region_search->second->touched_stamps[clearance_layer] = target_stamp;
+    }
+    stamp_regions_.clear();
+  }
+
+  releaseAbsentRegions();
+  return stats;
+}
+
+
+void DynamicEdt::setParams(const OccupancyMap &map, const Params &params)
+{
+  params_ = params;
+  region_dim_ = glm::ivec3(map.regionVoxelDimensions());
+  weight_sqr_ = glm::max(params.axis_scaling * params.axis_scaling, glm::vec3(kMinWeightSqr));
+  radius_voxels_ = std::max(params.search_radius, 0.0f) / float(map.resolution());
+  // Propagate far enough to find all obstructions which may be reported. For unscaled results, this is the
+  // obstructions within the search radius along the most heavily weighted axis.
+  max_dist_sqr_ = radius_voxels_ * radius_voxels_ *
+                  ((params.report_unscaled) ? std::max(weight_sqr_.x, std::max(weight_sqr_.y, weight_sqr_.z)) : 1.0f);
+}
+
+
+bool DynamicEdt::isDefaultState(const RegionState &region) const
+{
+  // Matches the state of an absent region: all obstructed when unknown is occupied, otherwise all without an
+  // obstruction.
+  const uint8_t default_flags = (params_.unknown_as_occupied) ? uint8_t(kFObstructed) : uint8_t(0u);
+  for (size_t i = 0; i < region.flags.size(); ++i)
+  {
+    if (region.flags[i] != default_flags || (!params_.unknown_as_occupied && region.obstruction[i] != kNoObstruction))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void DynamicEdt::releaseAbsentRegions()
+{
+  std::vector<RegionKey> release;
+  for (const auto &region_ref : regions_)
+  {
+    if (!region_ref.second->present && isDefaultState(*region_ref.second))
+    {
+      release.emplace_back(region_ref.first);
+    }
+  }
+
+  for (const RegionKey &region_key : release)
+  {
+    regions_.erase(region_key);
+  }
+  cached_state_ = nullptr;
+}
+
+
+DynamicEdt::RegionState *DynamicEdt::state(const RegionKey &region_key, bool create)
+{
+  if (cached_state_ && cached_key_ == region_key)
+  {
+    return cached_state_;
+  }
+
+  const auto search = regions_.find(region_key);
+  if (search != regions_.end())
+  {
+    cached_key_ = region_key;
+    cached_state_ = search->second.get();
+    return cached_state_;
+  }
+
+  if (!create)
+  {
+    return nullptr;
+  }
+
+  // New state for an absent region: all unobserved.
+  const size_t volume = size_t(region_dim_.x) * region_dim_.y * region_dim_.z;
+  std::unique_ptr<RegionState> region(new RegionState(volume, params_.unknown_as_occupied));
+  cached_key_ = region_key;
+  cached_state_ = region.get();
+  regions_.emplace(region_key, std::move(region));
+  return cached_state_;
+}
+
+
+DynamicEdt::RegionState *DynamicEdt::cellState(const glm::ivec3 &coord, unsigned *index, bool create)
+{
+  const glm::ivec3 region_coord(floorDiv(coord, region_dim_));
+  const glm::ivec3 local = coord - region_coord * region_dim_;
+  *index = unsigned(local.x + region_dim_.x * (local.y + region_dim_.y * local.z));
+  return state(RegionKey(region_coord), create);
+}
+
+
+bool DynamicEdt::isObstructed(const glm::ivec3 &coord)
+{
+  unsigned index = 0;
+  const RegionState *region = cellState(coord, &index, false);
+  return (region) ? (region->flags[index] & kFObstructed) != 0 : params_.unknown_as_occupied;
+}
+
+
+void DynamicEdt::setObstruction(RegionState &region, unsigned index, const glm::ivec3 &coord, bool obstructed)
+{
+  region.modified = true;
+  if (obstructed)
+  {
+    region.flags[index] = kFObstructed;
+    region.dist_sqr[index] = 0.0f;
+    region.obstruction[index] = glm::i16vec3(0);
+  }
+  else
+  {
+    region.flags[index] = kFRaise;
+    region.dist_sqr[index] = std::numeric_limits<float>::infinity();
+    region.obstruction[index] = kNoObstruction;
+  }
+  open_.push(QueueItem{ 0.0f, coord });
+}
+
+
+void DynamicEdt::raise(const glm::ivec3 &coord)
+{
+  for (const glm::ivec3 &neighbour_offset : neighbourOffsets())
+  {
+    const glm::ivec3 neighbour = coord + neighbour_offset;
+    unsigned index = 0;
+    // Absent neighbours are obstructions when treating unknown as occupied. Instantiate them so they seed lower
+    // waves into the raised voxels.
+    RegionState *region = cellState(neighbour, &index, params_.unknown_as_occupied);
+    if (!region || region->obstruction[index] == kNoObstruction || (region->flags[index] & kFRaise))
+    {
+      continue;
+    }
+
+    if (!isObstructed(neighbour + glm::ivec3(region->obstruction[index])))
+    {
+      // The neighbour's obstruction has been removed. Raise the neighbour.
+      open_.push(QueueItem{ region->dist_sqr[index], neighbour });
+      region->dist_sqr[index] = std::numeric_limits<float>::infinity();
+      region->obstruction[index] = kNoObstruction;
+      region->flags[index] |= kFRaise;
+      region->modified = true;
+    }
+    else
+    {
+      // The neighbour has a valid obstruction. Queue it to lower the raised voxels.
+      open_.push(QueueItem{ region->dist_sqr[index], neighbour });
+    }
+  }
+
+  unsigned index = 0;
+  RegionState *region = cellState(coord, &index, false);
+  region->flags[index] &= uint8_t(~kFRaise);
+}
+
+
+void DynamicEdt::lower(const glm::ivec3 &coord, RegionState &region, unsigned index)
+{
+  const glm::ivec3 obstruction = coord + glm::ivec3(region.obstruction[index]);
+  for (const glm::ivec3 &neighbour_offset : neighbourOffsets())
+  {
+    const glm::ivec3 neighbour = coord + neighbour_offset;
+    const glm::ivec3 offset = obstruction - neighbour;
+    if (glm::any(glm::greaterThan(glm::abs(offset), glm::ivec3(kMaxOffset))))
+    {
+      continue;
+    }
+
+    const float dist_sqr = distanceSqr(offset);
+    if (dist_sqr > max_dist_sqr_)
+    {
+      continue;
+    }
+
+    // Absent regions are obstructions when treating unknown as occupied and cannot be lowered. Otherwise waves
+    // cross absent regions.
+    unsigned neighbour_index = 0;
+    RegionState *neighbour_region = cellState(neighbour, &neighbour_index, !params_.unknown_as_occupied);
+    if (!neighbour_region || (neighbour_region->flags[neighbour_index] & kFRaise) ||
+        dist_sqr >= neighbour_region->dist_sqr[neighbour_index])
+    {
+      continue;
+    }
+
+    neighbour_region->dist_sqr[neighbour_index] = dist_sqr;
+    neighbour_region->obstruction[neighbour_index] = glm::i16vec3(offset);
+    neighbour_region->modified = true;
+    open_.push(QueueItem{ dist_sqr, neighbour });
+  }
+}
+
+
+float DynamicEdt::distanceSqr(const glm::ivec3 &offset) const
+{
+  const glm::vec3 separation(offset);
+  return glm::dot(separation * separation, weight_sqr_);
+}
+}  // namespace ohm
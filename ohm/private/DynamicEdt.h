@@ -0,0 +1,173 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_DYNAMICEDT_H
+#define OHM_DYNAMICEDT_H
+
+#include "OhmConfig.h"
+
+#include "ohm/RegionKey.h"
+
+#include <glm/glm.hpp>
+
+#include <ohmutil/VectorHash.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif  // __GNUC__
+#include <ska/bytell_hash_map.hpp>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif  // __GNUC__
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// Incremental Euclidean distance transform used by @c ClearanceProcessCpu to maintain the clearance layer.
+///
+/// This follows the dynamic brushfire algorithm of Lau, Sprunk and Burgard (DynamicEDT3D). Each voxel tracks the
+/// squared distance to and the offset of its nearest obstruction. Voxels whose obstruction state has changed since
+/// the last update seed wavefronts: new obstructions seed "lower" waves which propagate shorter distances, while
+/// removed obstructions seed "raise" waves which invalidate voxels referencing the removed obstruction until they are
+/// reached by lower waves from the remaining obstructions. Waves stop at the search radius, so the work done is
+/// proportional to the volume affected by the changes rather than the map size.
+///
+/// Changes are detected per region by comparing the occupancy layer @c MapChunk::touched_stamps with the stamp at the
+/// last update, then comparing the voxel obstruction state against the state recorded at the last update. New and
+/// removed regions are treated as changes from the unobserved state. Unless unobserved voxels are obstructions, absent
+/// regions may hold distance state where reached by a wave, allowing waves to cross unobserved space. Absent region
+/// state is released once it holds no distances.
+///
+/// The state may be seeded from a batch distance transform via @c beginSeed() , @c seed() and @c endSeed() , which is
+/// much faster than propagating wavefronts from every obstruction. Otherwise the first @c update() treats every
+/// obstruction as a change.
+///
+/// Wavefront propagation may be time sliced. A time sliced @c update() resumes propagation on the next call and only
+/// checks for further changes once the pending wavefronts are complete.
+///
+/// The wavefront propagates over the 26 voxel neighbourhood using the nearest obstruction of each neighbour. As noted
+/// by Lau et al., this may in rare cases select a marginally further obstruction than an exact transform.
+class DynamicEdt
+{
+public:
+  /// Distance transform parameters. Changing parameters requires a @c reset() .
+  struct Params
+  {
+    float search_radius = 0;
+    glm::vec3 axis_scaling = glm::vec3(1.0f);
+    bool unknown_as_occupied = false;
+    bool report_unscaled = false;
+  };
+
+  /// Update statistics.
+  struct Stats
+  {
+    /// Number of regions with changed occupancy checked for obstruction changes.
+    size_t regions_checked = 0;
+    /// Number of voxels with a changed obstruction state.
+    size_t changed_voxels = 0;
+    /// Number of voxels processed by the wavefronts.
+    size_t processed_voxels = 0;
+    /// Number of regions with clearance values written.
+    size_t regions_written = 0;
+    /// Number of voxels left in the wavefront queue when the time slice expired. Zero when the update is complete.
+    size_t pending_voxels = 0;
+  };
+
+  /// Batch distance transform results for one region used to seed the state.
+  struct RegionSeed
+  {
+    RegionKey key{ 0 };
+    /// Occupancy layer @c MapChunk::touched_stamps value for the occupancy used in the transform.
+    uint64_t occupancy_stamp = 0;
+    /// Is the region present in the map?
+    bool present = false;
+    /// Scaled, squared distance to the nearest obstruction in voxel units for each voxel. Zero for an obstruction and
+    /// infinite when there is no obstruction.
+    std::vector<float> dist_sqr;
+    /// Offset to the nearest obstruction for each voxel with a finite @c dist_sqr .
+    std::vector<glm::i16vec3> obstruction;
+  };
+
+  DynamicEdt();
+  ~DynamicEdt();
+
+  /// Drop all distance state. The next update processes the whole map.
+  void reset();
+
+  /// Query if the state has been built for @p map with @p params , by seeding or by a previous @c update() .
+  /// @param map The map to update.
+  /// @param params The transform parameters.
+  /// @return True if @c update() will only process changes.
+  bool isSeeded(const OccupancyMap &map, const Params &params) const;
+
+  /// Drop all distance state and begin seeding the state for @p map .
+  /// @param map The map to seed for.
+  /// @param params The transform parameters.
+  void beginSeed(const OccupancyMap &map, const Params &params);
+
+  /// Seed the state for a region. Must be called between @c beginSeed() and @c endSeed() for every region in the map
+  /// and, unless unobserved voxels are obstructions, absent regions within the search radius of the map regions.
+  /// Distances beyond the search radius are discarded.
+  /// @param region_seed The region transform results.
+  void seed(const RegionSeed &region_seed);
+
+  /// Complete seeding. The next @c update() only processes changes since seeding.
+  void endSeed();
+
+  /// Process obstruction changes in @p map and write updated clearance values.
+  /// @param map The map to update. Must have occupancy and clearance layers.
+  /// @param params The transform parameters. A change of parameters drops the state.
+  /// @param time_slice The time available for wavefront propagation (seconds). Zero or less for no limit.
+  /// @return Statistics for the update.
+  Stats update(OccupancyMap &map, const Params &params, double time_slice = 0);
+
+private:
+  struct RegionState;
+  struct QueueItem
+  {
+    float dist_sqr;
+    glm::ivec3 coord;
+
+    inline bool operator>(const QueueItem &other) const { return dist_sqr > other.dist_sqr; }
+  };
+  using RegionStateMap = ska::bytell_hash_map<RegionKey, std::unique_ptr<RegionState>, Vector3Hash<RegionKey>>;
+
+  void setParams(const OccupancyMap &map, const Params &params);
+  bool isDefaultState(const RegionState &region) const;
+  void releaseAbsentRegions();
+  RegionState *state(const RegionKey &region_key, bool create);
+  RegionState *cellState(const glm::ivec3 &coord, unsigned *index, bool create);
+  bool isObstructed(const glm::ivec3 &coord);
+  void setObstruction(RegionState &region, unsigned index, const glm::ivec3 &coord, bool obstructed);
+  void raise(const glm::ivec3 &coord);
+  void lower(const glm::ivec3 &coord, RegionState &region, unsigned index);
+  float distanceSqr(const glm::ivec3 &offset) const;
+
+  RegionStateMap regions_;
+  std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open_;
+  Params params_;
+  glm::ivec3 region_dim_{ 0 };
+  glm::vec3 weight_sqr_{ 1.0f };
+  float max_dist_sqr_ = 0;
+  float radius_voxels_ = 0;
+  /// Regions with changes in the current wavefronts. Their clearance stamps are updated once propagation completes.
+  std::vector<RegionKey> stamp_regions_;
+  /// Has the state been built for @c params_ ?
+  bool seeded_ = false;
+  // Lookup cache for state().
+  RegionKey cached_key_{ 0 };
+  RegionState *cached_state_ = nullptr;
+};
+}  // namespace ohm
+
+#endif  // OHM_DYNAMICEDT_H
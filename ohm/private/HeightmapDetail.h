@@ -69,6 +69,9 @@ struct ohm_API HeightmapDetail
   bool promote_virtual_below = false;
   /// Use the flood fill technique? Slower, but better at following surfaces.
   bool use_flood_fill = false;
+  /// Store the heightmap layer as @c HeightmapVoxelCompact with a quantised occupancy layer?
+  /// @see @c Heightmap::compactLayout()
+  bool compact_layout = false;
 
   void updateAxis();
   static const glm::dvec3 &upAxisNormal(UpAxis axis_id);
@@ -0,0 +1,69 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_INTERPOLATEDCLEARANCEQUERYDETAIL_H
+#define OHM_INTERPOLATEDCLEARANCEQUERYDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "QueryDetail.h"
+
+#include "ohm/RegionKey.h"
+
+#include <glm/glm.hpp>
+
+#include <ohmutil/VectorHash.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif  // __GNUC__
+#include <ska/bytell_hash_map.hpp>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif  // __GNUC__
+
+#include <vector>
+
+namespace ohm
+{
+/// A query point resolved to the voxel at the minimum corner of its interpolation cell.
+struct InterpolatedClearanceSample
+{
+  /// Key of the voxel whose centre is the minimum corner of the interpolation cell.
+  Key base;
+  /// Interpolation weights along each axis from the @c base voxel centre [0, 1).
+  glm::vec3 t;
+  /// Index of the point in the query input.
+  unsigned index;
+};
+
+struct ohm_API InterpolatedClearanceQueryDetail : QueryDetail
+{
+  /// Points to sample.
+  std::vector<glm::dvec3> points;
+  /// Clearance gradient results, one component array per axis.
+  std::vector<float> gradient_x;
+  std::vector<float> gradient_y;
+  std::vector<float> gradient_z;
+  /// Range substituted for unobstructed voxels.
+  float default_range = -1;
+
+  // Working memory retained between executions.
+  /// Resolved samples and the same samples grouped by region.
+  std::vector<InterpolatedClearanceSample> samples;
+  std::vector<InterpolatedClearanceSample> grouped_samples;
+  /// Batch index for each of the @c samples .
+  std::vector<unsigned> sample_batch;
+  /// Start index of each batch in @c grouped_samples plus a terminating end index.
+  std::vector<size_t> batches;
+  /// Insertion index for each batch while grouping samples.
+  std::vector<size_t> batch_insert;
+  /// Maps region keys to batch indices while grouping samples.
+  ska::bytell_hash_map<RegionKey, unsigned, Vector3Hash<RegionKey>> batch_lookup;
+};
+}  // namespace ohm
+
+#endif  // OHM_INTERPOLATEDCLEARANCEQUERYDETAIL_H
@@ -0,0 +1,32 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_KNEARESTOCCUPIEDDETAIL_H
+#define OHM_KNEARESTOCCUPIEDDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "QueryDetail.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ohm
+{
+struct ohm_API KNearestOccupiedDetail : QueryDetail
+{
+  /// Points to search around.
+  std::vector<glm::dvec3> near_points;
+  /// Start index of the results for each of the @c near_points plus a terminating end index.
+  std::vector<size_t> result_offsets;
+  /// Maximum number of results per point.
+  unsigned k = 1;
+  /// Maximum search radius or zero for no limit.
+  float search_radius = 0;
+};
+}  // namespace ohm
+
+#endif  // OHM_KNEARESTOCCUPIEDDETAIL_H
@@ -20,10 +20,48 @@ namespace ohm
 {
 OccupancyMapDetail::~OccupancyMapDetail()
 {
+  clearChunkPool();
   delete gpu_cache;
 }
 
 
+void OccupancyMapDetail::clearChunkPool()
+{
+  for (MapChunk *chunk : chunk_pool)
+  {
+    delete chunk;
+  }
+  chunk_pool.clear();
+}
+
+
+void OccupancyMapDetail::insertChunk(MapChunk *chunk)
+{
+  chunks.insert(std::make_pair(chunk->region.coord, chunk));
+  region_index.insert(chunk);
+}
+
+
+bool OccupancyMapDetail::eraseChunk(MapChunk *chunk)
+{
+  const auto chunk_iter = chunks.find(chunk->region.coord);
+  if (chunk_iter == chunks.end() || chunk_iter->second != chunk)
+  {
+    return false;
+  }
+  chunks.erase(chunk_iter);
+  region_index.remove(chunk);
+  return true;
+}
+
+
+void OccupancyMapDetail::clearChunks()
+{
+  chunks.clear();
+  region_index.clear();
+}
+
+
 void OccupancyMapDetail::moveKeyAlongAxis(Key &key, int axis, int step) const
 {
   const glm::ivec3 local_limits = region_voxel_dimensions;
@@ -36,7 +74,7 @@ void OccupancyMapDetail::moveKeyAlongAxis(Key &key, int axis, int step) const
 
   // We first step within the chunk region. If we can't then we step the region and reset
   // stepped local axis value.
-  glm::i16vec3 region_key = key.regionKey();
+  RegionKey region_key = key.regionKey();
   glm::ivec3 local_key = key.localKey();
   if (step > 0)
   {
@@ -103,14 +141,26 @@ void OccupancyMapDetail::setDefaultLayout(bool enable_voxel_mean)
   VoxelLayout voxel;
   size_t clear_value;
 
-  const float invalid_marker_value = unobservedOccupancyValue();
+  OccupancyEncoding encoding = OccupancyEncoding::kFloat;
+  if ((flags & MapFlag::kQuantisedOccupancy8) != MapFlag::kNone)
+  {
+    encoding = OccupancyEncoding::kInt8;
+  }
+  else if ((flags & MapFlag::kQuantisedOccupancy16) != MapFlag::kNone)
+  {
+    encoding = OccupancyEncoding::kInt16;
+  }
 
-  clear_value = 0;
-  memcpy(&clear_value, &invalid_marker_value, sizeof(invalid_marker_value));
+  clear_value = occupancyEncodingClearValue(encoding);
 
   layer = layout.addLayer(default_layer::occupancyLayerName(), 0);
+  if (encoding != OccupancyEncoding::kFloat)
+  {
+    // Quantised voxels are smaller than the minimum padded voxel size.
+    layer->setFlags(layer->flags() | MapLayer::kPackedVoxels);
+  }
   voxel = layer->voxelLayout();
-  voxel.addMember(default_layer::occupancyLayerName(), DataType::kFloat, clear_value);
+  voxel.addMember(default_layer::occupancyLayerName(), occupancyEncodingDataType(encoding), clear_value);
 
   if (enable_voxel_mean)
   {
@@ -12,10 +12,13 @@
 #include "ohm/MapFlag.h"
 #include "ohm/MapInfo.h"
 #include "ohm/MapLayout.h"
+#include "ohm/MapMemoryUsage.h"
 #include "ohm/MapRegion.h"
 #include "ohm/Mutex.h"
 #include "ohm/RayFilter.h"
 
+#include "RegionIndex.h"
+
 #include <ohmutil/VectorHash.h>
 
 #ifdef __GNUC__
@@ -27,17 +30,27 @@
 #pragma GCC diagnostic pop
 #endif  // __GNUC__
 
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
 
 namespace ohm
 {
-using ChunkMap = ska::bytell_hash_map<glm::i16vec3, MapChunk *, Vector3Hash<glm::i16vec3>>;
+using ChunkMap = ska::bytell_hash_map<RegionKey, MapChunk *, Vector3Hash<RegionKey>>;
 
 class MapRegionCache;
 class OccupancyMap;
 
+/// Voxel memory accounting counters for a map layer. Maintained by each @c VoxelBlock as its state changes.
+struct LayerMemoryCounters
+{
+  /// Number of blocks in each @c VoxelBlockState .
+  std::atomic<size_t> block_count[unsigned(VoxelBlockState::kCount)] = {};  // NOLINT(modernize-avoid-c-arrays)
+  /// Allocated voxel bytes in each @c VoxelBlockState .
+  std::atomic<size_t> byte_count[unsigned(VoxelBlockState::kCount)] = {};  // NOLINT(modernize-avoid-c-arrays)
+};
+
 /// Internal details associated with an @c OccupancyMap .
 struct ohm_API OccupancyMapDetail
 {
@@ -81,11 +94,29 @@ struct ohm_API OccupancyMapDetail
   MapLayout layout;
   /// The hash map of @c MapChunk objects contained in this map.
   ChunkMap chunks;
-  /// Data access mutex. Used to protect @c chunks .
+  /// Spatial and temporal index of the @c chunks used to accelerate region culling and extents calculations. Must be
+  /// kept in sync with @c chunks - use @c insertChunk() , @c eraseChunk() and @c clearChunks() . Protected by @c mutex .
+  RegionIndex region_index;
+  /// Pool of released @c MapChunk objects available for reuse when creating new regions. Chunks in the pool have
+  /// been recycled to the default state and match the current @c layout . Protected by @c mutex .
+  std::vector<MapChunk *> chunk_pool;
+  /// Maximum number of @c MapChunk objects held in the @c chunk_pool .
+  size_t chunk_pool_limit = 64u;  // NOLINT(readability-magic-numbers)
+  /// Data access mutex. Used to protect @c chunks and @c chunk_pool .
   mutable Mutex mutex;
   // Region count at load time. Useful when only the header is loaded.
   size_t loaded_region_count = 0;
 
+  /// Maximum number of layers for which memory accounting is maintained individually.
+  static constexpr unsigned kMaxAccountedLayers = MapMemoryUsage::kMaxLayers;
+  /// Voxel memory counters indexed by layer index. The final entry aggregates all layers from @c kMaxAccountedLayers
+  /// on. See @c OccupancyMap::memoryUsage() and @c layerMemoryCounters() .
+  mutable LayerMemoryCounters layer_memory[kMaxAccountedLayers + 1];  // NOLINT(modernize-avoid-c-arrays)
+  /// Number of allocated @c MapChunk objects, including the @c chunk_pool . Maintained by @c MapChunk .
+  mutable std::atomic<size_t> chunk_count{ 0 };
+  /// Bytes allocated for @c MapChunk::observed_mask and @c MapChunk::occupied_mask buffers. Maintained by @c MapChunk .
+  mutable std::atomic<size_t> voxel_mask_bytes{ 0 };
+
   /// GPU cache pointer. Note: this is declared here, but implemented in a dependent library. We simply ensure that
   /// the map detail supports a GPU cache.
   ///
@@ -105,6 +136,15 @@ struct ohm_API OccupancyMapDetail
   /// Destructor ensures @c gpu_cache is destroyed.
   ~OccupancyMapDetail();
 
+  /// Get the @c layer_memory counters for @p layer_index . Layers from @c kMaxAccountedLayers on share the final
+  /// entry.
+  /// @param layer_index The layer index.
+  /// @return The memory counters for the layer.
+  inline LayerMemoryCounters &layerMemoryCounters(unsigned layer_index) const
+  {
+    return layer_memory[(layer_index < kMaxAccountedLayers) ? layer_index : kMaxAccountedLayers];
+  }
+
   /// Move an @c Key along a selected axis.
   /// This is the implementation to @c OccupancyMap::moveKeyAlongAxis(). See that function for details.
   /// @param key The key to adjust.
@@ -113,9 +153,29 @@ struct ohm_API OccupancyMapDetail
   void moveKeyAlongAxis(Key &key, int axis, int step) const;
 
   /// Setup the default @c MapLayout: occupancy layer and clearance layer.
+  ///
+  /// The occupancy layer is quantised according to @c MapFlag::kQuantisedOccupancy8 or
+  /// @c MapFlag::kQuantisedOccupancy16 in @c flags .
   /// @param enable_voxel_mean Enable voxel mean positioning?
   void setDefaultLayout(bool enable_voxel_mean = false);
 
+  /// Release all the @c MapChunk objects in the @c chunk_pool . Must be called when the @c layout changes. The
+  /// @c mutex should be locked.
+  void clearChunkPool();
+
+  /// Add @p chunk to the @c chunks and @c region_index . The @c mutex should be locked.
+  /// @param chunk The chunk to add. Must not already be present.
+  void insertChunk(MapChunk *chunk);
+
+  /// Remove @p chunk from the @c chunks and @c region_index . This does not release the chunk. The @c mutex should
+  /// be locked.
+  /// @param chunk The chunk to remove.
+  /// @return True if @p chunk was present and has been removed.
+  bool eraseChunk(MapChunk *chunk);
+
+  /// Clear the @c chunks and @c region_index . This does not release the chunks. The @c mutex should be locked.
+  void clearChunks();
+
   /// Copy internal details from @p other. For cloning.
   /// @param other The map detail to copy from.
   void copyFrom(const OccupancyMapDetail &other);
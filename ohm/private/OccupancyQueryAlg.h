@@ -8,7 +8,9 @@
 
 #include "OhmConfig.h"
 
+#include "ohm/MapChunk.h"
 #include "ohm/OccupancyMap.h"
+#include "ohm/VoxelBuffer.h"
 
 #include "ohm/private/OccupancyMapDetail.h"
 #include "ohm/private/QueryDetail.h"
@@ -22,21 +24,203 @@
 #endif  // OHM_THREADS
 
 #include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 // This file contains various algorithms to help execute queries on GPU.
 // Common code, structures and contracts are presented here.
 
 namespace ohm
 {
+/// Visit the obstructed voxels of a region within the local voxel bounds [@p voxel_min, @p voxel_max] using the
+/// region's voxel masks.
+///
+/// Obstructed voxels are occupied voxels and, when @p unknown_as_occupied is set, unobserved voxels. A null @p chunk
+/// represents an absent region, for which all voxels are unobserved. Otherwise the @c MapChunk::occupied_mask must be
+/// up to date and the @c MapChunk::observed_mask must also be up to date for @p unknown_as_occupied .
+///
+/// @param chunk The region to visit. May be null.
+/// @param dim The region voxel dimensions.
+/// @param voxel_min The minimum local voxel coordinate to visit (inclusive).
+/// @param voxel_max The maximum local voxel coordinate to visit (inclusive).
+/// @param unknown_as_occupied True to treat unobserved voxels as obstructed.
+/// @param func Visitor function with the signature <tt>void(unsigned voxel_index, bool unobserved)</tt>.
+template <typename Func>
+void visitObstructedVoxels(const MapChunk *chunk, const glm::ivec3 &dim, const glm::ivec3 &voxel_min,
+                           const glm::ivec3 &voxel_max, bool unknown_as_occupied, Func &&func)
+{
+  const auto mask_bit = [](const std::vector<uint64_t> &mask, unsigned voxel_index) {
+    return (mask[voxel_index / 64u] & (uint64_t(1u) << (voxel_index % 64u))) != 0;
+  };
+
+  for (int z = voxel_min.z; z <= voxel_max.z; ++z)
+  {
+    for (int y = voxel_min.y; y <= voxel_max.y; ++y)
+    {
+      const unsigned row_begin = voxelIndex(unsigned(voxel_min.x), unsigned(y), unsigned(z), dim.x, dim.y, dim.z);
+      const unsigned row_end = row_begin + unsigned(voxel_max.x - voxel_min.x + 1);
+      if (!chunk)
+      {
+        if (unknown_as_occupied)
+        {
+          // Absent region: all voxels are unobserved.
+          for (unsigned voxel_index = row_begin; voxel_index < row_end; ++voxel_index)
+          {
+            func(voxel_index, true);
+          }
+        }
+      }
+      else if (unknown_as_occupied)
+      {
+        for (unsigned voxel_index = row_begin; voxel_index < row_end; ++voxel_index)
+        {
+          const bool observed = mask_bit(chunk->observed_mask, voxel_index);
+          if (!observed || mask_bit(chunk->occupied_mask, voxel_index))
+          {
+            func(voxel_index, !observed);
+          }
+        }
+      }
+      else
+      {
+        for (unsigned voxel_index = chunk->nextOccupiedIndex(row_begin, row_end); voxel_index != ~0u;
+             voxel_index = chunk->nextOccupiedIndex(voxel_index + 1, row_end))
+        {
+          func(voxel_index, false);
+        }
+      }
+    }
+  }
+}
+
+/// Map of regions resolved by @c prepareQueryRegions() .
+using QueryRegionMap = ska::bytell_hash_map<RegionKey, const MapChunk *, Vector3Hash<RegionKey>>;
+
+/// Collect the map regions within the region key bounds [@p search_min, @p search_max] into @p regions , optionally
+/// bringing their voxel masks up to date for use with @c visitObstructedVoxels() .
+///
+/// This locks the map once, allowing the @p regions to be searched in parallel without further locking, provided the
+/// map is not modified during the search.
+///
+/// @param map The map to collect regions from.
+/// @param search_min The minimum region coordinate to collect (inclusive).
+/// @param search_max The maximum region coordinate to collect (inclusive).
+/// @param unknown_as_occupied True to also update the @c MapChunk::observed_mask .
+/// @param[out] regions Populated with the collected regions. Cleared first.
+/// @param[out] map_region_min Optional: set to the minimum region coordinate of all map regions.
+/// @param[out] map_region_max Optional: set to the maximum region coordinate of all map regions.
+/// @param update_masks False to only collect the regions, leaving their voxel masks as they are. For queries which
+///   read voxel values directly rather than using @c visitObstructedVoxels() .
+inline void prepareQueryRegions(const OccupancyMap &map, const glm::ivec3 &search_min, const glm::ivec3 &search_max,
+                                bool unknown_as_occupied, QueryRegionMap &regions,
+                                glm::ivec3 *map_region_min = nullptr, glm::ivec3 *map_region_max = nullptr,
+                                bool update_masks = true)
+{
+  const OccupancyMapDetail &map_data = *map.detail();
+  std::unique_lock<decltype(map_data.mutex)> guard(map_data.mutex);
+  regions.clear();
+  glm::ivec3 region_min(0);
+  glm::ivec3 region_max(-1);
+  bool first = true;
+  for (const auto &chunk_ref : map_data.chunks)
+  {
+    const glm::ivec3 coord(chunk_ref.first);
+    region_min = (first) ? coord : glm::min(region_min, coord);
+    region_max = (first) ? coord : glm::max(region_max, coord);
+    first = false;
+
+    if (glm::any(glm::lessThan(coord, search_min)) || glm::any(glm::greaterThan(coord, search_max)))
+    {
+      continue;
+    }
+
+    const MapChunk *chunk = chunk_ref.second;
+    if (update_masks)
+    {
+      chunk->updateOccupiedMask();
+      if (unknown_as_occupied)
+      {
+        chunk->updateObservedMask();
+      }
+    }
+    regions.insert(std::make_pair(chunk_ref.first, chunk));
+  }
+
+  if (map_region_min)
+  {
+    *map_region_min = region_min;
+  }
+  if (map_region_max)
+  {
+    *map_region_max = region_max;
+  }
+}
+
+/// Clearance layer values for an up to date region.
+struct CachedClearanceRegion
+{
+  RegionKey region_key;
+  VoxelBuffer<const VoxelBlock> buffer;
+  /// Clearance values or null if the region is absent or its clearance is stale.
+  const float *clearance = nullptr;
+};
+
+/// Resolve the clearance layer values for @p region_key if they are up to date. That is, the clearance layer
+/// @c MapChunk::touched_stamps value is at least the occupancy stamp of every region within the search padding.
+/// Map mutex must be locked.
+inline CachedClearanceRegion cachedClearanceRegion(const OccupancyMapDetail &map_data, const RegionKey &region_key,
+                                                   const glm::ivec3 &region_padding)
+{
+  CachedClearanceRegion region;
+  region.region_key = region_key;
+
+  const int occupancy_layer = map_data.layout.occupancyLayer();
+  const int clearance_layer = map_data.layout.clearanceLayer();
+  const auto search = map_data.chunks.find(region_key);
+  if (search == map_data.chunks.end() || search->second->voxel_blocks[clearance_layer]->isUninitialised())
+  {
+    return region;
+  }
+
+  const uint64_t clearance_stamp = search->second->touched_stamps[clearance_layer];
+  if (clearance_stamp == 0)
+  {
+    // Never calculated.
+    return region;
+  }
+
+  for (int z = -region_padding.z; z <= region_padding.z; ++z)
+  {
+    for (int y = -region_padding.y; y <= region_padding.y; ++y)
+    {
+      for (int x = -region_padding.x; x <= region_padding.x; ++x)
+      {
+        const RegionKey neighbour_key(region_key.x + x, region_key.y + y, region_key.z + z);
+        const auto neighbour = map_data.chunks.find(neighbour_key);
+        if (neighbour != map_data.chunks.end() && neighbour->second->touched_stamps[occupancy_layer] > clearance_stamp)
+        {
+          // Stale.
+          return region;
+        }
+      }
+    }
+  }
+
+  region.buffer = VoxelBuffer<const VoxelBlock>(search->second->voxel_blocks[clearance_layer]);
+  region.clearance = reinterpret_cast<const float *>(region.buffer.voxelMemory());
+  return region;
+}
+
 template <typename QUERY>
 unsigned occupancyQueryRegions(
   OccupancyMap &map, QUERY &query, ClosestResult &closest, const glm::dvec3 &query_min_extents,
   const glm::dvec3 &query_max_extents,
-  const std::function<unsigned(OccupancyMap &, QUERY &, const glm::i16vec3 &, ClosestResult &)> &region_query_func)
+  const std::function<unsigned(OccupancyMap &, QUERY &, const RegionKey &, ClosestResult &)> &region_query_func)
 {
-  glm::i16vec3 min_region_key;
-  glm::i16vec3 max_region_key;
-  glm::i16vec3 region_key;
+  RegionKey min_region_key;
+  RegionKey max_region_key;
+  RegionKey region_key;
   unsigned current_neighbours = 0;
 
   // Determine the maximum deltas in region indexing we can have based on the provided extents.
@@ -44,13 +228,13 @@ unsigned occupancyQueryRegions(
   max_region_key = map.regionKey(query_max_extents);
 
   // Iterate the regions, invoking region_query_func for each.
-  for (int16_t z = min_region_key.z; z <= max_region_key.z; ++z)
+  for (RegionCoord z = min_region_key.z; z <= max_region_key.z; ++z)
   {
     region_key.z = z;
-    for (int16_t y = min_region_key.y; y <= max_region_key.y; ++y)
+    for (RegionCoord y = min_region_key.y; y <= max_region_key.y; ++y)
     {
       region_key.y = y;
-      for (int16_t x = min_region_key.x; x <= max_region_key.x; ++x)
+      for (RegionCoord x = min_region_key.x; x <= max_region_key.x; ++x)
       {
         region_key.x = x;
         current_neighbours += region_query_func(map, query, region_key, closest);
@@ -64,10 +248,10 @@ unsigned occupancyQueryRegions(
 template <typename QUERY>
 inline unsigned occupancyQueryRegions(OccupancyMap &map, QUERY &query, ClosestResult &closest,
                                       const glm::dvec3 &query_min_extents, const glm::dvec3 &query_max_extents,
-                                      unsigned (*region_query_func)(OccupancyMap &, QUERY &, const glm::i16vec3 &,
+                                      unsigned (*region_query_func)(OccupancyMap &, QUERY &, const RegionKey &,
                                                                     ClosestResult &))
 {
-  const std::function<unsigned(OccupancyMap &, QUERY &, const glm::i16vec3 &, ClosestResult &)> region_op =
+  const std::function<unsigned(OccupancyMap &, QUERY &, const RegionKey &, ClosestResult &)> region_op =
     region_query_func;
   return occupancyQueryRegions(map, query, closest, query_min_extents, query_max_extents, region_op);
 }
@@ -76,11 +260,11 @@ template <typename QUERY>
 unsigned occupancyQueryRegionsParallel(
   OccupancyMap &map, QUERY &query, ClosestResult &closest, const glm::dvec3 &query_min_extents,
   const glm::dvec3 &query_max_extents,
-  const std::function<unsigned(OccupancyMap &, QUERY &, const glm::i16vec3 &, ClosestResult &)> &region_query_func)
+  const std::function<unsigned(OccupancyMap &, QUERY &, const RegionKey &, ClosestResult &)> &region_query_func)
 {
 #ifdef OHM_THREADS
-  glm::i16vec3 min_region_key;
-  glm::i16vec3 max_region_key;
+  RegionKey min_region_key;
+  RegionKey max_region_key;
   std::atomic_uint current_neighbours(0u);
 
   // Determine the maximum deltas in region indexing we can have based on the provided extents.
@@ -91,7 +275,7 @@ unsigned occupancyQueryRegionsParallel(
     tbb::blocked_range3d<size_t>(max_region_key.z, max_region_key.z + 1, max_region_key.y, max_region_key.y + 1,
                                  max_region_key.x, max_region_key.x + 1),
     [&current_neighbours, &map, &query, &closest, &region_query_func](const tbb::blocked_range3d<int> &range) {
-      glm::i16vec3 region_key;
+      RegionKey region_key;
       for (int z = range.pages().begin(); z != range.pages().end(); ++z)
       {
         region_key.z = z;
@@ -117,9 +301,9 @@ template <typename QUERY>
 inline unsigned occupancyQueryRegionsParallel(OccupancyMap &map, QUERY &query, ClosestResult &closest,
                                               const glm::dvec3 &query_min_extents, const glm::dvec3 &query_max_extents,
                                               unsigned (*region_query_func)(OccupancyMap &, QUERY &,
-                                                                            const glm::i16vec3 &, ClosestResult &))
+                                                                            const RegionKey &, ClosestResult &))
 {
-  const std::function<unsigned(OccupancyMap &, QUERY &, const glm::i16vec3 &, ClosestResult &)> region_op =
+  const std::function<unsigned(OccupancyMap &, QUERY &, const RegionKey &, ClosestResult &)> region_op =
     region_query_func;
   return occupancyQueryRegionsParallel(map, query, closest, query_min_extents, query_max_extents, region_op);
 }
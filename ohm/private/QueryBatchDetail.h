@@ -0,0 +1,42 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_QUERYBATCHDETAIL_H
+#define OHM_QUERYBATCHDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "QueryDetail.h"
+
+#include "ohm/QueryBatch.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ohm
+{
+struct ohm_API QueryBatchDetail : QueryDetail
+{
+  /// A query in the batch.
+  struct Item
+  {
+    /// Line start or nearest neighbours search point.
+    glm::dvec3 start_point;
+    /// Line end point. Unused for nearest neighbours.
+    glm::dvec3 end_point;
+    QueryBatch::QueryType type;
+  };
+
+  /// The queries to execute.
+  std::vector<Item> queries;
+  /// Start index of the results for each of the @c queries plus a terminating end index.
+  std::vector<size_t> result_offsets;
+  /// Search radius for all queries.
+  float search_radius = 0;
+};
+}  // namespace ohm
+
+#endif  // OHM_QUERYBATCHDETAIL_H
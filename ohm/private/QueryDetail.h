@@ -10,6 +10,8 @@
 
 #include "ohm/Key.h"
 
+#include <exception>
+#include <future>
 #include <limits>
 #include <vector>
 
@@ -30,6 +32,12 @@ struct ohm_API QueryDetail
   size_t number_of_results = 0;
   /// @c QueryFlag values for the query.
   unsigned query_flags = 0;
+  /// Result of an asynchronous CPU execution. Valid while an execution is outstanding.
+  std::future<bool> async_result;
+  /// The @c onExecute() result of the last completed asynchronous execution.
+  bool async_success = true;
+  /// Exception thrown by the last completed asynchronous execution, if any.
+  std::exception_ptr async_exception;
 
   /// Virtual destructor.
   virtual ~QueryDetail() = default;
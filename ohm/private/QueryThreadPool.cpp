@@ -0,0 +1,80 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "QueryThreadPool.h"
+
+#include <algorithm>
+
+namespace ohm
+{
+QueryThreadPool::QueryThreadPool(unsigned thread_count)
+{
+  if (thread_count == 0)
+  {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  workers_.reserve(thread_count);
+  for (unsigned i = 0; i < thread_count; ++i)
+  {
+    workers_.emplace_back([this]() { run(); });
+  }
+}
+
+
+QueryThreadPool::~QueryThreadPool()
+{
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    quit_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread &worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+
+QueryThreadPool &QueryThreadPool::instance()
+{
+  static QueryThreadPool pool;
+  return pool;
+}
+
+
+std::future<bool> QueryThreadPool::enqueue(std::function<bool()> task)
+{
+  std::packaged_task<bool()> packaged(std::move(task));
+  std::future<bool> result = packaged.get_future();
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    queue_.emplace_back(std::move(packaged));
+  }
+  work_cv_.notify_one();
+  return result;
+}
+
+
+void QueryThreadPool::run()
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  while (true)
+  {
+    work_cv_.wait(guard, [this]() { return quit_ || !queue_.empty(); });
+    if (queue_.empty())
+    {
+      // Quitting with no outstanding work.
+      break;
+    }
+
+    std::packaged_task<bool()> task = std::move(queue_.front());
+    queue_.pop_front();
+    guard.unlock();
+    task();
+    guard.lock();
+  }
+}
+}  // namespace ohm
@@ -0,0 +1,62 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_QUERYTHREADPOOL_H
+#define OHM_QUERYTHREADPOOL_H
+
+#include "OhmConfig.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ohm
+{
+/// A fixed size thread pool used to execute CPU @c Query objects asynchronously.
+///
+/// A single shared pool is created on first use via @c instance() , sized to the hardware concurrency. Tasks are
+/// executed in submission order. The pool completes all queued tasks before its threads exit on destruction.
+class QueryThreadPool
+{
+public:
+  /// Create a pool with the given number of threads.
+  /// @param thread_count The number of worker threads. Zero selects the hardware concurrency.
+  explicit QueryThreadPool(unsigned thread_count = 0);
+
+  /// Destructor: completes queued tasks and joins the worker threads.
+  ~QueryThreadPool();
+
+  QueryThreadPool(const QueryThreadPool &) = delete;
+  QueryThreadPool &operator=(const QueryThreadPool &) = delete;
+
+  /// Access the shared query thread pool.
+  /// @return The shared pool.
+  static QueryThreadPool &instance();
+
+  /// Query the number of worker threads.
+  /// @return The worker thread count.
+  unsigned threadCount() const { return unsigned(workers_.size()); }
+
+  /// Queue @p task for execution on a worker thread.
+  /// @param task The task to execute.
+  /// @return A future for the result of @p task . Exceptions thrown by @p task are rethrown from the future.
+  std::future<bool> enqueue(std::function<bool()> task);
+
+private:
+  void run();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::packaged_task<bool()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  bool quit_ = false;
+};
+}  // namespace ohm
+
+#endif  // OHM_QUERYTHREADPOOL_H
@@ -0,0 +1,68 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_RAYCASTDETAIL_H
+#define OHM_RAYCASTDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "OccupancyQueryAlg.h"
+
+#include "ohm/Key.h"
+#include "ohm/OccupancyEncoding.h"
+#include "ohm/VoxelBuffer.h"
+
+#include <glm/glm.hpp>
+
+namespace ohm
+{
+class OccupancyMap;
+class OccupancyPyramid;
+struct MapChunk;
+struct RayCastResult;
+
+/// Cached region access for @c rayCastFirstOccupied() . A context may be reused for multiple rays on the same thread,
+/// but must not be shared between threads.
+struct RayCastContext
+{
+  const OccupancyMap &map;
+  const OccupancyPyramid *pyramid;
+  /// Optional, pre-resolved regions to look up instead of the map. Regions not present are treated as unknown.
+  /// Avoids locking the map on each region change.
+  const QueryRegionMap *regions;
+  glm::ivec3 region_dim;
+  OccupancyEncoding encoding;
+  int occupancy_layer;
+  int pyramid_layer = -1;
+  glm::ivec3 pyramid_dim{ 0 };
+  float threshold;
+  bool unknown_as_occupied;
+
+  const MapChunk *chunk = nullptr;
+  RegionKey chunk_key{ 0 };
+  bool chunk_resolved = false;
+  VoxelBuffer<const VoxelBlock> occupancy_buffer;
+  VoxelBuffer<const VoxelBlock> pyramid_buffer;
+
+  RayCastContext(const OccupancyMap &map, const OccupancyPyramid *pyramid, bool unknown_as_occupied,
+                 const QueryRegionMap *regions = nullptr);
+
+  /// Select the region containing the global voxel @p voxel and return its local voxel coordinate.
+  glm::ivec3 selectRegion(const glm::ivec3 &voxel);
+
+  /// Test if the block of 8x8x8 voxels with global block coordinate @p block may be skipped.
+  bool canSkipBlock(const glm::ivec3 &block);
+
+  /// Test the global voxel @p voxel for a hit, setting @p occupancy to its value.
+  bool isHit(const glm::ivec3 &voxel, Key *key, float *occupancy);
+};
+
+/// Cast a ray from @p start to @p end using an existing @p context . See the public overload.
+/// The map must have an occupancy layer.
+bool rayCastFirstOccupied(RayCastContext &context, const glm::dvec3 &start, const glm::dvec3 &end,
+                          RayCastResult *result);
+}  // namespace ohm
+
+#endif  // OHM_RAYCASTDETAIL_H
@@ -0,0 +1,32 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_RAYCASTQUERYDETAIL_H
+#define OHM_RAYCASTQUERYDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "QueryDetail.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ohm
+{
+class OccupancyPyramid;
+
+struct ohm_API RayCastQueryDetail : QueryDetail
+{
+  /// Ray start/end point pairs.
+  std::vector<glm::dvec3> rays;
+  /// Occupancy value of the hit voxel for each ray.
+  std::vector<float> occupancy;
+  /// Optional pyramid used to skip empty blocks.
+  const OccupancyPyramid *pyramid = nullptr;
+};
+}  // namespace ohm
+
+#endif  // OHM_RAYCASTQUERYDETAIL_H
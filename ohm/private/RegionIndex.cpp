@@ -0,0 +1,141 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RegionIndex.h"
+
+#include "MapChunk.h"
+#include "VoxelAlgorithms.h"
+
+#include <algorithm>
+
+namespace ohm
+{
+namespace
+{
+/// Expected time heap size multiplier, relative to the region count, before the heap is compacted.
+const size_t kHeapCompactionFactor = 2u;
+/// Minimum time heap size before compaction is considered.
+const size_t kHeapCompactionMinimum = 64u;
+}  // namespace
+
+
+void RegionIndex::clear()
+{
+  cells_.clear();
+  time_heap_ = TimeHeap();
+  for (auto &axis_counts : axis_counts_)
+  {
+    axis_counts.clear();
+  }
+  region_count_ = 0;
+}
+
+
+void RegionIndex::insert(MapChunk *chunk)
+{
+  const RegionKey region_key = chunk->region.coord;
+  cells_[cellKey(region_key)].emplace_back(chunk);
+  for (int i = 0; i < 3; ++i)
+  {
+    ++axis_counts_[i][region_key[i]];
+  }
+  ++region_count_;
+  touch(chunk);
+}
+
+
+void RegionIndex::remove(const MapChunk *chunk)
+{
+  const RegionKey region_key = chunk->region.coord;
+  const auto cell_iter = cells_.find(cellKey(region_key));
+  if (cell_iter == cells_.end())
+  {
+    return;
+  }
+
+  Cell &cell = cell_iter->second;
+  const auto chunk_iter = std::find(cell.begin(), cell.end(), chunk);
+  if (chunk_iter == cell.end())
+  {
+    return;
+  }
+
+  // Order within a cell is not significant. Swap and pop.
+  *chunk_iter = cell.back();
+  cell.pop_back();
+  if (cell.empty())
+  {
+    cells_.erase(cell_iter);
+  }
+
+  for (int i = 0; i < 3; ++i)
+  {
+    const auto count_iter = axis_counts_[i].find(region_key[i]);
+    if (count_iter != axis_counts_[i].end() && --count_iter->second == 0)
+    {
+      axis_counts_[i].erase(count_iter);
+    }
+  }
+  --region_count_;
+}
+
+
+void RegionIndex::touch(const MapChunk *chunk)
+{
+  time_heap_.push(TimeEntry{ chunk->touched_time, chunk->region.coord });
+  compactTimeHeap();
+}
+
+
+bool RegionIndex::extents(RegionKey *min_region, RegionKey *max_region) const
+{
+  if (region_count_ == 0)
+  {
+    return false;
+  }
+
+  for (int i = 0; i < 3; ++i)
+  {
+    (*min_region)[i] = axis_counts_[i].begin()->first;
+    (*max_region)[i] = axis_counts_[i].rbegin()->first;
+  }
+
+  return true;
+}
+
+
+RegionKey RegionIndex::cellKey(const RegionKey &region_key)
+{
+  return RegionKey(floorDiv(glm::ivec3(region_key), glm::ivec3(kCellRegions)));
+}
+
+
+void RegionIndex::cellRegionRange(const RegionKey &cell_key, glm::ivec3 *min_region, glm::ivec3 *max_region)
+{
+  *min_region = glm::ivec3(cell_key) * kCellRegions;
+  *max_region = *min_region + glm::ivec3(kCellRegions - 1);
+}
+
+
+void RegionIndex::compactTimeHeap()
+{
+  if (time_heap_.size() <= kHeapCompactionFactor * region_count_ + kHeapCompactionMinimum)
+  {
+    return;
+  }
+
+  // Rebuild with exactly one, current entry per region.
+  std::vector<TimeEntry> entries;
+  entries.reserve(region_count_);
+  for (const auto &cell : cells_)
+  {
+    for (const MapChunk *chunk : cell.second)
+    {
+      entries.emplace_back(TimeEntry{ chunk->touched_time, chunk->region.coord });
+    }
+  }
+  time_heap_ = TimeHeap(std::greater<TimeEntry>(), std::move(entries));
+}
+}  // namespace ohm
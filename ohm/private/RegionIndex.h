@@ -0,0 +1,131 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONINDEX_H
+#define OHM_REGIONINDEX_H
+
+#include "OhmConfig.h"
+
+#include "ohm/RegionKey.h"
+
+#include <glm/glm.hpp>
+
+#include <ohmutil/VectorHash.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif  // __GNUC__
+#include <ska/bytell_hash_map.hpp>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif  // __GNUC__
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+
+/// Spatial and temporal index of the regions in an @c OccupancyMap .
+///
+/// The index supports culling and extents operations at a cost proportional to the number of regions affected rather
+/// than the number of regions in the map. It maintains:
+/// - a coarse spatial grid where each cell holds the regions within a block of @c kCellRegions regions per axis
+/// - per axis region coordinate counts, yielding the region key extents
+/// - a min-heap of region @c MapChunk::touched_time values
+///
+/// The heap is lazily maintained. Entries are pushed whenever a region time is touched and stale entries are
+/// discarded or refreshed when popped. The heap is rebuilt when the number of stale entries grows too large.
+///
+/// The index is owned by the @c OccupancyMapDetail and is protected by the map mutex.
+class RegionIndex
+{
+public:
+  /// Number of regions along each axis of a spatial grid cell.
+  static constexpr int kCellRegions = 8;
+
+  /// An entry in the @c touched_time heap.
+  struct TimeEntry
+  {
+    double time;              ///< The @c MapChunk::touched_time at the time of the push.
+    RegionKey region_key;  ///< The region key.
+
+    /// Comparison operator yielding a min-heap ordering in a @c std::priority_queue .
+    /// @param other The entry to compare against.
+    /// @return True if this entry is later than @p other .
+    inline bool operator>(const TimeEntry &other) const { return time > other.time; }
+  };
+
+  /// Spatial grid cell contents: the regions within the cell.
+  using Cell = std::vector<MapChunk *>;
+  /// Spatial grid type.
+  using CellMap = ska::bytell_hash_map<RegionKey, Cell, Vector3Hash<RegionKey>>;
+  /// Time heap type.
+  using TimeHeap = std::priority_queue<TimeEntry, std::vector<TimeEntry>, std::greater<TimeEntry>>;
+
+  /// Clear the index.
+  void clear();
+
+  /// Add @p chunk to the index.
+  /// @param chunk The chunk to add.
+  void insert(MapChunk *chunk);
+
+  /// Remove @p chunk from the index. The time heap is lazily updated.
+  /// @param chunk The chunk to remove.
+  void remove(const MapChunk *chunk);
+
+  /// Note a change in the @c MapChunk::touched_time for @p chunk .
+  /// @param chunk The chunk which has been touched.
+  void touch(const MapChunk *chunk);
+
+  /// Query the region key extents of the indexed regions.
+  /// @param[out] min_region Set to the minimum region key.
+  /// @param[out] max_region Set to the maximum region key.
+  /// @return False when the index is empty, in which case the out values are unchanged.
+  bool extents(RegionKey *min_region, RegionKey *max_region) const;
+
+  /// Calculate the grid cell key containing @p region_key .
+  /// @param region_key The region key of interest.
+  /// @return The containing cell key.
+  static RegionKey cellKey(const RegionKey &region_key);
+
+  /// Calculate the region key range covered by the cell @p cell_key .
+  /// @param cell_key The cell of interest.
+  /// @param[out] min_region Set to the minimum region key in the cell.
+  /// @param[out] max_region Set to the maximum region key in the cell.
+  static void cellRegionRange(const RegionKey &cell_key, glm::ivec3 *min_region, glm::ivec3 *max_region);
+
+  /// Query the number of indexed regions.
+  /// @return The number of regions in the index.
+  inline size_t size() const { return region_count_; }
+
+  /// Access the spatial grid cells.
+  /// @return The spatial grid.
+  inline const CellMap &cells() const { return cells_; }
+
+  /// Access the time heap for popping expired entries.
+  /// @return The time heap.
+  inline TimeHeap &timeHeap() { return time_heap_; }
+
+  /// Rebuild the time heap if it holds too many stale entries compared to the number of indexed regions.
+  void compactTimeHeap();
+
+private:
+  /// Per axis region coordinate counts.
+  using AxisCounts = std::map<RegionCoord, unsigned>;
+
+  CellMap cells_;
+  TimeHeap time_heap_;
+  AxisCounts axis_counts_[3];  // NOLINT(modernize-avoid-c-arrays)
+  size_t region_count_ = 0;
+};
+}  // namespace ohm
+
+#endif  // OHM_REGIONINDEX_H
@@ -0,0 +1,188 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "SharedMapDetail.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OHM_SHARED_MAP_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(__unix__) || defined(__APPLE__)
+
+namespace ohm
+{
+namespace shared_map
+{
+namespace
+{
+std::string segmentName(const char *name)
+{
+  std::string segment_name = (name) ? name : "";
+  if (segment_name.empty() || segment_name[0] != '/')
+  {
+    segment_name.insert(segment_name.begin(), '/');
+  }
+  return segment_name;
+}
+}  // namespace
+
+
+int64_t findRegion(const SharedMapHeader *header, const int32_t coord[3], size_t *insert_index)
+{
+  const SharedRegionEntry *table = regionTable(header);
+  const uint32_t capacity = header->region_capacity;
+  uint32_t index = hashRegion(coord[0], coord[1], coord[2], capacity);
+  if (insert_index)
+  {
+    *insert_index = capacity;
+  }
+
+  for (uint32_t probe = 0; probe < capacity; ++probe, index = (index + 1u) & (capacity - 1u))
+  {
+    const SharedRegionEntry &entry = table[index];
+    // Acquire pairs with the release store making the entry non-empty, ensuring the coordinate is visible.
+    const uint32_t state = entry.state.load(std::memory_order_acquire);
+    if (state == kEntryEmpty)
+    {
+      if (insert_index && *insert_index == capacity)
+      {
+        *insert_index = index;
+      }
+      return -1;
+    }
+
+    if (entry.coord[0] == coord[0] && entry.coord[1] == coord[1] && entry.coord[2] == coord[2])
+    {
+      return int64_t(index);
+    }
+
+    if (state == kEntryRemoved && insert_index && *insert_index == capacity)
+    {
+      // Reuse the first removed entry on the probe sequence.
+      *insert_index = index;
+    }
+  }
+
+  return -1;
+}
+
+
+#ifdef OHM_SHARED_MAP_POSIX
+bool createSegment(SharedSegment *segment, const char *name, size_t size)
+{
+  closeSegment(segment);
+  segment->name = segmentName(name);
+
+  // Remove any stale segment so we start with fresh, zeroed memory.
+  shm_unlink(segment->name.c_str());
+  segment->fd = shm_open(segment->name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (segment->fd < 0)
+  {
+    return false;
+  }
+  segment->owner = true;
+
+  if (ftruncate(segment->fd, off_t(size)) != 0)
+  {
+    closeSegment(segment);
+    return false;
+  }
+
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+  if (memory == MAP_FAILED)  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+  {
+    closeSegment(segment);
+    return false;
+  }
+
+  segment->memory = memory;
+  segment->size = size;
+  return true;
+}
+
+
+bool openSegment(SharedSegment *segment, const char *name)
+{
+  closeSegment(segment);
+  segment->name = segmentName(name);
+  segment->owner = false;
+  segment->fd = shm_open(segment->name.c_str(), O_RDONLY, 0);
+  if (segment->fd < 0)
+  {
+    return false;
+  }
+
+  struct stat info
+  {
+  };
+  if (fstat(segment->fd, &info) != 0 || size_t(info.st_size) < sizeof(SharedMapHeader))
+  {
+    closeSegment(segment);
+    return false;
+  }
+
+  void *memory = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, segment->fd, 0);
+  if (memory == MAP_FAILED)  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+  {
+    closeSegment(segment);
+    return false;
+  }
+
+  segment->memory = memory;
+  segment->size = size_t(info.st_size);
+  return true;
+}
+
+
+void closeSegment(SharedSegment *segment)
+{
+  if (segment->memory)
+  {
+    munmap(segment->memory, segment->size);
+  }
+  if (segment->fd >= 0)
+  {
+    ::close(segment->fd);
+  }
+  if (segment->owner && !segment->name.empty())
+  {
+    shm_unlink(segment->name.c_str());
+  }
+
+  segment->memory = nullptr;
+  segment->size = 0;
+  segment->fd = -1;
+  segment->owner = false;
+}
+#else   // OHM_SHARED_MAP_POSIX
+bool createSegment(SharedSegment *segment, const char *name, size_t size)
+{
+  (void)size;
+  closeSegment(segment);
+  segment->name = segmentName(name);
+  return false;
+}
+
+
+bool openSegment(SharedSegment *segment, const char *name)
+{
+  closeSegment(segment);
+  segment->name = segmentName(name);
+  return false;
+}
+
+
+void closeSegment(SharedSegment *segment)
+{
+  segment->memory = nullptr;
+  segment->size = 0;
+  segment->fd = -1;
+  segment->owner = false;
+}
+#endif  // OHM_SHARED_MAP_POSIX
+}  // namespace shared_map
+}  // namespace ohm
@@ -0,0 +1,183 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_SHAREDMAPDETAIL_H
+#define OHM_SHAREDMAPDETAIL_H
+
+#include "OhmConfig.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <string>
+
+namespace ohm
+{
+/// Structures and helpers for the shared memory map segment used by @c SharedMapPublisher and @c SharedMapView .
+///
+/// The segment is laid out as:
+/// - @c SharedMapHeader
+/// - @c SharedRegionEntry table of @c SharedMapHeader::region_capacity entries, an open addressed hash table keyed on
+///   the region coordinate with linear probing.
+/// - Region data slots, one per table entry, each @c SharedMapHeader::slot_size bytes. A slot holds the voxel memory
+///   for each published layer at @c SharedLayerInfo::slot_offset .
+///
+/// Each table entry is protected by a seqlock: the writer increments @c SharedRegionEntry::sequence to an odd value
+/// before modifying the entry or its slot and back to an even value after. Readers retry when the sequence is odd or
+/// changes across a read, up to @c kMaxReadAttempts times. Removed entries may be reassigned to another region, so
+/// readers must validate the entry coordinate within the seqlock read.
+namespace shared_map
+{
+/// Segment identifier: "OHMS".
+constexpr uint32_t kMagic = 0x534d484fu;
+/// Segment format version.
+constexpr uint32_t kVersion = 1u;
+/// Maximum number of layers which may be published.
+constexpr unsigned kMaxLayers = 16u;
+/// Maximum layer name length, including the null terminator.
+constexpr unsigned kLayerNameLength = 32u;
+/// Maximum number of attempts at a seqlock read before failing. Bounds the wait should the publisher die mid write.
+constexpr unsigned kMaxReadAttempts = 100000u;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory publication requires lock free atomics");
+
+/// Table entry states.
+enum EntryState : uint32_t
+{
+  kEntryEmpty = 0,    ///< Never used. Terminates a probe sequence.
+  kEntryValid = 1,    ///< Holds a published region.
+  kEntryRemoved = 2,  ///< Held a region which has since been removed from the map. May be reused for another region.
+};
+
+/// Details of a published layer.
+struct SharedLayerInfo
+{
+  char name[kLayerNameLength];  ///< Layer name.
+  uint32_t voxel_byte_size;     ///< @c MapLayer::voxelByteSize()
+  uint32_t subsampling;         ///< @c MapLayer::subsampling()
+  uint64_t byte_size;           ///< @c MapLayer::layerByteSize() for a region.
+  uint64_t slot_offset;         ///< Byte offset of the layer within a region slot.
+};
+
+/// Segment header.
+struct SharedMapHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t segment_size;
+  double resolution;
+  double origin[3];
+  uint8_t region_dim[3];
+  uint8_t occupancy_encoding;  ///< @c OccupancyEncoding of the occupancy layer.
+  int32_t occupancy_layer;     ///< Index of the occupancy layer or -1.
+  uint32_t layer_count;
+  uint32_t region_capacity;  ///< Table size. Always a power of two.
+  uint64_t slot_size;
+  uint64_t table_offset;
+  uint64_t data_offset;
+  /// Incremented after each publication. Readers may poll this for changes.
+  std::atomic_uint64_t publish_stamp;
+  /// Number of valid regions.
+  std::atomic_uint32_t region_count;
+  /// Bit pattern of @c OccupancyMap::occupancyThresholdValue() as of the last publication.
+  std::atomic_uint32_t occupancy_threshold_bits;
+  SharedLayerInfo layers[kMaxLayers];
+};
+
+/// Region table entry.
+struct SharedRegionEntry
+{
+  /// Seqlock sequence. Odd while the writer is modifying the entry or its slot.
+  std::atomic_uint32_t sequence;
+  /// An @c EntryState value.
+  std::atomic_uint32_t state;
+  /// Region coordinate. Written before the entry becomes valid and retained when removed.
+  int32_t coord[3];
+  /// Padding for alignment.
+  uint32_t reserved;
+  /// The map stamp of the region data when published.
+  uint64_t stamp;
+  /// @c MapChunk::touched_time of the region data when published.
+  double touched_time;
+};
+
+/// Hash a region coordinate into the region table.
+/// @param x Region X coordinate.
+/// @param y Region Y coordinate.
+/// @param z Region Z coordinate.
+/// @param capacity The table capacity - a power of two.
+/// @return The first table index to probe.
+inline uint32_t hashRegion(int32_t x, int32_t y, int32_t z, uint32_t capacity)
+{
+  uint32_t hash = uint32_t(x) * 73856093u;
+  hash ^= uint32_t(y) * 19349663u;
+  hash ^= uint32_t(z) * 83492791u;
+  hash ^= hash >> 16u;
+  return hash & (capacity - 1u);
+}
+
+/// Access the region table for a mapped segment.
+inline SharedRegionEntry *regionTable(SharedMapHeader *header)
+{
+  return reinterpret_cast<SharedRegionEntry *>(reinterpret_cast<uint8_t *>(header) + header->table_offset);
+}
+
+/// @overload
+inline const SharedRegionEntry *regionTable(const SharedMapHeader *header)
+{
+  return reinterpret_cast<const SharedRegionEntry *>(reinterpret_cast<const uint8_t *>(header) +
+                                                     header->table_offset);
+}
+
+/// Access the data slot for the region table entry at @p index .
+inline uint8_t *regionSlot(SharedMapHeader *header, size_t index)
+{
+  return reinterpret_cast<uint8_t *>(header) + header->data_offset + index * header->slot_size;
+}
+
+/// @overload
+inline const uint8_t *regionSlot(const SharedMapHeader *header, size_t index)
+{
+  return reinterpret_cast<const uint8_t *>(header) + header->data_offset + index * header->slot_size;
+}
+
+/// Find the table index for a region coordinate.
+/// @param header The segment header.
+/// @param coord The region coordinate.
+/// @param[out] insert_index Set to the first removed or empty index on the probe sequence, or to
+///   @c region_capacity when the table is full. May be null.
+/// @return The index of the entry holding @p coord - valid or removed - or -1 when not present.
+int64_t findRegion(const SharedMapHeader *header, const int32_t coord[3], size_t *insert_index = nullptr);
+
+/// A mapped shared memory segment.
+struct SharedSegment
+{
+  std::string name;
+  void *memory = nullptr;
+  size_t size = 0;
+  int fd = -1;
+  bool owner = false;
+};
+
+/// Create and map a new shared memory segment, replacing any existing segment of the same name.
+/// @param segment The segment to populate.
+/// @param name Segment name. A leading '/' is added as required.
+/// @param size The segment size in bytes.
+/// @return True on success.
+bool createSegment(SharedSegment *segment, const char *name, size_t size);
+
+/// Map an existing shared memory segment read only.
+/// @param segment The segment to populate.
+/// @param name Segment name. A leading '/' is added as required.
+/// @return True on success.
+bool openSegment(SharedSegment *segment, const char *name);
+
+/// Unmap @p segment , unlinking the segment name if @p segment was created by @c createSegment() .
+void closeSegment(SharedSegment *segment);
+}  // namespace shared_map
+}  // namespace ohm
+
+#endif  // OHM_SHAREDMAPDETAIL_H
@@ -0,0 +1,42 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_SWEPTVOLUMEQUERYDETAIL_H
+#define OHM_SWEPTVOLUMEQUERYDETAIL_H
+
+#include "OhmConfig.h"
+
+#include "QueryDetail.h"
+
+#include "ohm/SweptVolumeQuery.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+namespace ohm
+{
+struct ohm_API SweptVolumeQueryDetail : QueryDetail
+{
+  /// Pose positions.
+  std::vector<glm::dvec3> positions;
+  /// Pose orientations. Same size as @c positions .
+  std::vector<glm::dquat> orientations;
+  SweptVolumeQuery::Shape shape = SweptVolumeQuery::Shape::kSphere;
+  /// Sphere and capsule radius.
+  double radius = 0;
+  /// Capsule half length.
+  double half_length = 0;
+  /// Box half extents.
+  glm::dvec3 half_extents{ 0 };
+  /// Maximum distance any point of the shape may move between tested poses. Zero to use the map resolution.
+  double sweep_step = 0;
+  /// Index of the pose at or before the first collision, or ~0u when there is no collision.
+  size_t collision_pose = ~size_t(0u);
+};
+}  // namespace ohm
+
+#endif  // OHM_SWEPTVOLUMEQUERYDETAIL_H
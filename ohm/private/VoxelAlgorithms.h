@@ -15,6 +15,25 @@ namespace ohm
 class Key;
 class OccupancyMap;
 
+/// Integer division of @p value by @p divisor rounding towards negative infinity. Used to convert global voxel
+/// coordinates to region coordinates.
+/// @param value The value to divide.
+/// @param divisor The divisor. Must be positive.
+/// @return The floor of @p value / @p divisor .
+inline int floorDiv(int value, int divisor)
+{
+  return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+/// Per component @c floorDiv() .
+/// @param value The values to divide.
+/// @param divisor The divisors. Must be positive.
+/// @return The floor of @p value / @p divisor for each component.
+inline glm::ivec3 floorDiv(const glm::ivec3 &value, const glm::ivec3 &divisor)
+{
+  return glm::ivec3(floorDiv(value.x, divisor.x), floorDiv(value.y, divisor.y), floorDiv(value.z, divisor.z));
+}
+
 /// A utility function for calculating the @c voxel_search_half_extents parameter for @c calculateNearestNeighbour.
 /// @param map The map being searched.
 /// @param search_radius The search radius of interest.
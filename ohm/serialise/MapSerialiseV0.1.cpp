@@ -61,7 +61,7 @@ int load(InputStream &stream, OccupancyMapDetail &detail, SerialiseProgress *pro
 
     // Resolve map chunk details.
     chunk->searchAndUpdateFirstValid(detail.region_voxel_dimensions);
-    detail.chunks.insert(std::make_pair(chunk->region.coord, chunk));
+    detail.insertChunk(chunk);
 
     if (progress)
     {
@@ -108,6 +108,7 @@ int loadLayout(InputStream &stream, OccupancyMapDetail &map)
     ok = read<uint16_t>(stream, subsampling) && ok;
 
     MapLayer *layer = layout.addLayer(layer_name.data(), subsampling);
+    layer->setFlags(layer_flags);
 
     // Read voxel layout.
     VoxelLayout voxel_layout = layer->voxelLayout();
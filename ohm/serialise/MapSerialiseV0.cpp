@@ -54,7 +54,7 @@ int load(InputStream &stream, OccupancyMapDetail &detail, SerialiseProgress *pro
 
     // Resolve map chunk details.
     chunk->searchAndUpdateFirstValid(detail.region_voxel_dimensions);
-    detail.chunks.insert(std::make_pair(chunk->region.coord, chunk));
+    detail.insertChunk(chunk);
 
     if (progress)
     {
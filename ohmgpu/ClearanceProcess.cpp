@@ -21,6 +21,7 @@
 #include <ohm/QueryFlag.h>
 #include <ohm/VoxelData.h>
 
+#include <ohm/private/ClearanceInfo.h>
 #include <ohm/private/MapLayoutDetail.h>
 #include <ohm/private/OccupancyMapDetail.h>
 #include <ohm/private/OccupancyQueryAlg.h>
@@ -325,6 +326,18 @@ unsigned regionFloodFillStepCpu(OccupancyMap &map, ClearanceProcessDetail &query
 
   return calc_extents.x * calc_extents.y * calc_extents.z;
 }
+
+/// Get the parameters to record with the clearance layer. See @c updateClearanceInfo() .
+ClearanceInfo clearanceInfo(const ClearanceProcessDetail &query)
+{
+  ClearanceInfo info;
+  info.search_radius = query.search_radius;
+  info.axis_scaling = query.axis_scaling;
+  info.unknown_as_occupied = (query.query_flags & kQfUnknownAsOccupied) != 0;
+  info.report_unscaled = (query.query_flags & kQfReportUnscaledResults) != 0;
+  info.valid = true;
+  return info;
+}
 }  // namespace
 
 
@@ -420,6 +433,7 @@ int ClearanceProcess::update(OccupancyMap &map, double time_slice)
 
   // Ensure clearnce layer is present.
   ensureClearanceLayer(map);
+  updateClearanceInfo(map, clearanceInfo(*d));
 
   using Clock = std::chrono::high_resolution_clock;
   const auto start_time = Clock::now();
@@ -475,6 +489,7 @@ void ohm::ClearanceProcess::calculateForExtents(OccupancyMap &map, const glm::dv
 {
   // Ensure clearnce layer is present.
   ensureClearanceLayer(map);
+  updateClearanceInfo(map, clearanceInfo(*imp()));
 
   const glm::i16vec3 min_region = map.regionKey(min_extents);
   const glm::i16vec3 max_region = map.regionKey(max_extents);
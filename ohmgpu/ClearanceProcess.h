@@ -47,6 +47,9 @@ class OccupancyMap;
 ///
 /// This query respects the @c QF_UnknownAsOccupied flag, allowing unknown obstacles to be considered as obstacles.
 ///
+/// The search parameters are recorded in the @c OccupancyMap::mapInfo() so queries can validate the clearance values
+/// before using them. Calculating with different parameters marks all regions as never calculated.
+///
 /// Note that for this @c Query the following methods are invalid, have different semantics or
 /// have no meaning:
 /// - @c Query::numberOfResults() not used.
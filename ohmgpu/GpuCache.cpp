@@ -83,7 +83,7 @@ void GpuCache::removeLayers()
 }
 
 
-void GpuCache::remove(const glm::i16vec3 &region_key)
+void GpuCache::remove(const RegionKey &region_key)
 {
   for (auto &&layer : imp_->layer_caches)
   {
@@ -87,7 +87,7 @@ public:
 
   /// Remove a particular region from the cache.
   /// @param region_key The region to flush from the cache.
-  void remove(const glm::i16vec3 &region_key) override;
+  void remove(const RegionKey &region_key) override;
 
   /// Query the target GPU memory allocation byte size. This is the target allocation accross all @c GpuLayerCache
   /// objects and is distributed amongst these objects. The distribution is weighted so that layers requiring more
@@ -496,6 +496,9 @@ void GpuMap::cacheGpuProgram(bool with_voxel_mean, bool force)
   {
     imp_->gpu_ok = false;
   }
+
+  // The GPU kernels only support float occupancy values. Quantised occupancy maps must be updated on CPU.
+  imp_->gpu_ok = imp_->gpu_ok && imp_->map->occupancyEncoding() == OccupancyEncoding::kFloat;
 }
 
 
@@ -189,6 +189,9 @@ void GpuNdtMap::cacheGpuProgram(bool /*with_voxel_mean*/, bool force)
       imp->gpu_ok = false;
     }
   }
+
+  // The GPU kernels only support float occupancy values. Quantised occupancy maps must be updated on CPU.
+  imp->gpu_ok = imp->gpu_ok && imp->map->occupancyEncoding() == OccupancyEncoding::kFloat;
 }
 
 
@@ -61,6 +61,7 @@ LineQueryGpu::LineQueryGpu(OccupancyMap &map, const glm::dvec3 &start_point, con
 
 LineQueryGpu::~LineQueryGpu()
 {
+  wait();
   LineQueryDetailGpu *d = imp();
   if (d)
   {
@@ -177,12 +178,6 @@ bool LineQueryGpu::onExecute()
 }
 
 
-bool LineQueryGpu::onExecuteAsync()
-{
-  return false;
-}
-
-
 void LineQueryGpu::onReset(bool /*hard_reset*/)
 {
   // LineQueryDetailGpu *d = imp();
@@ -79,7 +79,6 @@ public:
 
 protected:
   bool onExecute() override;
-  bool onExecuteAsync() override;
   void onReset(bool hard_reset) override;
 
   /// Internal pimpl data access.
@@ -5,46 +5,80 @@
 // Author: Kazys Stepanas
 #include "OhmCloud.h"
 
+#include <ohm/MapChunk.h>
+#include <ohm/MapLayer.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/OccupancyType.h>
 #include <ohm/Query.h>
+#include <ohm/RegionVisit.h>
+#include <ohm/VoxelBuffer.h>
 #include <ohm/VoxelData.h>
+#include <ohm/VoxelOccupancy.h>
 
 #include <ohmutil/PlyMesh.h>
 
 #include <algorithm>
+#include <cstring>
 #include <limits>
+#include <vector>
 
 namespace ohmtools
 {
 void saveCloud(const char *file_name, const ohm::OccupancyMap &map, const ProgressCallback &prog)
 {
-  ohm::PlyMesh ply;
-  glm::vec3 v;
-  const size_t region_count = map.regionCount();
-  size_t processed_region_count = 0;
-  glm::i16vec3 last_region = map.begin().key().regionKey();
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const int mean_layer = map.layout().meanLayer();
+  if (occupancy_layer < 0)
+  {
+    return;
+  }
 
-  ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
-  ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
+  // Collect occupied voxel positions for each region in parallel, skipping unobserved voxels, then add them to the
+  // PLY in region order.
+  const glm::ivec3 region_dim(map.regionVoxelDimensions());
+  const ohm::OccupancyEncoding occupancy_encoding = map.occupancyEncoding();
+  std::vector<std::vector<glm::vec3>> region_points(map.regionCount());
 
-  for (auto iter = map.begin(); iter != map.end(); ++iter)
-  {
-    mean.setKey(occupancy.setKey(*iter));
-    if (last_region != iter.key().regionKey())
+  const auto collect_region = [&](const ohm::MapChunk &chunk, size_t region_index) {
+    ohm::VoxelBuffer<const ohm::VoxelBlock> occupancy_buffer(chunk.voxel_blocks[occupancy_layer]);
+    ohm::VoxelBuffer<const ohm::VoxelBlock> mean_buffer;
+    if (mean_layer >= 0)
     {
-      ++processed_region_count;
-      if (prog)
+      mean_buffer = ohm::VoxelBuffer<const ohm::VoxelBlock>(chunk.voxel_blocks[mean_layer]);
+    }
+
+    std::vector<glm::vec3> &points = region_points[region_index];
+    ohm::visitObserved(chunk, [&](unsigned voxel_index) {
+      const float occupancy = ohm::readOccupancy(occupancy_buffer.voxelMemory(), voxel_index, occupancy_encoding);
+      if (ohm::isOccupied(occupancy, map))
       {
-        prog(processed_region_count, region_count);
+        const ohm::Key key = chunk.keyForIndex(voxel_index, region_dim);
+        glm::dvec3 pos = map.voxelCentreGlobal(key);
+        if (mean_buffer.isValid())
+        {
+          ohm::VoxelMean mean;
+          mean_buffer.readVoxel(voxel_index, &mean);
+          pos = ohm::position(mean, pos, map.resolution());
+        }
+        points.emplace_back(pos - map.origin());
       }
-      last_region = iter.key().regionKey();
-    }
-    if (isOccupied(occupancy))
+    });
+  };
+
+  const size_t region_count = ohm::visitRegions(map, collect_region);
+
+  ohm::PlyMesh ply;
+  for (size_t i = 0; i < region_count; ++i)
+  {
+    for (const glm::vec3 &v : region_points[i])
     {
-      v = positionSafe(mean) - map.origin();
       ply.addVertex(v);
     }
+
+    if (prog)
+    {
+      prog(i + 1, region_count);
+    }
   }
 
   ply.save(file_name, true);
@@ -92,12 +126,12 @@ size_t saveClearanceCloud(const char *file_name, const ohm::OccupancyMap &map, c
   const size_t region_count = map.regionCount();
   size_t processed_region_count = 0;
   glm::dvec3 v;
-  glm::i16vec3 last_region = map.begin().key().regionKey();
+  ohm::RegionKey last_region = map.begin().key().regionKey();
   ohm::PlyMesh ply;
   size_t point_count = 0;
 
-  glm::i16vec3 min_region = map.regionKey(min_extents);
-  glm::i16vec3 max_region = map.regionKey(max_extents);
+  ohm::RegionKey min_region = map.regionKey(min_extents);
+  ohm::RegionKey max_region = map.regionKey(max_extents);
 
   ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
   ohm::Voxel<const float> clearance(&map, map.layout().clearanceLayer());
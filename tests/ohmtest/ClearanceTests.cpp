@@ -0,0 +1,293 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OhmTestConfig.h"
+
+#include <ohm/ClearanceProcessCpu.h>
+#include <ohm/InterpolatedClearanceQuery.h>
+#include <ohm/Key.h>
+#include <ohm/MapChunk.h>
+#include <ohm/MapLayout.h>
+#include <ohm/OccupancyMap.h>
+#include <ohm/VoxelData.h>
+#include <ohm/VoxelOccupancy.h>
+
+#include <ohmtools/OhmGen.h>
+
+#include <glm/glm.hpp>
+
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace ohm;
+
+namespace clearancetests
+{
+/// Build a map of free space with scattered obstacles. The free space does not fully cover the outer regions, leaving
+/// some unobserved voxels.
+void buildMap(OccupancyMap &map)
+{
+  ohmgen::fillMapWithEmptySpace(map, -12, -12, -12, 12, 12, 12);
+  std::mt19937 rand_engine(1234u);
+  std::uniform_int_distribution<int> rand(-12, 11);
+  for (int i = 0; i < 20; ++i)
+  {
+    Key key(0, 0, 0, 0, 0, 0);
+    map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    integrateHit(map, key);
+  }
+}
+
+/// Brute force reference clearance calculation.
+float referenceClearance(const OccupancyMap &map, const Key &voxel_key, float search_radius, bool unknown_as_occupied,
+                         const glm::vec3 &axis_scaling)
+{
+  Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+  const auto is_obstructed = [&voxel, unknown_as_occupied](const Key &key) {
+    voxel.setKey(key);
+    return (voxel.isValid() && isOccupied(voxel)) || (unknown_as_occupied && isUnobservedOrNull(voxel));
+  };
+
+  if (is_obstructed(voxel_key))
+  {
+    return 0.0f;
+  }
+
+  const int extents = int(std::ceil(search_radius / map.resolution()));
+  float closest_sqr = std::numeric_limits<float>::infinity();
+  for (int z = -extents; z <= extents; ++z)
+  {
+    for (int y = -extents; y <= extents; ++y)
+    {
+      for (int x = -extents; x <= extents; ++x)
+      {
+        Key key = voxel_key;
+        map.moveKey(key, x, y, z);
+        if (is_obstructed(key))
+        {
+          const glm::vec3 separation = glm::vec3(x, y, z) * axis_scaling * float(map.resolution());
+          const float range_sqr = glm::dot(separation, separation);
+          if (range_sqr <= search_radius * search_radius)
+          {
+            closest_sqr = std::min(closest_sqr, range_sqr);
+          }
+        }
+      }
+    }
+  }
+
+  return (closest_sqr < std::numeric_limits<float>::infinity()) ? std::sqrt(closest_sqr) : -1.0f;
+}
+
+void validateClearance(const OccupancyMap &map, float search_radius, bool unknown_as_occupied,
+                       const glm::vec3 &axis_scaling)
+{
+  Voxel<const float> clearance(&map, map.layout().clearanceLayer());
+  ASSERT_TRUE(clearance.isLayerValid());
+  unsigned mismatches = 0;
+  for (auto iter = map.begin(); iter != map.end(); ++iter)
+  {
+    clearance.setKey(*iter);
+    ASSERT_TRUE(clearance.isValid());
+    const float expected = referenceClearance(map, *iter, search_radius, unknown_as_occupied, axis_scaling);
+    if (std::abs(clearance.data() - expected) > 1e-4f)
+    {
+      ++mismatches;
+    }
+  }
+  EXPECT_EQ(mismatches, 0u);
+}
+
+
+TEST(Clearance, CpuDistanceTransform)
+{
+  struct Config
+  {
+    unsigned flags;
+    glm::vec3 axis_scaling;
+  };
+  const Config configs[] = { { 0u, glm::vec3(1.0f) }, { kQfUnknownAsOccupied, glm::vec3(1.0f, 1.0f, 2.0f) } };
+  const float search_radius = 0.75f;
+
+  for (const Config &config : configs)
+  {
+    OccupancyMap map(0.25, glm::u8vec3(8));
+    buildMap(map);
+
+    ClearanceProcessCpu clearance_process(search_radius, config.flags);
+    clearance_process.setAxisScaling(config.axis_scaling);
+    const size_t region_count = map.regionCount();
+    EXPECT_EQ(clearance_process.calculateForExtents(map, glm::dvec3(-10.0), glm::dvec3(10.0)), region_count);
+    validateClearance(map, search_radius, (config.flags & kQfUnknownAsOccupied) != 0, config.axis_scaling);
+
+    // Up to date regions are not recalculated.
+    EXPECT_EQ(clearance_process.calculateForExtents(map, glm::dvec3(-10.0), glm::dvec3(10.0), false), 0u);
+    EXPECT_EQ(clearance_process.update(map, 0.0), kMprUpToDate);
+
+    // A new obstacle dirties the regions within the search radius.
+    Key key(0, 0, 0, 0, 0, 0);
+    integrateHit(map, key);
+    EXPECT_EQ(clearance_process.update(map, 0.0), kMprProgressing);
+    EXPECT_EQ(clearance_process.update(map, 0.0), kMprUpToDate);
+    validateClearance(map, search_radius, (config.flags & kQfUnknownAsOccupied) != 0, config.axis_scaling);
+  }
+}
+
+TEST(Clearance, CpuIncremental)
+{
+  const float search_radius = 0.75f;
+  for (const unsigned flags : { 0u, unsigned(kQfUnknownAsOccupied) })
+  {
+    OccupancyMap map(0.25, glm::u8vec3(8));
+    buildMap(map);
+
+    ClearanceProcessCpu incremental(search_radius, flags);
+    incremental.setIncremental(true);
+    ClearanceProcessCpu reference(search_radius, flags);
+
+    // Compare the incremental clearance against a full calculation on a copy of the map.
+    const auto validate = [&]() {
+      std::unique_ptr<OccupancyMap> expected_map(map.clone());
+      reference.calculateForExtents(*expected_map, glm::dvec3(-10.0), glm::dvec3(10.0));
+      Voxel<const float> clearance(&map, map.layout().clearanceLayer());
+      Voxel<const float> expected(expected_map.get(), expected_map->layout().clearanceLayer());
+      ASSERT_TRUE(clearance.isLayerValid());
+      unsigned mismatches = 0;
+      for (auto iter = map.begin(); iter != map.end(); ++iter)
+      {
+        clearance.setKey(*iter);
+        expected.setKey(*iter);
+        if (std::abs(clearance.data() - expected.data()) > 1e-4f)
+        {
+          ++mismatches;
+        }
+      }
+      EXPECT_EQ(mismatches, 0u);
+    };
+
+    EXPECT_EQ(incremental.update(map, 0.0), kMprProgressing);
+    EXPECT_EQ(incremental.update(map, 0.0), kMprUpToDate);
+    validate();
+
+    // Add and remove obstacles, and observe a new region.
+    std::mt19937 rand_engine(4321u);
+    std::uniform_int_distribution<int> rand(-12, 11);
+    for (int i = 0; i < 5; ++i)
+    {
+      Key key(0, 0, 0, 0, 0, 0);
+      map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+      integrateHit(map, key);
+    }
+    for (auto iter = map.begin(); iter != map.end(); ++iter)
+    {
+      Voxel<float> voxel(&map, map.layout().occupancyLayer(), *iter);
+      if (isOccupied(voxel) && iter->localKey().x % 2 == 0)
+      {
+        voxel.write(map.missValue());
+      }
+    }
+    Key key(0, 0, 0, 0, 0, 0);
+    map.moveKey(key, 20, 0, 0);
+    integrateHit(map, key);
+
+    EXPECT_EQ(incremental.update(map, 0.0), kMprProgressing);
+    validate();
+
+    // Time sliced wavefront propagation resumes across updates.
+    for (int i = 0; i < 10; ++i)
+    {
+      Key key(0, 0, 0, 0, 0, 0);
+      map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+      integrateHit(map, key);
+    }
+    unsigned update_count = 0;
+    while (incremental.update(map, 1e-9) == kMprProgressing)
+    {
+      ++update_count;
+    }
+    EXPECT_GT(update_count, 1u);
+    validate();
+  }
+}
+
+TEST(Clearance, InterpolatedQuery)
+{
+  const float search_radius = 0.75f;
+  OccupancyMap map(0.25, glm::u8vec3(8));
+  buildMap(map);
+  ClearanceProcessCpu clearance_process(search_radius, 0u);
+  clearance_process.calculateForExtents(map, glm::dvec3(-10.0), glm::dvec3(10.0));
+
+  // Sample points between voxel centres, away from the cell boundaries so we can use central differences.
+  std::mt19937 rand_engine(1234u);
+  std::uniform_int_distribution<int> rand_voxel(-12, 10);
+  std::uniform_real_distribution<double> rand_offset(0.1, 0.4);
+  std::vector<glm::dvec3> points;
+  for (int i = 0; i < 1000; ++i)
+  {
+    Key key(0, 0, 0, 0, 0, 0);
+    map.moveKey(key, rand_voxel(rand_engine), rand_voxel(rand_engine), rand_voxel(rand_engine));
+    const glm::dvec3 offset(rand_offset(rand_engine), rand_offset(rand_engine), rand_offset(rand_engine));
+    points.emplace_back(map.voxelCentreGlobal(key) + offset * map.resolution());
+  }
+
+  InterpolatedClearanceQuery query(map);
+  query.setDefaultRangeValue(search_radius);
+  query.setPoints(points.data(), points.size());
+  ASSERT_TRUE(query.execute());
+  ASSERT_EQ(query.numberOfResults(), points.size());
+  const std::vector<float> values(query.ranges(), query.ranges() + points.size());
+  const std::vector<float> gradient[3] = { { query.gradientX(), query.gradientX() + points.size() },
+                                           { query.gradientY(), query.gradientY() + points.size() },
+                                           { query.gradientZ(), query.gradientZ() + points.size() } };
+
+  // Validate values against a direct trilinear interpolation.
+  Voxel<const float> clearance(&map, map.layout().clearanceLayer());
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    EXPECT_EQ(query.intersectedVoxels()[i], map.voxelKey(points[i]));
+    const Key base = map.voxelKey(points[i] - glm::dvec3(0.5 * map.resolution()));
+    const glm::dvec3 t = (points[i] - map.voxelCentreGlobal(base)) / map.resolution();
+    double expected = 0;
+    for (int c = 0; c < 8; ++c)
+    {
+      const glm::ivec3 offset(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+      Key corner = base;
+      map.moveKey(corner, offset);
+      clearance.setKey(corner);
+      const double weight = (offset.x ? t.x : 1.0 - t.x) * (offset.y ? t.y : 1.0 - t.y) * (offset.z ? t.z : 1.0 - t.z);
+      expected += weight * ((clearance.data() >= 0) ? clearance.data() : search_radius);
+    }
+    EXPECT_NEAR(values[i], expected, 1e-4);
+  }
+
+  // Validate gradients by central differences.
+  const double delta = 0.01 * map.resolution();
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    std::vector<glm::dvec3> shifted[2] = { points, points };
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+      shifted[0][i][axis] -= delta;
+      shifted[1][i][axis] += delta;
+    }
+    std::vector<float> shifted_values[2];
+    for (int s = 0; s < 2; ++s)
+    {
+      query.setPoints(shifted[s].data(), shifted[s].size());
+      ASSERT_TRUE(query.execute());
+      shifted_values[s].assign(query.ranges(), query.ranges() + points.size());
+    }
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+      EXPECT_NEAR(gradient[axis][i], (shifted_values[1][i] - shifted_values[0][i]) / (2.0 * delta), 1e-2);
+    }
+  }
+}
+}  // namespace clearancetests
@@ -24,6 +24,10 @@
 #include <ohmutil/PlyMesh.h>
 #include <ohmutil/Profile.h>
 
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
 #include <sstream>
 
 using namespace ohm;
@@ -270,6 +274,81 @@ TEST(Heightmap, Layout)
 }
 
 
+TEST(Heightmap, Compact)
+{
+  // Validate the compact encoding helpers.
+  const float heights[] = { 0.0f, 0.1f, -0.35f, 1.5f, 20.0f, -1000.0f };
+  for (float height : heights)
+  {
+    EXPECT_NEAR(halfToFloat(floatToHalf(height)), height, std::abs(height) * 1e-3f);
+  }
+  EXPECT_EQ(halfToFloat(floatToHalf(1e6f)), std::numeric_limits<float>::infinity());
+
+  const glm::vec3 normals[] = { glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::normalize(glm::vec3(1, 2, 3)),
+                                glm::normalize(glm::vec3(-3, 1, -2)) };
+  for (const glm::vec3 &normal : normals)
+  {
+    const glm::vec3 decoded = decodeOctahedralNormal(encodeOctahedralNormal(normal));
+    EXPECT_GT(glm::dot(decoded, normal), 0.999f);
+  }
+
+  // Build the same heightmap with each layout.
+  const float boundary_distance = float(kBoxHalfExtents);
+  OccupancyMap map(0.2);
+  ohmgen::boxRoom(map, glm::dvec3(-boundary_distance), glm::dvec3(boundary_distance));
+
+  Heightmap heightmap(0.2, 1.0, UpAxis::kZ);
+  Heightmap compact_heightmap(0.2, 1.0, UpAxis::kZ, 0, true);
+  ASSERT_FALSE(heightmap.compactLayout());
+  ASSERT_TRUE(compact_heightmap.compactLayout());
+  heightmap.setOccupancyMap(&map);
+  compact_heightmap.setOccupancyMap(&map);
+  heightmap.buildHeightmap(glm::dvec3(0.0));
+  compact_heightmap.buildHeightmap(glm::dvec3(0.0));
+
+  const MapLayout &layout = compact_heightmap.heightmap().layout();
+  ASSERT_NE(layout.layer(HeightmapVoxel::kHeightmapLayer), nullptr);
+  EXPECT_EQ(layout.layer(HeightmapVoxel::kHeightmapLayer)->voxelByteSize(), sizeof(HeightmapVoxelCompact));
+  EXPECT_EQ(layout.layer(layout.occupancyLayer()).voxelByteSize(), sizeof(int8_t));
+  const MapLayout &full_layout = heightmap.heightmap().layout();
+  const size_t full_size = full_layout.layer(full_layout.occupancyLayer()).voxelByteSize() +
+                           full_layout.layer(heightmap.heightmapVoxelLayer()).voxelByteSize();
+  const size_t compact_size = layout.layer(layout.occupancyLayer()).voxelByteSize() +
+                              layout.layer(compact_heightmap.heightmapVoxelLayer()).voxelByteSize();
+  EXPECT_LT(compact_size * 2, full_size);
+
+  // Save and reload the compact heightmap.
+  ohm::save("heightmap-compact.ohm", compact_heightmap.heightmap());
+  Heightmap loaded_heightmap;
+  ASSERT_EQ(ohm::load("heightmap-compact.ohm", loaded_heightmap), 0);
+  EXPECT_TRUE(loaded_heightmap.compactLayout());
+
+  // Compare voxels.
+  size_t surface_count = 0;
+  for (auto iter = heightmap.heightmap().begin(); iter != heightmap.heightmap().end(); ++iter)
+  {
+    glm::dvec3 pos;
+    glm::dvec3 compact_pos;
+    glm::dvec3 loaded_pos;
+    HeightmapVoxel info{};
+    HeightmapVoxel compact_info{};
+    const HeightmapVoxelType type = heightmap.getHeightmapVoxelInfo(*iter, &pos, &info);
+    const HeightmapVoxelType compact_type = compact_heightmap.getHeightmapVoxelInfo(*iter, &compact_pos, &compact_info);
+    const HeightmapVoxelType loaded_type = loaded_heightmap.getHeightmapVoxelInfo(*iter, &loaded_pos);
+    ASSERT_EQ(compact_type, type);
+    ASSERT_EQ(loaded_type, type);
+    if (type == HeightmapVoxelType::kSurface)
+    {
+      ++surface_count;
+      EXPECT_NEAR(compact_pos.z, pos.z, 1e-3);
+      EXPECT_NEAR(loaded_pos.z, pos.z, 1e-3);
+      EXPECT_NEAR(compact_info.clearance, info.clearance, std::abs(info.clearance) * 1e-3f);
+    }
+  }
+  EXPECT_GT(surface_count, 0u);
+}
+
+
 TEST(Heightmap, Mesh)
 {
   std::shared_ptr<Heightmap> heightmap;
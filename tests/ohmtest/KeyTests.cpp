@@ -6,11 +6,24 @@
 #include "OhmTestConfig.h"
 
 #include <ohm/Key.h>
+#include <ohm/KeyList.h>
+#include <ohm/LineKeysQuery.h>
 #include <ohm/MapChunk.h>
 #include <ohm/MapCoord.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/PackedKey.h>
 
+#include <ohmutil/VectorHash.h>
+
+#include <ska/bytell_hash_map.hpp>
+
+#include <chrono>
 #include <cstdio>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <unordered_set>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -278,4 +291,243 @@ TEST(Keys, Quantisation)
     quantisationTest(bad_value, region_size, resolution);
   }
 }
+
+// Validate Key ordering across negative region coordinates.
+TEST(Keys, Ordering)
+{
+  std::mt19937 rand_engine(0x1u);
+  std::uniform_int_distribution<int> region_rand(-3, 3);
+  std::uniform_int_distribution<int> local_rand(0, 3);
+  std::vector<Key> keys;
+  for (unsigned i = 0; i < 2000u; ++i)
+  {
+    keys.emplace_back(Key(RegionCoord(region_rand(rand_engine)), RegionCoord(region_rand(rand_engine)),
+                          RegionCoord(region_rand(rand_engine)), uint8_t(local_rand(rand_engine)),
+                          uint8_t(local_rand(rand_engine)), uint8_t(local_rand(rand_engine))));
+  }
+
+  std::set<Key> key_set(keys.begin(), keys.end());
+  std::unordered_set<Key, Key::Hash> key_hash_set(keys.begin(), keys.end());
+  EXPECT_EQ(key_set.size(), key_hash_set.size());
+
+  const Key *previous = nullptr;
+  for (const Key &key : key_set)
+  {
+    if (previous)
+    {
+      EXPECT_TRUE(*previous < key);
+      EXPECT_FALSE(key < *previous);
+      const RegionKey &a = previous->regionKey();
+      const RegionKey &b = key.regionKey();
+      EXPECT_TRUE(a.z < b.z || (a.z == b.z && (a.y < b.y || (a.y == b.y && a.x <= b.x))));
+    }
+    previous = &key;
+  }
+}
+
+#ifdef OHM_REGION_COORD_32
+// Validate addressing beyond the 16-bit region coordinate range.
+TEST(Keys, RegionCoord32)
+{
+  OccupancyMap map(1.0, glm::u8vec3(8));
+  const glm::dvec3 far_point(1e6 + 0.5, -2e6 + 0.5, 0.5);
+  const Key key = map.voxelKey(far_point);
+  EXPECT_GT(key.regionKey().x, std::numeric_limits<int16_t>::max());
+  EXPECT_LT(key.regionKey().y, std::numeric_limits<int16_t>::min());
+  const glm::dvec3 centre = map.voxelCentreGlobal(key);
+  EXPECT_NEAR(centre.x, far_point.x, 1e-6);
+  EXPECT_NEAR(centre.y, far_point.y, 1e-6);
+  EXPECT_NEAR(centre.z, far_point.z, 1e-6);
+}
+#endif  // OHM_REGION_COORD_32
+
+template <typename RegionVec>
+double timeRegionLookup(const std::vector<glm::ivec3> &coords, size_t *found)
+{
+  using Clock = std::chrono::high_resolution_clock;
+  ska::bytell_hash_map<RegionVec, unsigned, Vector3Hash<RegionVec>> lookup;
+  const auto start_time = Clock::now();
+  for (size_t i = 0; i < coords.size(); ++i)
+  {
+    lookup.insert(std::make_pair(RegionVec(coords[i]), unsigned(i)));
+  }
+  *found = 0;
+  for (int pass = 0; pass < 4; ++pass)
+  {
+    for (const glm::ivec3 &coord : coords)
+    {
+      *found += lookup.find(RegionVec(coord)) != lookup.end();
+    }
+  }
+  return std::chrono::duration<double>(Clock::now() - start_time).count();
+}
+
+// Compare region key hashing and lookup costs for 16-bit and 32-bit region coordinates and report the Key overhead.
+// Informational: reports timing without making assertions on relative performance.
+TEST(Keys, RegionKeyBenchmark)
+{
+  std::mt19937 rand_engine(0x2u);
+  std::uniform_int_distribution<int> coord_rand(-2000, 2000);
+  std::vector<glm::ivec3> coords(200000u);
+  for (glm::ivec3 &coord : coords)
+  {
+    coord = glm::ivec3(coord_rand(rand_engine), coord_rand(rand_engine), coord_rand(rand_engine));
+  }
+
+  size_t found16 = 0;
+  size_t found32 = 0;
+  const double time16 = timeRegionLookup<glm::i16vec3>(coords, &found16);
+  const double time32 = timeRegionLookup<glm::i32vec3>(coords, &found32);
+  EXPECT_EQ(found16, found32);
+
+  std::vector<Key> keys;
+  keys.reserve(coords.size());
+  for (const glm::ivec3 &coord : coords)
+  {
+    keys.emplace_back(Key(RegionKey(coord), 1, 2, 3));
+  }
+  const auto start_time = std::chrono::high_resolution_clock::now();
+  size_t hash_accumulator = 0;
+  for (const Key &key : keys)
+  {
+    hash_accumulator ^= Key::Hash()(key);
+  }
+  const double key_hash_time =
+    std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+  std::cout << "Region lookup 16-bit: " << time16 << "s, 32-bit: " << time32 << "s" << std::endl;
+  std::cout << "Key size: " << sizeof(Key) << " bytes (" << sizeof(RegionCoord) * 8 << "-bit region coordinates)"
+            << ", hash " << keys.size() << " keys: " << key_hash_time << "s [" << hash_accumulator % 2 << "]"
+            << std::endl;
+}
+
+// Validate PackedKey conversion, ordering and sorting.
+TEST(Keys, Packed)
+{
+  const glm::u8vec3 region_dim(32, 20, 8);
+  const PackedKeyCodec codec(region_dim);
+#ifndef OHM_REGION_COORD_32
+  EXPECT_TRUE(codec.isLossless());
+#else   // OHM_REGION_COORD_32
+  EXPECT_FALSE(codec.isLossless());
+#endif  // OHM_REGION_COORD_32
+  EXPECT_FALSE(PackedKeyCodec(glm::u8vec3(255)).isLossless());
+  EXPECT_FALSE(PackedKeyCodec(glm::u8vec3(255)).canPack(Key(5000, 0, 0, 0, 0, 0)));
+
+  EXPECT_TRUE(codec.pack(Key::kNull).isNull());
+  EXPECT_TRUE(codec.unpack(PackedKey::kNull).isNull());
+
+  std::mt19937 rand_engine(0x3u);
+  std::uniform_int_distribution<int> region_rand(std::numeric_limits<int16_t>::lowest() + 1,
+                                                 std::numeric_limits<int16_t>::max());
+  std::uniform_int_distribution<int> small_region_rand(-4, 4);
+  std::vector<Key> keys;
+  for (unsigned i = 0; i < 20000u; ++i)
+  {
+    std::uniform_int_distribution<int> &rrand = (i % 2) ? region_rand : small_region_rand;
+    keys.emplace_back(Key(RegionCoord(rrand(rand_engine)), RegionCoord(rrand(rand_engine)),
+                          RegionCoord(rrand(rand_engine)), uint8_t(rand_engine() % region_dim.x),
+                          uint8_t(rand_engine() % region_dim.y), uint8_t(rand_engine() % region_dim.z)));
+  }
+
+  // Round trip.
+  std::vector<PackedKey> packed(keys.size());
+  ASSERT_EQ(codec.pack(keys.data(), keys.size(), packed.data()), keys.size());
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    EXPECT_EQ(codec.unpack(packed[i]), keys[i]);
+  }
+
+  // Packed ordering matches the global voxel coordinate ordering.
+  const auto global_less = [region_dim](const Key &a, const Key &b) {
+    for (int i = 2; i >= 0; --i)
+    {
+      const int64_t ga = int64_t(a.regionKey()[i]) * region_dim[i] + a.localKey()[i];
+      const int64_t gb = int64_t(b.regionKey()[i]) * region_dim[i] + b.localKey()[i];
+      if (ga != gb)
+      {
+        return ga < gb;
+      }
+    }
+    return false;
+  };
+  for (size_t i = 1; i < keys.size(); ++i)
+  {
+    EXPECT_EQ(packed[i - 1] < packed[i], global_less(keys[i - 1], keys[i]));
+  }
+
+  // Radix sort matches std::sort.
+  std::vector<PackedKey> radix_sorted = packed;
+  sortPackedKeys(radix_sorted);
+  std::sort(packed.begin(), packed.end());
+  EXPECT_EQ(radix_sorted, packed);
+}
+
+// Compare Key and PackedKey costs in KeyList heavy paths: de-duplicating calculateSegmentKeys() and LineKeysQuery
+// results. Informational: reports timing without making assertions on relative performance.
+TEST(Keys, PackedKeyBenchmark)
+{
+  using Clock = std::chrono::high_resolution_clock;
+  OccupancyMap map(0.1, glm::u8vec3(32));
+  const PackedKeyCodec codec(map);
+
+  std::mt19937 rand_engine(0x4u);
+  std::uniform_real_distribution<double> rand_point(-10.0, 10.0);
+  std::vector<glm::dvec3> rays;
+  for (unsigned i = 0; i < 2000u; ++i)
+  {
+    rays.emplace_back(glm::dvec3(0.0));
+    rays.emplace_back(glm::dvec3(rand_point(rand_engine), rand_point(rand_engine), rand_point(rand_engine)));
+  }
+
+  // calculateSegmentKeys() with hashed de-duplication.
+  KeyList key_list;
+  std::vector<PackedKey> packed_list;
+  std::unordered_set<Key, Key::Hash> key_set;
+  std::unordered_set<PackedKey, PackedKey::Hash> packed_set;
+  double key_time = 0;
+  double packed_time = 0;
+  for (size_t i = 0; i < rays.size(); i += 2)
+  {
+    key_list.clear();
+    map.calculateSegmentKeys(key_list, rays[i + 0], rays[i + 1], true);
+
+    auto start_time = Clock::now();
+    key_set.insert(key_list.begin(), key_list.end());
+    key_time += std::chrono::duration<double>(Clock::now() - start_time).count();
+
+    start_time = Clock::now();
+    ASSERT_TRUE(key_list.pack(packed_list, codec));
+    packed_set.insert(packed_list.begin(), packed_list.end());
+    packed_time += std::chrono::duration<double>(Clock::now() - start_time).count();
+  }
+  EXPECT_EQ(key_set.size(), packed_set.size());
+  std::cout << "Segment key de-duplication: Key " << key_time << "s, PackedKey " << packed_time << "s, "
+            << key_set.size() << " voxels" << std::endl;
+
+  // LineKeysQuery results: sort and de-duplicate.
+  LineKeysQuery query(map);
+  query.setRays(rays.data(), rays.size());
+  ASSERT_TRUE(query.execute());
+  const size_t result_count = query.resultIndices()[query.numberOfResults() - 1] +
+                              query.resultCounts()[query.numberOfResults() - 1];
+
+  std::vector<Key> keys(query.intersectedVoxels(), query.intersectedVoxels() + result_count);
+  auto start_time = Clock::now();
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  key_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+  std::vector<PackedKey> packed(result_count);
+  start_time = Clock::now();
+  ASSERT_EQ(codec.pack(query.intersectedVoxels(), result_count, packed.data()), result_count);
+  sortPackedKeys(packed);
+  packed.erase(std::unique(packed.begin(), packed.end()), packed.end());
+  packed_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+  EXPECT_EQ(keys.size(), packed.size());
+
+  std::cout << "LineKeysQuery sort/unique " << result_count << " keys: Key " << key_time << "s, PackedKey (radix) "
+            << packed_time << "s" << std::endl;
+  std::cout << "Key size " << sizeof(Key) << " bytes, PackedKey size " << sizeof(PackedKey) << " bytes" << std::endl;
+}
 }  // namespace keytests
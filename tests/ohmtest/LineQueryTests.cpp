@@ -5,24 +5,39 @@
 // Author: Kazys Stepanas
 #include "OhmTestConfig.h"
 
+#include <ohm/ClearanceProcessCpu.h>
 #include <ohm/Key.h>
 #include <ohm/KeyList.h>
 #include <ohm/LineQuery.h>
 #include <ohm/MapSerialise.h>
+#include <ohm/NearestNeighbours.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/OccupancyPyramid.h>
 #include <ohm/OccupancyType.h>
 #include <ohm/OccupancyUtil.h>
+#include <ohm/QueryBatch.h>
+#include <ohm/QueryFlag.h>
+#include <ohm/RayCast.h>
+#include <ohm/RayCastQuery.h>
+#include <ohm/SweptVolumeQuery.h>
 #include <ohm/VoxelData.h>
+#include <ohm/VoxelOccupancy.h>
 
 #include <ohmtools/OhmCloud.h>
 #include <ohmtools/OhmGen.h>
 #include <ohmutil/OhmUtil.h>
 #include <ohmutil/Profile.h>
 
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <random>
+#include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -82,4 +97,528 @@ TEST(LineQuery, Cpu)
   sparseMap(map);
   lineQueryTest(map);
 }
+
+TEST(LineQuery, CpuClearance)
+{
+  OccupancyMap map(0.1);
+  sparseMap(map);
+  const float search_radius = 2.0f;
+  const glm::dvec3 start_point(-2, 0, 0);
+  const glm::dvec3 end_point(2, 0, 0);
+
+  // Calculate clearance a little beyond the query radius so voxels at exactly the search radius are not lost to
+  // floating point error.
+  ClearanceProcessCpu clearance_process(search_radius + 0.5f * float(map.resolution()), 0u);
+  clearance_process.calculateForExtents(map, glm::dvec3(-7), glm::dvec3(7));
+
+  const auto compare_queries = [&](const char *context, float radius, unsigned flags) {
+    // kQfNoCache forces the brute force search.
+    LineQuery reference(map, start_point, end_point, radius, flags | kQfNoCache);
+    auto start_time = TimingClock::now();
+    ASSERT_TRUE(reference.execute());
+    const auto reference_time = TimingClock::now() - start_time;
+
+    LineQuery query(map, start_point, end_point, radius, flags);
+    start_time = TimingClock::now();
+    ASSERT_TRUE(query.execute());
+    const auto query_time = TimingClock::now() - start_time;
+
+    ASSERT_EQ(query.numberOfResults(), reference.numberOfResults());
+    for (size_t i = 0; i < query.numberOfResults(); ++i)
+    {
+      EXPECT_EQ(query.intersectedVoxels()[i], reference.intersectedVoxels()[i]);
+      EXPECT_NEAR(query.ranges()[i], reference.ranges()[i], 1e-4f);
+    }
+    std::cout << context << ": brute force " << reference_time << ", clearance layer " << query_time << std::endl;
+  };
+
+  compare_queries("Up to date clearance", search_radius, 0u);
+  // The clearance layer does not treat unknown voxels as obstructions, so must not be used here.
+  compare_queries("Unknown as occupied", search_radius, kQfUnknownAsOccupied);
+
+  LineQuery nearest_query(map, start_point, end_point, search_radius, kQfNearestResult);
+  ASSERT_TRUE(nearest_query.execute());
+  ASSERT_EQ(nearest_query.numberOfResults(), 1u);
+  EXPECT_EQ(nearest_query.intersectedVoxels()[0], map.voxelKey(glm::dvec3(0)));
+  EXPECT_EQ(nearest_query.ranges()[0], 0);
+
+  // Add an obstruction near the line without updating the clearance. The stale regions must fall back to the brute
+  // force search.
+  integrateHit(map, map.voxelKey(glm::dvec3(1.05, 0.55, 0.05)));
+  compare_queries("Stale clearance", search_radius, 0u);
+
+  // Recalculate with a smaller radius. The clearance layer no longer covers the query radius, but still serves queries
+  // within its radius.
+  const float small_radius = 0.5f;
+  ClearanceProcessCpu small_clearance_process(small_radius + 0.5f * float(map.resolution()), 0u);
+  small_clearance_process.calculateForExtents(map, glm::dvec3(-7), glm::dvec3(7));
+  compare_queries("Smaller clearance radius", search_radius, 0u);
+  compare_queries("Within clearance radius", small_radius, 0u);
+}
+
+TEST(LineQuery, RayCastSkipEmpty)
+{
+  // Build a sparse, outdoor like map: a patch of observed free space around the origin, scattered ground patches and
+  // poles, with the remainder unknown.
+  OccupancyMap map(0.25, glm::u8vec3(32));
+  ohmgen::fillMapWithEmptySpace(map, -64, -64, -8, 64, 64, 24);
+
+  std::mt19937 rand_engine(0x4a57);
+  std::uniform_int_distribution<int> coord_rand(-200, 200);
+  {
+    Voxel<float> voxel(&map, map.layout().occupancyLayer());
+    const auto set_occupied = [&](int x, int y, int z) {
+      Key key(0, 0, 0, 0, 0, 0);
+      map.moveKey(key, x, y, z);
+      voxel.setKey(key);
+      voxel.write(map.hitValue());
+    };
+    for (int patch = 0; patch < 60; ++patch)
+    {
+      const int px = coord_rand(rand_engine);
+      const int py = coord_rand(rand_engine);
+      for (int y = 0; y < 12; ++y)
+      {
+        for (int x = 0; x < 12; ++x)
+        {
+          set_occupied(px + x, py + y, -9);
+        }
+      }
+    }
+    for (int pole = 0; pole < 300; ++pole)
+    {
+      const int px = coord_rand(rand_engine);
+      const int py = coord_rand(rand_engine);
+      for (int z = -8; z < 8; ++z)
+      {
+        set_occupied(px, py, z);
+      }
+    }
+  }
+
+  OccupancyPyramid pyramid(&map);
+  ASSERT_TRUE(pyramid.isValid());
+  pyramid.update();
+
+  // Long, near horizontal rays.
+  std::uniform_real_distribution<double> heading_rand(-M_PI, M_PI);
+  std::uniform_real_distribution<double> elevation_rand(-0.2, 0.05);
+  const double ray_length = 60.0;
+  std::vector<glm::dvec3> rays;
+  for (unsigned i = 0; i < 2000u; ++i)
+  {
+    const double heading = heading_rand(rand_engine);
+    const double elevation = elevation_rand(rand_engine);
+    const glm::dvec3 dir(std::cos(heading) * std::cos(elevation), std::sin(heading) * std::cos(elevation),
+                         std::sin(elevation));
+    rays.emplace_back(glm::dvec3(0.1, 0.1, 0.1));
+    rays.emplace_back(rays.back() + ray_length * dir);
+  }
+
+  // Reference: walk every voxel along each ray.
+  std::vector<Key> reference_hits(rays.size() / 2);
+  KeyList keys;
+  size_t reference_voxels = 0;
+  auto start_time = TimingClock::now();
+  {
+    Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+    for (size_t i = 0; i < rays.size(); i += 2)
+    {
+      map.calculateSegmentKeys(keys, rays[i], rays[i + 1], true);
+      reference_hits[i / 2] = Key::kNull;
+      for (const Key &key : keys)
+      {
+        ++reference_voxels;
+        voxel.setKey(key);
+        if (isOccupied(voxel))
+        {
+          reference_hits[i / 2] = key;
+          break;
+        }
+      }
+    }
+  }
+  const auto reference_time = TimingClock::now() - start_time;
+
+  const auto cast_rays = [&](const OccupancyPyramid *use_pyramid, std::vector<Key> &hits, size_t *voxels_tested) {
+    RayCastResult result;
+    hits.resize(rays.size() / 2);
+    *voxels_tested = 0;
+    for (size_t i = 0; i < rays.size(); i += 2)
+    {
+      rayCastFirstOccupied(map, rays[i], rays[i + 1], &result, false, use_pyramid);
+      hits[i / 2] = result.key;
+      *voxels_tested += result.voxels_tested;
+    }
+  };
+
+  std::vector<Key> region_hits;
+  size_t region_voxels = 0;
+  start_time = TimingClock::now();
+  cast_rays(nullptr, region_hits, &region_voxels);
+  const auto region_time = TimingClock::now() - start_time;
+
+  std::vector<Key> pyramid_hits;
+  size_t pyramid_voxels = 0;
+  start_time = TimingClock::now();
+  cast_rays(&pyramid, pyramid_hits, &pyramid_voxels);
+  const auto pyramid_time = TimingClock::now() - start_time;
+
+  std::cout << "Reference walk: " << reference_time << " " << reference_voxels << " voxels" << std::endl;
+  std::cout << "Region skipping: " << region_time << " " << region_voxels << " voxels" << std::endl;
+  std::cout << "Pyramid skipping: " << pyramid_time << " " << pyramid_voxels << " voxels" << std::endl;
+
+  size_t hit_count = 0;
+  size_t mismatch_count = 0;
+  for (size_t i = 0; i < reference_hits.size(); ++i)
+  {
+    EXPECT_EQ(pyramid_hits[i], region_hits[i]);
+    hit_count += !reference_hits[i].isNull();
+    mismatch_count += reference_hits[i] != region_hits[i];
+  }
+  EXPECT_GT(hit_count, 0u);
+  EXPECT_EQ(mismatch_count, 0u);
+  EXPECT_LT(region_voxels, reference_voxels);
+  EXPECT_LT(pyramid_voxels, region_voxels);
+}
+
+
+/// Fill a map with free space over +/- @p half_extents voxels, with @p occupied_count randomly placed occupied voxels.
+void randomMap(OccupancyMap &map, int half_extents, unsigned occupied_count, unsigned seed)
+{
+  ohmgen::fillMapWithEmptySpace(map, -half_extents, -half_extents, -half_extents, half_extents - 1,
+                                half_extents - 1, half_extents - 1);
+  std::mt19937 rand_engine(seed);
+  std::uniform_int_distribution<int> rand(-half_extents, half_extents - 1);
+  for (unsigned i = 0; i < occupied_count; ++i)
+  {
+    Key key(0, 0, 0, 0, 0, 0);
+    map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    integrateHit(map, key);
+  }
+}
+
+TEST(QueryBatch, Cpu)
+{
+  OccupancyMap map(0.1, glm::u8vec3(16));
+  randomMap(map, 24, 600, 0x51u);
+
+  std::mt19937 rand_engine(0x52u);
+  std::uniform_real_distribution<double> rand(-3.0, 3.0);
+  const float search_radius = 0.45f;
+
+  std::vector<std::pair<glm::dvec3, glm::dvec3>> lines;
+  for (int i = 0; i < 20; ++i)
+  {
+    lines.emplace_back(glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine)),
+                       glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine)));
+  }
+  // Repeat a line to exercise shared line voxels.
+  lines.emplace_back(glm::dvec3(-2, 0.05, 0.05), glm::dvec3(2, 0.05, 0.05));
+  lines.emplace_back(lines.back());
+  std::vector<glm::dvec3> points;
+  for (int i = 0; i < 20; ++i)
+  {
+    points.emplace_back(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+  }
+
+  for (const unsigned flags : { 0u, unsigned(kQfUnknownAsOccupied) })
+  {
+    // Interleave the query types.
+    QueryBatch batch(map, search_radius, flags);
+    std::vector<size_t> line_indices;
+    std::vector<size_t> point_indices;
+    for (size_t i = 0; i < std::max(lines.size(), points.size()); ++i)
+    {
+      if (i < lines.size())
+      {
+        line_indices.emplace_back(batch.addLineQuery(lines[i].first, lines[i].second));
+      }
+      if (i < points.size())
+      {
+        point_indices.emplace_back(batch.addNearestNeighboursQuery(points[i]));
+      }
+    }
+    ASSERT_EQ(batch.queryCount(), lines.size() + points.size());
+
+    ASSERT_TRUE(batch.execute());
+    ASSERT_NE(batch.resultOffsets(), nullptr);
+    EXPECT_EQ(batch.resultOffsets()[batch.queryCount()], batch.numberOfResults());
+
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+      EXPECT_EQ(batch.queryType(line_indices[i]), QueryBatch::QueryType::kLine);
+      LineQuery query(map, lines[i].first, lines[i].second, search_radius, flags);
+      ASSERT_TRUE(query.execute());
+      const size_t offset = batch.resultOffsets()[line_indices[i]];
+      ASSERT_EQ(batch.resultOffsets()[line_indices[i] + 1] - offset, query.numberOfResults());
+      for (size_t j = 0; j < query.numberOfResults(); ++j)
+      {
+        EXPECT_EQ(batch.intersectedVoxels()[offset + j], query.intersectedVoxels()[j]);
+        EXPECT_NEAR(batch.ranges()[offset + j], query.ranges()[j], 1e-5f);
+      }
+    }
+
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+      EXPECT_EQ(batch.queryType(point_indices[i]), QueryBatch::QueryType::kNearestNeighbours);
+      NearestNeighbours query(map, points[i], search_radius, flags);
+      ASSERT_TRUE(query.execute());
+      const size_t offset = batch.resultOffsets()[point_indices[i]];
+      ASSERT_EQ(batch.resultOffsets()[point_indices[i] + 1] - offset, query.numberOfResults());
+      std::vector<Key> expected(query.intersectedVoxels(), query.intersectedVoxels() + query.numberOfResults());
+      for (size_t j = 0; j < query.numberOfResults(); ++j)
+      {
+        EXPECT_NE(std::find(expected.begin(), expected.end(), batch.intersectedVoxels()[offset + j]), expected.end());
+      }
+    }
+
+    // Nearest results only.
+    batch.setQueryFlags(flags | kQfNearestResult);
+    ASSERT_TRUE(batch.execute());
+    for (size_t i = 0; i < batch.queryCount(); ++i)
+    {
+      EXPECT_LE(batch.resultOffsets()[i + 1] - batch.resultOffsets()[i], 1u);
+    }
+  }
+}
+
+TEST(QueryBatch, Benchmark)
+{
+  OccupancyMap map(0.1, glm::u8vec3(32));
+  randomMap(map, 64, 20000, 0x53u);
+
+  // Short, overlapping segments typical of trajectory validation.
+  std::mt19937 rand_engine(0x54u);
+  std::uniform_real_distribution<double> rand(-5.0, 5.0);
+  std::uniform_real_distribution<double> step_rand(-0.5, 0.5);
+  std::vector<std::pair<glm::dvec3, glm::dvec3>> lines;
+  glm::dvec3 position(0);
+  for (int i = 0; i < 2000; ++i)
+  {
+    if (i % 100 == 0)
+    {
+      position = glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    }
+    const glm::dvec3 next =
+      position + glm::dvec3(step_rand(rand_engine), step_rand(rand_engine), step_rand(rand_engine));
+    lines.emplace_back(position, next);
+    position = next;
+  }
+  const float search_radius = 0.3f;
+
+  auto start_time = TimingClock::now();
+  size_t query_results = 0;
+  for (const auto &line : lines)
+  {
+    LineQuery query(map, line.first, line.second, search_radius, LineQuery::kDefaultFlags);
+    query.execute();
+    query_results += query.numberOfResults();
+  }
+  const auto query_time = TimingClock::now() - start_time;
+
+  QueryBatch batch(map, search_radius);
+  for (const auto &line : lines)
+  {
+    batch.addLineQuery(line.first, line.second);
+  }
+  start_time = TimingClock::now();
+  batch.execute();
+  const auto batch_time = TimingClock::now() - start_time;
+
+  EXPECT_EQ(batch.numberOfResults(), query_results);
+  std::cout << "Line queries: " << query_time << " " << lines.size() << " queries" << std::endl;
+  std::cout << "Query batch: " << batch_time << std::endl;
+}
+
+
+TEST(RayCastQuery, Cpu)
+{
+  OccupancyMap map(0.1, glm::u8vec3(32));
+  randomMap(map, 64, 4000, 0x55u);
+
+  OccupancyPyramid pyramid(&map);
+  ASSERT_TRUE(pyramid.isValid());
+  pyramid.update();
+
+  // Rays from a sensor near the origin, extending beyond the observed space into unknown regions.
+  std::mt19937 rand_engine(0x56u);
+  std::uniform_real_distribution<double> rand(-9.0, 9.0);
+  std::vector<glm::dvec3> rays;
+  for (int i = 0; i < 20000; ++i)
+  {
+    rays.emplace_back(glm::dvec3(0.05));
+    rays.emplace_back(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+  }
+
+  for (bool unknown_as_occupied : { false, true })
+  {
+    const unsigned flags = RayCastQuery::kDefaultFlags | ((unknown_as_occupied) ? kQfUnknownAsOccupied : 0u);
+    RayCastQuery query(map, flags);
+    query.setRays(rays.data(), rays.size());
+    query.setPyramid(&pyramid);
+    auto start_time = TimingClock::now();
+    ASSERT_TRUE(query.execute());
+    const auto query_time = TimingClock::now() - start_time;
+    ASSERT_EQ(query.numberOfResults(), rays.size() / 2);
+
+    RayCastResult result;
+    Voxel<const float> end_voxel(&map, map.layout().occupancyLayer());
+    size_t hit_count = 0;
+    start_time = TimingClock::now();
+    for (size_t i = 0; i < rays.size(); i += 2)
+    {
+      const bool hit = rayCastFirstOccupied(map, rays[i], rays[i + 1], &result, unknown_as_occupied);
+      const size_t index = i / 2;
+      EXPECT_EQ(query.intersectedVoxels()[index], result.key);
+      EXPECT_NEAR(query.ranges()[index], (hit) ? result.range : -1.0, 1e-4);
+      EXPECT_EQ(query.occupancy()[index], result.occupancy);
+      hit_count += hit;
+      // Rays ending in unknown space must hit.
+      end_voxel.setKey(map.voxelKey(rays[i + 1]));
+      if (unknown_as_occupied && isUnobservedOrNull(end_voxel))
+      {
+        EXPECT_TRUE(hit);
+      }
+    }
+    const auto single_time = TimingClock::now() - start_time;
+
+    EXPECT_GT(hit_count, 0u);
+    std::cout << "Unknown as occupied: " << unknown_as_occupied << std::endl;
+    std::cout << "Individual ray casts: " << single_time << " " << rays.size() / 2 << " rays" << std::endl;
+    std::cout << "Ray cast query: " << query_time << " " << hit_count << " hits" << std::endl;
+  }
+}
+
+
+TEST(SweptVolumeQuery, Shapes)
+{
+  OccupancyMap map(0.1);
+  sparseMap(map);
+  const glm::dvec3 centre = map.voxelCentreGlobal(map.voxelKey(glm::dvec3(0.5 * map.resolution())));
+  const glm::dquat identity(1, 0, 0, 0);
+
+  SweptVolumeQuery query(map);
+  const auto test_pose = [&](const glm::dvec3 &position, const glm::dquat &orientation) {
+    query.setPoses(&position, &orientation, 1);
+    EXPECT_TRUE(query.execute());
+    return query.collides();
+  };
+
+  query.setSphere(0.2);
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(0.3, 0, 0), identity));
+  EXPECT_TRUE(test_pose(centre + glm::dvec3(0.2, 0, 0), identity));
+  ASSERT_EQ(query.numberOfResults(), 1u);
+  EXPECT_EQ(query.intersectedVoxels()[0], map.voxelKey(centre));
+  EXPECT_EQ(query.collisionPoseIndex(), 0u);
+
+  // Capsule along the z axis.
+  query.setCapsule(0.1, 1.0);
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(0.2, 0, 0), identity));
+  EXPECT_TRUE(test_pose(centre + glm::dvec3(0, 0, 0.9), identity));
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(0, 0, 1.2), identity));
+  // Rotated onto the x axis.
+  EXPECT_TRUE(test_pose(centre + glm::dvec3(0.9, 0, 0), glm::angleAxis(0.5 * M_PI, glm::dvec3(0, 1, 0))));
+
+  query.setBox(glm::dvec3(1.0, 0.05, 0.05));
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(0, 0.3, 0), identity));
+  EXPECT_TRUE(test_pose(centre + glm::dvec3(0, 0.3, 0), glm::angleAxis(0.5 * M_PI, glm::dvec3(0, 0, 1))));
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(0.3, 0.3, 0), glm::angleAxis(0.5 * M_PI, glm::dvec3(0, 0, 1))));
+
+  // Sweep a sphere past, then through the occupied voxel.
+  query.setSphere(0.1);
+  const glm::dvec3 positions[] = { centre + glm::dvec3(-2, 0, 1), centre + glm::dvec3(-2, 0, 0),
+                                   centre + glm::dvec3(2, 0, 0) };
+  query.setPoses(positions, nullptr, 2);
+  ASSERT_TRUE(query.execute());
+  EXPECT_FALSE(query.collides());
+  query.setPoses(positions, nullptr, 3);
+  ASSERT_TRUE(query.execute());
+  ASSERT_TRUE(query.collides());
+  EXPECT_EQ(query.collisionPoseIndex(), 1u);
+  EXPECT_EQ(query.intersectedVoxels()[0], map.voxelKey(centre));
+  // Contact is at 2.85 along the path and is found by the first test after contact, within a sweep step.
+  EXPECT_GE(query.ranges()[0], 2.85f - 1e-4f);
+  EXPECT_LT(query.ranges()[0], 2.85f + map.resolution());
+
+  // Unknown space.
+  EXPECT_FALSE(test_pose(centre + glm::dvec3(10, 0, 0), identity));
+  query.setQueryFlags(kQfUnknownAsOccupied);
+  EXPECT_TRUE(test_pose(centre + glm::dvec3(10, 0, 0), identity));
+}
+
+
+TEST(SweptVolumeQuery, Clearance)
+{
+  OccupancyMap map(0.1, glm::u8vec3(32));
+  randomMap(map, 32, 300, 0x57u);
+  const float clearance_radius = 0.6f;
+  ClearanceProcessCpu clearance_process(clearance_radius, 0u);
+  clearance_process.calculateForExtents(map, glm::dvec3(-4), glm::dvec3(4));
+
+  // Random short trajectories.
+  std::mt19937 rand_engine(0x58u);
+  std::uniform_real_distribution<double> position_rand(-2.5, 2.5);
+  std::uniform_real_distribution<double> step_rand(-0.3, 0.3);
+  std::uniform_real_distribution<double> angle_rand(-M_PI, M_PI);
+  const unsigned sweep_count = 200;
+  const unsigned pose_count = 10;
+  std::vector<glm::dvec3> positions;
+  std::vector<glm::dquat> orientations;
+  for (unsigned i = 0; i < sweep_count; ++i)
+  {
+    glm::dvec3 position(position_rand(rand_engine), position_rand(rand_engine), position_rand(rand_engine));
+    for (unsigned j = 0; j < pose_count; ++j)
+    {
+      position += glm::dvec3(step_rand(rand_engine), step_rand(rand_engine), step_rand(rand_engine));
+      positions.emplace_back(position);
+      orientations.emplace_back(glm::angleAxis(
+        angle_rand(rand_engine),
+        glm::normalize(glm::dvec3(angle_rand(rand_engine), angle_rand(rand_engine), angle_rand(rand_engine)))));
+    }
+  }
+
+  const auto compare_shapes = [&](const char *context, const std::function<void(SweptVolumeQuery &)> &set_shape) {
+    // kQfNoCache forces the occupancy tests.
+    SweptVolumeQuery reference(map, kQfNoCache);
+    SweptVolumeQuery query(map);
+    set_shape(reference);
+    set_shape(query);
+
+    TimingClock::duration reference_time(0);
+    TimingClock::duration query_time(0);
+    unsigned collision_count = 0;
+    for (unsigned i = 0; i < sweep_count; ++i)
+    {
+      reference.setPoses(positions.data() + i * pose_count, orientations.data() + i * pose_count, pose_count);
+      query.setPoses(positions.data() + i * pose_count, orientations.data() + i * pose_count, pose_count);
+
+      auto start_time = TimingClock::now();
+      ASSERT_TRUE(reference.execute());
+      reference_time += TimingClock::now() - start_time;
+      start_time = TimingClock::now();
+      ASSERT_TRUE(query.execute());
+      query_time += TimingClock::now() - start_time;
+
+      ASSERT_EQ(query.collides(), reference.collides());
+      ASSERT_EQ(query.numberOfResults(), reference.numberOfResults());
+      if (reference.collides())
+      {
+        ++collision_count;
+        EXPECT_EQ(query.collisionPoseIndex(), reference.collisionPoseIndex());
+        EXPECT_EQ(query.intersectedVoxels()[0], reference.intersectedVoxels()[0]);
+        EXPECT_EQ(query.ranges()[0], reference.ranges()[0]);
+      }
+    }
+
+    EXPECT_GT(collision_count, 0u);
+    EXPECT_LT(collision_count, sweep_count);
+    std::cout << context << ": " << collision_count << " collisions, occupancy " << reference_time
+              << ", clearance layer " << query_time << std::endl;
+  };
+
+  compare_shapes("Sphere", [](SweptVolumeQuery &query) { query.setSphere(0.15); });
+  compare_shapes("Capsule", [](SweptVolumeQuery &query) { query.setCapsule(0.1, 0.3); });
+  compare_shapes("Box", [](SweptVolumeQuery &query) { query.setBox(glm::dvec3(0.3, 0.1, 0.05)); });
+}
 }  // namespace linequerytests
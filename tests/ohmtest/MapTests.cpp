@@ -8,9 +8,24 @@
 #include <ohm/Aabb.h>
 #include <ohm/Key.h>
 #include <ohm/LineQuery.h>
+#include <ohm/MapLayout.h>
+#include <ohm/MapMemoryUsage.h>
+#include <ohm/MapSerialise.h>
+#include <ohm/NdtMap.h>
+#include <ohm/OccupancyEncoding.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/OccupancyPyramid.h>
+#include <ohm/RayMapperNdt.h>
 #include <ohm/RayMapperOccupancy.h>
+#include <ohm/RegionPrefetcher.h>
+#include <ohm/RegionVisit.h>
+#include <ohm/SharedMapPublisher.h>
+#include <ohm/SharedMapView.h>
+#include <ohm/TernaryOccupancy.h>
+#include <ohm/VoxelBlock.h>
 #include <ohm/VoxelData.h>
+#include <ohm/VoxelLayout.h>
+#include <ohm/VoxelOccupancy.h>
 
 #include <ohmtools/OhmCloud.h>
 #include <ohmtools/OhmGen.h>
@@ -18,10 +33,17 @@
 #include <ohmutil/OhmUtil.h>
 #include <ohmutil/Profile.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
 
 #include <gtest/gtest.h>
 #include "ohmtestcommon/OhmTestUtil.h"
@@ -227,4 +249,1012 @@ TEST(Map, ClipBox)
 
   EXPECT_TRUE(touched);
 }
+
+TEST(Map, ObservedIteration)
+{
+  OccupancyMap map(0.25);
+
+  // Generate occupancy.
+  const double box_size = 5.0;
+  ohmgen::boxRoom(map, glm::dvec3(-box_size), glm::dvec3(box_size));
+  // Create a region with no observed voxels.
+  map.region(ohm::RegionKey(100, 100, 100), true);
+
+  // Collect the observed keys using the full iterator.
+  std::unordered_set<Key, Key::Hash> expected_keys;
+  {
+    Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    for (auto iter = map.begin(); iter != map.end(); ++iter)
+    {
+      occupancy.setKey(iter);
+      if (!isUnobservedOrNull(occupancy))
+      {
+        expected_keys.insert(*iter);
+      }
+    }
+  }
+  ASSERT_FALSE(expected_keys.empty());
+
+  // Validate the observed iterator.
+  std::unordered_set<Key, Key::Hash> observed_keys;
+  for (auto iter = map.beginObserved(); iter != map.end(); ++iter)
+  {
+    EXPECT_TRUE(observed_keys.insert(*iter).second);
+  }
+  EXPECT_EQ(observed_keys, expected_keys);
+
+  // Validate the parallel visitor.
+  std::vector<std::vector<Key>> region_keys(map.regionCount());
+  const size_t region_count = visitObservedVoxels(
+    map, [&region_keys](const MapChunk &, size_t region_index, unsigned, const Key &key) {
+      region_keys[region_index].emplace_back(key);
+    });
+  EXPECT_EQ(region_count, map.regionCount());
+  observed_keys.clear();
+  for (const auto &keys : region_keys)
+  {
+    observed_keys.insert(keys.begin(), keys.end());
+  }
+  EXPECT_EQ(observed_keys, expected_keys);
+
+  // Observe a new voxel in the empty region and ensure the observed mask is updated.
+  const Key new_key(100, 100, 100, 1, 2, 3);
+  integrateMiss(map, new_key);
+  expected_keys.insert(new_key);
+  observed_keys.clear();
+  for (auto iter = map.beginObserved(); iter != map.end(); ++iter)
+  {
+    observed_keys.insert(*iter);
+  }
+  EXPECT_EQ(observed_keys, expected_keys);
+
+  std::atomic<size_t> visit_count(0u);
+  visitRegions(map, [&visit_count](const MapChunk &chunk, size_t) {
+    visit_count += visitObserved(chunk, [](unsigned) {});
+  });
+  EXPECT_EQ(visit_count, expected_keys.size());
+}
+
+TEST(Map, LazyLayers)
+{
+  OccupancyMap map(0.25, MapFlag::kVoxelMean);
+  const Key key(0, 0, 0, 1, 2, 3);
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const int mean_layer = map.layout().meanLayer();
+  ASSERT_GE(occupancy_layer, 0);
+  ASSERT_GE(mean_layer, 0);
+
+  // Create a region without touching any layer.
+  const MapChunk *chunk = map.region(key.regionKey(), true);
+  ASSERT_NE(chunk, nullptr);
+  EXPECT_FALSE(chunk->isLayerAllocated(occupancy_layer));
+  EXPECT_FALSE(chunk->isLayerAllocated(mean_layer));
+
+  // Write occupancy only.
+  {
+    Voxel<float> occupancy(&map, occupancy_layer, key);
+    ASSERT_TRUE(occupancy.isValid());
+    integrateHit(occupancy);
+  }
+  EXPECT_TRUE(chunk->isLayerAllocated(occupancy_layer));
+  EXPECT_FALSE(chunk->isLayerAllocated(mean_layer));
+
+  // Unallocated layers read as default values.
+  {
+    Voxel<const float> occupancy(&map, occupancy_layer, Key(0, 0, 0, 0, 0, 0));
+    ASSERT_TRUE(occupancy.isValid());
+    EXPECT_TRUE(isUnobserved(occupancy));
+    Voxel<const VoxelMean> mean(&map, mean_layer, key);
+    ASSERT_TRUE(mean.isValid());
+    VoxelMean mean_data;
+    mean.read(&mean_data);
+    EXPECT_EQ(mean_data.coord, 0u);
+    EXPECT_EQ(mean_data.count, 0u);
+  }
+
+  // Unallocated layers clone as uninitialised.
+  const std::unique_ptr<OccupancyMap> map_copy(map.clone());
+  ohmtestutil::compareMaps(*map_copy, map, ohmtestutil::kCfCompareAll);
+
+  // Remove the region and recreate it. The pooled chunk must come back in the default state.
+  EXPECT_EQ(map.removeDistanceRegions(glm::dvec3(1e6), 1.0f), 1u);
+  EXPECT_EQ(map.regionCount(), 0u);
+  chunk = map.region(key.regionKey(), true);
+  ASSERT_NE(chunk, nullptr);
+  EXPECT_FALSE(chunk->hasValidNodes());
+  EXPECT_FALSE(chunk->isLayerAllocated(occupancy_layer));
+  EXPECT_EQ(chunk->touched_stamps[occupancy_layer], 0u);
+  Voxel<const float> occupancy(&map, occupancy_layer, key);
+  ASSERT_TRUE(occupancy.isValid());
+  EXPECT_TRUE(isUnobserved(occupancy));
+}
+
+TEST(Map, Compact)
+{
+  OccupancyMap map(0.25, glm::u8vec3(8), MapFlag::kCompressed | MapFlag::kVoxelMean);
+  const int occupancy_layer = map.layout().occupancyLayer();
+  // Allow compaction to compress blocks as soon as they are released.
+  MapLayer::CompressionPolicy policy;
+  policy.release_delay_ms = 0;
+  map.layout().layerPtr(occupancy_layer)->setCompressionPolicy(policy);
+
+  // Observed regions.
+  const std::vector<Key> observed_keys = { Key(0, 0, 0, 1, 2, 3), Key(1, 0, 0, 4, 4, 4), Key(-2, 3, 1, 7, 0, 5) };
+  for (const Key &key : observed_keys)
+  {
+    integrateHit(map, key);
+  }
+
+  // Regions with nothing observed: one never accessed, one with an allocated occupancy layer of unobserved voxels and
+  // one with only voxel mean data. The last is retained as it still holds data.
+  map.region(RegionKey(5, 5, 5), true);
+  {
+    Voxel<float> occupancy(&map, occupancy_layer, Key(6, 5, 5, 0, 0, 0));
+    ASSERT_TRUE(occupancy.isValid());
+    occupancy.write(unobservedOccupancyValue());
+  }
+  {
+    Voxel<VoxelMean> mean(&map, map.layout().meanLayer(), Key(7, 5, 5, 0, 0, 0));
+    ASSERT_TRUE(mean.isValid());
+    VoxelMean mean_data{};
+    mean_data.count = 1;
+    mean.write(mean_data);
+  }
+
+  // Pool a chunk.
+  map.region(RegionKey(40, 0, 0), true);
+  EXPECT_EQ(map.removeDistanceRegions(glm::dvec3(0), 50.0f), 1u);
+  EXPECT_EQ(map.regionCount(), observed_keys.size() + 3u);
+
+  const std::unique_ptr<OccupancyMap> reference(map.clone());
+  const size_t reclaimed = map.compact();
+  EXPECT_GT(reclaimed, 0u);
+  EXPECT_EQ(map.regionCount(), observed_keys.size() + 1u);
+  EXPECT_EQ(map.region(RegionKey(5, 5, 5)), nullptr);
+  EXPECT_EQ(map.region(RegionKey(6, 5, 5)), nullptr);
+  {
+    Voxel<const VoxelMean> mean(&map, map.layout().meanLayer(), Key(7, 5, 5, 0, 0, 0));
+    ASSERT_TRUE(mean.isValid());
+    EXPECT_EQ(mean.data().count, 1u);
+  }
+
+  // The observed regions are compressed, tightly allocated and unchanged.
+  for (const Key &key : observed_keys)
+  {
+    const MapChunk *chunk = map.region(key.regionKey());
+    ASSERT_NE(chunk, nullptr);
+    const VoxelBlock &block = *chunk->voxel_blocks[occupancy_layer];
+    EXPECT_TRUE(block.isCompressed());
+    EXPECT_LT(block.allocatedByteSize(), block.uncompressedByteSize());
+  }
+  for (const Key &key : observed_keys)
+  {
+    Voxel<const float> occupancy(&map, occupancy_layer, key);
+    Voxel<const float> expected(reference.get(), occupancy_layer, key);
+    ASSERT_TRUE(occupancy.isValid());
+    EXPECT_EQ(occupancy.data(), expected.data());
+    EXPECT_TRUE(isOccupied(occupancy));
+  }
+}
+
+TEST(Map, LayerCompressionPolicy)
+{
+  // Never compress occupancy in a compressed map and always compress voxel mean in an uncompressed map.
+  for (const MapFlag flags : { MapFlag::kCompressed, MapFlag::kNone })
+  {
+    OccupancyMap map(0.25, glm::u8vec3(8), flags | MapFlag::kVoxelMean);
+    const int occupancy_layer = map.layout().occupancyLayer();
+    const int mean_layer = map.layout().meanLayer();
+
+    MapLayer::CompressionPolicy policy;
+    policy.mode = MapLayer::CompressionPolicy::kNever;
+    map.layout().layerPtr(occupancy_layer)->setCompressionPolicy(policy);
+    policy.mode = MapLayer::CompressionPolicy::kAlways;
+    policy.override_codec = true;
+    policy.level = VoxelBlock::kCompressMax;
+    policy.type = VoxelBlock::kCompressGZip;
+    policy.release_delay_ms = 0;
+    map.layout().layerPtr(mean_layer)->setCompressionPolicy(policy);
+
+    const Key key(0, 0, 0, 1, 2, 3);
+    integrateHit(map, key);
+    {
+      Voxel<VoxelMean> mean(&map, mean_layer, key);
+      ASSERT_TRUE(mean.isValid());
+      VoxelMean mean_data{};
+      mean_data.coord = 42u;
+      mean_data.count = 1;
+      mean.write(mean_data);
+    }
+
+    const std::unique_ptr<OccupancyMap> reference(map.clone());
+    EXPECT_EQ(reference->layout().layer(mean_layer).compressionPolicy().mode,
+              MapLayer::CompressionPolicy::kAlways);
+
+    map.compact();
+    const MapChunk *chunk = map.region(key.regionKey());
+    ASSERT_NE(chunk, nullptr);
+    EXPECT_FALSE(chunk->voxel_blocks[occupancy_layer]->isCompressed());
+    EXPECT_TRUE(chunk->voxel_blocks[mean_layer]->isCompressed());
+
+    // Decompress with the layer codec.
+    Voxel<const VoxelMean> mean(&map, mean_layer, key);
+    Voxel<const VoxelMean> expected(reference.get(), mean_layer, key);
+    ASSERT_TRUE(mean.isValid());
+    EXPECT_EQ(mean.data().coord, expected.data().coord);
+    EXPECT_EQ(mean.data().count, expected.data().count);
+  }
+}
+
+TEST(Map, MemoryUsage)
+{
+  OccupancyMap map(0.25, glm::u8vec3(8), MapFlag::kCompressed);
+
+  // Compare the incremental accounting against the block states.
+  const auto validate = [&map]() {
+    MapMemoryUsage usage;
+    map.memoryUsage(&usage);
+    ASSERT_EQ(usage.layers.size(), std::min<size_t>(map.layout().layerCount(), MapMemoryUsage::kMaxLayers));
+    std::vector<LayerMemoryUsage> expected(usage.layers.size());
+    LayerMemoryUsage expected_overflow;
+    std::vector<const MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    for (const MapChunk *chunk : chunks)
+    {
+      for (size_t i = 0; i < chunk->voxel_blocks.size(); ++i)
+      {
+        const VoxelBlock &block = *chunk->voxel_blocks[i];
+        LayerMemoryUsage &layer_expected = (i < expected.size()) ? expected[i] : expected_overflow;
+        ++layer_expected.block_count[unsigned(block.state())];
+        layer_expected.byte_count[unsigned(block.state())] += block.allocatedByteSize();
+      }
+    }
+
+    for (size_t i = 0; i < usage.layers.size(); ++i)
+    {
+      EXPECT_EQ(usage.layers[i].name, map.layout().layer(i).name());
+      EXPECT_EQ(usage.layers[i].block_count, expected[i].block_count) << usage.layers[i].name;
+      EXPECT_EQ(usage.layers[i].byte_count, expected[i].byte_count) << usage.layers[i].name;
+    }
+    EXPECT_EQ(usage.overflow.block_count, expected_overflow.block_count);
+    EXPECT_EQ(usage.overflow.byte_count, expected_overflow.byte_count);
+    EXPECT_EQ(usage.chunk_count, chunks.size());
+    EXPECT_GT(usage.index_bytes, 0u);
+  };
+
+  const int occupancy_layer = map.layout().occupancyLayer();
+  for (int i = 0; i < 10; ++i)
+  {
+    integrateHit(map, Key(i, 0, 0, 1, 1, 1));
+  }
+  validate();
+
+  MapMemoryUsage usage;
+  map.memoryUsage(&usage);
+  const LayerMemoryUsage &occupancy_usage = usage.layers[occupancy_layer];
+  EXPECT_EQ(occupancy_usage.totalBlocks(), 10u);
+  EXPECT_EQ(occupancy_usage.blocks(VoxelBlockState::kCompressionQueued), 10u);
+  EXPECT_GE(occupancy_usage.totalBytes(), 10u * 8u * 8u * 8u * sizeof(float));
+
+  // Compaction leaves recently released blocks to the compression thread.
+  map.compact();
+  validate();
+  map.memoryUsage(&usage);
+  EXPECT_EQ(usage.layers[occupancy_layer].blocks(VoxelBlockState::kCompressionQueued), 10u);
+
+  // Compaction compresses everything past the release delay.
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  map.compact();
+  validate();
+  map.memoryUsage(&usage);
+  EXPECT_EQ(usage.layers[occupancy_layer].blocks(VoxelBlockState::kCompressed), 10u);
+  EXPECT_LT(usage.layers[occupancy_layer].totalBytes(), 10u * 8u * 8u * 8u * sizeof(float));
+
+  // Layout changes move the accounting to the new layer indices.
+  map.addVoxelMeanLayer();
+  validate();
+
+  // Layers beyond the individually reported layers are accounted in the overflow.
+  {
+    MapLayout layout = map.layout();
+    while (layout.layerCount() < MapMemoryUsage::kMaxLayers + 2u)
+    {
+      const std::string name = "extra" + std::to_string(layout.layerCount());
+      layout.addLayer(name.c_str())->voxelLayout().addMember("value", DataType::kFloat, 0);
+    }
+    map.updateLayout(layout, true);
+  }
+  const int last_layer = int(map.layout().layerCount() - 1);
+  for (int i = 0; i < 3; ++i)
+  {
+    Voxel<float> extra(&map, last_layer, Key(i, 0, 0, 1, 1, 1));
+    ASSERT_TRUE(extra.isValid());
+    extra.write(1.0f);
+  }
+  validate();
+  map.memoryUsage(&usage);
+  EXPECT_EQ(usage.overflow.name, "overflow");
+  EXPECT_EQ(usage.overflow.totalBlocks(), 2u * map.regionCount());
+  EXPECT_GT(usage.overflow.totalBytes(), 0u);
+
+  // Removal releases the accounting. Pooled chunks remain accounted, but are uniform.
+  map.removeDistanceRegions(glm::dvec3(0), 0.0f);
+  EXPECT_EQ(map.regionCount(), 0u);
+  map.memoryUsage(&usage);
+  for (const LayerMemoryUsage &layer : usage.layers)
+  {
+    EXPECT_EQ(layer.totalBlocks() - layer.blocks(VoxelBlockState::kUniform), 0u) << layer.name;
+  }
+  map.compact();
+  map.memoryUsage(&usage);
+  EXPECT_EQ(usage.chunk_count, 0u);
+  EXPECT_EQ(usage.voxelBytes(), 0u);
+}
+
+TEST(Map, RegionIndexCulling)
+{
+  OccupancyMap map(0.25, glm::u8vec3(8));
+  std::mt19937 rand_engine(0x2a);
+  std::uniform_int_distribution<int> coord_rand(-40, 40);
+  std::uniform_real_distribution<double> time_rand(0.0, 100.0);
+
+  const auto region_set = [&map]() {
+    std::vector<const MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    std::unordered_set<Key, Key::Hash> keys;
+    for (const MapChunk *chunk : chunks)
+    {
+      keys.insert(Key(chunk->region.coord, 0, 0, 0));
+    }
+    return keys;
+  };
+
+  // Brute force removal prediction.
+  const auto expected_remaining = [&map](const std::function<bool(const MapChunk &)> &remove) {
+    std::vector<const MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    std::unordered_set<Key, Key::Hash> keys;
+    for (const MapChunk *chunk : chunks)
+    {
+      if (!remove(*chunk))
+      {
+        keys.insert(Key(chunk->region.coord, 0, 0, 0));
+      }
+    }
+    return keys;
+  };
+
+  const auto validate_extents = [&map]() {
+    std::vector<const MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    ohm::RegionKey min_region(std::numeric_limits<ohm::RegionCoord>::max());
+    ohm::RegionKey max_region(std::numeric_limits<ohm::RegionCoord>::min());
+    for (const MapChunk *chunk : chunks)
+    {
+      min_region = glm::min(min_region, chunk->region.coord);
+      max_region = glm::max(max_region, chunk->region.coord);
+    }
+    Key min_key;
+    Key max_key;
+    glm::dvec3 min_ext;
+    glm::dvec3 max_ext;
+    ASSERT_EQ(map.calculateExtents(&min_ext, &max_ext, &min_key, &max_key), !chunks.empty());
+    if (!chunks.empty())
+    {
+      EXPECT_EQ(min_key.regionKey(), min_region);
+      EXPECT_EQ(max_key.regionKey(), max_region);
+      const glm::dvec3 expected_min = map.regionCentreLocal(min_region) - 0.5 * map.regionSpatialResolution();
+      EXPECT_NEAR(min_ext.x, expected_min.x, 1e-9);
+      EXPECT_NEAR(min_ext.y, expected_min.y, 1e-9);
+      EXPECT_NEAR(min_ext.z, expected_min.z, 1e-9);
+    }
+  };
+
+  for (unsigned i = 0; i < 4000u; ++i)
+  {
+    const ohm::RegionKey region_key(coord_rand(rand_engine), coord_rand(rand_engine), coord_rand(rand_engine));
+    map.touchRegionTimestampByKey(region_key, time_rand(rand_engine), true);
+  }
+  validate_extents();
+
+  // Expire.
+  const double expiry = 20.0;
+  std::unordered_set<Key, Key::Hash> expected =
+    expected_remaining([expiry](const MapChunk &chunk) { return chunk.touched_time < expiry; });
+  size_t expected_removed = map.regionCount() - expected.size();
+  EXPECT_EQ(map.expireRegions(expiry), expected_removed);
+  EXPECT_EQ(region_set(), expected);
+  validate_extents();
+
+  // Re-touch some regions to old and new times and expire again. Exercises stale heap entries.
+  for (unsigned i = 0; i < 500u; ++i)
+  {
+    const ohm::RegionKey region_key(coord_rand(rand_engine), coord_rand(rand_engine), coord_rand(rand_engine));
+    map.touchRegionTimestampByKey(region_key, time_rand(rand_engine), false);
+  }
+  expected = expected_remaining([](const MapChunk &chunk) { return chunk.touched_time < 50.0; });
+  expected_removed = map.regionCount() - expected.size();
+  EXPECT_EQ(map.expireRegions(50.0), expected_removed);
+  EXPECT_EQ(region_set(), expected);
+
+  // Distance culling.
+  const glm::dvec3 reference(3.1, -2.7, 1.3);
+  const float distance = 25.0f;
+  expected = expected_remaining([reference, distance](const MapChunk &chunk) {
+    const glm::dvec3 separation = chunk.region.centre - reference;
+    return glm::dot(separation, separation) >= distance * distance;
+  });
+  expected_removed = map.regionCount() - expected.size();
+  EXPECT_EQ(map.removeDistanceRegions(reference, distance), expected_removed);
+  EXPECT_EQ(region_set(), expected);
+  validate_extents();
+
+  // Box culling.
+  const Aabb cull_box(glm::dvec3(-12.3, -5.0, -20.0), glm::dvec3(7.7, 15.0, 3.0));
+  const glm::dvec3 region_ext = map.regionSpatialResolution();
+  expected = expected_remaining([cull_box, region_ext](const MapChunk &chunk) {
+    return !cull_box.overlaps(Aabb(chunk.region.centre - 0.5 * region_ext, chunk.region.centre + 0.5 * region_ext));
+  });
+  expected_removed = map.regionCount() - expected.size();
+  EXPECT_EQ(map.cullRegionsOutside(cull_box.minExtents(), cull_box.maxExtents()), expected_removed);
+  EXPECT_EQ(region_set(), expected);
+  validate_extents();
+
+  // Expire everything.
+  map.expireRegions(1e6);
+  EXPECT_EQ(map.regionCount(), 0u);
+  validate_extents();
+}
+
+
+TEST(Map, QuantisedOccupancy)
+{
+  const double resolution = 0.1;
+  const glm::u8vec3 region_size(16);
+  OccupancyMap float_map(resolution, region_size, MapFlag::kNone);
+  OccupancyMap map16(resolution, region_size, MapFlag::kQuantisedOccupancy16);
+  OccupancyMap map8(resolution, region_size, MapFlag::kQuantisedOccupancy8);
+
+  EXPECT_EQ(float_map.occupancyEncoding(), OccupancyEncoding::kFloat);
+  EXPECT_EQ(map16.occupancyEncoding(), OccupancyEncoding::kInt16);
+  EXPECT_EQ(map8.occupancyEncoding(), OccupancyEncoding::kInt8);
+  EXPECT_EQ(map16.layout().layer(map16.layout().occupancyLayer()).voxelByteSize(), sizeof(int16_t));
+  EXPECT_EQ(map8.layout().layer(map8.layout().occupancyLayer()).voxelByteSize(), sizeof(int8_t));
+
+  // Quantisation round trip.
+  for (float value : { 0.0f, -2.0f, 3.511f, 0.85f, -0.4f })
+  {
+    EXPECT_NEAR(dequantiseOccupancy(quantiseOccupancy<int16_t>(value, kOccupancyQuantisationScale16),
+                                    kOccupancyQuantisationScale16),
+                value, 0.5f * kOccupancyQuantisationScale16);
+    EXPECT_NEAR(dequantiseOccupancy(quantiseOccupancy<int8_t>(value, kOccupancyQuantisationScale8),
+                                    kOccupancyQuantisationScale8),
+                value, 0.5f * kOccupancyQuantisationScale8);
+  }
+  EXPECT_EQ(dequantiseOccupancy(quantiseOccupancy<int8_t>(unobservedOccupancyValue(), kOccupancyQuantisationScale8),
+                                kOccupancyQuantisationScale8),
+            unobservedOccupancyValue());
+  // Clamped to the representable range, excluding the sentinel.
+  EXPECT_EQ(quantiseOccupancy<int8_t>(-1000.0f, kOccupancyQuantisationScale8), -127);
+
+  // Populate each map with the same rays.
+  std::mt19937 rand_engine(0x5eed);
+  std::uniform_real_distribution<double> origin_rand(-0.5, 0.5);
+  std::uniform_real_distribution<double> sample_rand(-4.0, 4.0);
+  std::vector<glm::dvec3> rays;
+  for (unsigned i = 0; i < 2000u; ++i)
+  {
+    rays.emplace_back(glm::dvec3(origin_rand(rand_engine), origin_rand(rand_engine), origin_rand(rand_engine)));
+    rays.emplace_back(glm::dvec3(sample_rand(rand_engine), sample_rand(rand_engine), sample_rand(rand_engine)));
+  }
+
+  for (OccupancyMap *map : { &float_map, &map16, &map8 })
+  {
+    RayMapperOccupancy mapper(map);
+    ASSERT_TRUE(mapper.valid());
+    mapper.integrateRays(rays.data(), rays.size());
+  }
+
+  // Compare against the float map. Rounding accumulates differently in the quantised maps, so allow for some voxels
+  // near the occupancy threshold to classify differently.
+  const auto compare_map = [&float_map](const OccupancyMap &map, float tolerance, double max_mismatch_ratio) {
+    Voxel<const float> reference(&float_map, float_map.layout().occupancyLayer());
+    Voxel<const float> quantised(&map, map.layout().occupancyLayer());
+    ASSERT_TRUE(quantised.isLayerValid());
+    size_t observed_count = 0;
+    size_t mismatch_count = 0;
+    for (auto iter = float_map.begin(); iter != float_map.end(); ++iter)
+    {
+      reference.setKey(iter);
+      quantised.setKey(*iter);
+      ASSERT_TRUE(quantised.isValid());
+      const float expected = reference.data();
+      if (isUnobserved(expected))
+      {
+        EXPECT_TRUE(isUnobserved(quantised));
+        continue;
+      }
+      ++observed_count;
+      EXPECT_NEAR(quantised.data(), expected, tolerance);
+      mismatch_count += occupancyType(reference) != occupancyType(quantised);
+    }
+    EXPECT_GT(observed_count, 0u);
+    EXPECT_LE(double(mismatch_count), max_mismatch_ratio * double(observed_count));
+    EXPECT_EQ(map.regionCount(), float_map.regionCount());
+  };
+
+  compare_map(map16, 0.05f, 0.001);
+  compare_map(map8, 0.5f, 0.02);
+
+  // Serialisation preserves the encoding and values.
+  const char *map_name = "quantised-occupancy.ohm";
+  ASSERT_EQ(ohm::save(map_name, map8), 0);
+  OccupancyMap loaded_map(1.0);
+  ASSERT_EQ(ohm::load(map_name, loaded_map), 0);
+  EXPECT_EQ(loaded_map.occupancyEncoding(), OccupancyEncoding::kInt8);
+  EXPECT_TRUE((loaded_map.flags() & MapFlag::kQuantisedOccupancy8) != MapFlag::kNone);
+  EXPECT_EQ(loaded_map.regionCount(), map8.regionCount());
+
+  Voxel<const float> original(&map8, map8.layout().occupancyLayer());
+  Voxel<const float> loaded(&loaded_map, loaded_map.layout().occupancyLayer());
+  for (auto iter = map8.begin(); iter != map8.end(); ++iter)
+  {
+    original.setKey(iter);
+    loaded.setKey(*iter);
+    ASSERT_TRUE(loaded.isValid());
+    EXPECT_EQ(loaded.data(), original.data());
+  }
+}
+
+TEST(Map, TernaryOccupancy)
+{
+  const glm::u8vec3 region_size(16);
+  OccupancyMap map(0.1, region_size, MapFlag::kQuantisedOccupancy16);
+  TernaryOccupancy ternary(&map);
+  ASSERT_TRUE(ternary.isValid());
+  // Two bits per voxel.
+  EXPECT_EQ(map.layout().layer(ternary.layerIndex()).layerByteSize(region_size),
+            size_t(region_size.x) * region_size.y * region_size.z / 4u);
+
+  std::mt19937 rand_engine(0x7e2a);
+  std::uniform_real_distribution<double> origin_rand(-0.5, 0.5);
+  std::uniform_real_distribution<double> sample_rand(-3.0, 3.0);
+  std::vector<glm::dvec3> rays;
+  for (unsigned i = 0; i < 1000u; ++i)
+  {
+    rays.emplace_back(glm::dvec3(origin_rand(rand_engine), origin_rand(rand_engine), origin_rand(rand_engine)));
+    rays.emplace_back(glm::dvec3(sample_rand(rand_engine), sample_rand(rand_engine), sample_rand(rand_engine)));
+  }
+
+  RayMapperOccupancy mapper(&map);
+  ASSERT_TRUE(mapper.valid());
+  mapper.integrateRays(rays.data(), rays.size());
+
+  const auto expected_code = [](const Voxel<const float> &voxel) {
+    switch (occupancyType(voxel))
+    {
+    case kFree:
+      return kTernaryFree;
+    case kOccupied:
+      return kTernaryOccupied;
+    default:
+      break;
+    }
+    return kTernaryUnknown;
+  };
+
+  const auto validate = [&]() {
+    Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    size_t occupied_count = 0;
+    for (auto iter = map.begin(); iter != map.end(); ++iter)
+    {
+      occupancy.setKey(iter);
+      const TernaryCode code = ternary.code(*iter);
+      EXPECT_EQ(code, expected_code(occupancy));
+      occupied_count += code == kTernaryOccupied;
+    }
+    EXPECT_GT(occupied_count, 0u);
+  };
+
+  // The ray mapper maintains the layer incrementally: nothing is stale.
+  EXPECT_EQ(ternary.update(), 0u);
+  validate();
+
+  // Direct voxel writes leave the region stale for a lazy rebuild.
+  const Key key = map.voxelKey(glm::dvec3(0.05));
+  {
+    Voxel<float> occupancy(&map, map.layout().occupancyLayer(), key);
+    ASSERT_TRUE(occupancy.isValid());
+    occupancy.write(map.maxVoxelValue());
+  }
+  EXPECT_EQ(ternary.code(key), kTernaryOccupied);
+  EXPECT_EQ(ternary.update(), 0u);
+
+  // Changing the threshold invalidates all regions.
+  map.setOccupancyThresholdProbability(0.8f);
+  EXPECT_EQ(ternary.update(), map.regionCount());
+  validate();
+
+  // Further ray integration remains incremental.
+  mapper.integrateRays(rays.data(), rays.size());
+  EXPECT_EQ(ternary.update(), 0u);
+  validate();
+
+  // Window extraction spanning multiple regions, including regions not in the map.
+  TernaryWindow window;
+  ternary.extract(glm::dvec3(-3.95), glm::dvec3(1.95), &window);
+  EXPECT_EQ(window.dimensions(), glm::ivec3(60));
+  const Key min_key = map.voxelKey(glm::dvec3(-3.95));
+  EXPECT_EQ(window.origin(), ternary.globalVoxel(min_key));
+  size_t known_count = 0;
+  for (int z = 0; z < window.dimensions().z; ++z)
+  {
+    for (int y = 0; y < window.dimensions().y; ++y)
+    {
+      for (int x = 0; x < window.dimensions().x; ++x)
+      {
+        Key window_key = min_key;
+        map.moveKey(window_key, x, y, z);
+        const TernaryCode code = window.at(glm::ivec3(x, y, z));
+        EXPECT_EQ(code, ternary.code(window_key));
+        known_count += code != kTernaryUnknown;
+      }
+    }
+  }
+  EXPECT_GT(known_count, 0u);
+}
+
+TEST(Map, OccupancyPyramid)
+{
+  const glm::u8vec3 region_size(16);
+  OccupancyMap map(0.1, region_size);
+  OccupancyPyramid pyramid(&map);
+  ASSERT_TRUE(pyramid.isValid());
+
+  std::mt19937 rand_engine(0x9a1d);
+  std::uniform_real_distribution<double> origin_rand(-0.5, 0.5);
+  std::uniform_real_distribution<double> sample_rand(-3.0, 3.0);
+  std::vector<glm::dvec3> rays;
+  for (unsigned i = 0; i < 500u; ++i)
+  {
+    rays.emplace_back(glm::dvec3(origin_rand(rand_engine), origin_rand(rand_engine), origin_rand(rand_engine)));
+    rays.emplace_back(glm::dvec3(sample_rand(rand_engine), sample_rand(rand_engine), sample_rand(rand_engine)));
+  }
+
+  // The mapper maintains the pyramid.
+  RayMapperOccupancy mapper(&map);
+  mapper.integrateRays(rays.data(), rays.size());
+  EXPECT_EQ(pyramid.update(), 0u);
+
+  // Compare a sample of pyramid voxels against a brute force summary of the full resolution voxels.
+  const auto validate = [](const OccupancyMap &map, OccupancyPyramid &pyramid) {
+    Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    size_t visit = 0;
+    size_t occupied_blocks = 0;
+    for (auto iter = map.begin(); iter != map.end(); ++iter, ++visit)
+    {
+      if (visit % 13u)
+      {
+        continue;
+      }
+
+      for (int level = 1; level <= OccupancyPyramid::kLevels; ++level)
+      {
+        const int block_size = 1 << level;
+        const glm::ivec3 block_min = OccupancyPyramid::coarseLocalKey(*iter, level) * block_size;
+        float expected_max = unobservedOccupancyValue();
+        uint32_t expected_unknown = 0;
+        for (int z = 0; z < block_size; ++z)
+        {
+          for (int y = 0; y < block_size; ++y)
+          {
+            for (int x = 0; x < block_size; ++x)
+            {
+              Key key = *iter;
+              key.setLocalKey(glm::u8vec3(block_min + glm::ivec3(x, y, z)));
+              occupancy.setKey(key);
+              const float value = occupancy.data();
+              if (value == unobservedOccupancyValue())
+              {
+                ++expected_unknown;
+              }
+              else
+              {
+                expected_max = (expected_max == unobservedOccupancyValue()) ? value : std::max(expected_max, value);
+              }
+            }
+          }
+        }
+
+        OccupancyPyramidVoxel pyramid_voxel{};
+        EXPECT_TRUE(pyramid.voxel(*iter, level, &pyramid_voxel));
+        EXPECT_EQ(pyramid_voxel.max_occupancy, expected_max);
+        EXPECT_EQ(pyramid_voxel.unknown_count, expected_unknown);
+        occupied_blocks += pyramid.occupancyType(*iter, level) == kOccupied;
+      }
+    }
+    EXPECT_GT(occupied_blocks, 0u);
+  };
+
+  validate(map, pyramid);
+
+  // Further updates are picked up as regions are touched.
+  rays.clear();
+  for (unsigned i = 0; i < 200u; ++i)
+  {
+    rays.emplace_back(glm::dvec3(origin_rand(rand_engine), origin_rand(rand_engine), origin_rand(rand_engine)));
+    rays.emplace_back(glm::dvec3(sample_rand(rand_engine), sample_rand(rand_engine), sample_rand(rand_engine)));
+  }
+  mapper.integrateRays(rays.data(), rays.size());
+  EXPECT_EQ(pyramid.update(), 0u);
+  validate(map, pyramid);
+
+  // Other occupancy writes leave the region stale until the pyramid is updated.
+  const Key write_key = map.voxelKey(glm::dvec3(0.05));
+  {
+    Voxel<float> occupancy(&map, map.layout().occupancyLayer(), write_key);
+    occupancy.write(map.maxVoxelValue());
+  }
+  EXPECT_FALSE(pyramid.isCurrent(map.region(write_key.regionKey())));
+  EXPECT_EQ(pyramid.update(), 1u);
+  validate(map, pyramid);
+
+  // Regions which are not in the map are unobserved.
+  OccupancyPyramidVoxel missing{};
+  EXPECT_FALSE(pyramid.voxel(map.voxelKey(glm::dvec3(100.0)), 2, &missing));
+  EXPECT_EQ(missing.unknown_count, 64u);
+  EXPECT_EQ(pyramid.occupancyType(map.voxelKey(glm::dvec3(100.0)), 3), kUnobserved);
+
+  // The NDT mapper also maintains the pyramid.
+  OccupancyMap ndt_map(0.1, region_size);
+  NdtMap ndt(&ndt_map, true);
+  OccupancyPyramid ndt_pyramid(&ndt_map);
+  ASSERT_TRUE(ndt_pyramid.isValid());
+  RayMapperNdt ndt_mapper(&ndt);
+  ndt_mapper.integrateRays(rays.data(), rays.size());
+  EXPECT_EQ(ndt_pyramid.update(), 0u);
+  validate(ndt_map, ndt_pyramid);
+}
+
+TEST(Map, SharedMemory)
+{
+  const char *segment_name = "ohmtest_shared_map";
+  OccupancyMap map(0.25, glm::u8vec3(16));
+  ohmgen::fillMapWithEmptySpace(map, -20, -20, -4, 20, 20, 4);
+  {
+    Voxel<float> occupancy(&map, map.layout().occupancyLayer());
+    for (int i = -15; i < 15; ++i)
+    {
+      occupancy.setKey(map.voxelKey(glm::dvec3(i * 0.25, 0.3 * i, 0.0)));
+      integrateHit(occupancy);
+    }
+  }
+
+  SharedMapPublisher publisher;
+  ASSERT_TRUE(publisher.create(segment_name, map, map.regionCount() + 16));
+  size_t published_count = 0;
+  EXPECT_TRUE(publisher.publish(map, &published_count));
+  EXPECT_EQ(published_count, map.regionCount());
+  // Nothing has changed.
+  EXPECT_TRUE(publisher.publish(map, &published_count));
+  EXPECT_EQ(published_count, 0u);
+
+  SharedMapView view;
+  ASSERT_TRUE(view.open(segment_name));
+  EXPECT_EQ(view.resolution(), map.resolution());
+  EXPECT_EQ(view.regionVoxelDimensions(), map.regionVoxelDimensions());
+  EXPECT_EQ(view.layerCount(), map.layout().layerCount());
+  EXPECT_EQ(view.occupancyLayer(), map.layout().occupancyLayer());
+  EXPECT_EQ(view.regionCount(), map.regionCount());
+  EXPECT_EQ(view.occupancyThresholdValue(), map.occupancyThresholdValue());
+
+  // Validate all voxels.
+  Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+  size_t occupied_count = 0;
+  for (auto iter = map.begin(); iter != map.end(); ++iter)
+  {
+    occupancy.setKey(iter);
+    float value = unobservedOccupancyValue();
+    occupancy.read(&value);
+    ASSERT_EQ(view.occupancy(*iter), value);
+    ASSERT_EQ(view.occupancyType(*iter), occupancyType(occupancy));
+    occupied_count += (view.occupancyType(*iter) == kOccupied) ? 1u : 0u;
+  }
+  occupancy.reset();
+  EXPECT_GT(occupied_count, 0u);
+  EXPECT_EQ(view.occupancyType(map.voxelKey(glm::dvec3(100.0))), kNull);
+
+  // Invalid layers and zero sized reads are rejected.
+  {
+    const Key key = map.voxelKey(glm::dvec3(0.0));
+    float value = 0;
+    EXPECT_FALSE(view.readVoxel(key, -1, &value, 0));
+    EXPECT_FALSE(view.readVoxel(key, int(view.layerCount()), &value, 0));
+    EXPECT_FALSE(view.readVoxel(key, 1000, &value, 0));
+    EXPECT_FALSE(view.readVoxel(key, view.occupancyLayer(), &value, 0));
+    EXPECT_TRUE(view.readVoxel(key, view.occupancyLayer(), &value, sizeof(value)));
+    EXPECT_FALSE(SharedMapView().readVoxel(key, 0, &value, 0));
+    EXPECT_FALSE(SharedMapView().readVoxel(key, view.occupancyLayer(), &value, sizeof(value)));
+  }
+
+  // Incremental publication of a single voxel change.
+  const Key change_key = map.voxelKey(glm::dvec3(1.0, 1.0, 0.0));
+  const uint64_t publish_stamp = view.publishStamp();
+  {
+    Voxel<float> occupancy(&map, map.layout().occupancyLayer(), change_key);
+    occupancy.write(map.maxVoxelValue());
+  }
+  EXPECT_TRUE(publisher.publish(map, &published_count));
+  EXPECT_EQ(published_count, 1u);
+  EXPECT_GT(view.publishStamp(), publish_stamp);
+  EXPECT_EQ(view.occupancy(change_key), map.maxVoxelValue());
+
+  // Removed regions are withdrawn.
+  const RegionKey removed_region = map.voxelKey(glm::dvec3(4.5, 4.5, 0.0)).regionKey();
+  EXPECT_TRUE(view.hasRegion(removed_region));
+  map.removeDistanceRegions(glm::dvec3(0.0), 3.0f);
+  ASSERT_EQ(map.region(removed_region), nullptr);
+  ASSERT_NE(map.region(change_key.regionKey()), nullptr);
+  EXPECT_TRUE(publisher.publish(map));
+  EXPECT_FALSE(view.hasRegion(removed_region));
+  EXPECT_EQ(view.regionCount(), map.regionCount());
+
+  // Removed entries are reused: fill the table to capacity with new regions.
+  const auto add_region = [&](int index) {
+    Voxel<float> occupancy(&map, map.layout().occupancyLayer(),
+                           map.voxelKey(glm::dvec3(100.0 + index * 4.0, 100.0, 0.0)));
+    integrateHit(occupancy);
+    return occupancy.key().regionKey();
+  };
+  int added_count = 0;
+  RegionKey last_added_region;
+  while (map.regionCount() < publisher.regionCapacity())
+  {
+    last_added_region = add_region(added_count++);
+  }
+  EXPECT_TRUE(publisher.publish(map, &published_count));
+  EXPECT_EQ(published_count, size_t(added_count));
+  EXPECT_EQ(view.regionCount(), map.regionCount());
+  EXPECT_TRUE(view.hasRegion(last_added_region));
+  EXPECT_EQ(view.occupancyType(map.voxelKey(glm::dvec3(100.0, 100.0, 0.0))), kOccupied);
+
+  // Overflowing the table fails, but publishes the regions which fit.
+  const RegionKey overflow_region = add_region(added_count++);
+  EXPECT_FALSE(publisher.publish(map, &published_count));
+  EXPECT_EQ(published_count, 0u);
+  EXPECT_FALSE(view.hasRegion(overflow_region));
+  EXPECT_EQ(view.regionCount(), publisher.regionCapacity());
+  map.removeDistanceRegions(glm::dvec3(0.0), 50.0f);
+  EXPECT_TRUE(publisher.publish(map));
+  EXPECT_EQ(view.regionCount(), map.regionCount());
+  EXPECT_FALSE(view.hasRegion(last_added_region));
+
+  // Concurrent publication: each region update is seen entirely or not at all.
+  const Key region_key(0, 0, 0, 0, 0, 0);
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const auto fill_region = [&](float value) {
+    Voxel<float> occupancy(&map, occupancy_layer, region_key);
+    Key key = region_key;
+    do
+    {
+      occupancy.setKey(key);
+      occupancy.write(value);
+    } while (nextLocalKey(key, map.regionVoxelDimensions()));
+    occupancy.reset();
+    EXPECT_TRUE(publisher.publish(map));
+  };
+
+  fill_region(0.0f);
+  std::atomic_bool done{ false };
+  std::thread writer([&]() {
+    for (int update = 1; update <= 200; ++update)
+    {
+      fill_region(float(update) * 0.01f);
+    }
+    done = true;
+  });
+
+  std::vector<float> region_values(view.regionByteSize(occupancy_layer) / sizeof(float));
+  size_t read_count = 0;
+  while (!done)
+  {
+    if (view.readRegion(region_key.regionKey(), occupancy_layer, region_values.data(),
+                        region_values.size() * sizeof(float)))
+    {
+      ++read_count;
+      for (float value : region_values)
+      {
+        ASSERT_EQ(value, region_values[0]);
+      }
+    }
+  }
+  writer.join();
+
+  ASSERT_TRUE(view.readRegion(region_key.regionKey(), occupancy_layer, region_values.data(),
+                              region_values.size() * sizeof(float)));
+  EXPECT_EQ(region_values.back(), 2.0f);
+  std::cout << "Consistent concurrent region reads: " << read_count << std::endl;
+
+  publisher.close();
+  EXPECT_FALSE(SharedMapView().open(segment_name));
+}
+
+TEST(Map, RegionPrefetch)
+{
+  // Compressed map with a line of regions along X and one region well off the path.
+  OccupancyMap map(0.1, MapFlag::kCompressed);
+  const double region_size = map.regionSpatialResolution().x;
+  for (int i = -2; i < 10; ++i)
+  {
+    integrateHit(map, map.voxelKey(glm::dvec3((i + 0.5) * region_size, 0, 0)));
+  }
+  const glm::dvec3 off_path(0, 30, 0);
+  integrateHit(map, map.voxelKey(off_path));
+
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const auto is_compressed = [&map, occupancy_layer](const glm::dvec3 &point) {
+    const MapChunk *chunk = map.region(map.regionKey(point));
+    return chunk && chunk->voxel_blocks[occupancy_layer]->isCompressed();
+  };
+
+  // Wait for the background compression.
+  const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  bool all_compressed = false;
+  while (!all_compressed && std::chrono::steady_clock::now() < timeout)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    all_compressed = std::all_of(chunks.begin(), chunks.end(), [occupancy_layer](const MapChunk *chunk) {
+      return chunk->voxel_blocks[occupancy_layer]->isCompressed();
+    });
+  }
+  ASSERT_TRUE(all_compressed);
+
+  RegionPrefetcher prefetcher(map);
+  prefetcher.setSensorRange(0.5 * region_size);
+  prefetcher.setLookahead(1.0);
+  prefetcher.setHoldTime(10.0);
+
+  // Moving along +X at 5 region widths per second. The regions ahead are decompressed, those behind are not.
+  prefetcher.update(glm::dvec3(0.5 * region_size, 0, 0), glm::dvec3(5.0 * region_size, 0, 0), 0.0);
+  prefetcher.wait();
+  EXPECT_GT(prefetcher.heldRegionCount(), 0u);
+  for (int i = 0; i <= 5; ++i)
+  {
+    EXPECT_FALSE(is_compressed(glm::dvec3((i + 0.5) * region_size, 0, 0))) << i;
+  }
+  EXPECT_TRUE(is_compressed(glm::dvec3(-1.5 * region_size, 0, 0)));
+  EXPECT_TRUE(is_compressed(glm::dvec3(9.5 * region_size, 0, 0)));
+  EXPECT_TRUE(is_compressed(off_path));
+
+  const size_t held_count = prefetcher.heldRegionCount();
+  EXPECT_EQ(prefetcher.stats().prefetched, held_count);
+
+  // Observe rays ending ahead (prefetched) and off the path (compressed).
+  const glm::dvec3 origin(0.5 * region_size, 0, 0);
+  const std::vector<glm::dvec3> rays = { origin, glm::dvec3(3.5 * region_size, 0, 0), origin, off_path };
+  prefetcher.observeRays(rays.data(), rays.size(), 0.1);
+  RegionPrefetcher::Stats stats = prefetcher.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.waste, 0u);
+
+  // Observing the same region again does not count another hit.
+  prefetcher.observeRays(rays.data(), 2u, 0.2);
+  EXPECT_EQ(prefetcher.stats().hits, 1u);
+
+  // Remove the held regions from the map. The held blocks remain valid until released.
+  map.cullRegionsOutside(off_path - glm::dvec3(region_size), off_path + glm::dvec3(region_size));
+  EXPECT_EQ(map.regionCount(), 1u);
+  EXPECT_EQ(prefetcher.heldRegionCount(), held_count);
+
+  // Release: all unobserved regions are waste.
+  prefetcher.releaseAll();
+  EXPECT_EQ(prefetcher.heldRegionCount(), 0u);
+  stats = prefetcher.stats();
+  EXPECT_EQ(stats.waste, stats.prefetched - 1u);
+  std::cout << "Prefetched " << stats.prefetched << " hits " << stats.hits << " misses " << stats.misses << " waste "
+            << stats.waste << std::endl;
+}
 }  // namespace maptests
@@ -0,0 +1,415 @@
+// Copyright (c) 2020
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OhmTestConfig.h"
+
+#include <ohm/KNearestOccupied.h>
+#include <ohm/Key.h>
+#include <ohm/MapChunk.h>
+#include <ohm/MapLayout.h>
+#include <ohm/NearestNeighbours.h>
+#include <ohm/OccupancyEncoding.h>
+#include <ohm/OccupancyMap.h>
+#include <ohm/QueryFlag.h>
+#include <ohm/VoxelBuffer.h>
+#include <ohm/VoxelData.h>
+#include <ohm/VoxelOccupancy.h>
+
+#include <ohmtools/OhmGen.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace ohm;
+
+namespace nearestneighbourstests
+{
+using Clock = std::chrono::high_resolution_clock;
+using Result = std::pair<Key, float>;
+
+/// Build a map of free space over the given voxel half extents with @p occupied_count randomly placed occupied
+/// voxels. The map is seeded with unobserved voxels around the free space.
+void buildMap(OccupancyMap &map, int half_extents, unsigned occupied_count, unsigned seed)
+{
+  ohmgen::fillMapWithEmptySpace(map, -half_extents, -half_extents, -half_extents, half_extents - 1,
+                                half_extents - 1, half_extents - 1);
+  std::mt19937 rand_engine(seed);
+  std::uniform_int_distribution<int> rand(-half_extents, half_extents - 1);
+  for (unsigned i = 0; i < occupied_count; ++i)
+  {
+    Key key(0, 0, 0, 0, 0, 0);
+    map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    integrateHit(map, key);
+  }
+}
+
+bool resultLess(const Result &a, const Result &b)
+{
+  const Key &ka = a.first;
+  const Key &kb = b.first;
+  for (int i = 2; i >= 0; --i)
+  {
+    if (ka.regionKey()[i] != kb.regionKey()[i])
+    {
+      return ka.regionKey()[i] < kb.regionKey()[i];
+    }
+  }
+  for (int i = 2; i >= 0; --i)
+  {
+    if (ka.localKey()[i] != kb.localKey()[i])
+    {
+      return ka.localKey()[i] < kb.localKey()[i];
+    }
+  }
+  return false;
+}
+
+/// Reference nearest neighbours by scanning every voxel of every region overlapping the search bounds with a per
+/// voxel predicate. This mirrors the original @c NearestNeighbours CPU implementation.
+std::vector<Result> referenceNearestNeighbours(const OccupancyMap &map, const glm::dvec3 &near_point,
+                                               float search_radius, unsigned query_flags)
+{
+  std::vector<Result> results;
+  const bool unknown_as_occupied = (query_flags & kQfUnknownAsOccupied) != 0;
+  const glm::ivec3 dim(map.regionVoxelDimensions());
+  const glm::vec3 query_origin(near_point - map.origin());
+  const float occupancy_threshold = map.occupancyThresholdValue();
+  const RegionKey min_region = map.regionKey(near_point - glm::dvec3(search_radius));
+  const RegionKey max_region = map.regionKey(near_point + glm::dvec3(search_radius));
+  const std::function<bool(float)> occupied_func = [unknown_as_occupied, occupancy_threshold](float occupancy) {
+    if (occupancy == unobservedOccupancyValue())
+    {
+      return unknown_as_occupied;
+    }
+    return occupancy >= occupancy_threshold;
+  };
+
+  for (int rz = min_region.z; rz <= max_region.z; ++rz)
+  {
+    for (int ry = min_region.y; ry <= max_region.y; ++ry)
+    {
+      for (int rx = min_region.x; rx <= max_region.x; ++rx)
+      {
+        const RegionKey region_key(rx, ry, rz);
+        const MapChunk *chunk = map.region(region_key);
+        if (!chunk && !unknown_as_occupied)
+        {
+          continue;
+        }
+
+        VoxelBuffer<const VoxelBlock> buffer;
+        OccupancyEncoding encoding = OccupancyEncoding::kFloat;
+        if (chunk)
+        {
+          buffer = VoxelBuffer<const VoxelBlock>(chunk->voxel_blocks[map.layout().occupancyLayer()]);
+          encoding = occupancyEncoding(map.layout().layer(map.layout().occupancyLayer()));
+        }
+
+        unsigned voxel_index = 0;
+        for (int z = 0; z < dim.z; ++z)
+        {
+          for (int y = 0; y < dim.y; ++y)
+          {
+            for (int x = 0; x < dim.x; ++x, ++voxel_index)
+            {
+              const float occupancy = (chunk) ? readOccupancy(buffer.voxelMemory(), voxel_index, encoding) :
+                                                unobservedOccupancyValue();
+              if (occupied_func(occupancy))
+              {
+                const Key key(region_key, x, y, z);
+                const glm::vec3 separation = glm::vec3(map.voxelCentreLocal(key)) - query_origin;
+                const float range_sqr = glm::dot(separation, separation);
+                if (range_sqr <= search_radius * search_radius)
+                {
+                  results.emplace_back(key, std::sqrt(range_sqr));
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return results;
+}
+
+std::vector<Result> queryResults(const NearestNeighbours &query)
+{
+  std::vector<Result> results;
+  for (size_t i = 0; i < query.numberOfResults(); ++i)
+  {
+    results.emplace_back(query.intersectedVoxels()[i], query.ranges()[i]);
+  }
+  return results;
+}
+
+
+TEST(NearestNeighbours, Cpu)
+{
+  OccupancyMap map(0.1, glm::u8vec3(16));
+  buildMap(map, 24, 400, 0x5u);
+
+  std::mt19937 rand_engine(0x6u);
+  std::uniform_real_distribution<double> rand(-3.0, 3.0);
+  for (const unsigned flags : { 0u, unsigned(kQfUnknownAsOccupied) })
+  {
+    for (int i = 0; i < 20; ++i)
+    {
+      const glm::dvec3 near_point(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+      const float search_radius = 0.2f + float(i % 5) * 0.2f;
+      NearestNeighbours query(map, near_point, search_radius, flags);
+      ASSERT_TRUE(query.execute());
+
+      std::vector<Result> results = queryResults(query);
+      std::vector<Result> expected = referenceNearestNeighbours(map, near_point, search_radius, flags);
+      std::sort(results.begin(), results.end(), resultLess);
+      std::sort(expected.begin(), expected.end(), resultLess);
+      ASSERT_EQ(results.size(), expected.size());
+      for (size_t j = 0; j < results.size(); ++j)
+      {
+        EXPECT_EQ(results[j].first, expected[j].first);
+        EXPECT_NEAR(results[j].second, expected[j].second, 1e-5f);
+      }
+
+      // Nearest result only.
+      query.setQueryFlags(flags | kQfNearestResult);
+      ASSERT_TRUE(query.execute());
+      if (!expected.empty())
+      {
+        ASSERT_EQ(query.numberOfResults(), 1u);
+        const auto nearest = std::min_element(expected.begin(), expected.end(), [](const Result &a, const Result &b) {
+          return a.second < b.second;
+        });
+        EXPECT_NEAR(query.ranges()[0], nearest->second, 1e-5f);
+      }
+      else
+      {
+        EXPECT_EQ(query.numberOfResults(), 0u);
+      }
+    }
+  }
+
+  // Results update when the map changes.
+  const glm::dvec3 near_point(0.05);
+  NearestNeighbours query(map, near_point, 0.5f, 0u);
+  Key key = map.voxelKey(near_point);
+  integrateHit(map, key);
+  ASSERT_TRUE(query.execute());
+  const std::vector<Result> results = queryResults(query);
+  EXPECT_TRUE(std::any_of(results.begin(), results.end(), [&key](const Result &result) {
+    return result.first == key;
+  }));
+}
+
+
+TEST(NearestNeighbours, CpuAsync)
+{
+  OccupancyMap map(0.1, glm::u8vec3(16));
+  buildMap(map, 24, 400, 0xbu);
+
+  std::mt19937 rand_engine(0xcu);
+  std::uniform_real_distribution<double> rand(-2.0, 2.0);
+  const float search_radius = 0.6f;
+  std::vector<std::unique_ptr<NearestNeighbours>> queries;
+  for (int i = 0; i < 16; ++i)
+  {
+    const glm::dvec3 near_point(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    queries.emplace_back(new NearestNeighbours(map, near_point, search_radius, 0u));
+  }
+
+  // Start all queries before waiting on any of them.
+  for (auto &query : queries)
+  {
+    ASSERT_TRUE(query->executeAsync());
+  }
+
+  for (auto &query : queries)
+  {
+    ASSERT_TRUE(query->wait());
+    EXPECT_TRUE(query->asyncResult());
+    std::vector<Result> results = queryResults(*query);
+    std::vector<Result> expected = referenceNearestNeighbours(map, query->nearPoint(), search_radius, 0u);
+    std::sort(results.begin(), results.end(), resultLess);
+    std::sort(expected.begin(), expected.end(), resultLess);
+    ASSERT_EQ(results.size(), expected.size());
+    for (size_t j = 0; j < results.size(); ++j)
+    {
+      EXPECT_EQ(results[j].first, expected[j].first);
+    }
+  }
+
+  // Waiting with nothing outstanding succeeds immediately, while a query may be restarted once complete. Destroying a
+  // running query waits for completion.
+  EXPECT_TRUE(queries.front()->wait(0));
+  ASSERT_TRUE(queries.front()->executeAsync());
+  queries.clear();
+
+  // A failed execution is reported by asyncResult().
+  NearestNeighbours no_map_query(map, glm::dvec3(0.0), search_radius, 0u);
+  no_map_query.setMap(nullptr);
+  ASSERT_TRUE(no_map_query.executeAsync());
+  ASSERT_TRUE(no_map_query.wait());
+  EXPECT_FALSE(no_map_query.asyncResult());
+}
+
+TEST(NearestNeighbours, Benchmark)
+{
+  struct Config
+  {
+    const char *name;
+    unsigned occupied_count;
+  };
+  const Config configs[] = { { "sparse", 200 }, { "dense", 200000 } };
+  const float search_radius = 0.5f;
+
+  for (const Config &config : configs)
+  {
+    OccupancyMap map(0.1, glm::u8vec3(32));
+    buildMap(map, 64, config.occupied_count, 0x7u);
+
+    std::mt19937 rand_engine(0x8u);
+    std::uniform_real_distribution<double> rand(-6.0, 6.0);
+    std::vector<glm::dvec3> points(200);
+    for (glm::dvec3 &point : points)
+    {
+      point = glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    }
+
+    size_t reference_count = 0;
+    auto start_time = Clock::now();
+    for (const glm::dvec3 &point : points)
+    {
+      reference_count += referenceNearestNeighbours(map, point, search_radius, 0u).size();
+    }
+    const double reference_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+    // The first query over each region builds its occupied voxel mask.
+    NearestNeighbours query(map, glm::dvec3(0), search_radius, 0u);
+    size_t query_count = 0;
+    double query_times[2] = { 0, 0 };
+    for (double &query_time : query_times)
+    {
+      query_count = 0;
+      start_time = Clock::now();
+      for (const glm::dvec3 &point : points)
+      {
+        query.setNearPoint(point);
+        query.execute();
+        query_count += query.numberOfResults();
+      }
+      query_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+    }
+
+    EXPECT_EQ(query_count, reference_count);
+    std::cout << "Nearest neighbours " << config.name << " (" << points.size() << " queries, " << reference_count
+              << " results): scan " << reference_time << "s, first " << query_times[0] << "s, cached "
+              << query_times[1] << "s" << std::endl;
+  }
+}
+
+TEST(KNearestOccupied, Cpu)
+{
+  OccupancyMap map(0.1, glm::u8vec3(16));
+  buildMap(map, 24, 400, 0x9u);
+
+  std::mt19937 rand_engine(0xau);
+  std::uniform_real_distribution<double> rand(-3.0, 3.0);
+  std::vector<glm::dvec3> points(20);
+  for (glm::dvec3 &point : points)
+  {
+    point = glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+  }
+
+  struct Config
+  {
+    unsigned flags;
+    float search_radius;
+  };
+  // An unlimited search is only validated without kQfUnknownAsOccupied as the reference scan must cover the results.
+  const Config configs[] = { { 0u, 0.0f }, { 0u, 0.6f }, { unsigned(kQfUnknownAsOccupied), 0.6f } };
+  for (const Config &config : configs)
+  {
+    for (const unsigned k : { 1u, 5u })
+    {
+      KNearestOccupied query(map, glm::dvec3(0), k, config.flags);
+      query.setNearPoints(points.data(), points.size());
+      query.setSearchRadius(config.search_radius);
+      ASSERT_TRUE(query.execute());
+      ASSERT_NE(query.resultOffsets(), nullptr);
+      EXPECT_EQ(query.resultOffsets()[points.size()], query.numberOfResults());
+
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        const float reference_radius = (config.search_radius > 0) ? config.search_radius : 10.0f;
+        std::vector<Result> expected = referenceNearestNeighbours(map, points[i], reference_radius, config.flags);
+        std::sort(expected.begin(), expected.end(),
+                  [](const Result &a, const Result &b) { return a.second < b.second; });
+        expected.resize(std::min<size_t>(expected.size(), k));
+
+        const size_t begin = query.resultOffsets()[i];
+        const size_t end = query.resultOffsets()[i + 1];
+        ASSERT_EQ(end - begin, expected.size());
+        for (size_t j = begin; j < end; ++j)
+        {
+          // Keys may differ for equidistant voxels, so only validate ranges.
+          EXPECT_NEAR(query.ranges()[j], expected[j - begin].second, 1e-5f);
+          if (j > begin)
+          {
+            EXPECT_LE(query.ranges()[j - 1], query.ranges()[j]);
+          }
+        }
+      }
+
+      // Nearest result only limits the results to one per point.
+      query.setQueryFlags(config.flags | kQfNearestResult);
+      ASSERT_TRUE(query.execute());
+      for (size_t i = 0; i < points.size(); ++i)
+      {
+        EXPECT_LE(query.resultOffsets()[i + 1] - query.resultOffsets()[i], 1u);
+      }
+    }
+  }
+}
+
+TEST(KNearestOccupied, OutsideMap)
+{
+  OccupancyMap map(0.1, glm::u8vec3(16));
+  buildMap(map, 24, 400, 0x9u);
+
+  // Query points several regions outside the map, along an axis and diagonally.
+  const glm::dvec3 points[] = { glm::dvec3(0.3, -0.2, 8.0), glm::dvec3(-6.0, 7.0, -5.5) };
+  const unsigned k = 3;
+  KNearestOccupied query(map, glm::dvec3(0), k);
+  query.setNearPoints(points, sizeof(points) / sizeof(points[0]));
+  ASSERT_TRUE(query.execute());
+
+  for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); ++i)
+  {
+    std::vector<Result> expected = referenceNearestNeighbours(map, points[i], 14.0f, 0u);
+    std::sort(expected.begin(), expected.end(), [](const Result &a, const Result &b) { return a.second < b.second; });
+    expected.resize(std::min<size_t>(expected.size(), k));
+    ASSERT_EQ(expected.size(), k);
+
+    const size_t begin = query.resultOffsets()[i];
+    const size_t end = query.resultOffsets()[i + 1];
+    ASSERT_EQ(end - begin, expected.size());
+    for (size_t j = begin; j < end; ++j)
+    {
+      EXPECT_NEAR(query.ranges()[j], expected[j - begin].second, 1e-5f);
+    }
+  }
+}
+}  // namespace nearestneighbourstests
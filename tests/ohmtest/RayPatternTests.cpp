@@ -7,13 +7,19 @@
 
 #include "RayValidation.h"
 
+#include <ohm/MapLayout.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/OccupancyPyramid.h>
+#include <ohm/RayFlag.h>
 #include <ohm/RayPatternConical.h>
 #include <ohm/VoxelData.h>
 
+#include <ohmtools/OhmGen.h>
+
 #include <3esservermacros.h>
 
 #include <cstdio>
+#include <random>
 #include <vector>
 
 #include <glm/ext.hpp>
@@ -213,4 +219,119 @@ TEST(RayPattern, Clearing)
   }
   voxel_read.reset();
 }
+
+TEST(RayPattern, ClearingSkipEmptyBlocks)
+{
+  // Clear the same maps with and without kRfSkipEmptyBlocks and validate the results match. The maps have the
+  // pyramid layers so skipping uses the OccupancyPyramid.
+  const auto build_map = [](OccupancyMap &map) {
+    OccupancyPyramid pyramid(&map);
+    ohmgen::fillMapWithEmptySpace(map, -30, -30, -30, 29, 29, 29);
+    std::mt19937 rand_engine(0x34u);
+    std::uniform_int_distribution<int> rand(-30, 29);
+    for (unsigned i = 0; i < 2000; ++i)
+    {
+      Key key(0, 0, 0, 0, 0, 0);
+      map.moveKey(key, rand(rand_engine), rand(rand_engine), rand(rand_engine));
+      integrateHit(map, key);
+    }
+  };
+
+  OccupancyMap reference_map(0.1, glm::u8vec3(16));
+  OccupancyMap skip_map(0.1, glm::u8vec3(16));
+  build_map(reference_map);
+  build_map(skip_map);
+  ASSERT_TRUE(OccupancyPyramid(&skip_map).isValid());
+
+  const auto count_occupied = [](const OccupancyMap &map) {
+    Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+    unsigned count = 0;
+    for (auto iter = map.begin(); iter != map.end(); ++iter)
+    {
+      voxel.setKey(*iter);
+      count += isOccupied(voxel);
+    }
+    return count;
+  };
+  const unsigned initial_occupied_count = count_occupied(reference_map);
+
+  RayPattern pattern;
+  std::mt19937 rand_engine(0x35u);
+  std::uniform_real_distribution<double> rand(-1.0, 1.0);
+  for (unsigned i = 0; i < 500; ++i)
+  {
+    pattern.addPoint(3.5 * glm::normalize(glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine))));
+  }
+
+  ClearingPattern reference_clearing(&pattern, false);
+  ClearingPattern skip_clearing(&pattern, false);
+  skip_clearing.setRayFlags(skip_clearing.rayFlags() | kRfSkipEmptyBlocks);
+
+  // Repeated application from nearby positions clears voxels in regions modified by earlier applications.
+  for (unsigned i = 0; i < 6; ++i)
+  {
+    const glm::dvec3 position(0.3 * rand(rand_engine), 0.3 * rand(rand_engine), 0.3 * rand(rand_engine));
+    reference_clearing.apply(&reference_map, position, glm::dquat(1, 0, 0, 0));
+    skip_clearing.apply(&skip_map, position, glm::dquat(1, 0, 0, 0));
+  }
+
+  // Validate the clearing has had an effect.
+  const unsigned occupied_count = count_occupied(reference_map);
+  EXPECT_GT(occupied_count, 0u);
+  EXPECT_LT(occupied_count, initial_occupied_count);
+
+  Voxel<const float> reference_voxel(&reference_map, reference_map.layout().occupancyLayer());
+  Voxel<const float> skip_voxel(&skip_map, skip_map.layout().occupancyLayer());
+  for (auto iter = reference_map.begin(); iter != reference_map.end(); ++iter)
+  {
+    reference_voxel.setKey(*iter);
+    skip_voxel.setKey(*iter);
+    float reference_value = unobservedOccupancyValue();
+    float skip_value = unobservedOccupancyValue();
+    reference_voxel.read(&reference_value);
+    if (skip_voxel.isValid())
+    {
+      skip_voxel.read(&skip_value);
+    }
+    ASSERT_EQ(skip_value, reference_value);
+  }
+  reference_voxel.reset();
+  skip_voxel.reset();
+
+  // A voxel exactly at the occupancy threshold is the first occupied voxel along the ray. Both paths must stop there
+  // and leave the occupied voxel beyond it unchanged.
+  const auto build_threshold_map = [](OccupancyMap &map) {
+    OccupancyPyramid pyramid(&map);
+    ohmgen::fillMapWithEmptySpace(map, -5, -5, -5, 30, 5, 5);
+    Voxel<float> voxel(&map, map.layout().occupancyLayer(), map.voxelKey(glm::dvec3(1.05, 0.05, 0.05)));
+    voxel.write(map.occupancyThresholdValue());
+    voxel.setKey(map.voxelKey(glm::dvec3(2.05, 0.05, 0.05)));
+    voxel.write(map.maxVoxelValue());
+  };
+
+  OccupancyMap threshold_reference_map(0.1, glm::u8vec3(16));
+  OccupancyMap threshold_skip_map(0.1, glm::u8vec3(16));
+  build_threshold_map(threshold_reference_map);
+  build_threshold_map(threshold_skip_map);
+
+  RayPattern threshold_pattern;
+  threshold_pattern.addPoint(glm::dvec3(2.85, 0.0, 0.0));
+  ClearingPattern threshold_reference_clearing(&threshold_pattern, false);
+  ClearingPattern threshold_skip_clearing(&threshold_pattern, false);
+  threshold_skip_clearing.setRayFlags(threshold_skip_clearing.rayFlags() | kRfSkipEmptyBlocks);
+  const glm::dvec3 origin(0.05, 0.05, 0.05);
+  threshold_reference_clearing.apply(&threshold_reference_map, origin, glm::dquat(1, 0, 0, 0));
+  threshold_skip_clearing.apply(&threshold_skip_map, origin, glm::dquat(1, 0, 0, 0));
+
+  for (const OccupancyMap *map : { &threshold_reference_map, &threshold_skip_map })
+  {
+    Voxel<const float> voxel(map, map->layout().occupancyLayer(), map->voxelKey(glm::dvec3(1.05, 0.05, 0.05)));
+    float value = unobservedOccupancyValue();
+    voxel.read(&value);
+    EXPECT_LT(value, map->occupancyThresholdValue());
+    voxel.setKey(map->voxelKey(glm::dvec3(2.05, 0.05, 0.05)));
+    voxel.read(&value);
+    EXPECT_EQ(value, map->maxVoxelValue());
+  }
+}
 }  // namespace raypattern
@@ -56,7 +56,7 @@ void lineQueryTest(OccupancyMap &map, bool gpu)
 {
   const double map_res = map.resolution();
   LineQueryGpu query(map, glm::dvec3(0) - glm::dvec3(map_res), glm::dvec3(0), 2.0f,
-                     LineQuery::kDefaultFlags | kQfNearestResult);
+                     LineQueryGpu::kDefaultFlags | kQfNearestResult);
   query.setStartPoint(glm::dvec3(-2, 0, 0));
   query.setEndPoint(glm::dvec3(2, 0, 0));
   if (gpu)
@@ -253,7 +253,7 @@ TEST(LineQuery, CpuVsGpuPerf)
 
   query.setStartPoint(glm::dvec3(-5, 0, 0));
   query.setEndPoint(glm::dvec3(5, 0, 0));
-  query.setQueryFlags(LineQuery::kDefaultFlags | kQfNearestResult);
+  query.setQueryFlags(LineQueryGpu::kDefaultFlags | kQfNearestResult);
 
   std::cout << "Execute " << iterations << " query iterations." << std::endl;
 
@@ -332,7 +332,8 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
       std::cerr << "Missing '" << ohm::HeightmapVoxel::kHeightmapLayer << "' layer" << std::endl;
       return -1;
     }
-    if (layer->voxelByteSize() < sizeof(ohm::HeightmapVoxel))
+    if (layer->voxelByteSize() < sizeof(ohm::HeightmapVoxel) &&
+        layer->voxelByteSize() != sizeof(ohm::HeightmapVoxelCompact))
     {
       std::cerr << "Layer '" << ohm::HeightmapVoxel::kHeightmapLayer << "' is not large enough. Expect "
                 << sizeof(ohm::HeightmapVoxel) << " actual " << layer->voxelByteSize() << std::endl;
@@ -387,7 +388,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   std::cout << "Converting to PLY cloud" << std::endl;
   glm::vec3 v;
   const size_t region_count = map.regionCount();
-  glm::i16vec3 last_region = map.begin().key().regionKey();
+  ohm::RegionKey last_region = map.begin().key().regionKey();
   uint64_t point_count = 0;
 
   prog.beginProgress(ProgressMonitor::Info(region_count));
@@ -396,7 +397,11 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   ohm::Voxel<const float> clearance(&map, map.layout().clearanceLayer());
   ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
   ohm::Voxel<const ohm::HeightmapVoxel> height(&map, map.layout().layerIndex(ohm::HeightmapVoxel::kHeightmapLayer));
-  for (auto iter = map.begin(); iter != map.end() && !g_quit; ++iter)
+  ohm::Voxel<const ohm::HeightmapVoxelCompact> height_compact(
+    &map, map.layout().layerIndex(ohm::HeightmapVoxel::kHeightmapLayer));
+  // Only clearance export considers unobserved voxels. Other modes can skip them.
+  const auto begin_iter = (opt.mode == kExportClearance) ? map.begin() : map.beginObserved();
+  for (auto iter = begin_iter; iter != map.end() && !g_quit; ++iter)
   {
     clearance.setKey(mean.setKey(occupancy.setKey(iter)));
     if (last_region != iter->regionKey())
@@ -434,11 +439,20 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     {
       if (occupancy.isValid() && isOccupied(occupancy))
       {
-        height.setKey(occupancy);
-        if (height.isValid())
+        height_compact.setKey(height.setKey(occupancy));
+        if (height.isValid() || height_compact.isValid())
         {
           ohm::HeightmapVoxel voxel_height;
-          height.read(&voxel_height);
+          if (height_compact.isValid())
+          {
+            ohm::HeightmapVoxelCompact compact_height;
+            height_compact.read(&compact_height);
+            voxel_height = ohm::expandHeightmapVoxel(compact_height);
+          }
+          else
+          {
+            height.read(&voxel_height);
+          }
           auto c = uint8_t(std::numeric_limits<uint8_t>::max() *
                            std::max(0.0f, (opt.colour_scale - voxel_height.clearance) / opt.colour_scale));
           if (voxel_height.clearance <= 0)
@@ -563,7 +577,7 @@ int exportCovariance(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   };
 
   const size_t region_count = map.regionCount();
-  glm::i16vec3 last_region = map.begin().key().regionKey();
+  ohm::RegionKey last_region = map.begin().key().regionKey();
 
   ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
   ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
@@ -594,7 +608,7 @@ int exportCovariance(const Options &opt, ProgressMonitor &prog, LoadMapProgress
 
   prog.beginProgress(ProgressMonitor::Info(region_count));
 
-  for (auto iter = map.begin(); iter != map.end() && !g_quit; ++iter)
+  for (auto iter = map.beginObserved(); iter != map.end() && !g_quit; ++iter)
   {
     ohm::setVoxelKey(*iter, occupancy, mean, covariance);
     if (last_region != iter->regionKey())
@@ -55,6 +55,7 @@ struct Options
   double floor = 0;
   double ceiling = 0;
   bool no_voxel_mean = false;
+  bool compact = false;
 };
 
 
@@ -92,6 +93,8 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       ("ceiling", "Heightmap excludes voxels above this (positive) value above the --base height. Positive to enable.",
        optVal(opt->ceiling))                                                                         //
       ("no-voxel-mean", "Ignore voxel mean positioning if available?.", optVal(opt->no_voxel_mean))  //
+      ("compact", "Use the compact heightmap layout: half precision heights with 8-bit occupancy.",
+       optVal(opt->compact))  //
       ;
 
     opt_parse.parse_positional({ "i", "o" });
@@ -184,7 +187,7 @@ int main(int argc, char *argv[])
 
   const auto heightmap_start_time = Clock::now();
 
-  ohm::Heightmap heightmap(map.resolution(), opt.clearance, opt.axis_id);
+  ohm::Heightmap heightmap(map.resolution(), opt.clearance, opt.axis_id, 0, opt.compact);
   heightmap.setUseFloodFill(true);  // For better surface following.
   heightmap.setOccupancyMap(&map);
 
@@ -7,6 +7,7 @@
 #include <ohm/MapInfo.h>
 #include <ohm/MapLayer.h>
 #include <ohm/MapLayout.h>
+#include <ohm/MapMemoryUsage.h>
 #include <ohm/MapSerialise.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/OccupancyUtil.h>
@@ -45,6 +46,7 @@ struct Options
   std::string map_file;
   bool calculate_extents = false;
   bool detail = false;
+  bool memory = false;
 };
 }  // namespace
 
@@ -61,7 +63,9 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       "extents", "Report map extents? Requires region traversal",
       optVal(opt->calculate_extents)->implicit_value("true"))(
       "detail", "Traverse voxels for detailed information? min occupancy, max occupancy, max samples (if available)",
-      optVal(opt->detail)->implicit_value("true"));
+      optVal(opt->detail)->implicit_value("true"))(
+      "memory", "Report memory usage by layer and voxel block state? Requires loading all regions",
+      optVal(opt->memory)->implicit_value("true"));
 
     opt_parse.parse_positional({ "map" });
 
@@ -231,7 +235,7 @@ int main(int argc, char *argv[])
   }
 
   // Load full map if required
-  if (opt.calculate_extents || opt.detail)
+  if (opt.calculate_extents || opt.detail || opt.memory)
   {
     // Reload the map for full extents.
     res = ohm::load(opt.map_file.c_str(), map);
@@ -255,6 +259,33 @@ int main(int argc, char *argv[])
     std::cout << "Key Extents: " << min_key << " - " << max_key << std::endl;
   }
 
+  if (opt.memory)
+  {
+    ohm::MapMemoryUsage usage;
+    map.memoryUsage(&usage);
+    std::string bytes_str;
+
+    std::cout << std::endl;
+    ohm::util::makeMemoryDisplayString(bytes_str, usage.totalBytes());
+    std::cout << "Memory usage: " << bytes_str << std::endl;
+    ohm::util::makeMemoryDisplayString(bytes_str, usage.chunk_bytes);
+    std::cout << "  regions: " << usage.chunk_count << " : " << bytes_str << std::endl;
+    ohm::util::makeMemoryDisplayString(bytes_str, usage.index_bytes);
+    std::cout << "  index: " << bytes_str << std::endl;
+    for (const ohm::LayerMemoryUsage &layer : usage.layers)
+    {
+      ohm::util::makeMemoryDisplayString(bytes_str, layer.totalBytes());
+      std::cout << "  " << layer.name << ": " << bytes_str << std::endl;
+      for (unsigned i = 0; i < unsigned(ohm::VoxelBlockState::kCount); ++i)
+      {
+        const auto state = ohm::VoxelBlockState(i);
+        ohm::util::makeMemoryDisplayString(bytes_str, layer.bytes(state));
+        std::cout << "    " << ohm::voxelBlockStateName(state) << ": " << layer.blocks(state) << " blocks : " << bytes_str
+                  << std::endl;
+      }
+    }
+  }
+
   if (opt.detail)
   {
     float min_occupancy = std::numeric_limits<float>::max();
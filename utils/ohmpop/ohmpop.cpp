@@ -7,6 +7,7 @@
 
 #include <slamio/SlamCloudLoader.h>
 
+#include <ohm/MapMemoryUsage.h>
 #include <ohm/MapSerialise.h>
 #include <ohm/Mapper.h>
 #include <ohm/NdtMap.h>
@@ -15,6 +16,7 @@
 #include <ohm/RayMapperNdt.h>
 #include <ohm/RayMapperOccupancy.h>
 #include <ohm/RayMapperTrace.h>
+#include <ohm/RegionPrefetcher.h>
 #include <ohm/Trace.h>
 #include <ohm/VoxelData.h>
 
@@ -108,6 +110,10 @@ struct Options
   bool save_info = false;
   bool voxel_mean = false;
   bool uncompressed = false;
+  /// Sensor range for predictive region prefetch. Zero disables prefetch.
+  double prefetch_range = 0;
+  /// Occupancy quantisation bits: 0 (float), 16 or 8.
+  unsigned quantise_bits = 0;
 #ifndef OHMPOP_CPU
   double mapping_interval = 0.2;  // NOLINT(readability-magic-numbers)
   double progressive_mapping_slice = 0.0;
@@ -198,6 +204,9 @@ void Options::print(std::ostream **out, const ohm::OccupancyMap &map) const
     **out << "Voxel mean position: " << (map.voxelMeanEnabled() ? "on" : "off") << '\n';
     **out << "Compressed: " << ((map.flags() & ohm::MapFlag::kCompressed) == ohm::MapFlag::kCompressed ? "on" : "off")
           << '\n';
+    **out << "Occupancy quantisation: " << (quantise_bits ? std::to_string(quantise_bits) + " bit" : "off")
+          << '\n';
+    **out << "Region prefetch: " << (prefetch_range > 0 ? std::to_string(prefetch_range) : "off") << '\n';
     glm::i16vec3 region_dim = region_voxel_dim;
     region_dim.x = (region_dim.x) ? region_dim.x : OHM_DEFAULT_CHUNK_DIM_X;
     region_dim.y = (region_dim.y) ? region_dim.y : OHM_DEFAULT_CHUNK_DIM_Y;
@@ -324,7 +333,7 @@ void saveMap(const Options &opt, const ohm::OccupancyMap &map, const std::string
     glm::vec3 v;
     const auto map_end_iter = map.end();
     const size_t region_count = map.regionCount();
-    glm::i16vec3 last_region = map.begin().key().regionKey();
+    ohm::RegionKey last_region = map.begin().key().regionKey();
     uint64_t point_count = 0;
 
     if (prog)
@@ -428,6 +437,8 @@ int populateMap(const Options &opt)
   ohm::MapFlag map_flags = ohm::MapFlag::kDefault;
   map_flags |= (opt.voxel_mean) ? ohm::MapFlag::kVoxelMean : ohm::MapFlag::kNone;
   map_flags &= (opt.uncompressed) ? ~ohm::MapFlag::kCompressed : ~ohm::MapFlag::kNone;
+  map_flags |= (opt.quantise_bits == 16) ? ohm::MapFlag::kQuantisedOccupancy16 : ohm::MapFlag::kNone;  // NOLINT
+  map_flags |= (opt.quantise_bits == 8) ? ohm::MapFlag::kQuantisedOccupancy8 : ohm::MapFlag::kNone;    // NOLINT
   ohm::OccupancyMap map(opt.resolution, opt.region_voxel_dim, map_flags);
 #ifdef OHMPOP_CPU
   std::unique_ptr<ohm::NdtMap> ndt_map;
@@ -648,6 +659,13 @@ int populateMap(const Options &opt)
     std::cout << "Preload completed over " << preload_time << " seconds." << std::endl;
   }
 
+  std::unique_ptr<ohm::RegionPrefetcher> prefetcher;
+  if (opt.prefetch_range > 0)
+  {
+    prefetcher = std::make_unique<ohm::RegionPrefetcher>(map);
+    prefetcher->setSensorRange(opt.prefetch_range);
+  }
+
   start_time = Clock::now();
   std::cout << "Populating map" << std::endl;
 
@@ -693,6 +711,10 @@ int populateMap(const Options &opt)
 
     if (point_count % ray_batch_size == 0 || g_quit)
     {
+      if (prefetcher)
+      {
+        prefetcher->observeRays(origin_sample_pairs.data(), origin_sample_pairs.size(), timestamp);
+      }
       ray_mapper->integrateRays(origin_sample_pairs.data(), unsigned(origin_sample_pairs.size()), opt.ray_mode_flags);
       delta_motion = glm::length(origin_sample_pairs[0] - last_batch_origin);
       accumulated_motion += delta_motion;
@@ -752,6 +774,13 @@ int populateMap(const Options &opt)
   }
   end_time = Clock::now();
 
+  ohm::RegionPrefetcher::Stats prefetch_stats;
+  if (prefetcher)
+  {
+    prefetch_stats = prefetcher->stats();
+    prefetcher.reset();
+  }
+
   prog.endProgress();
   prog.pause();
 
@@ -808,6 +837,25 @@ int populateMap(const Options &opt)
     *out << "Points/sec: " << unsigned((processing_time_sec > 0) ? point_count / processing_time_sec : 0.0) << '\n';
     const double mibibytes = 1024 * 1024;
     *out << "Memory (approx): " << map.calculateApproximateMemory() / (mibibytes) << " MiB\n";
+    ohm::MapMemoryUsage memory_usage;
+    map.memoryUsage(&memory_usage);
+    *out << "Memory (accounted): " << memory_usage.totalBytes() / mibibytes << " MiB\n";
+    for (const ohm::LayerMemoryUsage &layer : memory_usage.layers)
+    {
+      *out << "  " << layer.name << ": " << layer.totalBytes() / mibibytes << " MiB";
+      for (unsigned i = 0; i < unsigned(ohm::VoxelBlockState::kCount); ++i)
+      {
+        const auto state = ohm::VoxelBlockState(i);
+        *out << ' ' << ohm::voxelBlockStateName(state) << ' ' << layer.blocks(state) << '/'
+             << layer.bytes(state) / mibibytes << " MiB";
+      }
+      *out << '\n';
+    }
+    if (opt.prefetch_range > 0)
+    {
+      *out << "Prefetched regions: " << prefetch_stats.prefetched << " hits: " << prefetch_stats.hits
+           << " misses: " << prefetch_stats.misses << " waste: " << prefetch_stats.waste << '\n';
+    }
     *out << std::flush;
   }
 
@@ -879,6 +927,8 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       ("dim", "Set the voxel dimensions of each region in the map. Range for each is [0, 255).", optVal(opt->region_voxel_dim))
       ("hit", "The occupancy probability due to a hit. Must be >= 0.5.", optVal(opt->prob_hit))
       ("miss", "The occupancy probability due to a miss. Must be < 0.5.", optVal(opt->prob_miss))
+      ("prefetch", "Predictively decompress regions within this range of the extrapolated sensor path on a background thread. Zero to disable.", optVal(opt->prefetch_range))
+      ("quantise", "Store occupancy as fixed point log-odds values with this many bits [0, 8, 16]. Zero stores floats.", optVal(opt->quantise_bits))
       ("resolution", "The voxel resolution of the generated map.", optVal(opt->resolution))
       ("uncompressed", "Maintain uncompressed map. By default, may regions may be compressed when no longer needed.", optVal(opt->uncompressed))
       ("voxel-mean", "Enable voxel mean coordinates?", optVal(opt->voxel_mean))
@@ -937,6 +987,12 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       return -1;
     }
 
+    if (opt->quantise_bits != 0 && opt->quantise_bits != 8 && opt->quantise_bits != 16)  // NOLINT
+    {
+      std::cerr << "Invalid quantise bits: " << opt->quantise_bits << std::endl;
+      return -1;
+    }
+
     // Derive ray_mode_flags from mode
     if (opt->mode == "normal")
     {
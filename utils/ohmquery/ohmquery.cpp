@@ -329,8 +329,8 @@ void saveRangesCloud(const ohm::OccupancyMap &map, const ohm::VoxelRanges &query
   glm::vec3 v;
   auto mapEndIter = map.end();
   size_t regionCount = map.regionCount();
-  glm::i16vec3 lastRegion = map.begin().key().regionKey();
-  glm::i16vec3 minRegion, maxRegion;
+  ohm::RegionKey lastRegion = map.begin().key().regionKey();
+  ohm::RegionKey minRegion, maxRegion;
   uint64_t pointCount = 0;
 
   prog.beginProgress(ProgressMonitor::Info(regionCount));